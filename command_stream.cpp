@@ -0,0 +1,302 @@
+#include "command_stream.h"
+
+#include <future>
+
+namespace
+{
+	struct command_header
+	{
+		command_stream::command_type type;
+		uint32_t size;	// bytes of arguments after the header, a multiple of 8
+	};
+
+	struct pointer_arguments
+	{
+		const void* pointer;
+	};
+	struct vertex_buffer_arguments
+	{
+		ID3D11Buffer* buffer;
+		uint32_t stride;
+		uint32_t offset;
+	};
+	struct index_buffer_arguments
+	{
+		ID3D11Buffer* buffer;
+		uint32_t index_size;
+		uint32_t offset;
+	};
+	// Followed by 'count' pointers.
+	struct shader_resources_arguments
+	{
+		uint32_t first_slot;
+		uint32_t count;
+	};
+	// Followed by 'size' bytes.
+	struct constants_arguments
+	{
+		uint32_t slot;
+		uint32_t size;
+	};
+	struct topology_arguments
+	{
+		command_stream::primitive_topology topology;
+	};
+	// Followed by stride * count bytes.
+	struct vertex_data_arguments
+	{
+		uint32_t stride;
+		uint32_t count;
+	};
+	struct draw_arguments
+	{
+		uint32_t vertex_count;
+		uint32_t start_vertex;
+	};
+	struct draw_indexed_arguments
+	{
+		uint32_t index_count;
+		uint32_t start_index;
+		int32_t base_vertex;
+	};
+	struct draw_indexed_instanced_arguments
+	{
+		uint32_t index_count;
+		uint32_t instance_count;
+		uint32_t start_index;
+		int32_t base_vertex;
+	};
+
+	template <class T>
+	T read(const uint8_t* p)
+	{
+		T value;
+		memcpy(&value, p, sizeof(T));
+		return value;
+	}
+}
+
+void command_stream::clear()
+{
+	bytes.clear();
+	draw_calls = 0;
+	state_changes = 0;
+}
+
+void* command_stream::append(command_type type, size_t size)
+{
+	const size_t padded_size{ (size + 7) & ~static_cast<size_t>(7) };
+	const size_t offset{ bytes.size() };
+	bytes.resize(offset + sizeof(command_header) + padded_size);
+	const command_header header{ type, static_cast<uint32_t>(padded_size) };
+	memcpy(bytes.data() + offset, &header, sizeof(header));
+	return bytes.data() + offset + sizeof(command_header);
+}
+
+void command_stream::set_input_layout(ID3D11InputLayout* input_layout)
+{
+	append(set_input_layout_command, pointer_arguments{ input_layout });
+	++state_changes;
+}
+
+void command_stream::set_vertex_shader(ID3D11VertexShader* vertex_shader)
+{
+	append(set_vertex_shader_command, pointer_arguments{ vertex_shader });
+	++state_changes;
+}
+
+void command_stream::set_pixel_shader(ID3D11PixelShader* pixel_shader)
+{
+	append(set_pixel_shader_command, pointer_arguments{ pixel_shader });
+	++state_changes;
+}
+
+void command_stream::set_vertex_buffer(ID3D11Buffer* buffer, uint32_t stride, uint32_t offset)
+{
+	append(set_vertex_buffer_command, vertex_buffer_arguments{ buffer, stride, offset });
+	++state_changes;
+}
+
+void command_stream::set_index_buffer(ID3D11Buffer* buffer, uint32_t index_size, uint32_t offset)
+{
+	append(set_index_buffer_command, index_buffer_arguments{ buffer, index_size, offset });
+	++state_changes;
+}
+
+void command_stream::set_shader_resources(uint32_t first_slot, uint32_t count, ID3D11ShaderResourceView* const* shader_resource_views)
+{
+	uint8_t* p{ static_cast<uint8_t*>(append(set_shader_resources_command, sizeof(shader_resources_arguments) + sizeof(void*) * count)) };
+	const shader_resources_arguments arguments{ first_slot, count };
+	memcpy(p, &arguments, sizeof(arguments));
+	memcpy(p + sizeof(arguments), shader_resource_views, sizeof(void*) * count);
+	++state_changes;
+}
+
+void command_stream::set_constants(uint32_t slot, const void* data, uint32_t size)
+{
+	uint8_t* p{ static_cast<uint8_t*>(append(set_constants_command, sizeof(constants_arguments) + size)) };
+	const constants_arguments arguments{ slot, size };
+	memcpy(p, &arguments, sizeof(arguments));
+	memcpy(p + sizeof(arguments), data, size);
+	++state_changes;
+}
+
+void command_stream::set_topology(primitive_topology topology)
+{
+	append(set_topology_command, topology_arguments{ topology });
+	++state_changes;
+}
+
+void* command_stream::append_vertex_data(command_type type, uint32_t stride, uint32_t count)
+{
+	const size_t size{ static_cast<size_t>(stride) * count };
+	uint8_t* p{ static_cast<uint8_t*>(append(type, sizeof(vertex_data_arguments) + size)) };
+	const vertex_data_arguments arguments{ stride, count };
+	memcpy(p, &arguments, sizeof(arguments));
+	++state_changes;
+	return p + sizeof(arguments);
+}
+
+void* command_stream::set_instances(uint32_t stride, uint32_t count)
+{
+	return append_vertex_data(set_instances_command, stride, count);
+}
+
+void* command_stream::set_vertices(uint32_t stride, uint32_t count)
+{
+	return append_vertex_data(set_vertices_command, stride, count);
+}
+
+void command_stream::draw(uint32_t vertex_count, uint32_t start_vertex)
+{
+	append(draw_command, draw_arguments{ vertex_count, start_vertex });
+	++draw_calls;
+}
+
+void command_stream::draw_indexed(uint32_t index_count, uint32_t start_index, int32_t base_vertex)
+{
+	append(draw_indexed_command, draw_indexed_arguments{ index_count, start_index, base_vertex });
+	++draw_calls;
+}
+
+void command_stream::draw_indexed_instanced(uint32_t index_count, uint32_t instance_count, uint32_t start_index, int32_t base_vertex)
+{
+	append(draw_indexed_instanced_command, draw_indexed_instanced_arguments{ index_count, instance_count, start_index, base_vertex });
+	++draw_calls;
+}
+
+void command_stream::call(const std::function<void(ID3D11DeviceContext*)>* function)
+{
+	append(call_command, pointer_arguments{ function });
+}
+
+void replay(const command_stream& stream, command_backend& backend)
+{
+	const uint8_t* p{ stream.data() };
+	const uint8_t* end{ p + stream.size() };
+	while (p < end)
+	{
+		const command_header header{ read<command_header>(p) };
+		const uint8_t* arguments{ p + sizeof(command_header) };
+		switch (header.type)
+		{
+		case command_stream::set_input_layout_command:
+			backend.set_input_layout(static_cast<ID3D11InputLayout*>(const_cast<void*>(read<pointer_arguments>(arguments).pointer)));
+			break;
+		case command_stream::set_vertex_shader_command:
+			backend.set_vertex_shader(static_cast<ID3D11VertexShader*>(const_cast<void*>(read<pointer_arguments>(arguments).pointer)));
+			break;
+		case command_stream::set_pixel_shader_command:
+			backend.set_pixel_shader(static_cast<ID3D11PixelShader*>(const_cast<void*>(read<pointer_arguments>(arguments).pointer)));
+			break;
+		case command_stream::set_vertex_buffer_command:
+			{
+				const vertex_buffer_arguments a{ read<vertex_buffer_arguments>(arguments) };
+				backend.set_vertex_buffer(a.buffer, a.stride, a.offset);
+			}
+			break;
+		case command_stream::set_index_buffer_command:
+			{
+				const index_buffer_arguments a{ read<index_buffer_arguments>(arguments) };
+				backend.set_index_buffer(a.buffer, a.index_size, a.offset);
+			}
+			break;
+		case command_stream::set_topology_command:
+			backend.set_topology(read<topology_arguments>(arguments).topology);
+			break;
+		case command_stream::set_shader_resources_command:
+			{
+				const shader_resources_arguments a{ read<shader_resources_arguments>(arguments) };
+				ID3D11ShaderResourceView* shader_resource_views[command_stream::max_shader_resources];
+				memcpy(shader_resource_views, arguments + sizeof(a), sizeof(void*) * a.count);
+				backend.set_shader_resources(a.first_slot, a.count, shader_resource_views);
+			}
+			break;
+		case command_stream::set_constants_command:
+			{
+				const constants_arguments a{ read<constants_arguments>(arguments) };
+				backend.set_constants(a.slot, arguments + sizeof(a), a.size);
+			}
+			break;
+		case command_stream::set_instances_command:
+			{
+				const vertex_data_arguments a{ read<vertex_data_arguments>(arguments) };
+				backend.set_instances(arguments + sizeof(a), a.stride, a.count);
+			}
+			break;
+		case command_stream::set_vertices_command:
+			{
+				const vertex_data_arguments a{ read<vertex_data_arguments>(arguments) };
+				backend.set_vertices(arguments + sizeof(a), a.stride, a.count);
+			}
+			break;
+		case command_stream::draw_command:
+			{
+				const draw_arguments a{ read<draw_arguments>(arguments) };
+				backend.draw(a.vertex_count, a.start_vertex);
+			}
+			break;
+		case command_stream::draw_indexed_command:
+			{
+				const draw_indexed_arguments a{ read<draw_indexed_arguments>(arguments) };
+				backend.draw_indexed(a.index_count, a.start_index, a.base_vertex);
+			}
+			break;
+		case command_stream::draw_indexed_instanced_command:
+			{
+				const draw_indexed_instanced_arguments a{ read<draw_indexed_instanced_arguments>(arguments) };
+				backend.draw_indexed_instanced(a.index_count, a.instance_count, a.start_index, a.base_vertex);
+			}
+			break;
+		case command_stream::call_command:
+			backend.call(*static_cast<const std::function<void(ID3D11DeviceContext*)>*>(read<pointer_arguments>(arguments).pointer));
+			break;
+		}
+		p = arguments + header.size;
+	}
+}
+
+void record_parallel(std::vector<command_stream>& streams, size_t item_count,
+	const std::function<void(command_stream& stream, size_t first, size_t last)>& record)
+{
+	const size_t stream_count{ streams.size() };
+	std::vector<std::future<void>> workers;
+	for (size_t s = 0; s < stream_count; ++s)
+	{
+		streams[s].clear();
+		const size_t first{ item_count * s / stream_count };
+		const size_t last{ item_count * (s + 1) / stream_count };
+		if (s > 0 && first < last)
+		{
+			workers.push_back(std::async(std::launch::async, [&record, &streams, s, first, last]() { record(streams[s], first, last); }));
+		}
+	}
+	if (stream_count > 0 && item_count > 0)
+	{
+		record(streams[0], 0, item_count / stream_count);
+	}
+	for (std::future<void>& worker : workers)
+	{
+		worker.get();
+	}
+}
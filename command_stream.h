@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+// The command stream only carries these pointers; it never calls them, so it builds without the Direct3D headers.
+struct ID3D11DeviceContext;
+struct ID3D11Buffer;
+struct ID3D11InputLayout;
+struct ID3D11VertexShader;
+struct ID3D11PixelShader;
+struct ID3D11ShaderResourceView;
+
+// A compact byte stream of draw commands (bindings, constant and instance data written inline, draws), recorded on any
+// thread and replayed later, in order, to a command_backend on the thread that owns the device context.
+// Every command is a header (type and size) followed by its arguments, padded to 8 bytes.
+class command_stream
+{
+public:
+	enum command_type : uint32_t
+	{
+		set_input_layout_command,
+		set_vertex_shader_command,
+		set_pixel_shader_command,
+		set_vertex_buffer_command,
+		set_index_buffer_command,
+		set_topology_command,
+		set_shader_resources_command,
+		set_constants_command,
+		set_instances_command,
+		set_vertices_command,
+		draw_command,
+		draw_indexed_command,
+		draw_indexed_instanced_command,
+		call_command,
+	};
+	static constexpr uint32_t command_type_count{ call_command + 1 };
+	enum primitive_topology : uint32_t
+	{
+		triangle_list,
+		triangle_strip,
+	};
+	static constexpr uint32_t max_shader_resources{ 8 };
+
+	void clear();
+	bool empty() const { return bytes.empty(); }
+	size_t size() const { return bytes.size(); }
+	const uint8_t* data() const { return bytes.data(); }
+
+	void set_input_layout(ID3D11InputLayout* input_layout);
+	void set_vertex_shader(ID3D11VertexShader* vertex_shader);
+	void set_pixel_shader(ID3D11PixelShader* pixel_shader);
+	// Vertex buffer slot 0.
+	void set_vertex_buffer(ID3D11Buffer* buffer, uint32_t stride, uint32_t offset);
+	// 'index_size' is 2 (R16_UINT) or 4 (R32_UINT).
+	void set_index_buffer(ID3D11Buffer* buffer, uint32_t index_size, uint32_t offset);
+	void set_topology(primitive_topology topology);
+	// Pixel shader resources [first_slot, first_slot + count), count <= max_shader_resources.
+	void set_shader_resources(uint32_t first_slot, uint32_t count, ID3D11ShaderResourceView* const* shader_resource_views);
+	// Copies 'size' bytes of constants for register 'slot' of the vertex and pixel shaders.
+	void set_constants(uint32_t slot, const void* data, uint32_t size);
+	template <class T>
+	void set_constants(uint32_t slot, const T& data) { set_constants(slot, &data, sizeof(T)); }
+	// Reserves 'count' instances of 'stride' bytes for vertex buffer slot 1, read by the following instanced draws.
+	// Returns where to write them; the pointer is valid until the next command is recorded.
+	void* set_instances(uint32_t stride, uint32_t count);
+	// Same for vertex buffer slot 0, for geometry rebuilt every frame (sprites). Replaces the set_vertex_buffer binding.
+	void* set_vertices(uint32_t stride, uint32_t count);
+	void draw(uint32_t vertex_count, uint32_t start_vertex);
+	void draw_indexed(uint32_t index_count, uint32_t start_index, int32_t base_vertex);
+	void draw_indexed_instanced(uint32_t index_count, uint32_t instance_count, uint32_t start_index, int32_t base_vertex);
+	// Calls 'function' with the device context at replay, for drawing code that talks to the context itself.
+	// 'function' must stay alive until the stream is replayed. The backend assumes every binding was changed.
+	void call(const std::function<void(ID3D11DeviceContext*)>* function);
+
+	// Commands recorded since the last clear.
+	uint32_t draw_call_count() const { return draw_calls; }
+	uint32_t state_change_count() const { return state_changes; }
+
+private:
+	void* append(command_type type, size_t size);
+	void* append_vertex_data(command_type type, uint32_t stride, uint32_t count);
+	template <class T>
+	void append(command_type type, const T& arguments) { memcpy(append(type, sizeof(T)), &arguments, sizeof(T)); }
+
+	std::vector<uint8_t> bytes;
+	uint32_t draw_calls{ 0 };
+	uint32_t state_changes{ 0 };
+};
+
+// Executes replayed commands : the rendering device interface of the draw submission. d3d11_command_backend forwards
+// them to the immediate context, state_filter drops redundant ones and recording_command_backend only counts them.
+// Like command_stream, it only refers to Direct3D types by pointer and builds without the Windows headers.
+class command_backend
+{
+public:
+	virtual ~command_backend() = default;
+
+	virtual void set_input_layout(ID3D11InputLayout* input_layout) = 0;
+	virtual void set_vertex_shader(ID3D11VertexShader* vertex_shader) = 0;
+	virtual void set_pixel_shader(ID3D11PixelShader* pixel_shader) = 0;
+	virtual void set_vertex_buffer(ID3D11Buffer* buffer, uint32_t stride, uint32_t offset) = 0;
+	virtual void set_index_buffer(ID3D11Buffer* buffer, uint32_t index_size, uint32_t offset) = 0;
+	virtual void set_topology(command_stream::primitive_topology topology) = 0;
+	virtual void set_shader_resources(uint32_t first_slot, uint32_t count, ID3D11ShaderResourceView* const* shader_resource_views) = 0;
+	virtual void set_constants(uint32_t slot, const void* data, uint32_t size) = 0;
+	virtual void set_instances(const void* data, uint32_t stride, uint32_t count) = 0;
+	virtual void set_vertices(const void* data, uint32_t stride, uint32_t count) = 0;
+	virtual void draw(uint32_t vertex_count, uint32_t start_vertex) = 0;
+	virtual void draw_indexed(uint32_t index_count, uint32_t start_index, int32_t base_vertex) = 0;
+	virtual void draw_indexed_instanced(uint32_t index_count, uint32_t instance_count, uint32_t start_index, int32_t base_vertex) = 0;
+	virtual void call(const std::function<void(ID3D11DeviceContext*)>& function) = 0;
+};
+
+// Decodes 'stream' and calls 'backend' once per command, in recording order.
+void replay(const command_stream& stream, command_backend& backend);
+
+// Splits [0, item_count) into one contiguous range per stream and runs record(stream, first, last) for every
+// non-empty range, the first one on the calling thread and the others on worker threads. Replaying the streams in
+// order then gives the commands in item order.
+void record_parallel(std::vector<command_stream>& streams, size_t item_count,
+	const std::function<void(command_stream& stream, size_t first, size_t last)>& record);
@@ -0,0 +1,59 @@
+#include "constant_block.h"
+#include "misc.h"
+
+#include <cstring>
+
+constant_block::constant_block(ID3D11Device* device, ID3D11DeviceContext* immediate_context, std::initializer_list<size_t> section_sizes)
+{
+	HRESULT hr{ S_OK };
+
+	hr = immediate_context->QueryInterface<ID3D11DeviceContext1>(this->immediate_context.GetAddressOf());
+	_ASSERT_EXPR(SUCCEEDED(hr), hr_trace(hr));
+
+	// Offsets and sizes of VSSetConstantBuffers1 are multiples of 16 constants of 16 bytes.
+	UINT first_constant{ 0 };
+	for (size_t size : section_sizes)
+	{
+		const UINT constant_count{ static_cast<UINT>((size + 255) / 256 * 16) };
+		sections.push_back({ first_constant, constant_count });
+		first_constant += constant_count;
+	}
+	staged.resize(static_cast<size_t>(first_constant) * 16);
+
+	D3D11_BUFFER_DESC buffer_desc{};
+	buffer_desc.ByteWidth = static_cast<UINT>(staged.size());
+	buffer_desc.Usage = D3D11_USAGE_DEFAULT;
+	buffer_desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	hr = device->CreateBuffer(&buffer_desc, nullptr, buffer.GetAddressOf());
+	_ASSERT_EXPR(SUCCEEDED(hr), hr_trace(hr));
+}
+
+bool constant_block::set(size_t index, const void* data, size_t size)
+{
+	_ASSERT_EXPR(size <= sections[index].constant_count * 16, L"The data is larger than the section.");
+	uint8_t* destination{ staged.data() + sections[index].first_constant * 16 };
+	if (memcmp(destination, data, size) == 0)
+	{
+		return false;
+	}
+	memcpy(destination, data, size);
+	dirty = true;
+	return true;
+}
+
+size_t constant_block::upload()
+{
+	if (!dirty)
+	{
+		return 0;
+	}
+	immediate_context->UpdateSubresource(buffer.Get(), 0, 0, staged.data(), 0, 0);
+	dirty = false;
+	return staged.size();
+}
+
+void constant_block::bind(UINT slot, size_t index)
+{
+	immediate_context->VSSetConstantBuffers1(slot, 1, buffer.GetAddressOf(), &sections[index].first_constant, &sections[index].constant_count);
+	immediate_context->PSSetConstantBuffers1(slot, 1, buffer.GetAddressOf(), &sections[index].first_constant, &sections[index].constant_count);
+}
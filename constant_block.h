@@ -0,0 +1,41 @@
+#pragma once
+
+#include <d3d11_1.h>
+#include <wrl.h>
+
+#include <initializer_list>
+#include <vector>
+
+// A persistent constant buffer for constants that rarely change. It holds one or more sections, each starting on
+// a 256 byte boundary so it can be bound to its own register with VSSetConstantBuffers1. Sections are staged on
+// the CPU and the buffer is only uploaded when a staged section differs from what the GPU already has.
+class constant_block
+{
+public:
+	constant_block(ID3D11Device* device, ID3D11DeviceContext* immediate_context, std::initializer_list<size_t> section_sizes);
+	virtual ~constant_block() = default;
+	constant_block(const constant_block&) = delete;
+	constant_block& operator=(const constant_block&) = delete;
+
+	// Stages the contents of section 'index'. Returns true when they differ from the staged ones.
+	bool set(size_t index, const void* data, size_t size);
+	template <class T>
+	bool set(size_t index, const T& data) { return set(index, &data, sizeof(T)); }
+	// Uploads the whole buffer if a section changed since the last upload. Returns the number of bytes uploaded.
+	size_t upload();
+	// Binds section 'index' to register 'slot' of the vertex and pixel shaders.
+	void bind(UINT slot, size_t index);
+
+private:
+	struct section
+	{
+		UINT first_constant;
+		UINT constant_count;
+	};
+
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext1> immediate_context;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+	std::vector<section> sections;
+	std::vector<uint8_t> staged;
+	bool dirty{ true };
+};
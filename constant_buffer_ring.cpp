@@ -0,0 +1,115 @@
+#include "constant_buffer_ring.h"
+#include "misc.h"
+
+#include <cstring>
+
+namespace
+{
+	// VSSetConstantBuffers1 takes offsets and sizes in multiples of 16 constants of 16 bytes.
+	constexpr size_t slice_alignment{ 256 };
+	// Frames that may be queued before the CPU waits, bounded by the number of event queries.
+	constexpr size_t max_frames_in_flight{ 4 };
+}
+
+constant_buffer_ring::constant_buffer_ring(ID3D11Device* device, ID3D11DeviceContext* immediate_context, size_t capacity) :
+	allocator((capacity + slice_alignment - 1) & ~(slice_alignment - 1), slice_alignment)
+{
+	HRESULT hr{ S_OK };
+
+	hr = immediate_context->QueryInterface<ID3D11DeviceContext1>(this->immediate_context.GetAddressOf());
+	_ASSERT_EXPR(SUCCEEDED(hr), hr_trace(hr));
+
+	D3D11_FEATURE_DATA_D3D11_OPTIONS options{};
+	hr = device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options));
+	_ASSERT_EXPR(SUCCEEDED(hr), hr_trace(hr));
+	_ASSERT_EXPR(options.ConstantBufferOffsetting && options.MapNoOverwriteOnDynamicConstantBuffer, L"Constant buffer offsetting is not supported.");
+
+	D3D11_BUFFER_DESC buffer_desc{};
+	buffer_desc.ByteWidth = static_cast<UINT>(allocator.capacity());
+	buffer_desc.Usage = D3D11_USAGE_DYNAMIC;
+	buffer_desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	buffer_desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	hr = device->CreateBuffer(&buffer_desc, nullptr, buffer.GetAddressOf());
+	_ASSERT_EXPR(SUCCEEDED(hr), hr_trace(hr));
+
+	D3D11_QUERY_DESC query_desc{};
+	query_desc.Query = D3D11_QUERY_EVENT;
+	fences.resize(max_frames_in_flight);
+	for (Microsoft::WRL::ComPtr<ID3D11Query>& fence : fences)
+	{
+		hr = device->CreateQuery(&query_desc, fence.GetAddressOf());
+		_ASSERT_EXPR(SUCCEEDED(hr), hr_trace(hr));
+	}
+}
+
+void constant_buffer_ring::begin_frame()
+{
+	poll();
+	pushed_bytes = 0;
+}
+
+void constant_buffer_ring::end_frame()
+{
+	// The query of the frame max_frames_in_flight ago is reused, so that frame has to be finished.
+	if (submitted_fence + 1 > max_frames_in_flight)
+	{
+		poll(submitted_fence + 1 - max_frames_in_flight);
+	}
+	++submitted_fence;
+	immediate_context->End(fences[submitted_fence % fences.size()].Get());
+	allocator.end_frame(submitted_fence);
+}
+
+constant_buffer_ring::slice constant_buffer_ring::push(const void* data, size_t size)
+{
+	const size_t slice_size{ (size + slice_alignment - 1) & ~(slice_alignment - 1) };
+	size_t offset{ allocator.allocate(slice_size) };
+	while (offset == ring_allocator::npos)
+	{
+		// The ring is full : wait for the oldest frame in flight. If the current frame alone fills it, the capacity is too small.
+		_ASSERT_EXPR(allocator.frames_in_flight() > 0, L"The constant buffer ring is too small for one frame.");
+		if (allocator.frames_in_flight() == 0)
+		{
+			return {};
+		}
+		poll(allocator.oldest_fence());
+		offset = allocator.allocate(slice_size);
+	}
+
+	HRESULT hr{ S_OK };
+	D3D11_MAPPED_SUBRESOURCE mapped_subresource{};
+	hr = immediate_context->Map(buffer.Get(), 0, mapped ? D3D11_MAP_WRITE_NO_OVERWRITE : D3D11_MAP_WRITE_DISCARD, 0, &mapped_subresource);
+	_ASSERT_EXPR(SUCCEEDED(hr), hr_trace(hr));
+	memcpy(static_cast<uint8_t*>(mapped_subresource.pData) + offset, data, size);
+	immediate_context->Unmap(buffer.Get(), 0);
+	mapped = true;
+	pushed_bytes += slice_size;
+
+	return { static_cast<UINT>(offset / 16), static_cast<UINT>(slice_size / 16) };
+}
+
+void constant_buffer_ring::bind(UINT slot, const slice& slice)
+{
+	immediate_context->VSSetConstantBuffers1(slot, 1, buffer.GetAddressOf(), &slice.first_constant, &slice.constant_count);
+	immediate_context->PSSetConstantBuffers1(slot, 1, buffer.GetAddressOf(), &slice.first_constant, &slice.constant_count);
+}
+
+void constant_buffer_ring::poll(uint64_t fence)
+{
+	while (completed_fence < submitted_fence)
+	{
+		ID3D11Query* query{ fences[(completed_fence + 1) % fences.size()].Get() };
+		BOOL done{ FALSE };
+		// Flushing only while blocking, so that polling never stalls the command stream.
+		const bool waiting{ completed_fence < fence };
+		if (immediate_context->GetData(query, &done, sizeof(done), waiting ? 0 : D3D11_ASYNC_GETDATA_DONOTFLUSH) == S_OK && done)
+		{
+			++completed_fence;
+		}
+		else if (!waiting)
+		{
+			break;
+		}
+	}
+	allocator.retire(completed_fence);
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <d3d11_1.h>
+#include <wrl.h>
+
+#include <vector>
+
+#include "ring_allocator.h"
+
+// One large dynamic constant buffer shared by every per-frame and per-draw constant block. Each push maps it with
+// WRITE_NO_OVERWRITE, copies the block to a 256 byte aligned slice and the slice is bound with VSSetConstantBuffers1.
+// Frames are fenced with event queries, so a slice is only overwritten once the GPU has consumed it.
+// Needs a Direct3D 11.1 runtime with constant buffer offsetting.
+class constant_buffer_ring
+{
+public:
+	// A pushed constant block, as the offset and size in shader constants (16 bytes) of VSSetConstantBuffers1.
+	struct slice
+	{
+		UINT first_constant{ 0 };
+		UINT constant_count{ 0 };
+	};
+
+	constant_buffer_ring(ID3D11Device* device, ID3D11DeviceContext* immediate_context, size_t capacity = 4 * 1024 * 1024);
+	virtual ~constant_buffer_ring() = default;
+	constant_buffer_ring(const constant_buffer_ring&) = delete;
+	constant_buffer_ring& operator=(const constant_buffer_ring&) = delete;
+
+	// Releases the slices of the frames the GPU has finished. Call once per frame before the first push.
+	void begin_frame();
+	// Fences the slices pushed since begin_frame. Call after the last draw of the frame.
+	void end_frame();
+
+	// Copies 'size' bytes to a free slice. Waits for the GPU when the ring is full.
+	slice push(const void* data, size_t size);
+	template <class T>
+	slice push(const T& data) { return push(&data, sizeof(T)); }
+	// Binds the slice to register 'slot' of the vertex and pixel shaders.
+	void bind(UINT slot, const slice& slice);
+	// Bytes of the slices pushed since begin_frame, alignment padding included.
+	size_t bytes_pushed() const { return pushed_bytes; }
+
+private:
+	// Advances completed_fence past the frames whose event query has been signalled. Blocks until 'fence' is reached if waiting.
+	void poll(uint64_t fence = 0);
+
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext1> immediate_context;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+	ring_allocator allocator;
+	bool mapped{ false };	// the first Map of the buffer must be a DISCARD
+	size_t pushed_bytes{ 0 };
+
+	// Event query of frame 'fence' is fences[fence % fences.size()].
+	std::vector<Microsoft::WRL::ComPtr<ID3D11Query>> fences;
+	uint64_t submitted_fence{ 0 };
+	uint64_t completed_fence{ 0 };
+};
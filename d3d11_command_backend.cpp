@@ -0,0 +1,104 @@
+#include "d3d11_command_backend.h"
+#include "misc.h"
+
+#include <algorithm>
+
+d3d11_command_backend::d3d11_command_backend(ID3D11Device* device, ID3D11DeviceContext* immediate_context, constant_buffer_ring* constant_ring) :
+	device(device), immediate_context(immediate_context), constant_ring(constant_ring)
+{
+}
+
+void d3d11_command_backend::set_input_layout(ID3D11InputLayout* input_layout)
+{
+	immediate_context->IASetInputLayout(input_layout);
+}
+
+void d3d11_command_backend::set_vertex_shader(ID3D11VertexShader* vertex_shader)
+{
+	immediate_context->VSSetShader(vertex_shader, nullptr, 0);
+}
+
+void d3d11_command_backend::set_pixel_shader(ID3D11PixelShader* pixel_shader)
+{
+	immediate_context->PSSetShader(pixel_shader, nullptr, 0);
+}
+
+void d3d11_command_backend::set_vertex_buffer(ID3D11Buffer* buffer, uint32_t stride, uint32_t offset)
+{
+	immediate_context->IASetVertexBuffers(0, 1, &buffer, &stride, &offset);
+}
+
+void d3d11_command_backend::set_index_buffer(ID3D11Buffer* buffer, uint32_t index_size, uint32_t offset)
+{
+	immediate_context->IASetIndexBuffer(buffer, index_size == 2 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT, offset);
+}
+
+void d3d11_command_backend::set_topology(command_stream::primitive_topology topology)
+{
+	immediate_context->IASetPrimitiveTopology(topology == command_stream::triangle_strip ? D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP : D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+}
+
+void d3d11_command_backend::set_shader_resources(uint32_t first_slot, uint32_t count, ID3D11ShaderResourceView* const* shader_resource_views)
+{
+	immediate_context->PSSetShaderResources(first_slot, count, shader_resource_views);
+}
+
+void d3d11_command_backend::set_constants(uint32_t slot, const void* data, uint32_t size)
+{
+	constant_ring->bind(slot, constant_ring->push(data, size));
+}
+
+void d3d11_command_backend::set_instances(const void* data, uint32_t stride, uint32_t count)
+{
+	upload(instance_buffer, 1, data, stride, count);
+}
+
+void d3d11_command_backend::set_vertices(const void* data, uint32_t stride, uint32_t count)
+{
+	upload(vertex_buffer, 0, data, stride, count);
+}
+
+void d3d11_command_backend::draw(uint32_t vertex_count, uint32_t start_vertex)
+{
+	immediate_context->Draw(vertex_count, start_vertex);
+}
+
+void d3d11_command_backend::draw_indexed(uint32_t index_count, uint32_t start_index, int32_t base_vertex)
+{
+	immediate_context->DrawIndexed(index_count, start_index, base_vertex);
+}
+
+void d3d11_command_backend::draw_indexed_instanced(uint32_t index_count, uint32_t instance_count, uint32_t start_index, int32_t base_vertex)
+{
+	immediate_context->DrawIndexedInstanced(index_count, instance_count, start_index, base_vertex, 0);
+}
+
+void d3d11_command_backend::call(const std::function<void(ID3D11DeviceContext*)>& function)
+{
+	function(immediate_context.Get());
+}
+
+void d3d11_command_backend::upload(dynamic_buffer& destination, UINT slot, const void* data, uint32_t stride, uint32_t count)
+{
+	HRESULT hr{ S_OK };
+	const size_t size{ static_cast<size_t>(stride) * count };
+	if (destination.size < size)
+	{
+		destination.size = std::max(size, destination.size * 2);
+		D3D11_BUFFER_DESC buffer_desc{};
+		buffer_desc.ByteWidth = static_cast<UINT>(destination.size);
+		buffer_desc.Usage = D3D11_USAGE_DYNAMIC;
+		buffer_desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+		buffer_desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		hr = device->CreateBuffer(&buffer_desc, nullptr, destination.buffer.ReleaseAndGetAddressOf());
+		_ASSERT_EXPR(SUCCEEDED(hr), hr_trace(hr));
+	}
+	D3D11_MAPPED_SUBRESOURCE mapped_subresource{};
+	hr = immediate_context->Map(destination.buffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped_subresource);
+	_ASSERT_EXPR(SUCCEEDED(hr), hr_trace(hr));
+	memcpy(mapped_subresource.pData, data, size);
+	immediate_context->Unmap(destination.buffer.Get(), 0);
+
+	UINT offset{ 0 };
+	immediate_context->IASetVertexBuffers(slot, 1, destination.buffer.GetAddressOf(), &stride, &offset);
+}
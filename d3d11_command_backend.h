@@ -0,0 +1,46 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl.h>
+
+#include "command_stream.h"
+#include "constant_buffer_ring.h"
+
+// Replays command streams to the immediate context. Constants are pushed to the constant buffer ring, and vertex
+// and instance data to dynamic vertex buffers owned by the backend.
+class d3d11_command_backend : public command_backend
+{
+public:
+	d3d11_command_backend(ID3D11Device* device, ID3D11DeviceContext* immediate_context, constant_buffer_ring* constant_ring);
+
+	void set_input_layout(ID3D11InputLayout* input_layout) override;
+	void set_vertex_shader(ID3D11VertexShader* vertex_shader) override;
+	void set_pixel_shader(ID3D11PixelShader* pixel_shader) override;
+	void set_vertex_buffer(ID3D11Buffer* buffer, uint32_t stride, uint32_t offset) override;
+	void set_index_buffer(ID3D11Buffer* buffer, uint32_t index_size, uint32_t offset) override;
+	void set_topology(command_stream::primitive_topology topology) override;
+	void set_shader_resources(uint32_t first_slot, uint32_t count, ID3D11ShaderResourceView* const* shader_resource_views) override;
+	void set_constants(uint32_t slot, const void* data, uint32_t size) override;
+	void set_instances(const void* data, uint32_t stride, uint32_t count) override;
+	void set_vertices(const void* data, uint32_t stride, uint32_t count) override;
+	void draw(uint32_t vertex_count, uint32_t start_vertex) override;
+	void draw_indexed(uint32_t index_count, uint32_t start_index, int32_t base_vertex) override;
+	void draw_indexed_instanced(uint32_t index_count, uint32_t instance_count, uint32_t start_index, int32_t base_vertex) override;
+	void call(const std::function<void(ID3D11DeviceContext*)>& function) override;
+
+private:
+	// A dynamic vertex buffer that grows to the largest upload and is rewritten with WRITE_DISCARD.
+	struct dynamic_buffer
+	{
+		Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+		size_t size{ 0 };
+	};
+	void upload(dynamic_buffer& destination, UINT slot, const void* data, uint32_t stride, uint32_t count);
+
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> immediate_context;
+	constant_buffer_ring* constant_ring;
+
+	dynamic_buffer vertex_buffer;	// slot 0
+	dynamic_buffer instance_buffer;	// slot 1
+};
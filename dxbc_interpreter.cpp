@@ -0,0 +1,299 @@
+#include "dxbc_interpreter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	float as_float(uint32_t bits)
+	{
+		float f;
+		memcpy(&f, &bits, sizeof(f));
+		return f;
+	}
+	uint32_t as_bits(float f)
+	{
+		uint32_t bits;
+		memcpy(&bits, &f, sizeof(bits));
+		return bits;
+	}
+	// Comparisons write all bits set for true.
+	float as_mask(bool b) { return as_float(b ? 0xFFFFFFFF : 0); }
+
+	// Component-wise instructions : 'arity' sources, 'integer' if the sources and result are integer bits (the
+	// negate modifier is then an integer negation and saturate does not apply).
+	template <uint32_t Arity, bool Integer> struct operation
+	{
+		static constexpr uint32_t arity{ Arity };
+		static constexpr bool integer{ Integer };
+	};
+	struct add_operation : operation<2, false> { static float apply(float a, float b) { return a + b; } };
+	struct and_operation : operation<2, true> { static float apply(float a, float b) { return as_float(as_bits(a) & as_bits(b)); } };
+	struct div_operation : operation<2, false> { static float apply(float a, float b) { return a / b; } };
+	struct eq_operation : operation<2, false> { static float apply(float a, float b) { return as_mask(a == b); } };
+	struct exp_operation : operation<1, false> { static float apply(float a) { return exp2f(a); } };
+	struct frc_operation : operation<1, false> { static float apply(float a) { return a - floorf(a); } };
+	struct ftoi_operation : operation<1, false>
+	{
+		// Out of range values clamp and NaN converts to 0.
+		static float apply(float a)
+		{
+			const int32_t i{ a >= 2147483648.0f ? INT32_MAX : a <= -2147483648.0f ? INT32_MIN : a == a ? static_cast<int32_t>(a) : 0 };
+			return as_float(static_cast<uint32_t>(i));
+		}
+	};
+	struct ge_operation : operation<2, false> { static float apply(float a, float b) { return as_mask(a >= b); } };
+	struct itof_operation : operation<1, true> { static float apply(float a) { return static_cast<float>(static_cast<int32_t>(as_bits(a))); } };
+	struct log_operation : operation<1, false> { static float apply(float a) { return log2f(a); } };
+	struct lt_operation : operation<2, false> { static float apply(float a, float b) { return as_mask(a < b); } };
+	struct mad_operation : operation<3, false> { static float apply(float a, float b, float c) { return a * b + c; } };
+	struct min_operation : operation<2, false> { static float apply(float a, float b) { return a < b ? a : b; } };
+	struct max_operation : operation<2, false> { static float apply(float a, float b) { return a > b ? a : b; } };
+	struct mov_operation : operation<1, false> { static float apply(float a) { return a; } };
+	struct movc_operation : operation<3, false> { static float apply(float a, float b, float c) { return as_bits(a) != 0 ? b : c; } };
+	struct mul_operation : operation<2, false> { static float apply(float a, float b) { return a * b; } };
+	struct ne_operation : operation<2, false> { static float apply(float a, float b) { return as_mask(a != b); } };
+	struct round_ne_operation : operation<1, false> { static float apply(float a) { return nearbyintf(a); } };
+	struct round_ni_operation : operation<1, false> { static float apply(float a) { return floorf(a); } };
+	struct round_pi_operation : operation<1, false> { static float apply(float a) { return ceilf(a); } };
+	struct round_z_operation : operation<1, false> { static float apply(float a) { return truncf(a); } };
+	struct rsq_operation : operation<1, false> { static float apply(float a) { return 1.0f / sqrtf(a); } };
+	struct sqrt_operation : operation<1, false> { static float apply(float a) { return sqrtf(a); } };
+}
+
+dxbc_interpreter::dxbc_interpreter(const dxbc_shader& shader) :
+	instructions{ shader.instructions() },
+	temps(shader.temp_count() * 4 * dxbc_lanes),
+	inputs(shader.input_count() * 4 * dxbc_lanes),
+	outputs(shader.output_count() * 4 * dxbc_lanes),
+	textures(128, nullptr)
+{
+	std::fill(std::begin(samplers), std::end(samplers), dxbc_sampler_filter::linear_wrap);
+	for (const dxbc_instruction& instruction : instructions)
+	{
+		handler run{ nullptr };
+		switch (instruction.opcode)
+		{
+		case dxbc_instruction::opcode_add: run = &run_component_wise<add_operation>; break;
+		case dxbc_instruction::opcode_and: run = &run_component_wise<and_operation>; break;
+		case dxbc_instruction::opcode_div: run = &run_component_wise<div_operation>; break;
+		case dxbc_instruction::opcode_dp2: run = &run_dot<2>; break;
+		case dxbc_instruction::opcode_dp3: run = &run_dot<3>; break;
+		case dxbc_instruction::opcode_dp4: run = &run_dot<4>; break;
+		case dxbc_instruction::opcode_eq: run = &run_component_wise<eq_operation>; break;
+		case dxbc_instruction::opcode_exp: run = &run_component_wise<exp_operation>; break;
+		case dxbc_instruction::opcode_frc: run = &run_component_wise<frc_operation>; break;
+		case dxbc_instruction::opcode_ftoi: run = &run_component_wise<ftoi_operation>; break;
+		case dxbc_instruction::opcode_ge: run = &run_component_wise<ge_operation>; break;
+		case dxbc_instruction::opcode_itof: run = &run_component_wise<itof_operation>; break;
+		case dxbc_instruction::opcode_log: run = &run_component_wise<log_operation>; break;
+		case dxbc_instruction::opcode_lt: run = &run_component_wise<lt_operation>; break;
+		case dxbc_instruction::opcode_mad: run = &run_component_wise<mad_operation>; break;
+		case dxbc_instruction::opcode_min: run = &run_component_wise<min_operation>; break;
+		case dxbc_instruction::opcode_max: run = &run_component_wise<max_operation>; break;
+		case dxbc_instruction::opcode_mov: run = &run_component_wise<mov_operation>; break;
+		case dxbc_instruction::opcode_movc: run = &run_component_wise<movc_operation>; break;
+		case dxbc_instruction::opcode_mul: run = &run_component_wise<mul_operation>; break;
+		case dxbc_instruction::opcode_ne: run = &run_component_wise<ne_operation>; break;
+		case dxbc_instruction::opcode_round_ne: run = &run_component_wise<round_ne_operation>; break;
+		case dxbc_instruction::opcode_round_ni: run = &run_component_wise<round_ni_operation>; break;
+		case dxbc_instruction::opcode_round_pi: run = &run_component_wise<round_pi_operation>; break;
+		case dxbc_instruction::opcode_round_z: run = &run_component_wise<round_z_operation>; break;
+		case dxbc_instruction::opcode_rsq: run = &run_component_wise<rsq_operation>; break;
+		case dxbc_instruction::opcode_sample: run = &run_sample; break;
+		case dxbc_instruction::opcode_sqrt: run = &run_component_wise<sqrt_operation>; break;
+		}
+		handlers.push_back(run);
+	}
+}
+
+void dxbc_interpreter::set_constant_buffer(uint32_t slot, const void* data, size_t size)
+{
+	constant_buffers[slot] = { static_cast<const float*>(data), size / (sizeof(float) * 4) };
+}
+
+void dxbc_interpreter::set_texture(uint32_t slot, const shading_texture* texture)
+{
+	textures[slot] = texture;
+}
+
+void dxbc_interpreter::set_sampler(uint32_t slot, dxbc_sampler_filter filter)
+{
+	samplers[slot] = filter;
+}
+
+void dxbc_interpreter::execute()
+{
+	const size_t count{ instructions.size() };
+	for (size_t i = 0; i < count; ++i)
+	{
+		handlers[i](*this, instructions[i]);
+	}
+}
+
+void dxbc_interpreter::fetch(const dxbc_operand& source, uint32_t component, bool integer, float* lanes) const
+{
+	const uint32_t selected{ source.swizzle[component] };
+	const std::vector<float>* registers{ nullptr };
+	float value{ 0.0f };
+	switch (source.type)
+	{
+	case dxbc_operand::file::temp:
+		registers = &temps;
+		break;
+	case dxbc_operand::file::input:
+		registers = &inputs;
+		break;
+	case dxbc_operand::file::output:
+		registers = &outputs;
+		break;
+	case dxbc_operand::file::constant_buffer:
+	{
+		const constant_buffer& buffer{ constant_buffers[source.index[0]] };
+		if (source.index[1] < buffer.element_count)
+		{
+			memcpy(&value, buffer.data + source.index[1] * 4 + selected, sizeof(value));
+		}
+		break;
+	}
+	case dxbc_operand::file::immediate:
+		value = as_float(source.immediate[selected]);
+		break;
+	default:
+		break;
+	}
+	if (registers)
+	{
+		memcpy(lanes, &(*registers)[(source.index[0] * 4 + selected) * dxbc_lanes], sizeof(float) * dxbc_lanes);
+	}
+	else
+	{
+		std::fill(lanes, lanes + dxbc_lanes, value);
+	}
+
+	if (source.absolute || source.negate)
+	{
+		for (size_t l = 0; l < dxbc_lanes; ++l)
+		{
+			if (integer)
+			{
+				uint32_t bits{ as_bits(lanes[l]) };
+				bits = source.absolute && static_cast<int32_t>(bits) < 0 ? 0 - bits : bits;
+				lanes[l] = as_float(source.negate ? 0 - bits : bits);
+			}
+			else
+			{
+				const float f{ source.absolute ? fabsf(lanes[l]) : lanes[l] };
+				lanes[l] = source.negate ? -f : f;
+			}
+		}
+	}
+}
+
+void dxbc_interpreter::store(const dxbc_operand& destination, bool saturate, const float (*values)[dxbc_lanes])
+{
+	std::vector<float>& registers{ destination.type == dxbc_operand::file::temp ? temps : outputs };
+	for (uint32_t component = 0; component < 4; ++component)
+	{
+		if (destination.type == dxbc_operand::file::null || (destination.mask & (1 << component)) == 0)
+		{
+			continue;
+		}
+		float* lanes{ &registers[(destination.index[0] * 4 + component) * dxbc_lanes] };
+		for (size_t l = 0; l < dxbc_lanes; ++l)
+		{
+			// Saturation turns NaN into 0.
+			const float v{ values[component][l] };
+			lanes[l] = saturate ? (v > 0.0f ? (v < 1.0f ? v : 1.0f) : 0.0f) : v;
+		}
+	}
+}
+
+template <class Operation> void dxbc_interpreter::run_component_wise(dxbc_interpreter& interpreter, const dxbc_instruction& instruction)
+{
+	// All the components are computed before any is written, as a source may be the destination register.
+	float values[4][dxbc_lanes];
+	float a[dxbc_lanes], b[dxbc_lanes], c[dxbc_lanes];
+	for (uint32_t component = 0; component < 4; ++component)
+	{
+		if ((instruction.destination.mask & (1 << component)) == 0)
+		{
+			continue;
+		}
+		interpreter.fetch(instruction.sources[0], component, Operation::integer, a);
+		if constexpr (Operation::arity == 1)
+		{
+			for (size_t l = 0; l < dxbc_lanes; ++l)
+			{
+				values[component][l] = Operation::apply(a[l]);
+			}
+		}
+		else if constexpr (Operation::arity == 2)
+		{
+			interpreter.fetch(instruction.sources[1], component, Operation::integer, b);
+			for (size_t l = 0; l < dxbc_lanes; ++l)
+			{
+				values[component][l] = Operation::apply(a[l], b[l]);
+			}
+		}
+		else
+		{
+			interpreter.fetch(instruction.sources[1], component, Operation::integer, b);
+			interpreter.fetch(instruction.sources[2], component, Operation::integer, c);
+			for (size_t l = 0; l < dxbc_lanes; ++l)
+			{
+				values[component][l] = Operation::apply(a[l], b[l], c[l]);
+			}
+		}
+	}
+	interpreter.store(instruction.destination, instruction.saturate && !Operation::integer, values);
+}
+
+template <uint32_t Components> void dxbc_interpreter::run_dot(dxbc_interpreter& interpreter, const dxbc_instruction& instruction)
+{
+	float sum[dxbc_lanes]{};
+	float a[dxbc_lanes], b[dxbc_lanes];
+	for (uint32_t component = 0; component < Components; ++component)
+	{
+		interpreter.fetch(instruction.sources[0], component, false, a);
+		interpreter.fetch(instruction.sources[1], component, false, b);
+		for (size_t l = 0; l < dxbc_lanes; ++l)
+		{
+			sum[l] += a[l] * b[l];
+		}
+	}
+	float values[4][dxbc_lanes];
+	for (uint32_t component = 0; component < 4; ++component)
+	{
+		memcpy(values[component], sum, sizeof(sum));
+	}
+	interpreter.store(instruction.destination, instruction.saturate, values);
+}
+
+void dxbc_interpreter::run_sample(dxbc_interpreter& interpreter, const dxbc_instruction& instruction)
+{
+	float u[dxbc_lanes], v[dxbc_lanes];
+	interpreter.fetch(instruction.sources[0], 0, false, u);
+	interpreter.fetch(instruction.sources[0], 1, false, v);
+	const dxbc_operand& resource{ instruction.sources[1] };
+	const shading_texture* texture{ interpreter.textures[resource.index[0]] };
+	const dxbc_sampler_filter filter{ interpreter.samplers[instruction.sources[2].index[0]] };
+
+	// Only the top mip level : there are no derivatives to select another.
+	float values[4][dxbc_lanes];
+	for (size_t l = 0; l < dxbc_lanes; ++l)
+	{
+		float4 texel{ 0.0f, 0.0f, 0.0f, 0.0f };
+		if (texture)
+		{
+			texel = filter == dxbc_sampler_filter::point_clamp ? texture->sample_point_clamp(u[l], v[l]) : texture->sample_linear_wrap(u[l], v[l]);
+		}
+		const float components[4]{ texel.x, texel.y, texel.z, texel.w };
+		for (uint32_t component = 0; component < 4; ++component)
+		{
+			values[component][l] = components[resource.swizzle[component]];
+		}
+	}
+	interpreter.store(instruction.destination, instruction.saturate, values);
+}
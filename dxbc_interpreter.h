@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "dxbc_shader.h"
+#include "shading_functions.h"
+
+// Invocations (vertices or pixels) a dxbc_interpreter runs together. Every instruction is applied to all of them
+// before the next one, so the cost of dispatching an instruction is shared and the per-lane loops vectorize.
+constexpr size_t dxbc_lanes{ 8 };
+
+// The two sampler states of framework, see shading_texture.
+enum class dxbc_sampler_filter { point_clamp, linear_wrap };
+
+// Runs a dxbc_shader on the CPU with constant buffers and textures bound from memory, like a device context would.
+// The program is translated once into a list of handlers, one per instruction with its operands decoded, so that
+// execution is a loop of indirect calls without decoding or a switch per instruction.
+//
+// Registers are stored as structure of arrays (register, component, lane). Fill the inputs for up to dxbc_lanes
+// invocations, call execute and read the outputs; lanes the caller does not use are computed all the same.
+class dxbc_interpreter
+{
+public:
+	explicit dxbc_interpreter(const dxbc_shader& shader);
+
+	// 'data' is read while executing, it must stay valid while bound. Elements beyond 'size' read as 0.
+	void set_constant_buffer(uint32_t slot, const void* data, size_t size);
+	// Unbound textures sample as 0.
+	void set_texture(uint32_t slot, const shading_texture* texture);
+	// Slots default to linear_wrap, the sampler framework binds to s0.
+	void set_sampler(uint32_t slot, dxbc_sampler_filter filter);
+
+	// dxbc_lanes values of a component of an input or output register.
+	float* input(uint32_t register_index, uint32_t component) { return &inputs[(register_index * 4 + component) * dxbc_lanes]; }
+	const float* output(uint32_t register_index, uint32_t component) const { return &outputs[(register_index * 4 + component) * dxbc_lanes]; }
+
+	void execute();
+	// Instructions executed per invocation.
+	size_t instruction_count() const { return instructions.size(); }
+
+private:
+	using handler = void (*)(dxbc_interpreter& interpreter, const dxbc_instruction& instruction);
+	struct constant_buffer
+	{
+		const float* data{ nullptr };
+		size_t element_count{ 0 };
+	};
+
+	template <class Operation> static void run_component_wise(dxbc_interpreter& interpreter, const dxbc_instruction& instruction);
+	template <uint32_t Components> static void run_dot(dxbc_interpreter& interpreter, const dxbc_instruction& instruction);
+	static void run_sample(dxbc_interpreter& interpreter, const dxbc_instruction& instruction);
+
+	// Reads destination component 'component' of a source operand into 'lanes', with its modifiers applied as
+	// float or integer negation.
+	void fetch(const dxbc_operand& source, uint32_t component, bool integer, float* lanes) const;
+	// Writes the components of 'values' selected by the destination mask, saturated if asked.
+	void store(const dxbc_operand& destination, bool saturate, const float (*values)[dxbc_lanes]);
+
+	std::vector<dxbc_instruction> instructions;
+	std::vector<handler> handlers;	// one per instruction
+	std::vector<float> temps;
+	std::vector<float> inputs;
+	std::vector<float> outputs;
+	constant_buffer constant_buffers[14];
+	std::vector<const shading_texture*> textures;
+	dxbc_sampler_filter samplers[16];
+};
@@ -0,0 +1,478 @@
+#include "dxbc_shader.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+#include "mapped_file.h"
+
+namespace
+{
+	// The other values of D3D10_SB_OPCODE_TYPE the parser handles.
+	enum opcode : uint32_t
+	{
+		opcode_customdata = 53, opcode_nop = 58, opcode_ret = 62, opcode_dcl_resource = 88, opcode_dcl_constant_buffer = 89, opcode_dcl_sampler = 90,
+		opcode_dcl_input = 95, opcode_dcl_input_sgv = 96, opcode_dcl_input_siv = 97, opcode_dcl_input_ps = 98,
+		opcode_dcl_input_ps_sgv = 99, opcode_dcl_input_ps_siv = 100, opcode_dcl_output = 101,
+		opcode_dcl_output_sgv = 102, opcode_dcl_output_siv = 103, opcode_dcl_temps = 104, opcode_dcl_global_flags = 106,
+	};
+	enum operand_type : uint32_t
+	{
+		operand_temp = 0, operand_input = 1, operand_output = 2, operand_immediate32 = 4, operand_sampler = 6,
+		operand_resource = 7, operand_constant_buffer = 8, operand_null = 13,
+	};
+	constexpr uint32_t resource_dimension_texture2d{ 3 };
+	// Limits of Direct3D 11.
+	constexpr uint32_t register_limit{ 32 };	// input and output registers
+	constexpr uint32_t temp_limit{ 4096 };
+	constexpr uint32_t constant_buffer_slots{ 14 };
+	constexpr uint32_t resource_slots{ 128 };
+	constexpr uint32_t sampler_slots{ 16 };
+
+	// Source operand count of the executable instructions, 0 for unsupported ones.
+	uint32_t source_count(uint32_t opcode)
+	{
+		switch (opcode)
+		{
+		case dxbc_instruction::opcode_exp: case dxbc_instruction::opcode_frc: case dxbc_instruction::opcode_ftoi: case dxbc_instruction::opcode_itof: case dxbc_instruction::opcode_log: case dxbc_instruction::opcode_mov:
+		case dxbc_instruction::opcode_round_ne: case dxbc_instruction::opcode_round_ni: case dxbc_instruction::opcode_round_pi: case dxbc_instruction::opcode_round_z: case dxbc_instruction::opcode_rsq: case dxbc_instruction::opcode_sqrt:
+			return 1;
+		case dxbc_instruction::opcode_add: case dxbc_instruction::opcode_and: case dxbc_instruction::opcode_div: case dxbc_instruction::opcode_dp2: case dxbc_instruction::opcode_dp3: case dxbc_instruction::opcode_dp4:
+		case dxbc_instruction::opcode_eq: case dxbc_instruction::opcode_ge: case dxbc_instruction::opcode_lt: case dxbc_instruction::opcode_min: case dxbc_instruction::opcode_max: case dxbc_instruction::opcode_mul: case dxbc_instruction::opcode_ne:
+			return 2;
+		case dxbc_instruction::opcode_mad: case dxbc_instruction::opcode_movc: case dxbc_instruction::opcode_sample:
+			return 3;
+		default:
+			return 0;
+		}
+	}
+
+	class token_reader
+	{
+	public:
+		token_reader(const uint32_t* begin, const uint32_t* end) : next{ begin }, end{ end } {}
+		bool read(uint32_t& token)
+		{
+			if (next == end)
+			{
+				return false;
+			}
+			token = *next++;
+			return true;
+		}
+		const uint32_t* position() const { return next; }
+	private:
+		const uint32_t* next;
+		const uint32_t* end;
+	};
+
+	bool read_operand(token_reader& tokens, dxbc_operand& operand)
+	{
+		uint32_t token;
+		if (!tokens.read(token))
+		{
+			return false;
+		}
+		const uint32_t component_count{ token & 3 };	// 0, 1, 4 or N components
+		const uint32_t selection_mode{ (token >> 2) & 3 };	// mask, swizzle or select 1
+		const uint32_t selection{ (token >> 4) & 0xFF };
+		const uint32_t type{ (token >> 12) & 0xFF };
+		const uint32_t dimension{ (token >> 20) & 3 };
+		if (token >> 31)
+		{
+			uint32_t extended;
+			if (!tokens.read(extended) || (extended >> 31))
+			{
+				return false;
+			}
+			if ((extended & 0x3F) == 1)	// modifier
+			{
+				const uint32_t modifier{ (extended >> 6) & 0xFF };
+				operand.negate = modifier == 1 || modifier == 3;
+				operand.absolute = modifier == 2 || modifier == 3;
+			}
+		}
+		if (component_count == 2)
+		{
+			switch (selection_mode)
+			{
+			case 0:
+				operand.mask = selection & 0xF;
+				break;
+			case 1:
+				for (int c = 0; c < 4; ++c)
+				{
+					operand.swizzle[c] = (selection >> (c * 2)) & 3;
+				}
+				break;
+			default:
+				for (int c = 0; c < 4; ++c)
+				{
+					operand.swizzle[c] = selection & 3;
+				}
+				break;
+			}
+		}
+		else if (component_count == 1)
+		{
+			operand.mask = 1;
+			for (int c = 0; c < 4; ++c)
+			{
+				operand.swizzle[c] = 0;
+			}
+		}
+		else if (component_count == 3)
+		{
+			return false;
+		}
+
+		if (type == operand_immediate32)
+		{
+			operand.type = dxbc_operand::file::immediate;
+			for (uint32_t c = 0; c < (component_count == 2 ? 4u : 1u); ++c)
+			{
+				if (!tokens.read(operand.immediate[c]))
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+		switch (type)
+		{
+		case operand_temp: operand.type = dxbc_operand::file::temp; break;
+		case operand_input: operand.type = dxbc_operand::file::input; break;
+		case operand_output: operand.type = dxbc_operand::file::output; break;
+		case operand_constant_buffer: operand.type = dxbc_operand::file::constant_buffer; break;
+		case operand_resource: operand.type = dxbc_operand::file::resource; break;
+		case operand_sampler: operand.type = dxbc_operand::file::sampler; break;
+		case operand_null: operand.type = dxbc_operand::file::null; break;
+		default: return false;
+		}
+		if (dimension > 2)
+		{
+			return false;
+		}
+		for (uint32_t d = 0; d < dimension; ++d)
+		{
+			// Only immediate 32 bit indices : relative addressing would need indexable registers.
+			if (((token >> (22 + d * 3)) & 7) != 0 || !tokens.read(operand.index[d]))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// The system value declarations name the value after the register; the signatures already have it.
+	bool skip_system_value(uint32_t opcode, token_reader& tokens)
+	{
+		switch (opcode)
+		{
+		case opcode_dcl_input_sgv:
+		case opcode_dcl_input_siv:
+		case opcode_dcl_input_ps_sgv:
+		case opcode_dcl_input_ps_siv:
+		case opcode_dcl_output_sgv:
+		case opcode_dcl_output_siv:
+		{
+			uint32_t name;
+			return tokens.read(name);
+		}
+		default:
+			return true;
+		}
+	}
+
+	bool read_signature(const uint8_t* chunk, uint32_t size, std::vector<dxbc_signature_element>& elements)
+	{
+		if (size < 8)
+		{
+			return false;
+		}
+		uint32_t count;
+		memcpy(&count, chunk, sizeof(count));
+		if (count > (size - 8) / 24)
+		{
+			return false;
+		}
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			uint32_t fields[5];
+			memcpy(fields, chunk + 8 + i * 24, sizeof(fields));
+			if (fields[0] >= size || memchr(chunk + fields[0], 0, size - fields[0]) == nullptr)
+			{
+				return false;
+			}
+			dxbc_signature_element element;
+			element.semantic_name = reinterpret_cast<const char*>(chunk + fields[0]);
+			element.semantic_index = fields[1];
+			element.system_value = fields[2];
+			element.register_index = fields[4];
+			element.mask = chunk[8 + i * 24 + 20];
+			elements.push_back(element);
+		}
+		return true;
+	}
+
+	int find_element(const std::vector<dxbc_signature_element>& elements, const char* semantic_name, uint32_t semantic_index)
+	{
+		for (const dxbc_signature_element& element : elements)
+		{
+			// Semantic names are case insensitive.
+			if (element.semantic_index == semantic_index && element.semantic_name.size() == strlen(semantic_name)
+				&& std::equal(element.semantic_name.begin(), element.semantic_name.end(), semantic_name, [](char a, char b) { return tolower(a) == tolower(b); }))
+			{
+				return static_cast<int>(element.register_index);
+			}
+		}
+		return -1;
+	}
+}
+
+bool dxbc_shader::load(const void* data, size_t size)
+{
+	input_signature.clear();
+	output_signature.clear();
+	program.clear();
+	temps = input_registers = output_registers = 0;
+
+	// Container : "DXBC", checksum, 1, total size, chunk count, chunk offsets.
+	const uint8_t* bytes{ static_cast<const uint8_t*>(data) };
+	uint32_t header[3];
+	if (size < 32 || memcmp(bytes, "DXBC", 4) != 0)
+	{
+		return false;
+	}
+	memcpy(header, bytes + 20, sizeof(header));
+	const uint32_t chunk_count{ header[2] };
+	if (header[1] > size || chunk_count > (size - 32) / 4)
+	{
+		return false;
+	}
+	const uint8_t* shader_chunk{ nullptr };
+	uint32_t shader_size{ 0 };
+	for (uint32_t i = 0; i < chunk_count; ++i)
+	{
+		uint32_t offset, chunk_size;
+		memcpy(&offset, bytes + 32 + i * 4, sizeof(offset));
+		if (offset > size - 8)
+		{
+			return false;
+		}
+		memcpy(&chunk_size, bytes + offset + 4, sizeof(chunk_size));
+		if (chunk_size > size - offset - 8)
+		{
+			return false;
+		}
+		const uint8_t* chunk{ bytes + offset + 8 };
+		if (memcmp(bytes + offset, "ISGN", 4) == 0 && !read_signature(chunk, chunk_size, input_signature))
+		{
+			return false;
+		}
+		if (memcmp(bytes + offset, "OSGN", 4) == 0 && !read_signature(chunk, chunk_size, output_signature))
+		{
+			return false;
+		}
+		if (memcmp(bytes + offset, "SHDR", 4) == 0 || memcmp(bytes + offset, "SHEX", 4) == 0)
+		{
+			shader_chunk = chunk;
+			shader_size = chunk_size;
+		}
+	}
+	if (shader_chunk == nullptr || shader_size < 8 || shader_size % 4 != 0)
+	{
+		return false;
+	}
+
+	std::vector<uint32_t> tokens(shader_size / 4);
+	memcpy(tokens.data(), shader_chunk, shader_size);
+	switch (tokens[0] >> 16)
+	{
+	case 0: program_stage = stage::pixel; break;
+	case 1: program_stage = stage::vertex; break;
+	default: return false;
+	}
+	if (tokens[1] > tokens.size())
+	{
+		return false;
+	}
+	const uint32_t* const end{ tokens.data() + tokens[1] };
+	const uint32_t* next{ tokens.data() + 2 };
+	bool returned{ false };
+	while (next < end)
+	{
+		const uint32_t token{ *next };
+		const uint32_t opcode{ token & 0x7FF };
+		uint32_t length{ (token >> 24) & 0x7F };
+		if (opcode == opcode_customdata)
+		{
+			// Immediate constant buffers and other data blocks are not supported.
+			return false;
+		}
+		if (length == 0 || length > static_cast<size_t>(end - next))
+		{
+			return false;
+		}
+		// Nothing may follow the final ret : there is no flow control to reach it.
+		if (returned)
+		{
+			return false;
+		}
+		token_reader operands{ next + 1, next + length };
+		// Extended opcode tokens : sample controls without texel offsets, and the resource dimension and return
+		// type shader model 5 repeats on sample instructions.
+		for (bool extended_token = (token >> 31) != 0; extended_token; )
+		{
+			uint32_t extended;
+			if (!operands.read(extended))
+			{
+				return false;
+			}
+			const uint32_t type{ extended & 0x3F };
+			if (type == 1 ? (extended & 0x7FFFFE00) != 0 : type == 2 ? ((extended >> 6) & 0x1F) != resource_dimension_texture2d : type != 3)
+			{
+				return false;
+			}
+			extended_token = (extended >> 31) != 0;
+		}
+
+		dxbc_operand operand;
+		switch (opcode)
+		{
+		case opcode_nop:
+		case opcode_dcl_global_flags:
+			break;
+		case opcode_ret:
+			returned = true;
+			break;
+		case opcode_dcl_temps:
+			if (!operands.read(temps) || temps > temp_limit)
+			{
+				return false;
+			}
+			break;
+		case opcode_dcl_constant_buffer:
+		case opcode_dcl_sampler:
+			if (!read_operand(operands, operand))
+			{
+				return false;
+			}
+			break;
+		case opcode_dcl_resource:
+		{
+			// Followed by the return type of each component.
+			uint32_t return_type;
+			if (((token >> 11) & 0x1F) != resource_dimension_texture2d || !read_operand(operands, operand) || !operands.read(return_type))
+			{
+				return false;
+			}
+			break;
+		}
+		case opcode_dcl_input:
+		case opcode_dcl_input_sgv:
+		case opcode_dcl_input_siv:
+		case opcode_dcl_input_ps:
+		case opcode_dcl_input_ps_sgv:
+		case opcode_dcl_input_ps_siv:
+			if (!read_operand(operands, operand) || operand.type != dxbc_operand::file::input || operand.index[0] >= register_limit || !skip_system_value(opcode, operands))
+			{
+				return false;
+			}
+			input_registers = std::max(input_registers, operand.index[0] + 1);
+			break;
+		case opcode_dcl_output:
+		case opcode_dcl_output_sgv:
+		case opcode_dcl_output_siv:
+			if (!read_operand(operands, operand) || operand.type != dxbc_operand::file::output || operand.index[0] >= register_limit || !skip_system_value(opcode, operands))
+			{
+				return false;
+			}
+			output_registers = std::max(output_registers, operand.index[0] + 1);
+			break;
+		default:
+		{
+			dxbc_instruction instruction{};
+			instruction.opcode = opcode;
+			instruction.saturate = ((token >> 13) & 1) != 0;
+			instruction.source_count = source_count(opcode);
+			if (instruction.source_count == 0 || !read_operand(operands, instruction.destination))
+			{
+				return false;
+			}
+			for (uint32_t s = 0; s < instruction.source_count; ++s)
+			{
+				if (!read_operand(operands, instruction.sources[s]))
+				{
+					return false;
+				}
+			}
+			program.push_back(instruction);
+			break;
+		}
+		}
+		if (operands.position() != next + length)
+		{
+			return false;
+		}
+		next += length;
+	}
+
+	// Operands must be of the kinds the interpreter expects and in the declared ranges, so it can index without checks.
+	auto in_range = [this](const dxbc_operand& operand)
+	{
+		switch (operand.type)
+		{
+		case dxbc_operand::file::temp: return operand.index[0] < temps;
+		case dxbc_operand::file::input: return operand.index[0] < input_registers;
+		case dxbc_operand::file::output: return operand.index[0] < output_registers;
+		case dxbc_operand::file::constant_buffer: return operand.index[0] < constant_buffer_slots;
+		case dxbc_operand::file::resource: return operand.index[0] < resource_slots;
+		case dxbc_operand::file::sampler: return operand.index[0] < sampler_slots;
+		default: return true;
+		}
+	};
+	auto is_value = [](const dxbc_operand& operand)
+	{
+		return operand.type != dxbc_operand::file::resource && operand.type != dxbc_operand::file::sampler && operand.type != dxbc_operand::file::null;
+	};
+	for (const dxbc_instruction& instruction : program)
+	{
+		const dxbc_operand::file destination{ instruction.destination.type };
+		if (destination != dxbc_operand::file::temp && destination != dxbc_operand::file::output && destination != dxbc_operand::file::null)
+		{
+			return false;
+		}
+		for (uint32_t s = 0; s < instruction.source_count; ++s)
+		{
+			const dxbc_operand& source{ instruction.sources[s] };
+			const bool expected{ instruction.opcode != dxbc_instruction::opcode_sample || s == 0 ? is_value(source) :
+				source.type == (s == 1 ? dxbc_operand::file::resource : dxbc_operand::file::sampler) };
+			if (!expected || !in_range(source))
+			{
+				return false;
+			}
+		}
+		if (!in_range(instruction.destination))
+		{
+			return false;
+		}
+	}
+	return returned;
+}
+
+bool dxbc_shader::load(const std::filesystem::path& cso_filename)
+{
+	mapped_file file;
+	return file.open(cso_filename) && load(file.data(), file.size());
+}
+
+int dxbc_shader::find_input(const char* semantic_name, uint32_t semantic_index) const
+{
+	return find_element(input_signature, semantic_name, semantic_index);
+}
+
+int dxbc_shader::find_output(const char* semantic_name, uint32_t semantic_index) const
+{
+	return find_element(output_signature, semantic_name, semantic_index);
+}
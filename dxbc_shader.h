@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// A compiled shader (.cso, the DXBC container fxc writes) decoded for dxbc_interpreter. Only what the shaders of
+// this renderer need is accepted : vertex and pixel shaders without flow control, 2D textures, constant buffers
+// and temporaries addressed with immediate indices, and the arithmetic, comparison, conversion and sample
+// instructions of dxbc_instruction::opcode_type. load fails on anything else rather than running it wrong.
+
+// An element of the input or output signature (ISGN / OSGN chunk).
+struct dxbc_signature_element
+{
+	std::string semantic_name;
+	uint32_t semantic_index;
+	uint32_t system_value;	// D3D_NAME, 0 for none, 1 for SV_Position
+	uint32_t register_index;
+	uint8_t mask;
+};
+
+struct dxbc_operand
+{
+	enum class file : uint8_t { temp, input, output, constant_buffer, immediate, resource, sampler, null };
+	file type{ file::null };
+	uint8_t mask{ 0 };	// components written, for destinations
+	uint8_t swizzle[4]{ 0, 1, 2, 3 };	// component read for each destination component, for sources and resources
+	bool negate{ false };
+	bool absolute{ false };
+	uint32_t index[2]{ 0, 0 };	// register; constant buffer slot and element
+	uint32_t immediate[4]{ 0, 0, 0, 0 };	// raw bits
+};
+
+struct dxbc_instruction
+{
+	// The executable instructions supported, with the values of D3D10_SB_OPCODE_TYPE.
+	enum opcode_type : uint32_t
+	{
+		opcode_add = 0, opcode_and = 1, opcode_div = 14, opcode_dp2 = 15, opcode_dp3 = 16, opcode_dp4 = 17,
+		opcode_eq = 24, opcode_exp = 25, opcode_frc = 26, opcode_ftoi = 27, opcode_ge = 29, opcode_itof = 43,
+		opcode_log = 47, opcode_lt = 49, opcode_mad = 50, opcode_min = 51, opcode_max = 52, opcode_mov = 54,
+		opcode_movc = 55, opcode_mul = 56, opcode_ne = 57, opcode_round_ne = 64, opcode_round_ni = 65,
+		opcode_round_pi = 66, opcode_round_z = 67, opcode_rsq = 68, opcode_sample = 69, opcode_sqrt = 75,
+	};
+	uint32_t opcode;
+	bool saturate;
+	dxbc_operand destination;
+	dxbc_operand sources[3];
+	uint32_t source_count;
+};
+
+class dxbc_shader
+{
+public:
+	enum class stage { pixel, vertex };
+
+	// Parses the container and decodes the shader program. Returns false if it is malformed or uses anything
+	// outside the supported subset.
+	bool load(const void* data, size_t size);
+	bool load(const std::filesystem::path& cso_filename);
+
+	stage shader_stage() const { return program_stage; }
+	const std::vector<dxbc_signature_element>& inputs() const { return input_signature; }
+	const std::vector<dxbc_signature_element>& outputs() const { return output_signature; }
+	// Register of the signature element, or -1.
+	int find_input(const char* semantic_name, uint32_t semantic_index = 0) const;
+	int find_output(const char* semantic_name, uint32_t semantic_index = 0) const;
+
+	// Executable instructions, without declarations, nop and the final ret.
+	const std::vector<dxbc_instruction>& instructions() const { return program; }
+	uint32_t temp_count() const { return temps; }
+	uint32_t input_count() const { return input_registers; }
+	uint32_t output_count() const { return output_registers; }
+
+private:
+	stage program_stage{ stage::pixel };
+	std::vector<dxbc_signature_element> input_signature;
+	std::vector<dxbc_signature_element> output_signature;
+	std::vector<dxbc_instruction> program;
+	uint32_t temps{ 0 };
+	uint32_t input_registers{ 0 };
+	uint32_t output_registers{ 0 };
+};
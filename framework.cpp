@@ -3,6 +3,8 @@
 #include "shader.h"
 #include "texture.h"
 
+#include <algorithm>
+
 framework::framework(HWND hwnd) : hwnd(hwnd)
 {
 }
@@ -132,69 +134,37 @@ bool framework::initialize()
 		hr = device->CreateRasterizerState(&rasterizer_desc, rasterizer_state.GetAddressOf());
 		_ASSERT_EXPR(SUCCEEDED(hr), hr_trace(hr));
 	}
-	// 萔obt@̐
-	{
-		D3D11_BUFFER_DESC buffer_desc{};
-		buffer_desc.Usage = D3D11_USAGE_DEFAULT;
-		buffer_desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-		buffer_desc.CPUAccessFlags = 0;
-		buffer_desc.MiscFlags = 0;
-		buffer_desc.StructureByteStride = 0;
-		{
-			buffer_desc.ByteWidth = sizeof(scene_constants);
-			hr = device->CreateBuffer(&buffer_desc, nullptr, scene_constant_buffer.GetAddressOf());
-			_ASSERT_EXPR(SUCCEEDED(hr), hr_trace(hr));
-		}
-		{
-			buffer_desc.ByteWidth = sizeof(scroll_constants);
-			hr = device->CreateBuffer(&buffer_desc, nullptr, scroll_constants_buffer.GetAddressOf());
-			_ASSERT_EXPR(SUCCEEDED(hr), hr_trace(hr));
-		}
-		{
-			buffer_desc.ByteWidth = sizeof(dissolve_constants);
-			hr = device->CreateBuffer(&buffer_desc, nullptr, dissolve_constant_buffer.GetAddressOf());
-			_ASSERT_EXPR(SUCCEEDED(hr), hr_trace(hr));
-		}
-		{
-			buffer_desc.ByteWidth = sizeof(light_constants);
-			hr = device->CreateBuffer(&buffer_desc, nullptr, light_constant_buffer.GetAddressOf());
-			_ASSERT_EXPR(SUCCEEDED(hr), hr_trace(hr));
-		}
-		{
-			buffer_desc.ByteWidth = sizeof(environment_constants);
-			hr = device->CreateBuffer(&buffer_desc, nullptr, environment_constant_buffer.GetAddressOf());
-			_ASSERT_EXPR(SUCCEEDED(hr), hr_trace(hr));
-		}
-		{
-			buffer_desc.ByteWidth = sizeof(hemisphere_light_constants);
-			hr = device->CreateBuffer(&buffer_desc, nullptr, hemisphere_light_constant_buffer.GetAddressOf());
-			_ASSERT_EXPR(SUCCEEDED(hr), hr_trace(hr));
-		}
-		{
-			buffer_desc.ByteWidth = sizeof(fog_constants);
-			hr = device->CreateBuffer(&buffer_desc, nullptr, fog_constant_buffer.GetAddressOf());
-			_ASSERT_EXPR(SUCCEEDED(hr), hr_trace(hr));
-		}
+	// 萔obt@̐ (S萔obt@ŋL郊Oobt@)
+	{
+		constant_ring = std::make_unique<constant_buffer_ring>(device.Get(), immediate_context.Get());
+		scene_block = std::make_unique<constant_block>(device.Get(), immediate_context.Get(),
+			std::initializer_list<size_t>{ sizeof(light_constants), sizeof(environment_constants), sizeof(hemisphere_light_constants), sizeof(fog_constants) });
+		command_backend = std::make_unique<d3d11_command_backend>(device.Get(), immediate_context.Get(), constant_ring.get());
+		command_filter = std::make_unique<state_filter>(*command_backend);
 	}
 	// `IuWFNg̓ǂݍ
 	{
 		//dummy_static_mesh = std::make_unique<static_mesh>(device.Get(), L".\\resources\\ball\\ball.obj", true);
 		//dummy_sprite = std::make_unique<sprite>(device.Get(), L".\\resources\\chip_win.png");
-		dummy_static_meshs.push_back(std::make_unique<static_mesh>(device.Get(),
-			L".\\resources\\ball\\ball.obj", true));
+		//bVƃeNX`̓[J[Xbhœǂݍ݁Ał̂resolve_loading_assetsōւ
+		loading_static_meshs.push_back(static_mesh::load_source_async(
+			L".\\resources\\ball\\ball.obj", true, static_mesh::optimize_vertex_cache | static_mesh::optimize_overdraw | static_mesh::quantize_vertices | static_mesh::generate_lods));
 
-		dummy_static_meshs.push_back(std::make_unique<static_mesh>(device.Get(),
+		loading_static_meshs.push_back(static_mesh::load_source_async(
 			L".\\resources\\plane\\plane.obj", true));
-		
-		load_texture_from_file(device.Get(), L".\\resources\\mask\\dissolve_animation.png",
-			mask_texture.GetAddressOf(), &mask_texture2dDesc);
-
-		load_texture_from_file(device.Get(), L".\\resources\\ramp.png",
-			ramp_texture.GetAddressOf(), &ramp_texture2dDesc);
+		dummy_static_meshs.resize(loading_static_meshs.size());
 
+		loading_mask_texture = decode_texture_async(L".\\resources\\mask\\dissolve_animation.png");
+		loading_ramp_texture = decode_texture_async(L".\\resources\\ramp.png");
 		//}bv̓ǂݍ
-		load_texture_from_file(device.Get(), L".\\resources\\SphereMap.bmp",
-			environment_texture.GetAddressOf(), &environment_texture2dDesc);
+		loading_environment_texture = decode_texture_async(L".\\resources\\SphereMap.bmp");
+
+		//ǂݍ݂I܂ł̃v[Xz_[
+		placeholder_sphere = std::make_unique<geometric_sphere>(device.Get(), 16, 8);
+		placeholder_cube = std::make_unique<geometric_cube>(device.Get());
+		make_dummy_texture(device.Get(), mask_texture.GetAddressOf(), 0xFFFFFFFF, 1);
+		make_dummy_texture(device.Get(), ramp_texture.GetAddressOf(), 0xFFFFFFFF, 1);
+		make_dummy_texture(device.Get(), environment_texture.GetAddressOf(), 0xFF000000, 1);
 
 		//Tv[Xe[g
 		D3D11_SAMPLER_DESC sampler_desc{};
@@ -246,6 +216,28 @@ bool framework::initialize()
 				"phong_shader_ps.cso",
 				mesh_pixel_shader.GetAddressOf());
 
+			//ʎq_p̒_VF[_[̓ǂݍ (sNZVF[_[͋)
+			create_vs_from_cso(device.Get(),
+				"phong_shader_quantized_vs.cso",
+				mesh_quantized_vertex_shader.GetAddressOf(),
+				mesh_quantized_input_layout.GetAddressOf(),
+				static_mesh::quantized_input_element_desc,
+				ARRAYSIZE(static_mesh::quantized_input_element_desc));
+
+			//CX^X`p̒_VF[_[̓ǂݍ ([hs𒸓_obt@̃Xbg1ǂ)
+			create_vs_from_cso(device.Get(),
+				"phong_shader_instanced_vs.cso",
+				mesh_instanced_vertex_shader.GetAddressOf(),
+				mesh_instanced_input_layout.GetAddressOf(),
+				static_mesh::instanced_input_element_desc,
+				ARRAYSIZE(static_mesh::instanced_input_element_desc));
+			create_vs_from_cso(device.Get(),
+				"phong_shader_quantized_instanced_vs.cso",
+				mesh_quantized_instanced_vertex_shader.GetAddressOf(),
+				mesh_quantized_instanced_input_layout.GetAddressOf(),
+				static_mesh::quantized_instanced_input_element_desc,
+				ARRAYSIZE(static_mesh::quantized_instanced_input_element_desc));
+
 
 		}
 		// spritepftHg`VF[_[
@@ -293,8 +285,65 @@ bool framework::initialize()
 	return true;
 }
 
+void framework::resolve_loading_assets()
+{
+	auto is_ready = [](const auto& future)
+	{
+		return future.valid() && future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+	};
+
+	bool loading{ false };
+	for (size_t i = 0; i < loading_static_meshs.size(); ++i)
+	{
+		if (is_ready(loading_static_meshs[i]))
+		{
+			static_mesh::source source{ loading_static_meshs[i].get() };
+			//{[͍łeLODIN[WJO̎Օɂ
+			if (i == 0 && !source.lods.empty())
+			{
+				ball_occluder = static_mesh::make_raster_mesh(source, source.lods.size() - 1);
+			}
+			dummy_static_meshs[i] = std::make_unique<static_mesh>(device.Get(), std::move(source));
+			dummy_static_meshs[i]->set_constant_buffer_ring(constant_ring.get());
+		}
+		loading |= loading_static_meshs[i].valid();
+	}
+
+	struct
+	{
+		std::future<decoded_texture>* future;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>* shader_resource_view;
+		D3D11_TEXTURE2D_DESC* texture2d_desc;
+	} textures[]
+	{
+		{ &loading_mask_texture, &mask_texture, &mask_texture2dDesc },
+		{ &loading_ramp_texture, &ramp_texture, &ramp_texture2dDesc },
+		{ &loading_environment_texture, &environment_texture, &environment_texture2dDesc },
+	};
+	for (auto& texture : textures)
+	{
+		if (is_ready(*texture.future))
+		{
+			//v[Xz_[ǂݍ񂾃eNX`ɍւ
+			create_texture_from_decoded(device.Get(), texture.future->get(), texture.shader_resource_view->ReleaseAndGetAddressOf(), texture.texture2d_desc);
+		}
+		loading |= texture.future->valid();
+	}
+
+	if (!loading && time_to_assets_loaded == 0.0f)
+	{
+		time_to_assets_loaded = startup_benchmark.end();
+		std::wostringstream outs;
+		outs << L"all assets loaded : " << time_to_assets_loaded * 1000.0f << L" ms\n";
+		OutputDebugStringW(outs.str().c_str());
+	}
+}
+
 void framework::update(float elapsed_time/*Elapsed seconds from last frame*/)
 {
+	//ǂݍ݂IAZbg̃foCXIuWFNg𐶐
+	resolve_loading_assets();
+
 	// ԌoߍXV
 	timer += elapsed_time;
 
@@ -328,6 +377,17 @@ void framework::update(float elapsed_time/*Elapsed seconds from last frame*/)
 	ImGui::ColorEdit3("fog_color", &fog_color.x);
 	ImGui::SliderFloat("fog_near", &fog_range.x, 0.1f, +100.0f);
 	ImGui::SliderFloat("fog_far", &fog_range.y, 0.1f, +100.0f);
+	ImGui::Separator();
+	ImGui::Text("static_mesh draw calls : %u", mesh_render_statistics.draw_calls);
+	ImGui::Text("static_mesh state changes : %u", mesh_render_statistics.state_changes);
+	ImGui::Text("state calls issued : %u, filtered : %u", command_filter->statistics().issued, command_filter->statistics().filtered);
+	ImGui::Text("visible balls : %zu / %zu", visible_balls.size(), ball_worlds.size());
+	ImGui::Checkbox("occlusion culling", &occlusion_culling);
+	ImGui::SliderInt("occluders", &ball_occluder_count, 0, 128);
+	ImGui::Text("occluded balls : %zu, %u occluder triangles, %.3f ms", occluded_balls, ball_occlusion.statistics().occluder_triangles, occlusion_cull_time * 1000.0f);
+	ImGui::Text("constant bytes uploaded : %zu", constant_bytes_uploaded);
+	ImGui::Text("time to first frame : %.1f ms", time_to_first_frame * 1000.0f);
+	ImGui::Text("time to assets loaded : %.1f ms", time_to_assets_loaded * 1000.0f);
 
 
 	ImGui::End();
@@ -337,6 +397,10 @@ void framework::render(float elapsed_time/*Elapsed seconds from last frame*/)
 {
 	HRESULT hr{ S_OK };
 
+	// Ot[܂łGPUgI萔obt@̗̈
+	constant_ring->begin_frame();
+	constant_bytes_uploaded = 0;
+
 	// _[^[Qbg̐ݒƃNA
 	FLOAT color[]{ 0.2f, 0.2f, 0.2f, 1.0f };
 	immediate_context->ClearRenderTargetView(render_target_view.Get(), color);
@@ -440,8 +504,8 @@ void framework::render(float elapsed_time/*Elapsed seconds from last frame*/)
 		float aspect_ratio{ viewport.Width / viewport.Height };
 		P = DirectX::XMMatrixPerspectiveFovLH(  DirectX::XMConvertToRadians(30),
 												aspect_ratio,
-												0.1f,
-												100.0f);
+												near_z,
+												far_z);
 	}
 	// 萔obt@̍XV
 	{
@@ -456,44 +520,38 @@ void framework::render(float elapsed_time/*Elapsed seconds from last frame*/)
 		scene.camera_position.y = camera_position.y;
 		scene.camera_position.z = camera_position.z;
 		DirectX::XMStoreFloat4x4(&scene.view_projection, V * P);
-		immediate_context->UpdateSubresource(scene_constant_buffer.Get(), 0, 0, &scene, 0, 0);
-		immediate_context->VSSetConstantBuffers(1, 1, scene_constant_buffer.GetAddressOf());
-		immediate_context->PSSetConstantBuffers(1, 1, scene_constant_buffer.GetAddressOf());
+		constant_ring->bind(1, constant_ring->push(scene));
 	
 		light_constants lights{};
 		lights.ambient_color = ambient_color;
 		lights.directional_light_direction = directional_light_direction;
 		lights.directional_light_color = directional_light_color;
-		immediate_context->UpdateSubresource(light_constant_buffer.Get(), 0, 0, &lights, 0, 0);
-		immediate_context->VSSetConstantBuffers(2, 1, light_constant_buffer.GetAddressOf());
-		immediate_context->PSSetConstantBuffers(2, 1, light_constant_buffer.GetAddressOf());
+		scene_block->set(0, lights);
 	
 		environment_constants environments{};
 		environments.environment_value = environment_value;
-		immediate_context->UpdateSubresource(environment_constant_buffer.Get(), 0, 0, &environments, 0, 0);
-		immediate_context->VSSetConstantBuffers(3, 1, environment_constant_buffer.GetAddressOf());
-		immediate_context->PSSetConstantBuffers(3, 1, environment_constant_buffer.GetAddressOf());
+		scene_block->set(1, environments);
 	
 		hemisphere_light_constants hemisphere_lights{};
 		hemisphere_lights.sky_color = sky_color;
 		hemisphere_lights.ground_color = ground_color;
 		hemisphere_lights.hemisphere_weight.x = hemisphere_weight;
-		immediate_context->UpdateSubresource(hemisphere_light_constant_buffer.Get(), 0, 0, &hemisphere_lights, 0, 0);
-		immediate_context->VSSetConstantBuffers(4, 1, hemisphere_light_constant_buffer.GetAddressOf());
-		immediate_context->PSSetConstantBuffers(4, 1, hemisphere_light_constant_buffer.GetAddressOf());
+		scene_block->set(2, hemisphere_lights);
 
 		fog_constants fogs{};
 		fogs.fog_color = fog_color;
 		fogs.fog_range = fog_range;
-		immediate_context->UpdateSubresource(fog_constant_buffer.Get(), 0, 0, &fogs, 0, 0);
-		immediate_context->VSSetConstantBuffers(5, 1, fog_constant_buffer.GetAddressOf());
-		immediate_context->PSSetConstantBuffers(5, 1, fog_constant_buffer.GetAddressOf());
+		scene_block->set(3, fogs);
+
+		//ω]AeZNV b2`b5 ɃZbg
+		constant_bytes_uploaded += scene_block->upload();
+		for (UINT slot = 2; slot <= 5; ++slot)
+		{
+			scene_block->bind(slot, slot - 2);
+		}
 	}
 
 	// static_mesh`
-	immediate_context->IASetInputLayout(mesh_input_layout.Get());
-	immediate_context->VSSetShader(mesh_vertex_shader.Get(), nullptr, 0);
-	immediate_context->PSSetShader(mesh_pixel_shader.Get(), nullptr, 0);
 	immediate_context->PSSetSamplers(0, 1, sampler_state.GetAddressOf());
 	
 
@@ -503,53 +561,229 @@ void framework::render(float elapsed_time/*Elapsed seconds from last frame*/)
 
 	immediate_context->PSSetShaderResources(3, 1, environment_texture.GetAddressOf());
 
+	//XvCgp̒萔 (b2 : UVXN[Ab3 : fB]u) ̓R}hXg[ɏ
+	scroll_constants scroll{};
+	scroll.scroll_direction.x = scroll_direction.x;
+	scroll.scroll_direction.y = scroll_direction.y;
+	dissolve_constants dissolve{};
+	dissolve.parameters.x = dissolve_value;//fB]uisxZbg
+	//\[gL[̃VF[_[ԍɍ킹ē̓CAEgƃVF[_[؂ւR}hL^
+	auto record_shader = [&](command_stream& stream, uint32_t shader)
+	{
+		switch (shader)
+		{
+		case mesh_shader:
+			stream.set_input_layout(mesh_input_layout.Get());
+			stream.set_vertex_shader(mesh_vertex_shader.Get());
+			stream.set_pixel_shader(mesh_pixel_shader.Get());
+			break;
+		case mesh_quantized_shader:
+			stream.set_input_layout(mesh_quantized_input_layout.Get());
+			stream.set_vertex_shader(mesh_quantized_vertex_shader.Get());
+			stream.set_pixel_shader(mesh_pixel_shader.Get());
+			break;
+		case mesh_instanced_shader:
+			stream.set_input_layout(mesh_instanced_input_layout.Get());
+			stream.set_vertex_shader(mesh_instanced_vertex_shader.Get());
+			stream.set_pixel_shader(mesh_pixel_shader.Get());
+			break;
+		case mesh_quantized_instanced_shader:
+			stream.set_input_layout(mesh_quantized_instanced_input_layout.Get());
+			stream.set_vertex_shader(mesh_quantized_instanced_vertex_shader.Get());
+			stream.set_pixel_shader(mesh_pixel_shader.Get());
+			break;
+		case primitive_shader:
+			//geometric_primitive ͎ŃVF[_[ݒ肷
+			break;
+		case sprite_shader:
+			//Tv[ s0 ̓t[̐擪Őݒς
+			stream.set_input_layout(sprite_input_layout.Get());
+			stream.set_vertex_shader(sprite_vertex_shader.Get());
+			stream.set_pixel_shader(sprite_pixel_shader.Get());
+			stream.set_shader_resources(1, 1, mask_texture.GetAddressOf());
+			stream.set_constants(2, scroll);
+			stream.set_constants(3, dissolve);
+			break;
+		}
+	};
+	//_`ƕ`@ (ʏ/CX^X`) ɑΉVF[_[ԍ
+	auto mesh_shader_of = [](const static_mesh* mesh, bool instanced)
+	{
+		if (instanced)
+		{
+			return mesh->is_quantized() ? mesh_quantized_instanced_shader : mesh_instanced_shader;
+		}
+		return mesh->is_quantized() ? mesh_quantized_shader : mesh_shader;
+	};
+
+	//`̓pPbgƂċL^A\[gĂ܂Ƃ߂Ďs
+	draw_queue.clear();
+	draw_commands.clear();
+	auto record = [&](uint32_t pass, uint32_t shader, uint32_t material, float distance, std::function<void(command_stream&)>&& command)
+	{
+		draw_queue.record(make_sort_key(pass, shader, material, 0, quantize_sort_depth(distance, near_z, far_z)), static_cast<uint32_t>(draw_commands.size()));
+		draw_commands.push_back(std::move(command));
+	};
+	auto distance_to_camera = [&](float x, float y, float z)
+	{
+		return DirectX::XMVectorGetX(DirectX::XMVector3Length(DirectX::XMVectorSubtract(DirectX::XMVectorSet(x, y, z, 0.0f), DirectX::XMLoadFloat3(&camera_position))));
+	};
+
 	DirectX::XMMATRIX S, R, T;
-	DirectX::XMFLOAT4X4 world;
-	//fʂɕ`
+	DirectX::XMFLOAT4X4 plane_world;
+	mesh_render_statistics = {};
+	//fʂɕ` (ǂݍݒ̓v[Xz_[̋)
+	static_mesh* ball{ dummy_static_meshs[0].get() };
+	//SCX^X̃[hsƃ[hԂAABB߂
+	const float placeholder_bounding_box[2][3]{ { -0.5f, -0.5f, -0.5f }, { +0.5f, +0.5f, +0.5f } };
+	const float* ball_minimum{ ball ? &ball->bounding_box[0].x : placeholder_bounding_box[0] };
+	const float* ball_maximum{ ball ? &ball->bounding_box[1].x : placeholder_bounding_box[1] };
+	ball_worlds.clear();
+	ball_bounds.clear();
 	for (int x = -10; x < 10; x++)
 	{
 		for (int z = 0; z < 75; z++)
 		{
-			S = DirectX::XMMatrixScaling(0.01f * scaling.x, 0.01f * scaling.y, 0.01f * scaling.z);
+			S = ball ? DirectX::XMMatrixScaling(0.01f * scaling.x, 0.01f * scaling.y, 0.01f * scaling.z) : DirectX::XMMatrixScaling(scaling.x, scaling.y, scaling.z);
 			R = DirectX::XMMatrixRotationRollPitchYaw(rotation.x, rotation.y, rotation.z);
 			T = DirectX::XMMatrixTranslation(translation.x + (static_cast<float>(x) * 3),
 				translation.y,
 				translation.z + (static_cast<float>(z) * 3));
-			DirectX::XMStoreFloat4x4(&world, S* R* T);
-			dummy_static_meshs[0]->render(immediate_context.Get(), world, material_color);
+			ball_worlds.emplace_back();
+			DirectX::XMStoreFloat4x4(&ball_worlds.back(), S* R* T);
+			ball_bounds.push_back(ball_minimum, ball_maximum, &ball_worlds.back()._11);
+		}
+	}
+	//̊ÕCX^X
+	DirectX::XMFLOAT4X4 view_projection;
+	DirectX::XMStoreFloat4x4(&view_projection, V * P);
+	visible_balls.clear();
+	cull_aabbs(extract_frustum(&view_projection._11), ball_bounds, visible_balls);
+	//Õ{[ɉBCX^X
+	occluded_balls = 0;
+	if (occlusion_culling && !ball_occluder.indices.empty())
+	{
+		occlusion_benchmark.begin();
+		//Օ͉CX^X̂Jɍł߂
+		auto distance_squared = [&](uint32_t i)
+		{
+			const float x{ ball_bounds.center_x[i] - camera_position.x };
+			const float y{ ball_bounds.center_y[i] - camera_position.y };
+			const float z{ ball_bounds.center_z[i] - camera_position.z };
+			return x * x + y * y + z * z;
+		};
+		ball_occluders.assign(visible_balls.begin(), visible_balls.end());
+		const size_t occluder_count{ (std::min)(ball_occluders.size(), static_cast<size_t>((std::max)(ball_occluder_count, 0))) };
+		std::nth_element(ball_occluders.begin(), ball_occluders.begin() + occluder_count, ball_occluders.end(),
+			[&](uint32_t a, uint32_t b) { return distance_squared(a) < distance_squared(b); });
+		ball_occlusion.clear(&view_projection._11);
+		for (size_t k = 0; k < occluder_count; ++k)
+		{
+			ball_occlusion.add_occluder(ball_occluder.positions.data(), ball_occluder.positions.size() / 3, ball_occluder.indices.data(), ball_occluder.indices.size(),
+				&ball_worlds[ball_occluders[k]]._11);
+		}
+		occluded_balls = ball_occlusion.cull_occluded(ball_bounds, visible_balls);
+		occlusion_cull_time = occlusion_benchmark.end();
+	}
+	//LODIpFoEfBO{bNX̒S܂ł̋Ɖʏ̌덷̃XP[
+	const float ball_world_scale{ 0.01f * (std::max)({ fabsf(scaling.x), fabsf(scaling.y), fabsf(scaling.z) }) };
+	const float projection_scale{ DirectX::XMVectorGetY(P.r[1]) * SCREEN_HEIGHT * 0.5f };
+	if (ball)
+	{
+		//CX^XLODƂɂ܂Ƃ߁ALODƂ1̃CX^X`ŕ`
+		visible_ball_lods.clear();
+		for (uint32_t i : visible_balls)
+		{
+			float distance{ distance_to_camera(ball_bounds.center_x[i], ball_bounds.center_y[i], ball_bounds.center_z[i]) };
+			visible_ball_lods.push_back(static_cast<uint32_t>(ball->select_lod(distance, ball_world_scale, projection_scale)));
+		}
+		batch_instances(visible_balls.data(), visible_ball_lods.data(), visible_balls.size(), static_cast<uint32_t>(ball->lods.size()),
+			ball_instance_order, ball_batches);
+		for (const instance_batch& batch : ball_batches)
+		{
+			//܂Ƃ߂CX^X̂łŐŃ\[g
+			float distance{ far_z };
+			for (uint32_t k = batch.first; k < batch.first + batch.count; ++k)
+			{
+				uint32_t i{ ball_instance_order[k] };
+				distance = (std::min)(distance, distance_to_camera(ball_bounds.center_x[i], ball_bounds.center_y[i], ball_bounds.center_z[i]));
+			}
+			record(opaque_pass, mesh_shader_of(ball, true), 0, distance, [this, ball, batch](command_stream& stream)
+			{
+				ball->record_instanced(stream, ball_worlds.data(), ball_instance_order.data() + batch.first, batch.count, material_color, batch.key);
+			});
+		}
+	}
+	else
+	{
+		for (uint32_t i : visible_balls)
+		{
+			record(opaque_pass, primitive_shader, 0, distance_to_camera(ball_bounds.center_x[i], ball_bounds.center_y[i], ball_bounds.center_z[i]), [this, i](command_stream& stream)
+			{
+				placeholder_sphere->record(stream, ball_worlds[i], material_color);
+			});
 		}
 	}
 
-	//ʃf\
+	//ʃf\ (ǂݍݒ͔őp)
 	S = DirectX::XMMatrixScaling(100 * scaling.x, 100 * scaling.y, 100 * scaling.z);
 	R = DirectX::XMMatrixRotationRollPitchYaw(rotation.x, rotation.y, rotation.z);
 	T = DirectX::XMMatrixTranslation(translation.x, translation.y - 1, translation.z);
-	DirectX::XMStoreFloat4x4(&world, S* R* T);
-	dummy_static_meshs[1]->render(immediate_context.Get(), world, material_color);
-
+	//̕ʂ͏ɑ̕艜ɂƂ݂ȂAVF[_[̕`̒ł͍Ōɕ`
+	if (static_mesh* plane{ dummy_static_meshs[1].get() })
+	{
+		DirectX::XMStoreFloat4x4(&plane_world, S* R* T);
+		record(opaque_pass, mesh_shader_of(plane, false), 1, far_z, [&, plane](command_stream& stream)
+		{
+			plane->record(stream, plane_world, material_color);
+		});
+	}
+	else
+	{
+		DirectX::XMStoreFloat4x4(&plane_world, DirectX::XMMatrixScaling(100 * scaling.x, 0.01f, 100 * scaling.z) * R * T);
+		record(opaque_pass, primitive_shader, 1, far_z, [&](command_stream& stream)
+		{
+			placeholder_cube->record(stream, plane_world, material_color);
+		});
+	}
 
 	// sprite`
 	if(dummy_sprite)
 	{
-		scroll_constants scroll{};
-		scroll.scroll_direction.x = scroll_direction.x;
-		scroll.scroll_direction.y = scroll_direction.y;
-		immediate_context->UpdateSubresource(scroll_constants_buffer.Get(), 0, 0, &scroll, 0, 0);
-		immediate_context->VSSetConstantBuffers(2, 1, scroll_constants_buffer.GetAddressOf());
-		immediate_context->PSSetConstantBuffers(2, 1, scroll_constants_buffer.GetAddressOf());
-
-		dissolve_constants dissolve{};
-		dissolve.parameters.x = dissolve_value;//fB]uisxZbg
-		immediate_context->UpdateSubresource(dissolve_constant_buffer.Get(), 0, 0, &dissolve, 0, 0);//VF[_pf[^XV
-		immediate_context->VSSetConstantBuffers(3, 1, dissolve_constant_buffer.GetAddressOf());//_VF[_ɒ萔obt@Zbg
-		immediate_context->PSSetConstantBuffers(3, 1, dissolve_constant_buffer.GetAddressOf());//sNZVF[_ɂZbg
-
-		immediate_context->IASetInputLayout(sprite_input_layout.Get());
-		immediate_context->VSSetShader(sprite_vertex_shader.Get(), nullptr, 0);
-		immediate_context->PSSetShader(sprite_pixel_shader.Get(), nullptr, 0);
-		immediate_context->PSSetSamplers(0, 1, sampler_state.GetAddressOf());
-		immediate_context->PSSetShaderResources(1, 1, mask_texture.GetAddressOf());
-		dummy_sprite->render(immediate_context.Get(), 256, 128, SCREEN_WIDTH - 256 * 2, SCREEN_HEIGHT - 128 * 2);
+		record(overlay_pass, sprite_shader, 0, 0.0f, [this](command_stream& stream)
+		{
+			dummy_sprite->record(stream, static_cast<float>(SCREEN_WIDTH), static_cast<float>(SCREEN_HEIGHT), 256, 128, SCREEN_WIDTH - 256 * 2, SCREEN_HEIGHT - 128 * 2);
+		});
+	}
+
+	//\[gL[ (pXVF[_[}eAO牜) ɕׁAAԂƂɕʃXbhŃR}hL^
+	//VF[_[͕ς鎞؂ւ (Ԃ̐擪ł͕Kݒ肷)
+	draw_queue.sort();
+	const size_t worker_count{ (std::max)(1u, std::thread::hardware_concurrency()) };
+	command_streams.resize((std::min)(worker_count, 1 + draw_queue.size() / packets_per_command_stream));
+	record_parallel(command_streams, draw_queue.size(), [&](command_stream& stream, size_t first, size_t last)
+	{
+		uint32_t bound_shader{ UINT32_MAX };
+		for (size_t k = first; k < last; ++k)
+		{
+			const draw_packet& packet{ draw_queue.begin()[k] };
+			const uint32_t shader{ sort_key_shader(packet.key) };
+			if (shader != bound_shader)
+			{
+				record_shader(stream, shader);
+				bound_shader = shader;
+			}
+			draw_commands[packet.payload](stream);
+		}
+	});
+	//L^ɃC~fBGCgReLXg֍Đ (Xg[̋ڂ܂ŏdXe[g̐ݒ͏Ȃ)
+	command_filter->invalidate();
+	command_filter->reset_statistics();
+	for (const command_stream& stream : command_streams)
+	{
+		replay(stream, *command_filter);
+		mesh_render_statistics.draw_calls += stream.draw_call_count();
+		mesh_render_statistics.state_changes += stream.state_change_count();
 	}
 
 #ifdef USE_IMGUI
@@ -557,8 +791,20 @@ void framework::render(float elapsed_time/*Elapsed seconds from last frame*/)
 	ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
 #endif
 
+	// ̃t[Ŏg萔obt@̗̈ɃtFXu
+	constant_bytes_uploaded += constant_ring->bytes_pushed();
+	constant_ring->end_frame();
+
 	UINT sync_interval{ 0 };
 	swap_chain->Present(sync_interval, 0);
+
+	if (time_to_first_frame == 0.0f)
+	{
+		time_to_first_frame = startup_benchmark.end();
+		std::wostringstream outs;
+		outs << L"first frame : " << time_to_first_frame * 1000.0f << L" ms\n";
+		OutputDebugStringW(outs.str().c_str());
+	}
 }
 
 bool framework::uninitialize()
@@ -21,6 +21,19 @@ extern ImWchar glyphRangesJapanese[];
 #include <wrl.h>
 #include "geometric_primitive.h"
 #include "static_mesh.h"
+#include "texture.h"
+#include "frustum_culling.h"
+#include "occlusion_culling.h"
+#include "constant_buffer_ring.h"
+#include "constant_block.h"
+#include "render_queue.h"
+#include "command_stream.h"
+#include "d3d11_command_backend.h"
+#include "state_filter.h"
+
+#include <future>
+#include <functional>
+#include <thread>
 
 CONST LONG SCREEN_WIDTH{ 1280 };
 CONST LONG SCREEN_HEIGHT{ 720 };
@@ -49,7 +62,6 @@ public:
 		DirectX::XMFLOAT4 fog_color;//̐F
 		DirectX::XMFLOAT4 fog_range;//tHŐ
 	};
-	Microsoft::WRL::ComPtr<ID3D11Buffer> fog_constant_buffer;//tHȌGPUɑ萔obt@
 	DirectX::XMFLOAT4 fog_color{ 0.2f,0.2f,0.2f,1.0f };		//̐F
 	DirectX::XMFLOAT4 fog_range{ 0.1f,100.0f,0.0f,0.0f };	//tHŐ
 
@@ -60,7 +72,6 @@ public:
 		DirectX::XMFLOAT4 ground_color;		//nʂ̐F
 		DirectX::XMFLOAT4 hemisphere_weight;//ƒnʂ̉ex
 	};
-	Microsoft::WRL::ComPtr<ID3D11Buffer> hemisphere_light_constant_buffer;//Cgp̒萔obt@
 	DirectX::XMFLOAT4 sky_color{ 1.0f,0.0f,0.0f,1.0f };		//̐F
 	DirectX::XMFLOAT4 ground_color{ 0.0f,0.0f,1.0f,1.0f };	//nʂ̐F
 	float hemisphere_weight{ 0.0f };						//ƒnʂ̉ex
@@ -73,7 +84,6 @@ public:
 		DirectX::XMFLOAT4 directional_light_direction;//š
 		DirectX::XMFLOAT4 directional_light_color;//s̐F
 	};
-	Microsoft::WRL::ComPtr<ID3D11Buffer> light_constant_buffer;
 
 	DirectX::XMFLOAT4 ambient_color{ 0.2f,0.2f,0.2f,0.2f };
 	DirectX::XMFLOAT4 directional_light_direction{ 0.0f,-1.0f,1.0f,1.0f };
@@ -85,7 +95,6 @@ public:
 		DirectX::XMFLOAT2 scroll_direction;
 		DirectX::XMFLOAT2 scroll_dummy;
 	};
-	Microsoft::WRL::ComPtr<ID3D11Buffer>scroll_constants_buffer;
 	DirectX::XMFLOAT2 scroll_direction;
 
 	//V[S̏GPU֑
@@ -101,9 +110,12 @@ public:
 		DirectX::XMFLOAT4 parameters;//x : fB]uKʁAyzw : 
 	};
 	float dissolve_value{ 0.0f };
-	Microsoft::WRL::ComPtr<ID3D11Buffer> dissolve_constant_buffer;
 
-	Microsoft::WRL::ComPtr<ID3D11Buffer> scene_constant_buffer;
+	//萔obt@ (b0`b5) ׂ͂ẴOobt@疈t[蓖Ă
+	std::unique_ptr<constant_buffer_ring> constant_ring;
+	//XC_[𓮂ςȂ萔͏풓̒萔obt@ɂ܂Ƃ߁Aω]
+	std::unique_ptr<constant_block> scene_block;//b2 : Ab3 : }bsOAb4 : CgAb5 : tHO
+	size_t constant_bytes_uploaded{ 0 };//Ot[ɒ萔obt@֓]oCg
 	float timer{0.0f};
 	bool flag{false};
 
@@ -120,10 +132,65 @@ public:
 	DirectX::XMFLOAT3 rotation{ 0, 0, 0 };
 	DirectX::XMFLOAT4 material_color{ 1 ,1, 1, 1 };
 
-	std::vector<std::unique_ptr<static_mesh>> dummy_static_meshs;
+	std::vector<std::unique_ptr<static_mesh>> dummy_static_meshs;//ǂݍ݂I܂łnullptr
+
+	//񓯊ǂݍ : ́EfR[hEO̓[J[XbhōsAfoCXIuWFNg̐resolve_loading_assetsōs
+	std::vector<std::future<static_mesh::source>> loading_static_meshs;
+	std::future<decoded_texture> loading_mask_texture;
+	std::future<decoded_texture> loading_ramp_texture;
+	std::future<decoded_texture> loading_environment_texture;
+	void resolve_loading_assets();
+	//ǂݍݒstatic_mesh̑ɕ`悷v[Xz_[
+	std::unique_ptr<geometric_primitive> placeholder_sphere;
+	std::unique_ptr<geometric_primitive> placeholder_cube;
+	//Ňv (b) : ŏ̃t[̕\܂ŁASAZbg̓ǂݍ݊܂
+	benchmark startup_benchmark;
+	float time_to_first_frame{ 0.0f };
+	float time_to_assets_loaded{ 0.0f };
+	//{[̃CX^XƂ̃[hsƃ[hԂAABBAJOʂCX^X
+	std::vector<DirectX::XMFLOAT4X4> ball_worlds;
+	world_aabbs ball_bounds;
+	std::vector<uint32_t> visible_balls;
+	//IN[WJOFōł߂{[eLODŒ𑜓x̐[xobt@ɕ`ẢɉBCX^X
+	raster_mesh ball_occluder;
+	occlusion_buffer ball_occlusion{ SCREEN_WIDTH / 4, SCREEN_HEIGHT / 4 };
+	std::vector<uint32_t> ball_occluders;
+	bool occlusion_culling{ true };
+	int ball_occluder_count{ 32 };
+	size_t occluded_balls{ 0 };
+	float occlusion_cull_time{ 0.0f };
+	benchmark occlusion_benchmark;
+	//CX^X`pFCX^XLODALODƂɕׂCX^XƂ̋؂
+	std::vector<uint32_t> visible_ball_lods;
+	std::vector<uint32_t> ball_instance_order;
+	std::vector<instance_batch> ball_batches;
+	//`pPbgF\[gL[draw_commands̓YL^A\[gĂs
+	enum draw_pass : uint32_t { opaque_pass, overlay_pass };
+	enum draw_shader : uint32_t { mesh_shader, mesh_quantized_shader, mesh_instanced_shader, mesh_quantized_instanced_shader, primitive_shader, sprite_shader };
+	render_queue draw_queue;
+	std::vector<std::function<void(command_stream&)>> draw_commands;
+	//\[gς݂̃pPbg[J[XbhƂ̃R}hXg[ɋL^ÃXbhŏɍĐ
+	std::vector<command_stream> command_streams;
+	std::unique_ptr<d3d11_command_backend> command_backend;
+	//ĐɑOƓXe[g̐ݒ菜
+	std::unique_ptr<state_filter> command_filter;
+	//菭ȂpPbg̓Xbh𕪂ɋL^
+	static constexpr size_t packets_per_command_stream{ 64 };
+	//es̃jAEt@[ (`pPbg̐[x͈̔͂ɂg)
+	float near_z{ 0.1f };
+	float far_z{ 100.0f };
+	static_mesh::render_statistics mesh_render_statistics;//Ot[static_mesh`APIĂяo
 	Microsoft::WRL::ComPtr<ID3D11VertexShader> mesh_vertex_shader;
 	Microsoft::WRL::ComPtr<ID3D11InputLayout> mesh_input_layout;
 	Microsoft::WRL::ComPtr<ID3D11PixelShader> mesh_pixel_shader;
+	//ʎq_ (static_mesh::quantize_vertices) ̃bVp
+	Microsoft::WRL::ComPtr<ID3D11VertexShader> mesh_quantized_vertex_shader;
+	Microsoft::WRL::ComPtr<ID3D11InputLayout> mesh_quantized_input_layout;
+	//CX^X` (static_mesh::render_instanced) p
+	Microsoft::WRL::ComPtr<ID3D11VertexShader> mesh_instanced_vertex_shader;
+	Microsoft::WRL::ComPtr<ID3D11InputLayout> mesh_instanced_input_layout;
+	Microsoft::WRL::ComPtr<ID3D11VertexShader> mesh_quantized_instanced_vertex_shader;
+	Microsoft::WRL::ComPtr<ID3D11InputLayout> mesh_quantized_instanced_input_layout;
 
 	std::unique_ptr<sprite> dummy_sprite;
 	Microsoft::WRL::ComPtr<ID3D11VertexShader> sprite_vertex_shader;
@@ -139,7 +206,6 @@ public:
 		float environment_value;
 		DirectX::XMFLOAT3 dummy;
 	};
-	Microsoft::WRL::ComPtr<ID3D11Buffer> environment_constant_buffer;//GPUɑ萔obt@IuWFNg
 	D3D11_TEXTURE2D_DESC environment_texture2dDesc;//eNX`ݒ\
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> environment_texture;//eNX`
 	float environment_value{ 0.5f };//ʂ̋x▾邳𒲐
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cmath>
+
+// View frustum as six inward facing planes (a, b, c, d) : a point p is inside a plane if a*x + b*y + c*z + d >= 0.
+struct frustum
+{
+	enum { left, right, bottom, top, near_plane, far_plane };
+	float planes[6][4];
+};
+
+// Extracts the frustum from a row-major matrix used as 'clip = float4(p, 1) * m' (the HLSL mul(p, m)
+// convention of the shaders), with the D3D clip volume -w <= x, y <= w, 0 <= z <= w.
+// Passing world * view * projection gives the frustum in the object space of that world matrix.
+inline frustum extract_frustum(const float m[16])
+{
+	auto column = [m](int c, int r) { return m[r * 4 + c]; };
+	frustum f{};
+	for (int r = 0; r < 4; ++r)
+	{
+		f.planes[frustum::left][r] = column(3, r) + column(0, r);
+		f.planes[frustum::right][r] = column(3, r) - column(0, r);
+		f.planes[frustum::bottom][r] = column(3, r) + column(1, r);
+		f.planes[frustum::top][r] = column(3, r) - column(1, r);
+		f.planes[frustum::near_plane][r] = column(2, r);
+		f.planes[frustum::far_plane][r] = column(3, r) - column(2, r);
+	}
+	for (float(&plane)[4] : f.planes)
+	{
+		float length{ sqrtf(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]) };
+		if (length > 0)
+		{
+			for (float& v : plane)
+			{
+				v /= length;
+			}
+		}
+	}
+	return f;
+}
@@ -0,0 +1,186 @@
+#include "frustum_culling.h"
+
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define FRUSTUM_CULLING_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+// MSVC accepts AVX intrinsics in any function; GCC and Clang need the target attribute.
+#define AVX_FUNCTION
+#else
+#define AVX_FUNCTION __attribute__((target("avx")))
+#endif
+#endif
+
+namespace
+{
+	// Plane equations with the absolute values of the normals precomputed for the extent projection.
+	struct cull_planes
+	{
+		float n[6][3];
+		float abs_n[6][3];
+		float d[6];
+	};
+
+	cull_planes make_cull_planes(const frustum& f)
+	{
+		cull_planes planes;
+		for (int p = 0; p < 6; ++p)
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				planes.n[p][k] = f.planes[p][k];
+				planes.abs_n[p][k] = fabsf(f.planes[p][k]);
+			}
+			planes.d[p] = f.planes[p][3];
+		}
+		return planes;
+	}
+
+	// A box is outside a plane if even its corner furthest along the normal is behind it :
+	// dot(n, center) + d + dot(|n|, extent) < 0.
+	size_t cull_scalar(const cull_planes& planes, const world_aabbs& boxes, size_t first, size_t last, uint32_t* visible)
+	{
+		size_t count{ 0 };
+		for (size_t i = first; i < last; ++i)
+		{
+			bool inside{ true };
+			for (int p = 0; p < 6 && inside; ++p)
+			{
+				float distance{ planes.n[p][0] * boxes.center_x[i] + planes.n[p][1] * boxes.center_y[i] + planes.n[p][2] * boxes.center_z[i] + planes.d[p] };
+				float radius{ planes.abs_n[p][0] * boxes.extent_x[i] + planes.abs_n[p][1] * boxes.extent_y[i] + planes.abs_n[p][2] * boxes.extent_z[i] };
+				inside = distance + radius >= 0.0f;
+			}
+			visible[count] = static_cast<uint32_t>(i);
+			count += inside ? 1 : 0;
+		}
+		return count;
+	}
+
+#ifdef FRUSTUM_CULLING_X86
+	// Writes the lanes set in 'mask' without branches; 'visible' needs room for 'lanes' entries past 'count'.
+	inline size_t compact(uint32_t* visible, size_t count, uint32_t first, int mask, int lanes)
+	{
+		for (int k = 0; k < lanes; ++k)
+		{
+			visible[count] = first + k;
+			count += (mask >> k) & 1;
+		}
+		return count;
+	}
+
+	size_t cull_sse(const cull_planes& planes, const world_aabbs& boxes, uint32_t* visible)
+	{
+		const size_t batch_end{ boxes.size() & ~static_cast<size_t>(3) };
+		const __m128 zero{ _mm_setzero_ps() };
+		size_t count{ 0 };
+		for (size_t i = 0; i < batch_end; i += 4)
+		{
+			const __m128 cx{ _mm_loadu_ps(&boxes.center_x[i]) }, cy{ _mm_loadu_ps(&boxes.center_y[i]) }, cz{ _mm_loadu_ps(&boxes.center_z[i]) };
+			const __m128 ex{ _mm_loadu_ps(&boxes.extent_x[i]) }, ey{ _mm_loadu_ps(&boxes.extent_y[i]) }, ez{ _mm_loadu_ps(&boxes.extent_z[i]) };
+			__m128 inside{ _mm_castsi128_ps(_mm_set1_epi32(-1)) };
+			for (int p = 0; p < 6; ++p)
+			{
+				__m128 distance{ _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes.n[p][0]), cx), _mm_mul_ps(_mm_set1_ps(planes.n[p][1]), cy)),
+					_mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes.n[p][2]), cz), _mm_set1_ps(planes.d[p]))) };
+				__m128 radius{ _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes.abs_n[p][0]), ex), _mm_mul_ps(_mm_set1_ps(planes.abs_n[p][1]), ey)),
+					_mm_mul_ps(_mm_set1_ps(planes.abs_n[p][2]), ez)) };
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, radius), zero));
+			}
+			count = compact(visible, count, static_cast<uint32_t>(i), _mm_movemask_ps(inside), 4);
+		}
+		return count + cull_scalar(planes, boxes, batch_end, boxes.size(), visible + count);
+	}
+
+	AVX_FUNCTION size_t cull_avx(const cull_planes& planes, const world_aabbs& boxes, uint32_t* visible)
+	{
+		const size_t batch_end{ boxes.size() & ~static_cast<size_t>(7) };
+		const __m256 zero{ _mm256_setzero_ps() };
+		size_t count{ 0 };
+		for (size_t i = 0; i < batch_end; i += 8)
+		{
+			const __m256 cx{ _mm256_loadu_ps(&boxes.center_x[i]) }, cy{ _mm256_loadu_ps(&boxes.center_y[i]) }, cz{ _mm256_loadu_ps(&boxes.center_z[i]) };
+			const __m256 ex{ _mm256_loadu_ps(&boxes.extent_x[i]) }, ey{ _mm256_loadu_ps(&boxes.extent_y[i]) }, ez{ _mm256_loadu_ps(&boxes.extent_z[i]) };
+			__m256 inside{ _mm256_castsi256_ps(_mm256_set1_epi32(-1)) };
+			for (int p = 0; p < 6; ++p)
+			{
+				__m256 distance{ _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(planes.n[p][0]), cx), _mm256_mul_ps(_mm256_set1_ps(planes.n[p][1]), cy)),
+					_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(planes.n[p][2]), cz), _mm256_set1_ps(planes.d[p]))) };
+				__m256 radius{ _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(planes.abs_n[p][0]), ex), _mm256_mul_ps(_mm256_set1_ps(planes.abs_n[p][1]), ey)),
+					_mm256_mul_ps(_mm256_set1_ps(planes.abs_n[p][2]), ez)) };
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, radius), zero, _CMP_GE_OQ));
+			}
+			count = compact(visible, count, static_cast<uint32_t>(i), _mm256_movemask_ps(inside), 8);
+		}
+		return count + cull_scalar(planes, boxes, batch_end, boxes.size(), visible + count);
+	}
+
+	bool cpu_supports_avx()
+	{
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 1);
+		const bool osxsave{ (info[2] & (1 << 27)) != 0 };
+		const bool avx{ (info[2] & (1 << 28)) != 0 };
+		return osxsave && avx && (_xgetbv(0) & 6) == 6;
+#else
+		return __builtin_cpu_supports("avx");
+#endif
+	}
+#endif
+}
+
+void world_aabbs::clear()
+{
+	for (std::vector<float>* v : { &center_x, &center_y, &center_z, &extent_x, &extent_y, &extent_z })
+	{
+		v->clear();
+	}
+}
+
+void world_aabbs::push_back(const float minimum[3], const float maximum[3], const float world[16])
+{
+	// Arvo's method : the transformed center, and the extent projected on each world axis through |world|.
+	float center[3], extent[3];
+	for (int k = 0; k < 3; ++k)
+	{
+		center[k] = (minimum[k] + maximum[k]) * 0.5f;
+		extent[k] = (maximum[k] - minimum[k]) * 0.5f;
+	}
+	float world_center[3], world_extent[3];
+	for (int c = 0; c < 3; ++c)
+	{
+		world_center[c] = world[12 + c];
+		world_extent[c] = 0.0f;
+		for (int r = 0; r < 3; ++r)
+		{
+			world_center[c] += center[r] * world[r * 4 + c];
+			world_extent[c] += extent[r] * fabsf(world[r * 4 + c]);
+		}
+	}
+	center_x.push_back(world_center[0]);
+	center_y.push_back(world_center[1]);
+	center_z.push_back(world_center[2]);
+	extent_x.push_back(world_extent[0]);
+	extent_y.push_back(world_extent[1]);
+	extent_z.push_back(world_extent[2]);
+}
+
+size_t cull_aabbs(const frustum& f, const world_aabbs& boxes, std::vector<uint32_t>& visible)
+{
+	const cull_planes planes{ make_cull_planes(f) };
+	const size_t start{ visible.size() };
+	// Room for the lanes written past the last visible box by the branchless compaction.
+	visible.resize(start + boxes.size() + 8);
+	size_t count;
+#ifdef FRUSTUM_CULLING_X86
+	static const bool avx{ cpu_supports_avx() };
+	count = avx ? cull_avx(planes, boxes, visible.data() + start) : cull_sse(planes, boxes, visible.data() + start);
+#else
+	count = cull_scalar(planes, boxes, 0, boxes.size(), visible.data() + start);
+#endif
+	visible.resize(start + count);
+	return count;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "frustum.h"
+
+// World space axis aligned boxes in structure of arrays form (center and half extent per axis), so that
+// 4 (SSE) or 8 (AVX) boxes are tested against a plane with a handful of vector instructions.
+struct world_aabbs
+{
+	std::vector<float> center_x, center_y, center_z;
+	std::vector<float> extent_x, extent_y, extent_z;
+
+	size_t size() const { return center_x.size(); }
+	void clear();
+	// Appends the box that bounds the object space box [minimum, maximum] transformed by 'world', a row-major
+	// matrix used as 'float4(p, 1) * world' like the world matrices of static_mesh.
+	void push_back(const float minimum[3], const float maximum[3], const float world[16]);
+};
+
+// Appends the indices of the boxes that are not entirely outside one of the frustum planes to 'visible', in
+// increasing order, and returns how many were appended. The test is conservative : a box near a frustum corner
+// may be kept although it is outside. Uses AVX when the CPU supports it, SSE on other x86 / x64 CPUs and scalar
+// code on other platforms.
+size_t cull_aabbs(const frustum& f, const world_aabbs& boxes, std::vector<uint32_t>& visible);
@@ -1,6 +1,7 @@
 #include "shader.h"
 #include "misc.h"
 #include "geometric_primitive.h"
+#include "index_packing.h"
 #include <vector>
 
 geometric_primitive::geometric_primitive(ID3D11Device* device)
@@ -28,7 +29,7 @@ void geometric_primitive::render(ID3D11DeviceContext* immediate_context, const D
 	uint32_t stride{ sizeof(vertex) };
 	uint32_t offset{ 0 };
 	immediate_context->IASetVertexBuffers(0, 1, vertex_buffer.GetAddressOf(), &stride, &offset);
-	immediate_context->IASetIndexBuffer(index_buffer.Get(), DXGI_FORMAT_R32_UINT, 0);
+	immediate_context->IASetIndexBuffer(index_buffer.Get(), index_format, 0);
 	immediate_context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 	immediate_context->IASetInputLayout(input_layout.Get());
 
@@ -39,9 +40,22 @@ void geometric_primitive::render(ID3D11DeviceContext* immediate_context, const D
 	immediate_context->UpdateSubresource(constant_buffer.Get(), 0, 0, &data, 0, 0);
 	immediate_context->VSSetConstantBuffers(0, 1, constant_buffer.GetAddressOf());
 
-	D3D11_BUFFER_DESC buffer_desc{};
-	index_buffer->GetDesc(&buffer_desc);
-	immediate_context->DrawIndexed(buffer_desc.ByteWidth / sizeof(uint32_t), 0, 0);
+	immediate_context->DrawIndexed(index_count, 0, base_vertex);
+}
+
+void geometric_primitive::record(command_stream& stream, const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT4& material_color) const
+{
+	stream.set_vertex_buffer(vertex_buffer.Get(), sizeof(vertex), 0);
+	stream.set_index_buffer(index_buffer.Get(), index_format == DXGI_FORMAT_R16_UINT ? 2 : 4, 0);
+	stream.set_topology(command_stream::triangle_list);
+	stream.set_input_layout(input_layout.Get());
+
+	stream.set_vertex_shader(vertex_shader.Get());
+	stream.set_pixel_shader(pixel_shader.Get());
+
+	stream.set_constants(0, constants{ world, material_color });
+
+	stream.draw_indexed(index_count, 0, base_vertex);
 }
 
 void geometric_primitive::create_com_buffers(ID3D11Device* device, vertex* vertices, size_t vertex_count, uint32_t* indices, size_t index_count)
@@ -62,10 +76,18 @@ void geometric_primitive::create_com_buffers(ID3D11Device* device, vertex* verti
 	hr = device->CreateBuffer(&buffer_desc, &subresource_data, vertex_buffer.ReleaseAndGetAddressOf());
 	_ASSERT_EXPR(SUCCEEDED(hr), hr_trace(hr));
 
-	buffer_desc.ByteWidth = static_cast<UINT>(sizeof(uint32_t) * index_count);
+	// 16-bit indices whenever the vertex count allows it.
+	index_range range{ 0, static_cast<uint32_t>(index_count) };
+	std::vector<packed_index_range> packed;
+	std::vector<uint8_t> packed_indices{ pack_indices(indices, vertex_count, &range, 1, packed) };
+	this->index_format = packed[0].index_size == sizeof(uint16_t) ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+	this->index_count = static_cast<uint32_t>(index_count);
+	this->base_vertex = packed[0].base_vertex;
+
+	buffer_desc.ByteWidth = static_cast<UINT>(packed_indices.size());
 	buffer_desc.Usage = D3D11_USAGE_DEFAULT;
 	buffer_desc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-	subresource_data.pSysMem = indices;
+	subresource_data.pSysMem = packed_indices.data();
 	hr = device->CreateBuffer(&buffer_desc, &subresource_data, index_buffer.ReleaseAndGetAddressOf());
 	_ASSERT_EXPR(SUCCEEDED(hr), hr_trace(hr));
 }
@@ -5,6 +5,8 @@
 
 #include <directxmath.h>
 
+#include "command_stream.h"
+
 class geometric_primitive
 {
 public:
@@ -22,6 +24,9 @@ public:
 private:
 	Microsoft::WRL::ComPtr<ID3D11Buffer> vertex_buffer;
 	Microsoft::WRL::ComPtr<ID3D11Buffer> index_buffer;
+	DXGI_FORMAT index_format{ DXGI_FORMAT_R32_UINT };
+	uint32_t index_count{ 0 };
+	int32_t base_vertex{ 0 };
 
 	Microsoft::WRL::ComPtr<ID3D11VertexShader> vertex_shader;
 	Microsoft::WRL::ComPtr<ID3D11PixelShader> pixel_shader;
@@ -33,6 +38,8 @@ public:
 	virtual ~geometric_primitive() = default;
 
 	void render(ID3D11DeviceContext* immediate_context, const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT4& material_color);
+	// Records the same draw into 'stream', with its own shaders and constants (register 0) from the stream.
+	void record(command_stream& stream, const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT4& material_color) const;
 
 protected:
 	geometric_primitive(ID3D11Device* device);
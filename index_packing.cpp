@@ -0,0 +1,80 @@
+#include "index_packing.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	constexpr size_t max_16bit_vertex_count{ 65536 };
+
+	void append_narrowed(std::vector<uint8_t>& buffer, const uint32_t* indices, size_t index_count, uint32_t base_vertex)
+	{
+		const size_t at{ buffer.size() };
+		buffer.resize(at + index_count * sizeof(uint16_t));
+		uint16_t* destination{ reinterpret_cast<uint16_t*>(buffer.data() + at) };
+		for (size_t i = 0; i < index_count; ++i)
+		{
+			destination[i] = static_cast<uint16_t>(indices[i] - base_vertex);
+		}
+	}
+}
+
+std::vector<uint8_t> pack_indices(const uint32_t* indices, size_t vertex_count, const index_range* ranges, size_t range_count,
+	std::vector<packed_index_range>& packed)
+{
+	std::vector<uint8_t> buffer;
+	packed.clear();
+	packed.reserve(range_count);
+
+	if (vertex_count <= max_16bit_vertex_count)
+	{
+		// One 16-bit buffer with the same layout as the original, bound once at offset 0.
+		size_t index_count{ 0 };
+		for (size_t r = 0; r < range_count; ++r)
+		{
+			index_count = std::max<size_t>(index_count, ranges[r].index_start + ranges[r].index_count);
+		}
+		append_narrowed(buffer, indices, index_count, 0);
+		for (size_t r = 0; r < range_count; ++r)
+		{
+			packed.push_back({ 2, 0, ranges[r].index_start, ranges[r].index_count, 0 });
+		}
+		return buffer;
+	}
+
+	// Per range : narrowed and rebased when the span of its indices fits, 32-bit otherwise.
+	for (size_t r = 0; r < range_count; ++r)
+	{
+		const uint32_t* range_indices{ indices + ranges[r].index_start };
+		const uint32_t index_count{ ranges[r].index_count };
+
+		uint32_t minimum{ UINT32_MAX }, maximum{ 0 };
+		for (uint32_t i = 0; i < index_count; ++i)
+		{
+			minimum = std::min(minimum, range_indices[i]);
+			maximum = std::max(maximum, range_indices[i]);
+		}
+
+		// IASetIndexBuffer offsets must be a multiple of the index size.
+		buffer.resize((buffer.size() + 3) & ~static_cast<size_t>(3));
+		packed_index_range p{ 4, static_cast<uint32_t>(buffer.size()), 0, index_count, 0 };
+		if (index_count == 0)
+		{
+			p.index_size = 2;
+		}
+		else if (maximum - minimum < max_16bit_vertex_count)
+		{
+			p.index_size = 2;
+			p.base_vertex = static_cast<int32_t>(minimum);
+			append_narrowed(buffer, range_indices, index_count, minimum);
+		}
+		else
+		{
+			const size_t at{ buffer.size() };
+			buffer.resize(at + index_count * sizeof(uint32_t));
+			memcpy(buffer.data() + at, range_indices, index_count * sizeof(uint32_t));
+		}
+		packed.push_back(p);
+	}
+	return buffer;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct index_range
+{
+	uint32_t index_start{ 0 };
+	uint32_t index_count{ 0 };
+};
+
+struct packed_index_range
+{
+	uint32_t index_size{ 4 };	// 2 or 4 bytes (R16_UINT or R32_UINT)
+	uint32_t byte_offset{ 0 };	// offset to bind the index buffer at, aligned to 4 bytes
+	uint32_t index_start{ 0 };	// start index location relative to byte_offset
+	uint32_t index_count{ 0 };
+	int32_t base_vertex{ 0 };
+};
+
+// Chooses 16-bit indices wherever they fit. If the whole mesh has at most 65536 vertices every range
+// is narrowed in place; otherwise each range whose indices span at most 65536 vertices is rebased to
+// its smallest index (drawn with that base vertex) and narrowed, and the others stay 32-bit.
+// Returns the packed index buffer contents and fills 'packed' with one entry per range.
+std::vector<uint8_t> pack_indices(const uint32_t* indices, size_t vertex_count, const index_range* ranges, size_t range_count,
+	std::vector<packed_index_range>& packed);
@@ -0,0 +1,733 @@
+#include "instance_bvh.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <future>
+#include <thread>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define INSTANCE_BVH_X86
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	constexpr int bin_count{ 16 };
+	// Ranges with at least this many instances are binned by several threads, and nodes with at least this many
+	// are built as a separate task near the root.
+	constexpr uint32_t parallel_bin_threshold{ 65536 };
+	constexpr uint32_t parallel_build_threshold{ 4096 };
+	// Deeper nodes are split in the middle of their range instead, which bounds the depth of the tree
+	// whatever the boxes, and the traversal stacks with it.
+	constexpr size_t max_heuristic_depth{ 32 };
+	constexpr size_t max_stack_size{ 3 * (max_heuristic_depth + 16) + 1 };
+
+	struct bounds
+	{
+		float minimum[3]{ FLT_MAX, FLT_MAX, FLT_MAX };
+		float maximum[3]{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+		void grow(const bounds& other)
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				minimum[k] = (std::min)(minimum[k], other.minimum[k]);
+				maximum[k] = (std::max)(maximum[k], other.maximum[k]);
+			}
+		}
+		void grow(const float point[3])
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				minimum[k] = (std::min)(minimum[k], point[k]);
+				maximum[k] = (std::max)(maximum[k], point[k]);
+			}
+		}
+		float surface_area() const
+		{
+			const float dx{ maximum[0] - minimum[0] }, dy{ maximum[1] - minimum[1] }, dz{ maximum[2] - minimum[2] };
+			return dx < 0.0f ? 0.0f : 2.0f * (dx * dy + dy * dz + dz * dx);
+		}
+		bool operator!=(const bounds& other) const
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				if (minimum[k] != other.minimum[k] || maximum[k] != other.maximum[k])
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+	};
+
+	bounds box_of(const world_aabbs& boxes, uint32_t i)
+	{
+		bounds b;
+		b.minimum[0] = boxes.center_x[i] - boxes.extent_x[i];
+		b.minimum[1] = boxes.center_y[i] - boxes.extent_y[i];
+		b.minimum[2] = boxes.center_z[i] - boxes.extent_z[i];
+		b.maximum[0] = boxes.center_x[i] + boxes.extent_x[i];
+		b.maximum[1] = boxes.center_y[i] + boxes.extent_y[i];
+		b.maximum[2] = boxes.center_z[i] + boxes.extent_z[i];
+		return b;
+	}
+
+	bounds slot_bounds(const instance_bvh::node& n, int k)
+	{
+		bounds b;
+		b.minimum[0] = n.min_x[k];
+		b.minimum[1] = n.min_y[k];
+		b.minimum[2] = n.min_z[k];
+		b.maximum[0] = n.max_x[k];
+		b.maximum[1] = n.max_y[k];
+		b.maximum[2] = n.max_z[k];
+		return b;
+	}
+
+	void set_slot_bounds(instance_bvh::node& n, int k, const bounds& b)
+	{
+		n.min_x[k] = b.minimum[0];
+		n.min_y[k] = b.minimum[1];
+		n.min_z[k] = b.minimum[2];
+		n.max_x[k] = b.maximum[0];
+		n.max_y[k] = b.maximum[1];
+		n.max_z[k] = b.maximum[2];
+	}
+
+	bounds node_bounds(const instance_bvh::node& n)
+	{
+		bounds b;
+		for (int k = 0; k < 4; ++k)
+		{
+			b.grow(slot_bounds(n, k));
+		}
+		return b;
+	}
+
+	// An instance box copied for the build, so that splits read and partition contiguous memory. Each corner loads
+	// as one SSE vector.
+	struct alignas(16) primitive
+	{
+		float minimum[3];
+		uint32_t index;
+		float maximum[3];
+		float unused;
+
+		float center(int axis) const { return (minimum[axis] + maximum[axis]) * 0.5f; }
+	};
+
+	// Primitives [first, first + count) of the build, with the bounds of their boxes and of their centers.
+	struct range
+	{
+		uint32_t first;
+		uint32_t count;
+		bounds box{};
+		bounds centers{};
+	};
+
+	struct bin
+	{
+		bounds box;
+		bounds centers;
+		uint32_t count{ 0 };
+	};
+	struct histogram
+	{
+		bin bins[bin_count];
+	};
+
+	struct builder
+	{
+		primitive* primitives;
+		size_t thread_count;
+		size_t parallel_depth;
+
+		static void add(bounds& box, bounds& centers, const primitive& p)
+		{
+			const float center[3]{ p.center(0), p.center(1), p.center(2) };
+			box.grow(p.minimum);
+			box.grow(p.maximum);
+			centers.grow(center);
+		}
+
+		range make_range(uint32_t first, uint32_t count) const
+		{
+			range r{ first, count };
+			for (uint32_t j = first; j < first + count; ++j)
+			{
+				add(r.box, r.centers, primitives[j]);
+			}
+			return r;
+		}
+
+		void fill_bins(uint32_t first, uint32_t last, int axis, float offset, float scale, int used, histogram& bins) const
+		{
+#ifdef INSTANCE_BVH_X86
+			__m128 box_min[bin_count], box_max[bin_count], center_min[bin_count], center_max[bin_count];
+			for (int b = 0; b < used; ++b)
+			{
+				box_min[b] = center_min[b] = _mm_set1_ps(FLT_MAX);
+				box_max[b] = center_max[b] = _mm_set1_ps(-FLT_MAX);
+			}
+			const __m128 half{ _mm_set1_ps(0.5f) };
+			// The index shares a vector with the minimum : cleared so that it is not processed as a denormal.
+			const __m128 xyz{ _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0)) };
+			for (uint32_t j = first; j < last; ++j)
+			{
+				const primitive& p{ primitives[j] };
+				const int b{ (std::min)(used - 1, static_cast<int>((p.center(axis) - offset) * scale)) };
+				const __m128 minimum{ _mm_and_ps(_mm_load_ps(p.minimum), xyz) }, maximum{ _mm_load_ps(p.maximum) };
+				const __m128 center{ _mm_mul_ps(_mm_add_ps(minimum, maximum), half) };
+				box_min[b] = _mm_min_ps(box_min[b], minimum);
+				box_max[b] = _mm_max_ps(box_max[b], maximum);
+				center_min[b] = _mm_min_ps(center_min[b], center);
+				center_max[b] = _mm_max_ps(center_max[b], center);
+				++bins.bins[b].count;
+			}
+			for (int b = 0; b < used; ++b)
+			{
+				float lanes[4][4];
+				_mm_storeu_ps(lanes[0], box_min[b]);
+				_mm_storeu_ps(lanes[1], box_max[b]);
+				_mm_storeu_ps(lanes[2], center_min[b]);
+				_mm_storeu_ps(lanes[3], center_max[b]);
+				for (int k = 0; k < 3; ++k)
+				{
+					bins.bins[b].box.minimum[k] = lanes[0][k];
+					bins.bins[b].box.maximum[k] = lanes[1][k];
+					bins.bins[b].centers.minimum[k] = lanes[2][k];
+					bins.bins[b].centers.maximum[k] = lanes[3][k];
+				}
+			}
+#else
+			for (uint32_t j = first; j < last; ++j)
+			{
+				const primitive& p{ primitives[j] };
+				bin& b{ bins.bins[(std::min)(used - 1, static_cast<int>((p.center(axis) - offset) * scale))] };
+				add(b.box, b.centers, p);
+				++b.count;
+			}
+#endif
+		}
+
+		// Splits 'r' in two with the lowest surface area heuristic cost among the bin boundaries of the longest axis
+		// of its centers, or in the middle if all the centers are equal or 'heuristic' is false.
+		void split(const range& r, bool heuristic, range& left, range& right) const
+		{
+			int axis{ 0 };
+			float extent[3];
+			for (int k = 0; k < 3; ++k)
+			{
+				extent[k] = r.centers.maximum[k] - r.centers.minimum[k];
+				axis = extent[k] > extent[axis] ? k : axis;
+			}
+			if (!heuristic || !(extent[axis] > 0.0f))
+			{
+				left = make_range(r.first, r.count / 2);
+				right = make_range(r.first + r.count / 2, r.count - r.count / 2);
+				return;
+			}
+
+			// Small ranges use as many bins as instances, so that the cost of a split follows the size of the range.
+			const int used{ static_cast<int>((std::min)(r.count, static_cast<uint32_t>(bin_count))) };
+			const float offset{ r.centers.minimum[axis] };
+			const float scale{ used / extent[axis] };
+			histogram bins;
+			const size_t workers{ r.count < parallel_bin_threshold ? 1 : (std::min)(thread_count, static_cast<size_t>(r.count / (parallel_bin_threshold / 2))) };
+			if (workers <= 1)
+			{
+				fill_bins(r.first, r.first + r.count, axis, offset, scale, used, bins);
+			}
+			else
+			{
+				std::vector<std::future<void>> tasks;
+				std::vector<histogram> partial(workers);
+				for (size_t w = 0; w < workers; ++w)
+				{
+					const uint32_t first{ r.first + static_cast<uint32_t>(r.count * w / workers) };
+					const uint32_t last{ r.first + static_cast<uint32_t>(r.count * (w + 1) / workers) };
+					tasks.push_back(std::async(std::launch::async, [this, first, last, axis, offset, scale, used, &bins = partial[w]]()
+					{
+						fill_bins(first, last, axis, offset, scale, used, bins);
+					}));
+				}
+				for (size_t w = 0; w < workers; ++w)
+				{
+					tasks[w].get();
+					for (int b = 0; b < used; ++b)
+					{
+						bins.bins[b].box.grow(partial[w].bins[b].box);
+						bins.bins[b].centers.grow(partial[w].bins[b].centers);
+						bins.bins[b].count += partial[w].bins[b].count;
+					}
+				}
+			}
+
+			// Cost of putting bins [0, s) left and [s, used) right : area * count on each side.
+			float right_cost[bin_count];
+			bounds accumulated;
+			uint32_t accumulated_count{ 0 };
+			for (int s = used - 1; s > 0; --s)
+			{
+				accumulated.grow(bins.bins[s].box);
+				accumulated_count += bins.bins[s].count;
+				right_cost[s] = accumulated.surface_area() * accumulated_count;
+			}
+			int best_split{ 0 };
+			float best_cost{ FLT_MAX };
+			accumulated = {};
+			accumulated_count = 0;
+			for (int s = 1; s < used; ++s)
+			{
+				accumulated.grow(bins.bins[s - 1].box);
+				accumulated_count += bins.bins[s - 1].count;
+				// The first and last bins hold the extreme centers, so some boundary leaves both sides non-empty.
+				const float cost{ accumulated.surface_area() * accumulated_count + right_cost[s] };
+				if (accumulated_count > 0 && accumulated_count < r.count && cost < best_cost)
+				{
+					best_cost = cost;
+					best_split = s;
+				}
+			}
+
+			primitive* middle{ std::partition(primitives + r.first, primitives + r.first + r.count, [&](const primitive& p)
+			{
+				return (std::min)(used - 1, static_cast<int>((p.center(axis) - offset) * scale)) < best_split;
+			}) };
+			left = { r.first, static_cast<uint32_t>(middle - primitives) - r.first };
+			right = { left.first + left.count, r.count - left.count };
+			for (int b = 0; b < used; ++b)
+			{
+				range& side{ b < best_split ? left : right };
+				side.box.grow(bins.bins[b].box);
+				side.centers.grow(bins.bins[b].centers);
+			}
+		}
+
+		// Appends the node of 'r' and its subtree to 'nodes' depth first and returns its index.
+		uint32_t build_node(std::vector<instance_bvh::node>& nodes, const range& r, size_t depth) const
+		{
+			// Split the largest child until there are 4 or all fit in leaves.
+			range children[4]{ r };
+			int child_count{ 1 };
+			while (child_count < 4)
+			{
+				int largest{ 0 };
+				for (int k = 1; k < child_count; ++k)
+				{
+					largest = children[k].count > children[largest].count ? k : largest;
+				}
+				if (children[largest].count <= instance_bvh::max_leaf_size)
+				{
+					break;
+				}
+				range left, right;
+				split(children[largest], depth < max_heuristic_depth, left, right);
+				children[largest] = left;
+				children[child_count++] = right;
+			}
+			// Leaf slots find their instances from the counts of the slots before them.
+			std::sort(children, children + child_count, [](const range& a, const range& b) { return a.first < b.first; });
+
+			const uint32_t self{ static_cast<uint32_t>(nodes.size()) };
+			nodes.emplace_back();
+			for (int k = 0; k < 4; ++k)
+			{
+				set_slot_bounds(nodes[self], k, k < child_count ? children[k].box : bounds{});
+				nodes[self].count[k] = k < child_count ? children[k].count : 0;
+				nodes[self].child[k] = instance_bvh::leaf;
+			}
+
+			std::future<std::vector<instance_bvh::node>> tasks[4];
+			for (int k = 0; k < child_count; ++k)
+			{
+				if (children[k].count <= instance_bvh::max_leaf_size)
+				{
+					continue;
+				}
+				if (depth < parallel_depth && children[k].count >= parallel_build_threshold)
+				{
+					tasks[k] = std::async(std::launch::async, [this, child = children[k], depth]()
+					{
+						std::vector<instance_bvh::node> subtree;
+						build_node(subtree, child, depth + 1);
+						return subtree;
+					});
+				}
+				else
+				{
+					const uint32_t child{ build_node(nodes, children[k], depth + 1) };
+					nodes[self].child[k] = child;
+				}
+			}
+			for (int k = 0; k < child_count; ++k)
+			{
+				if (!tasks[k].valid())
+				{
+					continue;
+				}
+				std::vector<instance_bvh::node> subtree{ tasks[k].get() };
+				const uint32_t offset{ static_cast<uint32_t>(nodes.size()) };
+				for (instance_bvh::node& n : subtree)
+				{
+					for (uint32_t& child : n.child)
+					{
+						child = child == instance_bvh::leaf ? child : child + offset;
+					}
+				}
+				nodes.insert(nodes.end(), subtree.begin(), subtree.end());
+				nodes[self].child[k] = offset;
+			}
+			return self;
+		}
+	};
+
+	// Plane equations with the absolute values of the normals, as in frustum_culling.
+	struct query_planes
+	{
+		float n[6][3];
+		float abs_n[6][3];
+		float d[6];
+	};
+
+	// Bit k of the result is set if slot k of 'n' is not empty and not outside a plane. Bit k of 'inside' is set if the
+	// slot is also entirely inside every plane.
+	int test_node(const query_planes& planes, const instance_bvh::node& n, int& inside)
+	{
+#ifdef INSTANCE_BVH_X86
+		const __m128 half{ _mm_set1_ps(0.5f) };
+		const __m128 minimum[3]{ _mm_loadu_ps(n.min_x), _mm_loadu_ps(n.min_y), _mm_loadu_ps(n.min_z) };
+		const __m128 maximum[3]{ _mm_loadu_ps(n.max_x), _mm_loadu_ps(n.max_y), _mm_loadu_ps(n.max_z) };
+		__m128 center[3], extent[3];
+		for (int k = 0; k < 3; ++k)
+		{
+			center[k] = _mm_mul_ps(_mm_add_ps(minimum[k], maximum[k]), half);
+			extent[k] = _mm_mul_ps(_mm_sub_ps(maximum[k], minimum[k]), half);
+		}
+		const __m128 zero{ _mm_setzero_ps() };
+		__m128 intersecting{ _mm_castsi128_ps(_mm_cmpgt_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(n.count)), _mm_setzero_si128())) };
+		__m128 contained{ intersecting };
+		for (int p = 0; p < 6; ++p)
+		{
+			const __m128 distance{ _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes.n[p][0]), center[0]), _mm_mul_ps(_mm_set1_ps(planes.n[p][1]), center[1])),
+				_mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes.n[p][2]), center[2]), _mm_set1_ps(planes.d[p]))) };
+			const __m128 radius{ _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes.abs_n[p][0]), extent[0]), _mm_mul_ps(_mm_set1_ps(planes.abs_n[p][1]), extent[1])),
+				_mm_mul_ps(_mm_set1_ps(planes.abs_n[p][2]), extent[2])) };
+			intersecting = _mm_and_ps(intersecting, _mm_cmpge_ps(_mm_add_ps(distance, radius), zero));
+			contained = _mm_and_ps(contained, _mm_cmpge_ps(_mm_sub_ps(distance, radius), zero));
+		}
+		inside = _mm_movemask_ps(contained);
+		return _mm_movemask_ps(intersecting);
+#else
+		int intersecting{ 0 };
+		inside = 0;
+		for (int k = 0; k < 4; ++k)
+		{
+			if (n.count[k] == 0)
+			{
+				continue;
+			}
+			const float center[3]{ (n.min_x[k] + n.max_x[k]) * 0.5f, (n.min_y[k] + n.max_y[k]) * 0.5f, (n.min_z[k] + n.max_z[k]) * 0.5f };
+			const float extent[3]{ (n.max_x[k] - n.min_x[k]) * 0.5f, (n.max_y[k] - n.min_y[k]) * 0.5f, (n.max_z[k] - n.min_z[k]) * 0.5f };
+			bool slot_intersecting{ true }, slot_contained{ true };
+			for (int p = 0; p < 6; ++p)
+			{
+				const float distance{ planes.n[p][0] * center[0] + planes.n[p][1] * center[1] + planes.n[p][2] * center[2] + planes.d[p] };
+				const float radius{ planes.abs_n[p][0] * extent[0] + planes.abs_n[p][1] * extent[1] + planes.abs_n[p][2] * extent[2] };
+				slot_intersecting = slot_intersecting && distance + radius >= 0.0f;
+				slot_contained = slot_contained && distance - radius >= 0.0f;
+			}
+			intersecting |= slot_intersecting ? 1 << k : 0;
+			inside |= slot_intersecting && slot_contained ? 1 << k : 0;
+		}
+		return intersecting;
+#endif
+	}
+
+	// A ray with the reciprocal of its direction, zero components replaced by tiny ones to avoid 0 * infinity.
+	struct query_ray
+	{
+		float origin[3];
+		float inverse_direction[3];
+		float max_distance;
+	};
+
+	// Bit k of the result is set if slot k of 'n' is not empty and its box is hit by the ray.
+	int test_node(const query_ray& ray, const instance_bvh::node& n)
+	{
+#ifdef INSTANCE_BVH_X86
+		const float* minimum[3]{ n.min_x, n.min_y, n.min_z };
+		const float* maximum[3]{ n.max_x, n.max_y, n.max_z };
+		__m128 near_t{ _mm_setzero_ps() }, far_t{ _mm_set1_ps(ray.max_distance) };
+		for (int k = 0; k < 3; ++k)
+		{
+			const __m128 origin{ _mm_set1_ps(ray.origin[k]) }, inverse_direction{ _mm_set1_ps(ray.inverse_direction[k]) };
+			const __m128 t0{ _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(minimum[k]), origin), inverse_direction) };
+			const __m128 t1{ _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(maximum[k]), origin), inverse_direction) };
+			near_t = _mm_max_ps(near_t, _mm_min_ps(t0, t1));
+			far_t = _mm_min_ps(far_t, _mm_max_ps(t0, t1));
+		}
+		const __m128 occupied{ _mm_castsi128_ps(_mm_cmpgt_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(n.count)), _mm_setzero_si128())) };
+		return _mm_movemask_ps(_mm_and_ps(occupied, _mm_cmple_ps(near_t, far_t)));
+#else
+		int hit{ 0 };
+		for (int k = 0; k < 4; ++k)
+		{
+			const float minimum[3]{ n.min_x[k], n.min_y[k], n.min_z[k] };
+			const float maximum[3]{ n.max_x[k], n.max_y[k], n.max_z[k] };
+			float near_t{ 0.0f }, far_t{ ray.max_distance };
+			for (int c = 0; c < 3; ++c)
+			{
+				const float t0{ (minimum[c] - ray.origin[c]) * ray.inverse_direction[c] };
+				const float t1{ (maximum[c] - ray.origin[c]) * ray.inverse_direction[c] };
+				near_t = (std::max)(near_t, (std::min)(t0, t1));
+				far_t = (std::min)(far_t, (std::max)(t0, t1));
+			}
+			hit |= n.count[k] > 0 && near_t <= far_t ? 1 << k : 0;
+		}
+		return hit;
+#endif
+	}
+}
+
+void instance_bvh::build(const world_aabbs& boxes, size_t thread_count)
+{
+	tree.clear();
+	const uint32_t instance_count{ static_cast<uint32_t>(boxes.size()) };
+	order.resize(instance_count);
+	if (instance_count > 0)
+	{
+		std::vector<primitive> primitives(instance_count);
+		for (uint32_t i = 0; i < instance_count; ++i)
+		{
+			const bounds b{ box_of(boxes, i) };
+			primitives[i] = { { b.minimum[0], b.minimum[1], b.minimum[2] }, i, { b.maximum[0], b.maximum[1], b.maximum[2] }, 0.0f };
+		}
+		thread_count = thread_count > 0 ? thread_count : (std::max)(1u, std::thread::hardware_concurrency());
+		// Tasks are started for the subtrees of the first levels, until there are a few per thread.
+		size_t parallel_depth{ 0 };
+		for (size_t tasks = 1; thread_count > 1 && tasks < thread_count * 4; tasks *= 4)
+		{
+			++parallel_depth;
+		}
+		const builder b{ primitives.data(), thread_count, parallel_depth };
+		// A 4-ary tree with leaves of 1 or more instances has fewer nodes than instances.
+		tree.reserve(instance_count);
+		b.build_node(tree, b.make_range(0, instance_count), 0);
+		for (uint32_t j = 0; j < instance_count; ++j)
+		{
+			order[j] = primitives[j].index;
+		}
+	}
+
+	node_first.assign(tree.size(), 0);
+	parent_slots.assign(tree.size(), leaf);
+	leaf_slots.assign(instance_count, leaf);
+	queued.assign(tree.size(), 0);
+	for (uint32_t i = 0; i < tree.size(); ++i)
+	{
+		uint32_t first{ node_first[i] };
+		for (uint32_t k = 0; k < 4; ++k)
+		{
+			if (tree[i].child[k] != leaf)
+			{
+				node_first[tree[i].child[k]] = first;
+				parent_slots[tree[i].child[k]] = i * 4 + k;
+			}
+			else
+			{
+				for (uint32_t j = first; j < first + tree[i].count[k]; ++j)
+				{
+					leaf_slots[order[j]] = i * 4 + k;
+				}
+			}
+			first += tree[i].count[k];
+		}
+	}
+}
+
+void instance_bvh::refit(const world_aabbs& boxes)
+{
+	// Children come after their parents.
+	for (size_t i = tree.size(); i-- > 0;)
+	{
+		node& n{ tree[i] };
+		uint32_t first{ node_first[i] };
+		for (int k = 0; k < 4; ++k)
+		{
+			if (n.count[k] == 0)
+			{
+				continue;
+			}
+			bounds b;
+			if (n.child[k] != leaf)
+			{
+				b = node_bounds(tree[n.child[k]]);
+			}
+			else
+			{
+				for (uint32_t j = first; j < first + n.count[k]; ++j)
+				{
+					b.grow(box_of(boxes, order[j]));
+				}
+			}
+			set_slot_bounds(n, k, b);
+			first += n.count[k];
+		}
+	}
+}
+
+void instance_bvh::refit(const world_aabbs& boxes, const uint32_t* changed, size_t changed_count)
+{
+	// Nodes are updated from the deepest index down, so that every node is done after all of its descendants, and
+	// an ancestor is only queued if the box of its child changed.
+	pending.clear();
+	auto queue = [this](uint32_t node_index)
+	{
+		if (!queued[node_index])
+		{
+			queued[node_index] = 1;
+			pending.push_back(node_index);
+			std::push_heap(pending.begin(), pending.end());
+		}
+	};
+	for (size_t c = 0; c < changed_count; ++c)
+	{
+		const uint32_t slot{ leaf_slots[changed[c]] };
+		node& n{ tree[slot / 4] };
+		const uint32_t k{ slot % 4 };
+		uint32_t first{ node_first[slot / 4] };
+		for (uint32_t s = 0; s < k; ++s)
+		{
+			first += n.count[s];
+		}
+		bounds b;
+		for (uint32_t j = first; j < first + n.count[k]; ++j)
+		{
+			b.grow(box_of(boxes, order[j]));
+		}
+		set_slot_bounds(n, k, b);
+		queue(slot / 4);
+	}
+	while (!pending.empty())
+	{
+		std::pop_heap(pending.begin(), pending.end());
+		const uint32_t i{ pending.back() };
+		pending.pop_back();
+		queued[i] = 0;
+		const uint32_t parent_slot{ parent_slots[i] };
+		if (parent_slot == leaf)
+		{
+			continue;
+		}
+		const bounds b{ node_bounds(tree[i]) };
+		node& parent{ tree[parent_slot / 4] };
+		if (b != slot_bounds(parent, parent_slot % 4))
+		{
+			set_slot_bounds(parent, parent_slot % 4, b);
+			queue(parent_slot / 4);
+		}
+	}
+}
+
+size_t instance_bvh::query(const frustum& f, std::vector<uint32_t>& result) const
+{
+	if (tree.empty())
+	{
+		return 0;
+	}
+	query_planes planes;
+	for (int p = 0; p < 6; ++p)
+	{
+		for (int k = 0; k < 3; ++k)
+		{
+			planes.n[p][k] = f.planes[p][k];
+			planes.abs_n[p][k] = fabsf(f.planes[p][k]);
+		}
+		planes.d[p] = f.planes[p][3];
+	}
+	const size_t start{ result.size() };
+	// Node and its first instance. Children are pushed last first, so that instances come out in tree order.
+	struct entry { uint32_t node, first; };
+	entry stack[max_stack_size];
+	size_t depth{ 0 };
+	stack[depth++] = { 0, 0 };
+	while (depth > 0)
+	{
+		const entry e{ stack[--depth] };
+		const node& n{ tree[e.node] };
+		int inside;
+		const int intersecting{ test_node(planes, n, inside) };
+		uint32_t first[4];
+		first[0] = e.first;
+		for (int k = 1; k < 4; ++k)
+		{
+			first[k] = first[k - 1] + n.count[k - 1];
+		}
+		for (int k = 3; k >= 0; --k)
+		{
+			if ((intersecting & ~inside & (1 << k)) && n.child[k] != leaf)
+			{
+				stack[depth++] = { n.child[k], first[k] };
+			}
+		}
+		// Leaves, and subtrees entirely inside whose instances are contiguous.
+		for (int k = 0; k < 4; ++k)
+		{
+			if ((intersecting & (1 << k)) && (n.child[k] == leaf || (inside & (1 << k))))
+			{
+				result.insert(result.end(), order.begin() + first[k], order.begin() + first[k] + n.count[k]);
+			}
+		}
+	}
+	return result.size() - start;
+}
+
+size_t instance_bvh::query(const float origin[3], const float direction[3], float max_distance, std::vector<uint32_t>& result) const
+{
+	if (tree.empty())
+	{
+		return 0;
+	}
+	query_ray ray;
+	for (int k = 0; k < 3; ++k)
+	{
+		ray.origin[k] = origin[k];
+		ray.inverse_direction[k] = 1.0f / (fabsf(direction[k]) > 1e-30f ? direction[k] : copysignf(1e-30f, direction[k]));
+	}
+	ray.max_distance = max_distance;
+	const size_t start{ result.size() };
+	struct entry { uint32_t node, first; };
+	entry stack[max_stack_size];
+	size_t depth{ 0 };
+	stack[depth++] = { 0, 0 };
+	while (depth > 0)
+	{
+		const entry e{ stack[--depth] };
+		const node& n{ tree[e.node] };
+		const int hit{ test_node(ray, n) };
+		uint32_t first[4];
+		first[0] = e.first;
+		for (int k = 1; k < 4; ++k)
+		{
+			first[k] = first[k - 1] + n.count[k - 1];
+		}
+		for (int k = 3; k >= 0; --k)
+		{
+			if ((hit & (1 << k)) && n.child[k] != leaf)
+			{
+				stack[depth++] = { n.child[k], first[k] };
+			}
+		}
+		for (int k = 0; k < 4; ++k)
+		{
+			if ((hit & (1 << k)) && n.child[k] == leaf)
+			{
+				result.push_back(order[first[k]]);
+			}
+		}
+	}
+	return result.size() - start;
+}
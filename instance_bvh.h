@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "frustum.h"
+#include "frustum_culling.h"
+
+// Bounding volume hierarchy over the world boxes of many instances, for culling, picking and ray queries that would
+// otherwise test every box.
+//
+// build splits the boxes with the binned surface area heuristic (up to 16 bins on the longest axis of the centers,
+// splitting the largest child of a node until it has 4) into nodes of 4 children whose boxes are stored as structure of arrays, so that a node is
+// tested with one SSE instruction per plane or slab. Leaves hold one instance, so the box of a leaf slot is the box
+// of its instance and queries need no other data. Subtrees of large nodes are built on worker threads and the
+// nodes are laid out depth first, so that a subtree is contiguous in the node array and its instances are
+// contiguous in instances().
+//
+// refit updates the boxes after instances moved without changing the tree : everything, or only the leaves of the
+// instances listed and their ancestors. The tree gets looser as instances move away from where it was built, so
+// rebuild once the queries slow down.
+class instance_bvh
+{
+public:
+	static constexpr uint32_t max_leaf_size{ 1 };
+	// child[] value of leaves and empty slots.
+	static constexpr uint32_t leaf{ 0xFFFFFFFF };
+
+	// 128 bytes, two cache lines. Slot k holds the 'count[k]' instances of node child[k], or the instance of a leaf.
+	// They follow those of slots 0 to k - 1 in instances(), from the first instance of the node. Empty slots have a
+	// count of 0 and an inverted box.
+	struct alignas(64) node
+	{
+		float min_x[4], min_y[4], min_z[4];
+		float max_x[4], max_y[4], max_z[4];
+		uint32_t child[4];
+		uint32_t count[4];
+	};
+
+	// Builds the hierarchy of 'boxes', replacing the previous one. 'thread_count' 0 uses
+	// std::thread::hardware_concurrency.
+	void build(const world_aabbs& boxes, size_t thread_count = 0);
+	// Updates every node from 'boxes', which must have the size of the build.
+	void refit(const world_aabbs& boxes);
+	// Updates the leaves holding the instances in 'changed' and their ancestors only.
+	void refit(const world_aabbs& boxes, const uint32_t* changed, size_t changed_count);
+
+	// Append the instances whose boxes are at least partly inside the frustum, or hit by the ray within
+	// 'max_distance' (in units of 'direction'), to 'result' in tree order and return how many were appended.
+	// The frustum test is conservative like cull_aabbs.
+	size_t query(const frustum& f, std::vector<uint32_t>& result) const;
+	size_t query(const float origin[3], const float direction[3], float max_distance, std::vector<uint32_t>& result) const;
+
+	// Nodes depth first, the root first. Empty before the first build and for an empty set of boxes.
+	const std::vector<node>& nodes() const { return tree; }
+	// Instance indices in leaf order.
+	const std::vector<uint32_t>& instances() const { return order; }
+
+private:
+	std::vector<node> tree;
+	std::vector<uint32_t> order;
+	// For refit : the first instance of each node in 'order', the parent node * 4 + slot of each node, and the
+	// leaf node * 4 + slot of each instance.
+	std::vector<uint32_t> node_first;
+	std::vector<uint32_t> parent_slots;
+	std::vector<uint32_t> leaf_slots;
+	// Nodes waiting for their parent slot to be updated by the incremental refit.
+	std::vector<uint32_t> pending;
+	std::vector<uint8_t> queued;
+};
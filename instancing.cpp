@@ -0,0 +1,30 @@
+#include "instancing.h"
+
+void batch_instances(const uint32_t* instances, const uint32_t* keys, size_t count, uint32_t key_count,
+	std::vector<uint32_t>& order, std::vector<instance_batch>& batches)
+{
+	std::vector<uint32_t> offsets(static_cast<size_t>(key_count) + 1, 0);
+	for (size_t i = 0; i < count; ++i)
+	{
+		++offsets[keys[i] + 1];
+	}
+	for (uint32_t key = 0; key < key_count; ++key)
+	{
+		offsets[key + 1] += offsets[key];
+	}
+
+	batches.clear();
+	for (uint32_t key = 0; key < key_count; ++key)
+	{
+		if (offsets[key + 1] > offsets[key])
+		{
+			batches.push_back({ key, offsets[key], offsets[key + 1] - offsets[key] });
+		}
+	}
+
+	order.resize(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		order[offsets[keys[i]]++] = instances[i];
+	}
+}
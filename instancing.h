@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// CPU side of instanced drawing, kept free of the device so it can be checked on its own.
+
+// A run of instances drawn with one DrawIndexedInstanced per draw entry of the mesh.
+struct instance_batch
+{
+	uint32_t key{ 0 };	// value shared by the instances of the batch, e.g. their level of detail
+	uint32_t first{ 0 };	// first entry of the batch in the instance order
+	uint32_t count{ 0 };
+};
+
+// Groups 'count' instances by key with a stable counting sort. keys[i] (< key_count) is the key of instances[i].
+// 'order' receives the instance indices grouped by increasing key, and 'batches' one entry per non-empty key.
+void batch_instances(const uint32_t* instances, const uint32_t* keys, size_t count, uint32_t key_count,
+	std::vector<uint32_t>& order, std::vector<instance_batch>& batches);
+
+// Writes the world matrices of 'count' instances to 'destination', the per-instance vertex buffer layout (one row-major
+// float4x4 per instance). Instance i is worlds[instances[i]], or worlds[i] when 'instances' is null.
+// 'matrix' is DirectX::XMFLOAT4X4 in the renderer; the header does not include DirectXMath so that it builds anywhere.
+template <class matrix>
+void pack_instance_worlds(const matrix* worlds, const uint32_t* instances, size_t count, matrix* destination)
+{
+	if (!instances)
+	{
+		memcpy(destination, worlds, sizeof(matrix) * count);
+		return;
+	}
+	for (size_t i = 0; i < count; ++i)
+	{
+		destination[i] = worlds[instances[i]];
+	}
+}
@@ -0,0 +1,142 @@
+#include "mapped_file.h"
+
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+mapped_file::mapped_file(const std::filesystem::path& filename)
+{
+	open(filename);
+}
+
+mapped_file::~mapped_file()
+{
+	close();
+}
+
+mapped_file::mapped_file(mapped_file&& rhs) noexcept
+{
+	*this = std::move(rhs);
+}
+
+mapped_file& mapped_file::operator=(mapped_file&& rhs) noexcept
+{
+	if (this != &rhs)
+	{
+		close();
+		data_ = std::exchange(rhs.data_, nullptr);
+		size_ = std::exchange(rhs.size_, 0);
+		opened = std::exchange(rhs.opened, false);
+#ifdef _WIN32
+		file_handle = std::exchange(rhs.file_handle, nullptr);
+		mapping_handle = std::exchange(rhs.mapping_handle, nullptr);
+#endif
+	}
+	return *this;
+}
+
+bool mapped_file::open(const std::filesystem::path& filename)
+{
+	close();
+
+#ifdef _WIN32
+	HANDLE file{ CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL) };
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+	LARGE_INTEGER file_size{};
+	if (!GetFileSizeEx(file, &file_size))
+	{
+		CloseHandle(file);
+		return false;
+	}
+	file_handle = file;
+	opened = true;
+	size_ = static_cast<size_t>(file_size.QuadPart);
+	if (size_ == 0)
+	{
+		// CreateFileMapping rejects empty files; an empty view is still a valid result.
+		return true;
+	}
+	mapping_handle = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mapping_handle)
+	{
+		close();
+		return false;
+	}
+	data_ = MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0);
+	if (!data_)
+	{
+		close();
+		return false;
+	}
+#else
+	int fd{ ::open(filename.c_str(), O_RDONLY) };
+	if (fd < 0)
+	{
+		return false;
+	}
+	struct stat st {};
+	if (fstat(fd, &st) != 0)
+	{
+		::close(fd);
+		return false;
+	}
+	opened = true;
+	size_ = static_cast<size_t>(st.st_size);
+	if (size_ > 0)
+	{
+		void* p{ mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0) };
+		if (p == MAP_FAILED)
+		{
+			::close(fd);
+			close();
+			return false;
+		}
+		madvise(p, size_, MADV_SEQUENTIAL);
+		data_ = p;
+	}
+	// The mapping keeps its own reference to the file.
+	::close(fd);
+#endif
+	return true;
+}
+
+void mapped_file::close()
+{
+#ifdef _WIN32
+	if (data_)
+	{
+		UnmapViewOfFile(data_);
+	}
+	if (mapping_handle)
+	{
+		CloseHandle(mapping_handle);
+	}
+	if (file_handle)
+	{
+		CloseHandle(file_handle);
+	}
+	mapping_handle = nullptr;
+	file_handle = nullptr;
+#else
+	if (data_)
+	{
+		munmap(const_cast<void*>(data_), size_);
+	}
+#endif
+	data_ = nullptr;
+	size_ = 0;
+	opened = false;
+}
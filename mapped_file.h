@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+// Read-only view of a whole file mapped into the address space.
+// Works on Windows (CreateFileMapping) and POSIX (mmap) so that asset loaders can be
+// built and profiled on the Linux tool chain as well.
+class mapped_file
+{
+public:
+	mapped_file() = default;
+	explicit mapped_file(const std::filesystem::path& filename);
+	~mapped_file();
+	mapped_file(const mapped_file&) = delete;
+	mapped_file& operator=(const mapped_file&) = delete;
+	mapped_file(mapped_file&& rhs) noexcept;
+	mapped_file& operator=(mapped_file&& rhs) noexcept;
+
+	bool open(const std::filesystem::path& filename);
+	void close();
+
+	bool is_open() const { return opened; }
+	const char* data() const { return static_cast<const char*>(data_); }
+	size_t size() const { return size_; }
+
+private:
+	const void* data_{ nullptr };
+	size_t size_{ 0 };
+	bool opened{ false };
+#ifdef _WIN32
+	void* file_handle{ nullptr };
+	void* mapping_handle{ nullptr };
+#endif
+};
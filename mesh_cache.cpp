@@ -0,0 +1,259 @@
+#include "mesh_cache.h"
+
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	constexpr char cache_magic[4]{ 'S', 'M', 'C', '1' };
+	constexpr uint32_t no_string{ UINT32_MAX };
+
+	bool file_stamp(const std::filesystem::path& path, uint64_t& size, int64_t& time)
+	{
+		std::error_code ec;
+		size = static_cast<uint64_t>(std::filesystem::file_size(path, ec));
+		if (ec)
+		{
+			return false;
+		}
+		time = static_cast<int64_t>(std::filesystem::last_write_time(path, ec).time_since_epoch().count());
+		return !ec;
+	}
+
+	uint64_t align16(uint64_t offset)
+	{
+		return (offset + 15) & ~uint64_t{ 15 };
+	}
+
+	class string_pool
+	{
+	public:
+		uint32_t add(const std::string& s)
+		{
+			uint32_t offset{ static_cast<uint32_t>(data.size()) };
+			data.insert(data.end(), s.begin(), s.end());
+			data.push_back('\0');
+			return offset;
+		}
+		std::vector<char> data;
+	};
+
+	// Returns the zero-terminated string at 'offset', or an empty string if it does not lie in the pool.
+	std::string read_string(const char* pool, uint32_t pool_size, uint32_t offset)
+	{
+		if (offset >= pool_size)
+		{
+			return {};
+		}
+		const void* terminator{ memchr(pool + offset, '\0', pool_size - offset) };
+		return terminator ? std::string(pool + offset, static_cast<const char*>(terminator)) : std::string();
+	}
+}
+
+std::filesystem::path mesh_cache::cache_filename(const std::filesystem::path& obj_filename)
+{
+	std::filesystem::path path(obj_filename);
+	path += ".smc";
+	return path;
+}
+
+bool mesh_cache::open(const std::filesystem::path& cache_filename, const std::filesystem::path& obj_filename, uint32_t options, obj_model& model)
+{
+	close();
+
+	uint64_t obj_size{ 0 };
+	int64_t obj_time{ 0 };
+	if (!file_stamp(obj_filename, obj_size, obj_time) || !file.open(cache_filename))
+	{
+		return false;
+	}
+
+	const char* data{ file.data() };
+	const size_t size{ file.size() };
+	const mesh_cache_header* h{ reinterpret_cast<const mesh_cache_header*>(data) };
+	if (size < sizeof(mesh_cache_header) || memcmp(h->magic, cache_magic, sizeof(cache_magic)) != 0 ||
+		h->version != format_version || h->options != options || h->obj_size != obj_size || h->obj_time != obj_time)
+	{
+		file.close();
+		return false;
+	}
+
+	auto fits = [size](uint64_t offset, uint64_t count, size_t element_size)
+	{
+		return offset <= size && count <= (size - offset) / element_size;
+	};
+	if (!fits(h->vertex_offset, h->vertex_count, sizeof(obj_vertex)) || !fits(h->index_offset, h->index_count, sizeof(uint32_t)) ||
+		!fits(h->subset_offset, h->subset_count, sizeof(mesh_cache_subset)) || !fits(h->material_offset, h->material_count, sizeof(mesh_cache_material)) ||
+		!fits(h->string_offset, h->string_size, 1))
+	{
+		file.close();
+		return false;
+	}
+
+	// A damaged cache must not make the draws read outside the index or vertex buffers.
+	const mesh_cache_subset* subsets{ reinterpret_cast<const mesh_cache_subset*>(data + h->subset_offset) };
+	for (uint32_t i = 0; i < h->subset_count; ++i)
+	{
+		if (static_cast<uint64_t>(subsets[i].index_start) + subsets[i].index_count > h->index_count)
+		{
+			file.close();
+			return false;
+		}
+	}
+	const uint32_t* indices{ reinterpret_cast<const uint32_t*>(data + h->index_offset) };
+	for (uint32_t i = 0; i < h->index_count; ++i)
+	{
+		if (indices[i] >= h->vertex_count)
+		{
+			file.close();
+			return false;
+		}
+	}
+
+	const char* pool{ data + h->string_offset };
+	if (h->mtl_filename != no_string)
+	{
+		// The materials come from the MTL file, so it has to be unchanged as well.
+		std::string mtl_filename{ read_string(pool, h->string_size, h->mtl_filename) };
+		uint64_t mtl_size{ 0 };
+		int64_t mtl_time{ 0 };
+		if (!file_stamp(resolve_obj_reference(obj_filename, mtl_filename), mtl_size, mtl_time) || mtl_size != h->mtl_size || mtl_time != h->mtl_time)
+		{
+			file.close();
+			return false;
+		}
+		model.mtl_filenames.push_back(mtl_filename);
+	}
+
+	for (uint32_t i = 0; i < h->subset_count; ++i)
+	{
+		model.subsets.push_back({ read_string(pool, h->string_size, subsets[i].usemtl), subsets[i].index_start, subsets[i].index_count });
+	}
+	const mesh_cache_material* materials{ reinterpret_cast<const mesh_cache_material*>(data + h->material_offset) };
+	for (uint32_t i = 0; i < h->material_count; ++i)
+	{
+		obj_material material;
+		material.name = read_string(pool, h->string_size, materials[i].name);
+		memcpy(material.Ka, materials[i].Ka, sizeof(material.Ka));
+		memcpy(material.Kd, materials[i].Kd, sizeof(material.Kd));
+		memcpy(material.Ks, materials[i].Ks, sizeof(material.Ks));
+		material.texture_filenames[0] = read_string(pool, h->string_size, materials[i].texture_filenames[0]);
+		material.texture_filenames[1] = read_string(pool, h->string_size, materials[i].texture_filenames[1]);
+		model.materials.push_back(material);
+	}
+
+	header = h;
+	return true;
+}
+
+const obj_vertex* mesh_cache::vertices() const
+{
+	return reinterpret_cast<const obj_vertex*>(file.data() + header->vertex_offset);
+}
+
+const uint32_t* mesh_cache::indices() const
+{
+	return reinterpret_cast<const uint32_t*>(file.data() + header->index_offset);
+}
+
+bool write_mesh_cache(const std::filesystem::path& cache_filename, const std::filesystem::path& obj_filename, uint32_t options, const obj_model& model)
+{
+	mesh_cache_header header{};
+	memcpy(header.magic, cache_magic, sizeof(cache_magic));
+	header.version = mesh_cache::format_version;
+	header.options = options;
+	if (!file_stamp(obj_filename, header.obj_size, header.obj_time))
+	{
+		return false;
+	}
+
+	string_pool strings;
+	header.mtl_filename = no_string;
+	if (!model.mtl_filenames.empty())
+	{
+		if (!file_stamp(resolve_obj_reference(obj_filename, model.mtl_filenames[0]), header.mtl_size, header.mtl_time))
+		{
+			// Without a stamp a later MTL edit could not be detected.
+			return false;
+		}
+		header.mtl_filename = strings.add(model.mtl_filenames[0]);
+	}
+
+	std::vector<mesh_cache_subset> subsets;
+	for (const obj_subset& subset : model.subsets)
+	{
+		subsets.push_back({ strings.add(subset.usemtl), subset.index_start, subset.index_count });
+	}
+	std::vector<mesh_cache_material> materials;
+	for (const obj_material& material : model.materials)
+	{
+		mesh_cache_material m{};
+		m.name = strings.add(material.name);
+		m.texture_filenames[0] = strings.add(material.texture_filenames[0]);
+		m.texture_filenames[1] = strings.add(material.texture_filenames[1]);
+		memcpy(m.Ka, material.Ka, sizeof(m.Ka));
+		memcpy(m.Kd, material.Kd, sizeof(m.Kd));
+		memcpy(m.Ks, material.Ks, sizeof(m.Ks));
+		materials.push_back(m);
+	}
+
+	header.vertex_count = static_cast<uint32_t>(model.vertices.size());
+	header.index_count = static_cast<uint32_t>(model.indices.size());
+	header.subset_count = static_cast<uint32_t>(subsets.size());
+	header.material_count = static_cast<uint32_t>(materials.size());
+	header.string_size = static_cast<uint32_t>(strings.data.size());
+	header.vertex_offset = align16(sizeof(mesh_cache_header));
+	header.index_offset = align16(header.vertex_offset + sizeof(obj_vertex) * model.vertices.size());
+	header.subset_offset = align16(header.index_offset + sizeof(uint32_t) * model.indices.size());
+	header.material_offset = align16(header.subset_offset + sizeof(mesh_cache_subset) * subsets.size());
+	header.string_offset = align16(header.material_offset + sizeof(mesh_cache_material) * materials.size());
+
+	// Loaders of the same OBJ file on other threads or in other processes write their own temporary file; the
+	// last rename wins, and every cache renamed into place is complete.
+	static std::atomic<uint32_t> temporary_counter{ 0 };
+	std::filesystem::path temporary_filename(cache_filename);
+	temporary_filename += "." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + "." +
+		std::to_string(temporary_counter++) + ".tmp";
+	{
+		std::ofstream fout(temporary_filename, std::ios::binary | std::ios::trunc);
+		if (!fout)
+		{
+			return false;
+		}
+		auto write_blob = [&fout](uint64_t offset, const void* data, size_t size)
+		{
+			static const char padding[16]{};
+			uint64_t position{ static_cast<uint64_t>(fout.tellp()) };
+			fout.write(padding, static_cast<std::streamsize>(offset - position));
+			fout.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+		};
+		fout.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		write_blob(header.vertex_offset, model.vertices.data(), sizeof(obj_vertex) * model.vertices.size());
+		write_blob(header.index_offset, model.indices.data(), sizeof(uint32_t) * model.indices.size());
+		write_blob(header.subset_offset, subsets.data(), sizeof(mesh_cache_subset) * subsets.size());
+		write_blob(header.material_offset, materials.data(), sizeof(mesh_cache_material) * materials.size());
+		write_blob(header.string_offset, strings.data.data(), strings.data.size());
+		if (!fout)
+		{
+			fout.close();
+			std::error_code ec;
+			std::filesystem::remove(temporary_filename, ec);
+			return false;
+		}
+	}
+
+	std::error_code ec;
+	std::filesystem::rename(temporary_filename, cache_filename, ec);
+	if (ec)
+	{
+		std::filesystem::remove(temporary_filename, ec);
+		return false;
+	}
+	return true;
+}
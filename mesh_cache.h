@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <utility>
+
+#include "mapped_file.h"
+#include "obj_loader.h"
+
+// Binary cache of a loaded OBJ model, written next to the source as "<name>.obj.smc".
+//
+// File layout (little-endian, every blob 16-byte aligned):
+//   mesh_cache_header
+//   vertex blob    : obj_vertex[vertex_count]
+//   index blob     : uint32_t[index_count]
+//   subset table   : mesh_cache_subset[subset_count]
+//   material table : mesh_cache_material[material_count]
+//   string pool    : usemtl names, material names, MTL and texture file names
+//
+// A cache is only used if the size and modification time of the OBJ file and of the MTL file it
+// referenced still match, and if it was built with the same loader options and format version.
+// The vertex and index blobs are used in place from the mapped file.
+struct mesh_cache_header
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t options;
+	uint32_t reserved;
+	uint64_t obj_size;
+	int64_t obj_time;
+	uint64_t mtl_size;
+	int64_t mtl_time;
+	uint32_t mtl_filename;	// string pool offset, UINT32_MAX if the OBJ has no mtllib
+	uint32_t vertex_count;
+	uint32_t index_count;
+	uint32_t subset_count;
+	uint32_t material_count;
+	uint32_t string_size;
+	uint64_t vertex_offset;
+	uint64_t index_offset;
+	uint64_t subset_offset;
+	uint64_t material_offset;
+	uint64_t string_offset;
+};
+
+struct mesh_cache_subset
+{
+	uint32_t usemtl;	// string pool offset
+	uint32_t index_start;
+	uint32_t index_count;
+};
+
+struct mesh_cache_material
+{
+	uint32_t name;	// string pool offset
+	uint32_t texture_filenames[2];	// string pool offsets
+	float Ka[4];
+	float Kd[4];
+	float Ks[4];
+};
+
+class mesh_cache
+{
+public:
+	// Bump whenever the loader or the post-load processing changes the produced data.
+	static constexpr uint32_t format_version{ 2 };
+
+	static std::filesystem::path cache_filename(const std::filesystem::path& obj_filename);
+
+	mesh_cache() = default;
+	mesh_cache(mesh_cache&& rhs) noexcept : file(std::move(rhs.file)), header(rhs.header) { rhs.header = nullptr; }
+	mesh_cache& operator=(mesh_cache&& rhs) noexcept
+	{
+		file = std::move(rhs.file);
+		header = rhs.header;
+		rhs.header = nullptr;
+		return *this;
+	}
+
+	// Maps 'cache_filename' and validates it against 'obj_filename', and checks that every subset lies
+	// in the index blob and every index is below the vertex count. On success the subsets, materials
+	// and MTL file name are decoded into 'model'; its vertices and indices stay empty, use vertices()
+	// and indices() instead.
+	bool open(const std::filesystem::path& cache_filename, const std::filesystem::path& obj_filename, uint32_t options, obj_model& model);
+	void close() { file.close(); header = nullptr; }
+	bool is_open() const { return header != nullptr; }
+
+	const obj_vertex* vertices() const;
+	size_t vertex_count() const { return header->vertex_count; }
+	const uint32_t* indices() const;
+	size_t index_count() const { return header->index_count; }
+
+private:
+	mapped_file file;
+	const mesh_cache_header* header{ nullptr };
+};
+
+// Writes 'model' as a cache for 'obj_filename'. The file is written under a temporary name unique to the call
+// and renamed, so a reader never sees a partially written cache. Returns false if the cache could not be written.
+bool write_mesh_cache(const std::filesystem::path& cache_filename, const std::filesystem::path& obj_filename, uint32_t options, const obj_model& model);
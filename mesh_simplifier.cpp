@@ -0,0 +1,303 @@
+#include "mesh_simplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+	constexpr size_t max_passes{ 64 };
+
+	struct float3
+	{
+		float x, y, z;
+	};
+	float3 operator-(const float3& a, const float3& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+	float dot(const float3& a, const float3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+	float3 cross(const float3& a, const float3& b) { return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x }; }
+
+	float3 load_position(const float* positions, size_t stride, uint32_t index)
+	{
+		const float* p{ reinterpret_cast<const float*>(reinterpret_cast<const char*>(positions) + stride * index) };
+		return { p[0], p[1], p[2] };
+	}
+
+	// Symmetric 4x4 quadric : the area weighted sum of squared distances to a set of planes. Dividing by the
+	// total weight gives a mean squared distance, which is what the error is reported in.
+	struct quadric
+	{
+		double a00{ 0 }, a01{ 0 }, a02{ 0 }, a11{ 0 }, a12{ 0 }, a22{ 0 };
+		double b0{ 0 }, b1{ 0 }, b2{ 0 };
+		double c{ 0 };
+		double w{ 0 };
+
+		void add_plane(double nx, double ny, double nz, double d, double weight)
+		{
+			a00 += weight * nx * nx; a01 += weight * nx * ny; a02 += weight * nx * nz;
+			a11 += weight * ny * ny; a12 += weight * ny * nz; a22 += weight * nz * nz;
+			b0 += weight * nx * d; b1 += weight * ny * d; b2 += weight * nz * d;
+			c += weight * d * d;
+			w += weight;
+		}
+		void add(const quadric& q)
+		{
+			a00 += q.a00; a01 += q.a01; a02 += q.a02;
+			a11 += q.a11; a12 += q.a12; a22 += q.a22;
+			b0 += q.b0; b1 += q.b1; b2 += q.b2;
+			c += q.c;
+			w += q.w;
+		}
+		double error(const float3& p) const
+		{
+			const double x{ p.x }, y{ p.y }, z{ p.z };
+			double e{ a00 * x * x + a11 * y * y + a22 * z * z + 2 * (a01 * x * y + a02 * x * z + a12 * y * z) + 2 * (b0 * x + b1 * y + b2 * z) + c };
+			return w > 0 ? std::max(e, 0.0) / w : 0.0;
+		}
+	};
+
+	struct position_key
+	{
+		uint32_t bits[3];
+		bool operator==(const position_key& other) const { return memcmp(bits, other.bits, sizeof(bits)) == 0; }
+	};
+	struct position_hash
+	{
+		size_t operator()(const position_key& key) const
+		{
+			uint64_t h{ 0xcbf29ce484222325ull };
+			for (uint32_t b : key.bits)
+			{
+				h = (h ^ b) * 0x100000001b3ull;
+			}
+			return static_cast<size_t>(h);
+		}
+	};
+
+	uint64_t edge_key(uint32_t a, uint32_t b)
+	{
+		return (static_cast<uint64_t>(a) << 32) | b;
+	}
+
+	struct collapse
+	{
+		uint32_t from, to;
+		float cost;
+	};
+}
+
+size_t simplify_mesh(uint32_t* destination, const uint32_t* indices, size_t index_count, const float* positions, size_t stride, size_t vertex_count,
+	size_t target_index_count, float target_error, float* result_error)
+{
+	index_count -= index_count % 3;
+	std::vector<uint32_t> current(indices, indices + index_count);
+	float max_error{ 0 };
+
+	// Position groups : the first vertex of the range with the same position stands for all of them.
+	std::vector<uint32_t> position_id(vertex_count, UINT32_MAX);
+	std::vector<uint32_t> group_size(vertex_count, 0);
+	{
+		std::unordered_map<position_key, uint32_t, position_hash> groups;
+		for (uint32_t v : current)
+		{
+			if (position_id[v] != UINT32_MAX)
+			{
+				continue;
+			}
+			position_key key;
+			memcpy(key.bits, reinterpret_cast<const char*>(positions) + stride * v, sizeof(key.bits));
+			auto inserted{ groups.emplace(key, v) };
+			position_id[v] = inserted.first->second;
+			++group_size[inserted.first->second];
+		}
+	}
+
+	// Locked vertices : seams (shared positions), open borders and non-manifold edges, in position space.
+	std::vector<bool> locked(vertex_count, false);
+	{
+		std::unordered_map<uint64_t, uint32_t> edges;
+		edges.reserve(index_count);
+		for (size_t i = 0; i < index_count; i += 3)
+		{
+			for (size_t k = 0; k < 3; ++k)
+			{
+				++edges[edge_key(position_id[current[i + k]], position_id[current[i + (k + 1) % 3]])];
+			}
+		}
+		for (uint32_t v : current)
+		{
+			if (group_size[position_id[v]] > 1)
+			{
+				locked[v] = true;
+			}
+		}
+		for (size_t i = 0; i < index_count; i += 3)
+		{
+			for (size_t k = 0; k < 3; ++k)
+			{
+				const uint32_t a{ current[i + k] }, b{ current[i + (k + 1) % 3] };
+				auto opposite{ edges.find(edge_key(position_id[b], position_id[a])) };
+				if (opposite == edges.end() || opposite->second != 1 || edges[edge_key(position_id[a], position_id[b])] != 1)
+				{
+					locked[a] = locked[b] = true;
+				}
+			}
+		}
+	}
+
+	std::vector<quadric> quadrics(vertex_count);
+	for (size_t i = 0; i < index_count; i += 3)
+	{
+		float3 p0{ load_position(positions, stride, current[i + 0]) };
+		float3 p1{ load_position(positions, stride, current[i + 1]) };
+		float3 p2{ load_position(positions, stride, current[i + 2]) };
+		float3 n{ cross(p1 - p0, p2 - p0) };
+		double length{ sqrt(static_cast<double>(dot(n, n))) };
+		if (length == 0)
+		{
+			continue;
+		}
+		const double nx{ n.x / length }, ny{ n.y / length }, nz{ n.z / length };
+		const double d{ -(nx * p0.x + ny * p0.y + nz * p0.z) };
+		for (size_t k = 0; k < 3; ++k)
+		{
+			quadrics[current[i + k]].add_plane(nx, ny, nz, d, length * 0.5);
+		}
+	}
+
+	const double error_limit{ static_cast<double>(target_error) * target_error };
+	std::vector<uint32_t> remap(vertex_count);
+	std::vector<bool> touched(vertex_count);
+	std::vector<uint32_t> triangle_offsets(vertex_count + 1);
+	std::vector<uint32_t> vertex_triangles;
+	std::vector<collapse> collapses;
+	for (size_t pass = 0; pass < max_passes && current.size() > target_index_count; ++pass)
+	{
+		// Vertex to triangle adjacency of the current triangles.
+		std::fill(triangle_offsets.begin(), triangle_offsets.end(), 0);
+		for (uint32_t v : current)
+		{
+			++triangle_offsets[v + 1];
+		}
+		for (size_t v = 0; v < vertex_count; ++v)
+		{
+			triangle_offsets[v + 1] += triangle_offsets[v];
+		}
+		vertex_triangles.resize(current.size());
+		{
+			std::vector<uint32_t> fill(triangle_offsets.begin(), triangle_offsets.end() - 1);
+			for (size_t i = 0; i < current.size(); ++i)
+			{
+				vertex_triangles[fill[current[i]]++] = static_cast<uint32_t>(i / 3);
+			}
+		}
+
+		collapses.clear();
+		for (size_t i = 0; i < current.size(); i += 3)
+		{
+			for (size_t k = 0; k < 3; ++k)
+			{
+				const uint32_t a{ current[i + k] }, b{ current[i + (k + 1) % 3] };
+				if (!locked[a])
+				{
+					collapses.push_back({ a, b, static_cast<float>(quadrics[a].error(load_position(positions, stride, b))) });
+				}
+				if (!locked[b])
+				{
+					collapses.push_back({ b, a, static_cast<float>(quadrics[b].error(load_position(positions, stride, a))) });
+				}
+			}
+		}
+		if (collapses.empty())
+		{
+			break;
+		}
+		std::sort(collapses.begin(), collapses.end(), [](const collapse& a, const collapse& b) { return a.cost < b.cost; });
+
+		for (size_t v = 0; v < vertex_count; ++v)
+		{
+			remap[v] = static_cast<uint32_t>(v);
+		}
+		std::fill(touched.begin(), touched.end(), false);
+
+		// Independent collapses in cost order : a vertex whose one-ring changed waits for the next pass,
+		// so the flip test below always sees up to date triangles.
+		const size_t triangles_to_remove{ (current.size() - target_index_count) / 3 };
+		size_t removed{ 0 };
+		size_t performed{ 0 };
+		for (const collapse& c : collapses)
+		{
+			if (c.cost > error_limit || removed >= triangles_to_remove)
+			{
+				break;
+			}
+			if (touched[c.from] || touched[c.to])
+			{
+				continue;
+			}
+
+			const float3 target{ load_position(positions, stride, c.to) };
+			bool flips{ false };
+			size_t collapsed_triangles{ 0 };
+			for (uint32_t t = triangle_offsets[c.from]; t < triangle_offsets[c.from + 1] && !flips; ++t)
+			{
+				const uint32_t* triangle{ &current[vertex_triangles[t] * 3] };
+				if (triangle[0] == c.to || triangle[1] == c.to || triangle[2] == c.to)
+				{
+					++collapsed_triangles;
+					continue;
+				}
+				float3 p[3], q[3];
+				for (size_t k = 0; k < 3; ++k)
+				{
+					p[k] = load_position(positions, stride, triangle[k]);
+					q[k] = triangle[k] == c.from ? target : p[k];
+				}
+				float3 before{ cross(p[1] - p[0], p[2] - p[0]) };
+				float3 after{ cross(q[1] - q[0], q[2] - q[0]) };
+				// Reject flipped triangles and triangles that turn by more than about 75 degrees.
+				flips = dot(before, after) <= 0.25f * sqrtf(dot(before, before) * dot(after, after));
+			}
+			if (flips || collapsed_triangles == 0)
+			{
+				continue;
+			}
+
+			remap[c.from] = c.to;
+			quadrics[c.to].add(quadrics[c.from]);
+			for (uint32_t t = triangle_offsets[c.from]; t < triangle_offsets[c.from + 1]; ++t)
+			{
+				const uint32_t* triangle{ &current[vertex_triangles[t] * 3] };
+				touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = true;
+			}
+			removed += collapsed_triangles;
+			max_error = std::max(max_error, c.cost);
+			++performed;
+		}
+		if (performed == 0)
+		{
+			break;
+		}
+
+		size_t write{ 0 };
+		for (size_t i = 0; i < current.size(); i += 3)
+		{
+			const uint32_t a{ remap[current[i + 0]] }, b{ remap[current[i + 1]] }, c{ remap[current[i + 2]] };
+			if (a != b && b != c && c != a)
+			{
+				current[write++] = a;
+				current[write++] = b;
+				current[write++] = c;
+			}
+		}
+		current.resize(write);
+	}
+
+	std::copy(current.begin(), current.end(), destination);
+	if (result_error)
+	{
+		*result_error = sqrtf(max_error);
+	}
+	return current.size();
+}
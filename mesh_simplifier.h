@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Quadric error metric simplification of triangle lists (Garland and Heckbert, "Surface Simplification
+// Using Quadric Error Metrics"), by collapsing edges onto existing vertices. No vertex is created or
+// moved, so the simplified index list draws from the same vertex buffer as the original.
+//
+// Vertices on an open border of the index range (including material boundaries between subsets),
+// vertices on non-manifold edges, and vertices that share their position with another vertex (UV and
+// normal seams) are locked, so borders and seams keep their shape and texture mapping.
+//
+// Writes at most 'index_count' indices to 'destination' and returns the number written. Stops at
+// 'target_index_count' or when the next collapse would exceed 'target_error' (object space distance).
+// 'result_error' receives the largest error of the collapses performed.
+size_t simplify_mesh(uint32_t* destination, const uint32_t* indices, size_t index_count, const float* positions, size_t stride, size_t vertex_count,
+	size_t target_index_count, float target_error, float* result_error = nullptr);
@@ -0,0 +1,227 @@
+#include "meshlet.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+	// Normal cones wider than this (minimum dot product to the axis) can't reject anything useful.
+	constexpr float minimum_cone_spread{ 0.1f };
+
+	struct float3
+	{
+		float x, y, z;
+	};
+	float3 operator-(const float3& a, const float3& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+	float3 operator+(const float3& a, const float3& b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+	float3 operator*(const float3& a, float s) { return { a.x * s, a.y * s, a.z * s }; }
+	float dot(const float3& a, const float3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+	float3 cross(const float3& a, const float3& b) { return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x }; }
+	float3 normalize(const float3& a)
+	{
+		float length{ sqrtf(dot(a, a)) };
+		return length > 0 ? a * (1.0f / length) : float3{ 0, 0, 0 };
+	}
+
+	float3 load_position(const float* positions, size_t stride, uint32_t index)
+	{
+		const float* p{ reinterpret_cast<const float*>(reinterpret_cast<const char*>(positions) + stride * index) };
+		return { p[0], p[1], p[2] };
+	}
+	void store(float* destination, const float3& v)
+	{
+		destination[0] = v.x;
+		destination[1] = v.y;
+		destination[2] = v.z;
+	}
+
+	void compute_bounds(meshlet& m, const meshlet_data& data, const float* positions, size_t stride)
+	{
+		float3 aabb_min{ std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+		float3 aabb_max{ -aabb_min.x, -aabb_min.y, -aabb_min.z };
+		for (uint32_t v = 0; v < m.vertex_count; ++v)
+		{
+			float3 p{ load_position(positions, stride, data.vertices[m.vertex_offset + v]) };
+			aabb_min = { std::min(aabb_min.x, p.x), std::min(aabb_min.y, p.y), std::min(aabb_min.z, p.z) };
+			aabb_max = { std::max(aabb_max.x, p.x), std::max(aabb_max.y, p.y), std::max(aabb_max.z, p.z) };
+		}
+		store(m.aabb_min, aabb_min);
+		store(m.aabb_max, aabb_max);
+
+		const float3 center{ (aabb_min + aabb_max) * 0.5f };
+		float radius_squared{ 0 };
+		for (uint32_t v = 0; v < m.vertex_count; ++v)
+		{
+			float3 d{ load_position(positions, stride, data.vertices[m.vertex_offset + v]) - center };
+			radius_squared = std::max(radius_squared, dot(d, d));
+		}
+		store(m.center, center);
+		m.radius = sqrtf(radius_squared);
+
+		// Normal cone : the axis is the average front facing normal, the cutoff comes from the normal
+		// furthest away from it, and the apex is moved back along the axis until every triangle plane
+		// passes behind it.
+		std::vector<float3> normals(m.triangle_count);
+		float3 axis{ 0, 0, 0 };
+		for (uint32_t t = 0; t < m.triangle_count; ++t)
+		{
+			const uint8_t* triangle{ &data.triangles[m.triangle_offset + t * 3] };
+			float3 a{ load_position(positions, stride, data.vertices[m.vertex_offset + triangle[0]]) };
+			float3 b{ load_position(positions, stride, data.vertices[m.vertex_offset + triangle[1]]) };
+			float3 c{ load_position(positions, stride, data.vertices[m.vertex_offset + triangle[2]]) };
+			// With clockwise front faces cross(b - a, c - a) points to the front side.
+			normals[t] = normalize(cross(b - a, c - a));
+			axis = axis + normals[t];
+		}
+		axis = normalize(axis);
+
+		float minimum_dot{ 1 };
+		for (const float3& n : normals)
+		{
+			minimum_dot = std::min(minimum_dot, dot(n, axis));
+		}
+		if (minimum_dot <= minimum_cone_spread)
+		{
+			store(m.cone_apex, center);
+			store(m.cone_axis, axis);
+			m.cone_cutoff = 1;
+			return;
+		}
+
+		float maximum_t{ 0 };
+		for (uint32_t t = 0; t < m.triangle_count; ++t)
+		{
+			float3 a{ load_position(positions, stride, data.vertices[m.vertex_offset + data.triangles[m.triangle_offset + t * 3]]) };
+			// dot(axis, normals[t]) >= minimum_dot > 0 unless the triangle is degenerate.
+			float denominator{ dot(axis, normals[t]) };
+			if (denominator > 0)
+			{
+				maximum_t = std::max(maximum_t, dot(center - a, normals[t]) / denominator);
+			}
+		}
+		store(m.cone_apex, center - axis * maximum_t);
+		store(m.cone_axis, axis);
+		m.cone_cutoff = sqrtf(1 - minimum_dot * minimum_dot);
+	}
+}
+
+size_t build_meshlets(const uint32_t* indices, size_t index_count, const float* positions, size_t stride, meshlet_data& data,
+	uint32_t max_vertices, uint32_t max_triangles)
+{
+	// Local indices are stored in a byte.
+	max_vertices = std::min(std::max(max_vertices, 3u), 256u);
+	max_triangles = std::max(max_triangles, 1u);
+
+	const size_t first_meshlet{ data.meshlets.size() };
+	const size_t triangle_count{ index_count / 3 };
+	if (triangle_count == 0)
+	{
+		return 0;
+	}
+
+	// Vertex to local index of the current meshlet, reset through the local vertex list when it is closed.
+	uint32_t vertex_count{ 0 };
+	for (size_t i = 0; i < triangle_count * 3; ++i)
+	{
+		vertex_count = std::max(vertex_count, indices[i] + 1);
+	}
+	std::vector<uint8_t> local(vertex_count, 0);
+	std::vector<bool> used(vertex_count, false);
+
+	meshlet current;
+	current.vertex_offset = static_cast<uint32_t>(data.vertices.size());
+	current.triangle_offset = static_cast<uint32_t>(data.triangles.size());
+	auto close = [&]()
+	{
+		for (uint32_t v = 0; v < current.vertex_count; ++v)
+		{
+			used[data.vertices[current.vertex_offset + v]] = false;
+		}
+		compute_bounds(current, data, positions, stride);
+		data.meshlets.push_back(current);
+
+		current = meshlet{};
+		current.vertex_offset = static_cast<uint32_t>(data.vertices.size());
+		current.triangle_offset = static_cast<uint32_t>(data.triangles.size());
+	};
+
+	for (size_t t = 0; t < triangle_count; ++t)
+	{
+		const uint32_t* triangle{ indices + t * 3 };
+		uint32_t new_vertices{ 0 };
+		for (size_t k = 0; k < 3; ++k)
+		{
+			// A triangle may repeat a vertex; count it once.
+			if (!used[triangle[k]] && (k == 0 || triangle[k] != triangle[0]) && (k < 2 || triangle[k] != triangle[1]))
+			{
+				++new_vertices;
+			}
+		}
+		if (current.vertex_count + new_vertices > max_vertices || current.triangle_count == max_triangles)
+		{
+			close();
+		}
+
+		for (size_t k = 0; k < 3; ++k)
+		{
+			const uint32_t v{ triangle[k] };
+			if (!used[v])
+			{
+				used[v] = true;
+				local[v] = static_cast<uint8_t>(current.vertex_count++);
+				data.vertices.push_back(v);
+			}
+			data.triangles.push_back(local[v]);
+		}
+		++current.triangle_count;
+	}
+	close();
+
+	return data.meshlets.size() - first_meshlet;
+}
+
+meshlet_cull_statistics cull_meshlets(const meshlet_data& data, size_t first, size_t count, const frustum& object_frustum,
+	const float camera_position[3], std::vector<uint32_t>& indices)
+{
+	meshlet_cull_statistics statistics;
+	const float3 camera{ camera_position[0], camera_position[1], camera_position[2] };
+	for (size_t i = first; i < first + count; ++i)
+	{
+		const meshlet& m{ data.meshlets[i] };
+		++statistics.meshlet_count;
+
+		bool outside{ false };
+		for (const float(&plane)[4] : object_frustum.planes)
+		{
+			if (plane[0] * m.center[0] + plane[1] * m.center[1] + plane[2] * m.center[2] + plane[3] < -m.radius)
+			{
+				outside = true;
+				break;
+			}
+		}
+		if (outside)
+		{
+			++statistics.frustum_culled;
+			continue;
+		}
+
+		if (m.cone_cutoff < 1)
+		{
+			float3 view{ normalize(float3{ m.cone_apex[0], m.cone_apex[1], m.cone_apex[2] } - camera) };
+			if (dot(view, float3{ m.cone_axis[0], m.cone_axis[1], m.cone_axis[2] }) >= m.cone_cutoff)
+			{
+				++statistics.backface_culled;
+				continue;
+			}
+		}
+
+		const uint32_t* vertices{ &data.vertices[m.vertex_offset] };
+		const uint8_t* triangles{ &data.triangles[m.triangle_offset] };
+		for (uint32_t k = 0; k < m.triangle_count * 3; ++k)
+		{
+			indices.push_back(vertices[triangles[k]]);
+		}
+	}
+	return statistics;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "frustum.h"
+
+// A small cluster of triangles with its own bounds, used to cull parts of a large mesh.
+struct meshlet
+{
+	uint32_t vertex_offset{ 0 };	// first entry in meshlet_data::vertices
+	uint32_t triangle_offset{ 0 };	// first entry in meshlet_data::triangles (3 local indices per triangle)
+	uint32_t vertex_count{ 0 };
+	uint32_t triangle_count{ 0 };
+
+	float center[3]{};	// bounding sphere
+	float radius{ 0 };
+	float aabb_min[3]{};
+	float aabb_max[3]{};
+
+	// Backface cone : every triangle faces away from a camera at 'camera_position' if
+	// dot(normalize(cone_apex - camera_position), cone_axis) >= cone_cutoff. cone_cutoff is 1 (never
+	// rejects) when the normals spread too much.
+	float cone_apex[3]{};
+	float cone_axis[3]{};
+	float cone_cutoff{ 1 };
+};
+
+struct meshlet_data
+{
+	std::vector<meshlet> meshlets;
+	std::vector<uint32_t> vertices;	// mesh vertex index of every meshlet-local vertex
+	std::vector<uint8_t> triangles;	// meshlet-local vertex indices
+};
+
+// Splits a triangle list into meshlets of at most 'max_vertices' vertices and 'max_triangles' triangles,
+// in index order (run it on a vertex cache optimized range to get compact meshlets), and appends them to 'data'.
+// Returns the number of meshlets appended. 'positions' points to the first position (float3) and 'stride' is
+// the vertex size in bytes.
+size_t build_meshlets(const uint32_t* indices, size_t index_count, const float* positions, size_t stride, meshlet_data& data,
+	uint32_t max_vertices = 64, uint32_t max_triangles = 124);
+
+struct meshlet_cull_statistics
+{
+	size_t meshlet_count{ 0 };
+	size_t frustum_culled{ 0 };
+	size_t backface_culled{ 0 };
+};
+
+// Tests meshlets [first, first + count) against an object-space frustum and camera position and appends the
+// indices (mesh vertex indices) of the surviving meshlets to 'indices'.
+meshlet_cull_statistics cull_meshlets(const meshlet_data& data, size_t first, size_t count, const frustum& object_frustum,
+	const float camera_position[3], std::vector<uint32_t>& indices);
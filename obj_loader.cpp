@@ -0,0 +1,618 @@
+#include "obj_loader.h"
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <functional>
+#include <string_view>
+#include <thread>
+
+namespace
+{
+	// Cursor over the mapped text. Only ' ', '\t' and '\r' are treated as blanks inside a line.
+	struct scanner
+	{
+		const char* p;
+		const char* end;
+
+		bool eof() const { return p >= end; }
+		static bool is_blank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+		void skip_blanks()
+		{
+			while (p < end && is_blank(*p)) ++p;
+		}
+		void skip_line()
+		{
+			const void* lf{ memchr(p, '\n', static_cast<size_t>(end - p)) };
+			p = lf ? static_cast<const char*>(lf) + 1 : end;
+		}
+		bool end_of_line()
+		{
+			skip_blanks();
+			return p >= end || *p == '\n' || *p == '#';
+		}
+		std::string_view token()
+		{
+			skip_blanks();
+			const char* begin{ p };
+			while (p < end && !is_blank(*p) && *p != '\n') ++p;
+			return { begin, static_cast<size_t>(p - begin) };
+		}
+		// Last token of the current line; options such as "-bm 1.0" in front of a map filename are skipped.
+		std::string_view last_token()
+		{
+			std::string_view last;
+			while (!end_of_line())
+			{
+				last = token();
+			}
+			return last;
+		}
+		bool parse_float(float& value)
+		{
+			skip_blanks();
+			if (p < end && *p == '+') ++p;
+			std::from_chars_result result{ std::from_chars(p, end, value) };
+			if (result.ec != std::errc{})
+			{
+				return false;
+			}
+			p = result.ptr;
+			return true;
+		}
+		bool parse_int(int64_t& value)
+		{
+			if (p < end && *p == '+') ++p;
+			std::from_chars_result result{ std::from_chars(p, end, value) };
+			if (result.ec != std::errc{})
+			{
+				return false;
+			}
+			p = result.ptr;
+			return true;
+		}
+	};
+
+	// Open-addressing table that maps a (v, vt, vn) reference triple to the vertex already emitted for it,
+	// so corners shared between faces are welded into one vertex.
+	class corner_table
+	{
+		struct slot
+		{
+			uint32_t v, vt, vn;
+			uint32_t index;
+		};
+		static constexpr uint32_t empty{ UINT32_MAX };
+		std::vector<slot> slots;
+		size_t count{ 0 };
+
+		static size_t hash(uint32_t v, uint32_t vt, uint32_t vn)
+		{
+			uint64_t h{ v * 0x9E3779B97F4A7C15ull };
+			h ^= (vt + 0x632BE59BD9B4E019ull) * 0xC2B2AE3D27D4EB4Full;
+			h ^= (vn + 0x85EBCA77C2B2AE63ull) * 0x165667B19E3779F9ull;
+			return static_cast<size_t>(h ^ (h >> 29));
+		}
+		void grow()
+		{
+			std::vector<slot> old(slots.size() * 2, slot{ 0, 0, 0, empty });
+			old.swap(slots);
+			for (const slot& s : old)
+			{
+				if (s.index != empty)
+				{
+					size_t mask{ slots.size() - 1 };
+					size_t i{ hash(s.v, s.vt, s.vn) & mask };
+					while (slots[i].index != empty) i = (i + 1) & mask;
+					slots[i] = s;
+				}
+			}
+		}
+
+	public:
+		// 'expected_count' only sizes the initial table; it grows as needed.
+		explicit corner_table(size_t expected_count)
+		{
+			size_t size{ 1024 };
+			while (size < expected_count * 2) size *= 2;
+			slots.assign(size, slot{ 0, 0, 0, empty });
+		}
+
+		// Returns the index stored for the triple, or stores and returns 'new_index' if it is not present yet.
+		uint32_t find_or_insert(uint32_t v, uint32_t vt, uint32_t vn, uint32_t new_index)
+		{
+			if ((count + 1) * 2 > slots.size())
+			{
+				grow();
+			}
+			size_t mask{ slots.size() - 1 };
+			size_t i{ hash(v, vt, vn) & mask };
+			while (slots[i].index != empty)
+			{
+				if (slots[i].v == v && slots[i].vt == vt && slots[i].vn == vn)
+				{
+					return slots[i].index;
+				}
+				i = (i + 1) & mask;
+			}
+			slots[i] = { v, vt, vn, new_index };
+			++count;
+			return new_index;
+		}
+	};
+
+	// Reads up to 'max_count' floats of the current line. Components that are not present keep their value.
+	size_t parse_floats(scanner& s, float* values, size_t max_count)
+	{
+		size_t count{ 0 };
+		while (count < max_count && !s.end_of_line() && s.parse_float(values[count]))
+		{
+			++count;
+		}
+		return count;
+	}
+
+	bool parse_color(scanner& s, float* color)
+	{
+		float rgb[3]{};
+		size_t count{ parse_floats(s, rgb, 3) };
+		if (count == 0)
+		{
+			return false;
+		}
+		// The g and b arguments are optional. If only r is specified, then g, and b are assumed to be equal to r.
+		color[0] = rgb[0];
+		color[1] = count > 1 ? rgb[1] : rgb[0];
+		color[2] = count > 2 ? rgb[2] : rgb[0];
+		color[3] = 1.0f;
+		return true;
+	}
+
+	// Records of one line-aligned piece of OBJ text. Face references are kept unresolved so that
+	// chunks can be parsed independently and merged afterwards in file order.
+	struct obj_chunk
+	{
+		struct usemtl_record
+		{
+			std::string name;
+			size_t corner;	// number of corners of this chunk that precede the statement
+		};
+
+		std::vector<float> positions;
+		std::vector<float> texcoords;
+		std::vector<float> normals;
+		std::vector<int32_t> corners;	// v, vt, vn per corner (0-based), 'absent_reference' if not given
+		std::vector<size_t> relative_corners;	// slots of 'corners' holding chunk-local indices from negative references
+		std::vector<usemtl_record> usemtls;
+		std::vector<std::string> mtl_filenames;
+		bool succeeded{ true };
+	};
+	constexpr int32_t absent_reference{ INT32_MIN };
+
+	void append(std::vector<float>& destination, std::vector<float>& source)
+	{
+		if (destination.empty())
+		{
+			destination.swap(source);
+		}
+		else
+		{
+			destination.insert(destination.end(), source.begin(), source.end());
+		}
+	}
+
+	// OBJ references are 1-based; negative values are relative to the end of the list read so far.
+	// Negative ones are stored relative to the start of the chunk and fixed up when merging.
+	bool parse_reference(scanner& s, size_t local_count, obj_chunk& chunk)
+	{
+		int64_t reference{ 0 };
+		if (!s.parse_int(reference) || reference == 0)
+		{
+			return false;
+		}
+		if (reference > 0)
+		{
+			if (reference > INT32_MAX)
+			{
+				return false;
+			}
+			chunk.corners.push_back(static_cast<int32_t>(reference - 1));
+		}
+		else
+		{
+			int64_t local{ static_cast<int64_t>(local_count) + reference };
+			if (local <= INT32_MIN || local > INT32_MAX)
+			{
+				return false;
+			}
+			chunk.relative_corners.push_back(chunk.corners.size());
+			chunk.corners.push_back(static_cast<int32_t>(local));
+		}
+		return true;
+	}
+
+	void parse_chunk(const char* text, size_t size, bool flipping_v_coordinates, obj_chunk& chunk)
+	{
+		scanner s{ text, text + size };
+		while (!s.eof())
+		{
+			std::string_view command{ s.token() };
+			if (command == "v")
+			{
+				// v x y z w
+				//
+				// Specifies a geometric vertex and its x y z coordinates. w is only used by
+				// rational curves and surfaces and is ignored here.
+				float xyz[3]{};
+				if (parse_floats(s, xyz, 3) != 3)
+				{
+					chunk.succeeded = false;
+					return;
+				}
+				chunk.positions.insert(chunk.positions.end(), xyz, xyz + 3);
+			}
+			else if (command == "vt")
+			{
+				// vt u v w
+				//
+				// Specifies a texture vertex and its coordinates. v and w are optional
+				// arguments; the default is 0.
+				float uv[2]{};
+				if (parse_floats(s, uv, 2) == 0)
+				{
+					chunk.succeeded = false;
+					return;
+				}
+				chunk.texcoords.push_back(uv[0]);
+				chunk.texcoords.push_back(flipping_v_coordinates ? 1.0f - uv[1] : uv[1]);
+			}
+			else if (command == "vn")
+			{
+				// vn i j k
+				//
+				// Specifies a normal vector with components i, j, and k.
+				float ijk[3]{};
+				if (parse_floats(s, ijk, 3) != 3)
+				{
+					chunk.succeeded = false;
+					return;
+				}
+				chunk.normals.insert(chunk.normals.end(), ijk, ijk + 3);
+			}
+			else if (command == "f")
+			{
+				// f  v1/vt1/vn1   v2/vt2/vn2   v3/vt3/vn3 . . .
+				//
+				// The reference numbers for the vertices, texture vertices, and
+				// vertex normals must be separated by slashes(/). There is no space
+				// between the number and the slash. vt and vn are optional.
+				//
+				// Only the first three corners are used, faces are expected to be triangulated.
+				for (size_t i = 0; i < 3; i++)
+				{
+					s.skip_blanks();
+					if (!parse_reference(s, chunk.positions.size() / 3, chunk))
+					{
+						chunk.succeeded = false;
+						return;
+					}
+					bool slash{ !s.eof() && *s.p == '/' };
+					if (slash)
+					{
+						++s.p;
+					}
+					if (slash && !s.eof() && *s.p != '/')
+					{
+						if (!parse_reference(s, chunk.texcoords.size() / 2, chunk))
+						{
+							chunk.succeeded = false;
+							return;
+						}
+					}
+					else
+					{
+						chunk.corners.push_back(absent_reference);
+					}
+					if (slash && !s.eof() && *s.p == '/')
+					{
+						++s.p;
+						if (!parse_reference(s, chunk.normals.size() / 3, chunk))
+						{
+							chunk.succeeded = false;
+							return;
+						}
+					}
+					else
+					{
+						chunk.corners.push_back(absent_reference);
+					}
+				}
+			}
+			else if (command == "mtllib")
+			{
+				// mtllib filename1 filename2 . . .
+				// Specifies the material library file for the material definitions
+				// set with the usemtl statement.
+				while (!s.end_of_line())
+				{
+					chunk.mtl_filenames.emplace_back(s.token());
+				}
+			}
+			else if (command == "usemtl")
+			{
+				chunk.usemtls.push_back({ std::string(s.token()), chunk.corners.size() / 3 });
+			}
+			s.skip_line();
+		}
+	}
+}
+
+bool parse_obj(const char* text, size_t size, bool flipping_v_coordinates, obj_model& model, unsigned thread_count)
+{
+	// Split the text at line boundaries. Tiny files are not worth the thread start-up.
+	constexpr size_t minimum_chunk_size{ 1 << 20 };
+	if (thread_count == 0)
+	{
+		thread_count = std::max(1u, std::thread::hardware_concurrency());
+	}
+	size_t chunk_count{ std::max<size_t>(1, std::min<size_t>(thread_count, size / minimum_chunk_size)) };
+
+	std::vector<const char*> boundaries{ text };
+	for (size_t i = 1; i < chunk_count; ++i)
+	{
+		const char* p{ std::max(text + size * i / chunk_count, boundaries.back()) };
+		const void* lf{ memchr(p, '\n', static_cast<size_t>(text + size - p)) };
+		boundaries.push_back(lf ? static_cast<const char*>(lf) + 1 : text + size);
+	}
+	boundaries.push_back(text + size);
+
+	std::vector<obj_chunk> chunks(chunk_count);
+	std::vector<std::thread> workers;
+	for (size_t i = 1; i < chunk_count; ++i)
+	{
+		workers.emplace_back(parse_chunk, boundaries[i], static_cast<size_t>(boundaries[i + 1] - boundaries[i]), flipping_v_coordinates, std::ref(chunks[i]));
+	}
+	parse_chunk(boundaries[0], static_cast<size_t>(boundaries[1] - boundaries[0]), flipping_v_coordinates, chunks[0]);
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+
+	// Merge in file order. Everything below is sequential, so the result does not depend on the chunking.
+	std::vector<float> positions;
+	std::vector<float> texcoords;
+	std::vector<float> normals;
+	for (obj_chunk& chunk : chunks)
+	{
+		if (!chunk.succeeded)
+		{
+			return false;
+		}
+		const int64_t base[3]{ static_cast<int64_t>(positions.size() / 3), static_cast<int64_t>(texcoords.size() / 2), static_cast<int64_t>(normals.size() / 3) };
+		for (size_t slot : chunk.relative_corners)
+		{
+			int64_t resolved{ chunk.corners[slot] + base[slot % 3] };
+			if (resolved < 0 || resolved > INT32_MAX)
+			{
+				return false;
+			}
+			chunk.corners[slot] = static_cast<int32_t>(resolved);
+		}
+		append(positions, chunk.positions);
+		append(texcoords, chunk.texcoords);
+		append(normals, chunk.normals);
+		model.mtl_filenames.insert(model.mtl_filenames.end(), chunk.mtl_filenames.begin(), chunk.mtl_filenames.end());
+	}
+	size_t total_corner_count{ 0 };
+	for (const obj_chunk& chunk : chunks)
+	{
+		total_corner_count += chunk.corners.size() / 3;
+	}
+	const int64_t counts[3]{ static_cast<int64_t>(positions.size() / 3), static_cast<int64_t>(texcoords.size() / 2), static_cast<int64_t>(normals.size() / 3) };
+
+	std::vector<obj_vertex>& vertices{ model.vertices };
+	std::vector<uint32_t>& indices{ model.indices };
+	std::vector<obj_subset>& subsets{ model.subsets };
+	uint32_t current_index{ static_cast<uint32_t>(vertices.size()) };
+	// Closed triangle meshes have roughly one unique vertex per six corners.
+	corner_table corners(total_corner_count / 6);
+	vertices.reserve(vertices.size() + total_corner_count / 6);
+	indices.reserve(indices.size() + total_corner_count);
+
+	for (const obj_chunk& chunk : chunks)
+	{
+		std::vector<obj_chunk::usemtl_record>::const_iterator usemtl{ chunk.usemtls.begin() };
+		size_t corner_count{ chunk.corners.size() / 3 };
+		for (size_t corner = 0; corner <= corner_count; ++corner)
+		{
+			for (; usemtl != chunk.usemtls.end() && usemtl->corner == corner; ++usemtl)
+			{
+				subsets.push_back({ usemtl->name, static_cast<uint32_t>(indices.size()), 0 });
+			}
+			if (corner == corner_count)
+			{
+				break;
+			}
+
+			// Corners referencing the same (v, vt, vn) triple are welded into one vertex.
+			const int32_t* reference{ &chunk.corners[corner * 3] };
+			for (size_t k = 0; k < 3; ++k)
+			{
+				if (reference[k] != absent_reference && (reference[k] < 0 || reference[k] >= counts[k]))
+				{
+					return false;
+				}
+			}
+			if (reference[0] == absent_reference)
+			{
+				return false;
+			}
+			size_t v{ static_cast<size_t>(reference[0]) };
+			size_t vt{ reference[1] == absent_reference ? SIZE_MAX : static_cast<size_t>(reference[1]) };
+			size_t vn{ reference[2] == absent_reference ? SIZE_MAX : static_cast<size_t>(reference[2]) };
+
+			uint32_t index{ corners.find_or_insert(static_cast<uint32_t>(v), static_cast<uint32_t>(vt), static_cast<uint32_t>(vn), current_index) };
+			if (index == current_index)
+			{
+				obj_vertex vertex;
+				memcpy(vertex.position, &positions[v * 3], sizeof(vertex.position));
+				if (vt != SIZE_MAX)
+				{
+					memcpy(vertex.texcoord, &texcoords[vt * 2], sizeof(vertex.texcoord));
+				}
+				if (vn != SIZE_MAX)
+				{
+					memcpy(vertex.normal, &normals[vn * 3], sizeof(vertex.normal));
+				}
+				vertices.push_back(vertex);
+				++current_index;
+			}
+			indices.push_back(index);
+		}
+	}
+
+	if (subsets.empty() && !indices.empty())
+	{
+		// Faces without any usemtl statement still form one drawable subset.
+		subsets.push_back({ "", 0, 0 });
+	}
+	if (!subsets.empty())
+	{
+		std::vector<obj_subset>::reverse_iterator iterator = subsets.rbegin();
+		iterator->index_count = static_cast<uint32_t>(indices.size()) - iterator->index_start;
+		for (iterator = subsets.rbegin() + 1; iterator != subsets.rend(); ++iterator)
+		{
+			iterator->index_count = (iterator - 1)->index_start - iterator->index_start;
+		}
+	}
+	return true;
+}
+
+bool parse_mtl(const char* text, size_t size, std::vector<obj_material>& materials)
+{
+	scanner s{ text, text + size };
+	while (!s.eof())
+	{
+		std::string_view command{ s.token() };
+		if (command == "newmtl")
+		{
+			// newmtl name
+			//
+			// Specifies the start of a material description and assigns a name to the
+			// material. Names may be any length but cannot include blanks.
+			obj_material material;
+			material.name = s.token();
+			materials.push_back(material);
+		}
+		else if (!materials.empty())
+		{
+			obj_material& material{ materials.back() };
+			if (command == "map_Kd")
+			{
+				// map_Kd -options args filename
+				//
+				// Specifies that a color texture file is linked to the diffuse reflectivity
+				// of the material.
+				material.texture_filenames[0] = s.last_token();
+			}
+			else if (command == "map_bump" || command == "bump")
+			{
+				// map_bump -options args filename
+				//
+				// Specifies that a bump texture file is linked to the material.
+				material.texture_filenames[1] = s.last_token();
+			}
+			else if (command == "Ka")
+			{
+				// Ka r g b : ambient reflectivity
+				parse_color(s, material.Ka);
+			}
+			else if (command == "Kd")
+			{
+				// Kd r g b : diffuse reflectivity
+				parse_color(s, material.Kd);
+			}
+			else if (command == "Ks")
+			{
+				// Ks r g b : specular reflectivity
+				parse_color(s, material.Ks);
+			}
+		}
+		s.skip_line();
+	}
+	return true;
+}
+
+bool load_obj(const std::filesystem::path& obj_filename, bool flipping_v_coordinates, obj_model& model, unsigned thread_count)
+{
+	mapped_file obj_file(obj_filename);
+	if (!obj_file.is_open())
+	{
+		return false;
+	}
+	if (!parse_obj(obj_file.data(), obj_file.size(), flipping_v_coordinates, model, thread_count))
+	{
+		return false;
+	}
+	obj_file.close();
+
+	if (!model.mtl_filenames.empty())
+	{
+		mapped_file mtl_file(resolve_obj_reference(obj_filename, model.mtl_filenames[0]));
+		if (mtl_file.is_open())
+		{
+			parse_mtl(mtl_file.data(), mtl_file.size(), model.materials);
+		}
+	}
+	return true;
+}
+
+std::filesystem::path resolve_obj_reference(const std::filesystem::path& obj_filename, const std::string& filename)
+{
+	std::filesystem::path path(obj_filename);
+	path.replace_filename(std::filesystem::path(filename).filename());
+	return path;
+}
+
+void group_subsets_by_material(obj_model& model)
+{
+	auto material_order = [&model](const obj_subset& subset)
+	{
+		for (size_t i = 0; i < model.materials.size(); ++i)
+		{
+			if (model.materials[i].name == subset.usemtl)
+			{
+				return i;
+			}
+		}
+		return model.materials.size();
+	};
+	std::vector<std::pair<size_t, const obj_subset*>> order;
+	order.reserve(model.subsets.size());
+	for (const obj_subset& subset : model.subsets)
+	{
+		order.emplace_back(material_order(subset), &subset);
+	}
+	std::stable_sort(order.begin(), order.end(), [](const auto& a, const auto& b)
+	{
+		return a.first != b.first ? a.first < b.first : a.second->usemtl < b.second->usemtl;
+	});
+
+	std::vector<uint32_t> indices;
+	indices.reserve(model.indices.size());
+	std::vector<obj_subset> subsets;
+	for (const auto& entry : order)
+	{
+		const obj_subset& subset{ *entry.second };
+		if (subsets.empty() || subsets.back().usemtl != subset.usemtl)
+		{
+			subsets.push_back({ subset.usemtl, static_cast<uint32_t>(indices.size()), 0 });
+		}
+		indices.insert(indices.end(), model.indices.begin() + subset.index_start, model.indices.begin() + subset.index_start + subset.index_count);
+		subsets.back().index_count += subset.index_count;
+	}
+	model.indices.swap(indices);
+	model.subsets.swap(subsets);
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Platform-neutral Wavefront OBJ/MTL reader.
+// The file is memory-mapped and scanned byte by byte; numbers are converted with
+// std::from_chars, so no locale or stream state is involved. Face corners that reference the
+// same (v, vt, vn) triple are welded, so 'indices' addresses unique vertices.
+struct obj_vertex
+{
+	float position[3]{};
+	float normal[3]{};
+	float texcoord[2]{};
+};
+
+struct obj_subset
+{
+	std::string usemtl;
+	uint32_t index_start{ 0 };	// start position of index buffer
+	uint32_t index_count{ 0 };	// number of vertices (indices)
+};
+
+struct obj_material
+{
+	std::string name;
+	float Ka[4]{ 0.2f, 0.2f, 0.2f, 1.0f };
+	float Kd[4]{ 0.8f, 0.8f, 0.8f, 1.0f };
+	float Ks[4]{ 1.0f, 1.0f, 1.0f, 1.0f };
+	std::string texture_filenames[2];	// [0] : map_Kd, [1] : map_bump (as written in the MTL file)
+};
+
+struct obj_model
+{
+	std::vector<obj_vertex> vertices;
+	std::vector<uint32_t> indices;
+	std::vector<obj_subset> subsets;
+	std::vector<obj_material> materials;
+	std::vector<std::string> mtl_filenames;
+};
+
+// Loads 'obj_filename' and the first material library it references (looked up next to the OBJ file).
+// Returns false if the OBJ file cannot be opened or is malformed. A missing MTL file is not an error.
+//
+// Large files are split at line boundaries and parsed by up to 'thread_count' threads
+// (0 : std::thread::hardware_concurrency()). The chunks are merged in file order, so the result is
+// identical for any thread count.
+bool load_obj(const std::filesystem::path& obj_filename, bool flipping_v_coordinates, obj_model& model, unsigned thread_count = 0);
+
+// Files referenced from OBJ/MTL statements (mtllib, map_Kd, ...) are looked up next to the OBJ file.
+std::filesystem::path resolve_obj_reference(const std::filesystem::path& obj_filename, const std::string& filename);
+
+// Reorders the subsets in the order of 'materials' (subsets with an unknown usemtl last, by name), moves
+// their indices along, and merges subsets that end up next to each other with the same usemtl, so each
+// material is drawn with as few draw calls as possible.
+void group_subsets_by_material(obj_model& model);
+
+bool parse_obj(const char* text, size_t size, bool flipping_v_coordinates, obj_model& model, unsigned thread_count = 0);
+bool parse_mtl(const char* text, size_t size, std::vector<obj_material>& materials);
@@ -0,0 +1,369 @@
+#include "occlusion_culling.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define OCCLUSION_CULLING_X86
+#include <immintrin.h>
+#endif
+
+namespace
+{
+	// 'a' * 'b' for row-major matrices used as 'float4(p, 1) * m'.
+	void multiply(const float a[16], const float b[16], float result[16])
+	{
+		for (int r = 0; r < 4; ++r)
+		{
+			for (int c = 0; c < 4; ++c)
+			{
+				result[r * 4 + c] = a[r * 4 + 0] * b[0 * 4 + c] + a[r * 4 + 1] * b[1 * 4 + c] + a[r * 4 + 2] * b[2 * 4 + c] + a[r * 4 + 3] * b[3 * 4 + c];
+			}
+		}
+	}
+
+	// Between the near and the far plane of Direct3D clip space, written so that NaN fails.
+	inline bool in_front_of_near_plane(const float* clip)
+	{
+		return clip[2] >= 0.0f && clip[3] > 0.0f;
+	}
+}
+
+occlusion_buffer::occlusion_buffer(uint32_t width, uint32_t height) :
+	buffer_width{ width }, buffer_height{ height },
+	tile_columns{ (width + tile_size - 1) / tile_size }, tile_rows{ (height + tile_size - 1) / tile_size },
+	depth(static_cast<size_t>(tile_columns) * tile_rows * tile_size * tile_size),
+	tile_depth(static_cast<size_t>(tile_columns) * tile_rows)
+{
+	const float identity[16]{ 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+	clear(identity);
+}
+
+void occlusion_buffer::clear(const float view_projection[16])
+{
+	std::copy(view_projection, view_projection + 16, matrix);
+	// The padding right of and below the buffer is 0, in front of everything, so that it does not raise the farthest
+	// depth of the tiles on the edges. Occluders may write it but never above 0, and boxes never test it.
+	const uint32_t buffer_pitch{ pitch() };
+	std::fill(depth.begin(), depth.end(), 0.0f);
+	for (uint32_t y = 0; y < buffer_height; ++y)
+	{
+		std::fill_n(depth.begin() + static_cast<size_t>(y) * buffer_pitch, buffer_width, 1.0f);
+	}
+	tiles_dirty = true;
+	counts = {};
+}
+
+void occlusion_buffer::add_occluder(const float* positions, size_t vertex_count, const uint32_t* indices, size_t index_count, const float world[16])
+{
+	float m[16];
+	multiply(world, matrix, m);
+	clip_positions.resize(vertex_count * 4);
+	float* clip{ clip_positions.data() };
+#ifdef OCCLUSION_CULLING_X86
+	const __m128 m0{ _mm_loadu_ps(m + 0) }, m1{ _mm_loadu_ps(m + 4) }, m2{ _mm_loadu_ps(m + 8) }, m3{ _mm_loadu_ps(m + 12) };
+	for (size_t v = 0; v < vertex_count; ++v)
+	{
+		const float* p{ positions + v * 3 };
+		_mm_storeu_ps(clip + v * 4, _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(p[0]), m0), _mm_mul_ps(_mm_set1_ps(p[1]), m1)),
+			_mm_add_ps(_mm_mul_ps(_mm_set1_ps(p[2]), m2), m3)));
+	}
+#else
+	for (size_t v = 0; v < vertex_count; ++v)
+	{
+		const float* p{ positions + v * 3 };
+		for (int c = 0; c < 4; ++c)
+		{
+			clip[v * 4 + c] = p[0] * m[c] + p[1] * m[4 + c] + p[2] * m[8 + c] + m[12 + c];
+		}
+	}
+#endif
+	for (size_t i = 0; i + 2 < index_count; i += 3)
+	{
+		rasterize(clip + indices[i] * 4, clip + indices[i + 1] * 4, clip + indices[i + 2] * 4);
+	}
+	counts.occluder_triangles += static_cast<uint32_t>(index_count / 3);
+	tiles_dirty = true;
+}
+
+void occlusion_buffer::rasterize(const float* a, const float* b, const float* c)
+{
+	// Clipping would only add occluder area near the camera, where the few triangles lost matter least.
+	if (!in_front_of_near_plane(a) || !in_front_of_near_plane(b) || !in_front_of_near_plane(c))
+	{
+		return;
+	}
+	const float* vertices[3]{ a, b, c };
+	float sx[3], sy[3], sz[3];
+	for (int k = 0; k < 3; ++k)
+	{
+		const float inverse_w{ 1.0f / vertices[k][3] };
+		sx[k] = (vertices[k][0] * inverse_w * 0.5f + 0.5f) * buffer_width;
+		sy[k] = (0.5f - vertices[k][1] * inverse_w * 0.5f) * buffer_height;
+		sz[k] = vertices[k][2] * inverse_w;
+	}
+	// Clockwise on screen (y down) is a positive area : front facing.
+	const float area{ (sx[1] - sx[0]) * (sy[2] - sy[0]) - (sy[1] - sy[0]) * (sx[2] - sx[0]) };
+	if (!(area > 0.0f))
+	{
+		return;
+	}
+	// Pixels whose centers are inside the bounding rectangle.
+	const float left{ ceilf((std::min)({ sx[0], sx[1], sx[2] }) - 0.5f) }, right{ floorf((std::max)({ sx[0], sx[1], sx[2] }) - 0.5f) };
+	const float top{ ceilf((std::min)({ sy[0], sy[1], sy[2] }) - 0.5f) }, bottom{ floorf((std::max)({ sy[0], sy[1], sy[2] }) - 0.5f) };
+	if (right < 0.0f || bottom < 0.0f || left > buffer_width - 1.0f || top > buffer_height - 1.0f || left > right || top > bottom)
+	{
+		return;
+	}
+	const int x0{ static_cast<int>((std::max)(left, 0.0f)) }, x1{ static_cast<int>((std::min)(right, buffer_width - 1.0f)) };
+	const int y0{ static_cast<int>((std::max)(top, 0.0f)) }, y1{ static_cast<int>((std::min)(bottom, buffer_height - 1.0f)) };
+	const float z{ (std::max)({ sz[0], sz[1], sz[2] }) };
+	++counts.rasterized;
+
+	// Edge k runs from vertex k to vertex k + 1 and is positive inside : e = ex * x + ey * y + e0 at pixel centers.
+	float ex[3], ey[3], e0[3];
+	for (int k = 0; k < 3; ++k)
+	{
+		const int n{ (k + 1) % 3 };
+		ex[k] = -(sy[n] - sy[k]);
+		ey[k] = sx[n] - sx[k];
+		e0[k] = -(ex[k] * sx[k] + ey[k] * sy[k]);
+	}
+	const uint32_t buffer_pitch{ pitch() };
+#ifdef OCCLUSION_CULLING_X86
+	// Groups of 4 pixels aligned in the row : the pixels left of x0 or right of x1 in a group are written only if
+	// the triangle covers them, which is right, or fall in the padding, which stays 0.
+	const int group_start{ x0 & ~3 };
+	const __m128 offsets{ _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f) };
+	const __m128 triangle_depth{ _mm_set1_ps(z) };
+	const __m128 zero{ _mm_setzero_ps() };
+	__m128 step[3], row_start[3];
+	for (int k = 0; k < 3; ++k)
+	{
+		step[k] = _mm_set1_ps(ex[k] * 4.0f);
+		row_start[k] = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(ex[k]), _mm_add_ps(_mm_set1_ps(static_cast<float>(group_start)), offsets)),
+			_mm_set1_ps(ey[k] * (y0 + 0.5f) + e0[k]));
+	}
+	for (int y = y0; y <= y1; ++y)
+	{
+		float* row{ &depth[static_cast<size_t>(y) * buffer_pitch] };
+		__m128 e[3]{ row_start[0], row_start[1], row_start[2] };
+		for (int x = group_start; x <= x1; x += 4)
+		{
+			const __m128 inside{ _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e[0], zero), _mm_cmpge_ps(e[1], zero)), _mm_cmpge_ps(e[2], zero)) };
+			const __m128 d{ _mm_loadu_ps(row + x) };
+			_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, _mm_min_ps(d, triangle_depth)), _mm_andnot_ps(inside, d)));
+			for (int k = 0; k < 3; ++k)
+			{
+				e[k] = _mm_add_ps(e[k], step[k]);
+			}
+		}
+		for (int k = 0; k < 3; ++k)
+		{
+			row_start[k] = _mm_add_ps(row_start[k], _mm_set1_ps(ey[k]));
+		}
+	}
+#else
+	for (int y = y0; y <= y1; ++y)
+	{
+		float* row{ &depth[static_cast<size_t>(y) * buffer_pitch] };
+		for (int x = x0; x <= x1; ++x)
+		{
+			bool inside{ true };
+			for (int k = 0; k < 3; ++k)
+			{
+				inside = inside && ex[k] * (x + 0.5f) + ey[k] * (y + 0.5f) + e0[k] >= 0.0f;
+			}
+			if (inside)
+			{
+				row[x] = (std::min)(row[x], z);
+			}
+		}
+	}
+#endif
+}
+
+void occlusion_buffer::update_tiles()
+{
+	const uint32_t buffer_pitch{ pitch() };
+	for (uint32_t ty = 0; ty < tile_rows; ++ty)
+	{
+		for (uint32_t tx = 0; tx < tile_columns; ++tx)
+		{
+			const float* tile{ &depth[static_cast<size_t>(ty) * tile_size * buffer_pitch + tx * tile_size] };
+#ifdef OCCLUSION_CULLING_X86
+			__m128 farthest{ _mm_setzero_ps() };
+			for (uint32_t y = 0; y < tile_size; ++y)
+			{
+				farthest = _mm_max_ps(farthest, _mm_max_ps(_mm_loadu_ps(tile + y * buffer_pitch), _mm_loadu_ps(tile + y * buffer_pitch + 4)));
+			}
+			farthest = _mm_max_ps(farthest, _mm_shuffle_ps(farthest, farthest, _MM_SHUFFLE(1, 0, 3, 2)));
+			farthest = _mm_max_ps(farthest, _mm_shuffle_ps(farthest, farthest, _MM_SHUFFLE(2, 3, 0, 1)));
+			tile_depth[ty * tile_columns + tx] = _mm_cvtss_f32(farthest);
+#else
+			float farthest{ 0.0f };
+			for (uint32_t y = 0; y < tile_size; ++y)
+			{
+				for (uint32_t x = 0; x < tile_size; ++x)
+				{
+					farthest = (std::max)(farthest, tile[y * buffer_pitch + x]);
+				}
+			}
+			tile_depth[ty * tile_columns + tx] = farthest;
+#endif
+		}
+	}
+	tiles_dirty = false;
+}
+
+bool occlusion_buffer::is_occluded(const world_aabbs& boxes, size_t index)
+{
+	++counts.tested;
+	// Screen rectangle and nearest depth of the 8 corners.
+	float min_x, max_x, min_y, max_y, min_z;
+#ifdef OCCLUSION_CULLING_X86
+	{
+		const __m128 signs_x{ _mm_setr_ps(-1.0f, +1.0f, -1.0f, +1.0f) }, signs_y{ _mm_setr_ps(-1.0f, -1.0f, +1.0f, +1.0f) };
+		const __m128 x{ _mm_add_ps(_mm_set1_ps(boxes.center_x[index]), _mm_mul_ps(_mm_set1_ps(boxes.extent_x[index]), signs_x)) };
+		const __m128 y{ _mm_add_ps(_mm_set1_ps(boxes.center_y[index]), _mm_mul_ps(_mm_set1_ps(boxes.extent_y[index]), signs_y)) };
+		__m128 lowest_x{ _mm_set1_ps(FLT_MAX) }, highest_x{ _mm_set1_ps(-FLT_MAX) };
+		__m128 lowest_y{ _mm_set1_ps(FLT_MAX) }, highest_y{ _mm_set1_ps(-FLT_MAX) }, lowest_z{ _mm_set1_ps(FLT_MAX) };
+		__m128 behind{ _mm_setzero_ps() };
+		for (float side : { -1.0f, +1.0f })
+		{
+			const __m128 z{ _mm_set1_ps(boxes.center_z[index] + boxes.extent_z[index] * side) };
+			__m128 clip[4];
+			for (int c = 0; c < 4; ++c)
+			{
+				clip[c] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(matrix[c])), _mm_mul_ps(y, _mm_set1_ps(matrix[4 + c]))),
+					_mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(matrix[8 + c])), _mm_set1_ps(matrix[12 + c])));
+			}
+			behind = _mm_or_ps(behind, _mm_or_ps(_mm_cmpnge_ps(clip[2], _mm_setzero_ps()), _mm_cmpngt_ps(clip[3], _mm_setzero_ps())));
+			const __m128 inverse_w{ _mm_div_ps(_mm_set1_ps(1.0f), clip[3]) };
+			const __m128 sx{ _mm_mul_ps(clip[0], inverse_w) }, sy{ _mm_mul_ps(clip[1], inverse_w) }, sz{ _mm_mul_ps(clip[2], inverse_w) };
+			lowest_x = _mm_min_ps(lowest_x, sx);
+			highest_x = _mm_max_ps(highest_x, sx);
+			lowest_y = _mm_min_ps(lowest_y, sy);
+			highest_y = _mm_max_ps(highest_y, sy);
+			lowest_z = _mm_min_ps(lowest_z, sz);
+		}
+		if (_mm_movemask_ps(behind) != 0)
+		{
+			return false;
+		}
+		auto horizontal_min = [](__m128 v)
+		{
+			v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+			return _mm_cvtss_f32(_mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1))));
+		};
+		auto horizontal_max = [](__m128 v)
+		{
+			v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+			return _mm_cvtss_f32(_mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1))));
+		};
+		min_x = horizontal_min(lowest_x);
+		max_x = horizontal_max(highest_x);
+		min_y = horizontal_min(lowest_y);
+		max_y = horizontal_max(highest_y);
+		min_z = horizontal_min(lowest_z);
+	}
+#else
+	min_x = min_y = min_z = FLT_MAX;
+	max_x = max_y = -FLT_MAX;
+	for (int corner = 0; corner < 8; ++corner)
+	{
+		const float p[3]{ boxes.center_x[index] + boxes.extent_x[index] * ((corner & 1) ? 1.0f : -1.0f),
+			boxes.center_y[index] + boxes.extent_y[index] * ((corner & 2) ? 1.0f : -1.0f),
+			boxes.center_z[index] + boxes.extent_z[index] * ((corner & 4) ? 1.0f : -1.0f) };
+		float clip[4];
+		for (int c = 0; c < 4; ++c)
+		{
+			clip[c] = p[0] * matrix[c] + p[1] * matrix[4 + c] + p[2] * matrix[8 + c] + matrix[12 + c];
+		}
+		if (!in_front_of_near_plane(clip))
+		{
+			return false;
+		}
+		min_x = (std::min)(min_x, clip[0] / clip[3]);
+		max_x = (std::max)(max_x, clip[0] / clip[3]);
+		min_y = (std::min)(min_y, clip[1] / clip[3]);
+		max_y = (std::max)(max_y, clip[1] / clip[3]);
+		min_z = (std::min)(min_z, clip[2] / clip[3]);
+	}
+#endif
+	// Every pixel the rectangle touches, including those whose centers are outside it.
+	const float left{ floorf((min_x * 0.5f + 0.5f) * buffer_width) }, right{ floorf((max_x * 0.5f + 0.5f) * buffer_width) };
+	const float top{ floorf((0.5f - max_y * 0.5f) * buffer_height) }, bottom{ floorf((0.5f - min_y * 0.5f) * buffer_height) };
+	if (!(right >= 0.0f && bottom >= 0.0f && left <= buffer_width - 1.0f && top <= buffer_height - 1.0f))
+	{
+		return false;
+	}
+	const int x0{ static_cast<int>((std::max)(left, 0.0f)) }, x1{ static_cast<int>((std::min)(right, buffer_width - 1.0f)) };
+	const int y0{ static_cast<int>((std::max)(top, 0.0f)) }, y1{ static_cast<int>((std::min)(bottom, buffer_height - 1.0f)) };
+
+	if (tiles_dirty)
+	{
+		update_tiles();
+	}
+	const uint32_t buffer_pitch{ pitch() };
+	for (int ty = y0 / static_cast<int>(tile_size); ty <= y1 / static_cast<int>(tile_size); ++ty)
+	{
+		for (int tx = x0 / static_cast<int>(tile_size); tx <= x1 / static_cast<int>(tile_size); ++tx)
+		{
+			if (tile_depth[ty * tile_columns + tx] < min_z)
+			{
+				continue;
+			}
+			// Part of the tile is not behind the box : test the pixels the rectangle covers.
+			const int px0{ (std::max)(x0, tx * static_cast<int>(tile_size)) }, px1{ (std::min)(x1, (tx + 1) * static_cast<int>(tile_size) - 1) };
+			const int py0{ (std::max)(y0, ty * static_cast<int>(tile_size)) }, py1{ (std::min)(y1, (ty + 1) * static_cast<int>(tile_size) - 1) };
+#ifdef OCCLUSION_CULLING_X86
+			const __m128 nearest{ _mm_set1_ps(min_z) };
+			const __m128 lanes{ _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f) };
+			const __m128 first{ _mm_set1_ps(static_cast<float>(px0)) }, last{ _mm_set1_ps(static_cast<float>(px1)) };
+			for (int y = py0; y <= py1; ++y)
+			{
+				const float* row{ &depth[static_cast<size_t>(y) * buffer_pitch] };
+				for (int x = px0 & ~3; x <= px1; x += 4)
+				{
+					const __m128 column{ _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), lanes) };
+					const __m128 covered{ _mm_and_ps(_mm_cmpge_ps(column, first), _mm_cmple_ps(column, last)) };
+					if (_mm_movemask_ps(_mm_and_ps(covered, _mm_cmpge_ps(_mm_loadu_ps(row + x), nearest))) != 0)
+					{
+						return false;
+					}
+				}
+			}
+#else
+			for (int y = py0; y <= py1; ++y)
+			{
+				for (int x = px0; x <= px1; ++x)
+				{
+					if (!(depth[static_cast<size_t>(y) * buffer_pitch + x] < min_z))
+					{
+						return false;
+					}
+				}
+			}
+#endif
+		}
+	}
+	++counts.occluded;
+	return true;
+}
+
+size_t occlusion_buffer::cull_occluded(const world_aabbs& boxes, std::vector<uint32_t>& indices)
+{
+	size_t count{ 0 };
+	for (uint32_t i : indices)
+	{
+		if (!is_occluded(boxes, i))
+		{
+			indices[count++] = i;
+		}
+	}
+	const size_t removed{ indices.size() - count };
+	indices.resize(count);
+	return removed;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "frustum_culling.h"
+
+struct occlusion_statistics
+{
+	uint32_t occluder_triangles{ 0 };	// submitted by add_occluder
+	uint32_t rasterized{ 0 };	// front facing, in front of the near plane and on screen
+	uint32_t tested{ 0 };	// boxes tested by cull_occluded
+	uint32_t occluded{ 0 };	// boxes removed by cull_occluded
+};
+
+// A small depth buffer filled on the CPU with the triangles of a few large objects near the camera (the occluders),
+// then used to drop the objects whose bounding boxes are entirely behind them before they are submitted.
+//
+// Every occluder triangle writes its farthest depth to the pixels whose centers it covers, keeping the nearest value
+// per pixel, so a stored depth is never in front of the occluder surface that produced it. A box is hidden if the
+// nearest depth of its corners is behind the stored depth of every pixel its screen rectangle touches. Pixels are
+// grouped in 8 x 8 tiles with the farthest depth of each tile, so most tiles of a hidden box are accepted with one
+// comparison. Occluders rasterize 4 pixels per step and boxes test 4 corners or 4 pixels per step with SSE, with
+// scalar code on other platforms.
+//
+// The results are conservative except at occluder silhouettes, where a pixel partly covered by an occluder counts as
+// covered if its center is : use occluders whose triangles lie inside the object, such as a coarse level of detail of
+// a convex mesh, and a resolution of a quarter of the screen or more.
+class occlusion_buffer
+{
+public:
+	occlusion_buffer(uint32_t width, uint32_t height);
+
+	// Empties the buffer for a new view. 'view_projection' is a row-major matrix used as 'float4(p, 1) * view_projection'
+	// with the depth range of Direct3D, z / w in [0, 1].
+	void clear(const float view_projection[16]);
+	// Rasterizes the triangles of an occluder, x, y, z per vertex, transformed by 'world'. Back faces (counterclockwise
+	// on screen, like the default rasterizer state) and triangles crossing the near plane are skipped.
+	void add_occluder(const float* positions, size_t vertex_count, const uint32_t* indices, size_t index_count, const float world[16]);
+
+	// Removes from 'indices' the boxes hidden behind the occluders, keeping the order of the others, and returns how
+	// many were removed. Boxes crossing the near plane or off screen are kept.
+	size_t cull_occluded(const world_aabbs& boxes, std::vector<uint32_t>& indices);
+	// The test of cull_occluded for box 'index' alone.
+	bool is_occluded(const world_aabbs& boxes, size_t index);
+
+	uint32_t width() const { return buffer_width; }
+	uint32_t height() const { return buffer_height; }
+	// Row-major depths with a pitch of pitch() floats, 1 where no occluder was drawn.
+	const float* depths() const { return depth.data(); }
+	uint32_t pitch() const { return tile_columns * tile_size; }
+	// Counts since the last clear.
+	const occlusion_statistics& statistics() const { return counts; }
+
+	static constexpr uint32_t tile_size{ 8 };
+
+private:
+	void rasterize(const float* a, const float* b, const float* c);
+	void update_tiles();
+
+	uint32_t buffer_width;
+	uint32_t buffer_height;
+	uint32_t tile_columns;
+	uint32_t tile_rows;
+	float matrix[16]{};
+	std::vector<float> depth;	// tile_rows * tile_size rows of pitch() pixels
+	std::vector<float> tile_depth;	// farthest depth per tile, valid when 'tiles_dirty' is false
+	bool tiles_dirty{ false };
+	std::vector<float> clip_positions;	// x, y, z, w per vertex of the current occluder
+	occlusion_statistics counts;
+};
@@ -0,0 +1,265 @@
+#include "overdraw_optimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+namespace
+{
+	constexpr uint32_t cluster_cache_size{ 16 };
+	constexpr size_t minimum_cluster_size{ 16 };	// triangles
+
+	struct float3
+	{
+		float x, y, z;
+	};
+	float3 operator-(const float3& a, const float3& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+	float3 operator+(const float3& a, const float3& b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+	float3 operator*(const float3& a, float s) { return { a.x * s, a.y * s, a.z * s }; }
+	float dot(const float3& a, const float3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+	float3 cross(const float3& a, const float3& b) { return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x }; }
+
+	float3 load_position(const float* positions, size_t stride, uint32_t index)
+	{
+		const float* p{ reinterpret_cast<const float*>(reinterpret_cast<const char*>(positions) + stride * index) };
+		return { p[0], p[1], p[2] };
+	}
+
+	// FIFO post-transform cache used to find the points where the cache is cold.
+	class fifo_cache
+	{
+	public:
+		explicit fifo_cache(size_t vertex_count) : pushed_at(vertex_count, SIZE_MAX) {}
+		void reset() { push_count += cluster_cache_size; }
+		uint32_t misses(const uint32_t* triangle)
+		{
+			uint32_t count{ 0 };
+			for (size_t k = 0; k < 3; ++k)
+			{
+				size_t& at{ pushed_at[triangle[k]] };
+				if (at == SIZE_MAX || push_count - at >= cluster_cache_size)
+				{
+					at = push_count++;
+					++count;
+				}
+			}
+			return count;
+		}
+	private:
+		std::vector<size_t> pushed_at;
+		size_t push_count{ 0 };
+	};
+}
+
+void optimize_overdraw(uint32_t* indices, size_t index_count, const float* positions, size_t stride, size_t vertex_count, float threshold)
+{
+	const size_t triangle_count{ index_count / 3 };
+	if (triangle_count < minimum_cluster_size * 2)
+	{
+		return;
+	}
+
+	// Hard boundaries : triangles that miss the cache with all three vertices start a new cluster.
+	std::vector<size_t> hard_clusters;
+	{
+		fifo_cache cache(vertex_count);
+		for (size_t t = 0; t < triangle_count; ++t)
+		{
+			if (cache.misses(indices + t * 3) == 3 || t == 0)
+			{
+				hard_clusters.push_back(t);
+			}
+		}
+		hard_clusters.push_back(triangle_count);
+	}
+
+	// Soft boundaries : a hard cluster is split again wherever the running cache miss ratio is within
+	// 'threshold' of the whole hard cluster, so that the split costs little vertex cache efficiency.
+	std::vector<size_t> clusters;
+	{
+		fifo_cache cache(vertex_count);
+		for (size_t c = 0; c + 1 < hard_clusters.size(); ++c)
+		{
+			const size_t begin{ hard_clusters[c] };
+			const size_t end{ hard_clusters[c + 1] };
+
+			cache.reset();
+			size_t hard_misses{ 0 };
+			for (size_t t = begin; t < end; ++t)
+			{
+				hard_misses += cache.misses(indices + t * 3);
+			}
+			const float acmr_limit{ threshold * static_cast<float>(hard_misses) / static_cast<float>(end - begin) };
+
+			cache.reset();
+			clusters.push_back(begin);
+			size_t misses{ 0 };
+			size_t start{ begin };
+			for (size_t t = begin; t < end; ++t)
+			{
+				misses += cache.misses(indices + t * 3);
+				const size_t size{ t + 1 - start };
+				if (size >= minimum_cluster_size && end - (t + 1) >= minimum_cluster_size &&
+					static_cast<float>(misses) <= acmr_limit * static_cast<float>(size))
+				{
+					start = t + 1;
+					clusters.push_back(start);
+					misses = 0;
+					cache.reset();
+				}
+			}
+		}
+		clusters.push_back(triangle_count);
+	}
+
+	// Sort the clusters by how far they face away from the mesh centre, outermost first.
+	float3 mesh_centroid{ 0, 0, 0 };
+	float mesh_area{ 0 };
+	struct cluster
+	{
+		size_t begin, end;
+		float3 centroid;
+		float3 normal;
+		float sort_key;
+	};
+	std::vector<cluster> sorted;
+	for (size_t c = 0; c + 1 < clusters.size(); ++c)
+	{
+		cluster cl{ clusters[c], clusters[c + 1], { 0, 0, 0 }, { 0, 0, 0 }, 0.0f };
+		float area{ 0 };
+		for (size_t t = cl.begin; t < cl.end; ++t)
+		{
+			float3 a{ load_position(positions, stride, indices[t * 3 + 0]) };
+			float3 b{ load_position(positions, stride, indices[t * 3 + 1]) };
+			float3 c3{ load_position(positions, stride, indices[t * 3 + 2]) };
+			// With clockwise front faces cross(b - a, c - a) points to the front side.
+			float3 n{ cross(b - a, c3 - a) };
+			float triangle_area{ sqrtf(dot(n, n)) * 0.5f };
+			cl.normal = cl.normal + n;
+			cl.centroid = cl.centroid + (a + b + c3) * (triangle_area / 3.0f);
+			area += triangle_area;
+		}
+		mesh_centroid = mesh_centroid + cl.centroid;
+		mesh_area += area;
+		cl.centroid = area > 0 ? cl.centroid * (1.0f / area) : load_position(positions, stride, indices[cl.begin * 3]);
+		sorted.push_back(cl);
+	}
+	if (mesh_area > 0)
+	{
+		mesh_centroid = mesh_centroid * (1.0f / mesh_area);
+	}
+	for (cluster& cl : sorted)
+	{
+		float length{ sqrtf(dot(cl.normal, cl.normal)) };
+		cl.sort_key = length > 0 ? dot(cl.centroid - mesh_centroid, cl.normal * (1.0f / length)) : 0.0f;
+	}
+	std::stable_sort(sorted.begin(), sorted.end(), [](const cluster& a, const cluster& b) { return a.sort_key > b.sort_key; });
+
+	std::vector<uint32_t> output;
+	output.reserve(triangle_count * 3);
+	for (const cluster& cl : sorted)
+	{
+		output.insert(output.end(), indices + cl.begin * 3, indices + cl.end * 3);
+	}
+	std::copy(output.begin(), output.end(), indices);
+}
+
+overdraw_statistics estimate_overdraw(const uint32_t* indices, size_t index_count, const float* positions, size_t stride, size_t vertex_count, uint32_t resolution)
+{
+	overdraw_statistics statistics;
+	const size_t triangle_count{ index_count / 3 };
+	if (triangle_count == 0 || resolution == 0)
+	{
+		return statistics;
+	}
+
+	// Rows are right, up and forward; right x up = forward keeps the handedness, so the winding
+	// of front faces is the same in every view.
+	static const float3 views[6][3]
+	{
+		{ { +1, 0, 0 }, { 0, +1, 0 }, { 0, 0, +1 } },
+		{ { -1, 0, 0 }, { 0, +1, 0 }, { 0, 0, -1 } },
+		{ { 0, 0, -1 }, { 0, +1, 0 }, { +1, 0, 0 } },
+		{ { 0, 0, +1 }, { 0, +1, 0 }, { -1, 0, 0 } },
+		{ { +1, 0, 0 }, { 0, 0, -1 }, { 0, +1, 0 } },
+		{ { +1, 0, 0 }, { 0, 0, +1 }, { 0, -1, 0 } },
+	};
+
+	std::vector<float> depth(static_cast<size_t>(resolution) * resolution);
+	std::vector<float3> projected(vertex_count);
+	for (const float3(&view)[3] : views)
+	{
+		float min_x{ std::numeric_limits<float>::max() }, min_y{ min_x };
+		float max_x{ -min_x }, max_y{ -min_x };
+		for (size_t v = 0; v < vertex_count; ++v)
+		{
+			float3 p{ load_position(positions, stride, static_cast<uint32_t>(v)) };
+			projected[v] = { dot(p, view[0]), dot(p, view[1]), dot(p, view[2]) };
+		}
+		for (size_t i = 0; i < triangle_count * 3; ++i)
+		{
+			const float3& p{ projected[indices[i]] };
+			min_x = std::min(min_x, p.x); max_x = std::max(max_x, p.x);
+			min_y = std::min(min_y, p.y); max_y = std::max(max_y, p.y);
+		}
+		const float extent{ std::max(max_x - min_x, max_y - min_y) };
+		const float scale{ extent > 0 ? (resolution - 1) / extent : 0.0f };
+		for (float3& p : projected)
+		{
+			p.x = (p.x - min_x) * scale;
+			p.y = (p.y - min_y) * scale;
+		}
+
+		std::fill(depth.begin(), depth.end(), std::numeric_limits<float>::infinity());
+		for (size_t t = 0; t < triangle_count; ++t)
+		{
+			float3 a{ projected[indices[t * 3 + 0]] };
+			float3 b{ projected[indices[t * 3 + 1]] };
+			float3 c{ projected[indices[t * 3 + 2]] };
+			float area{ (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x) };
+			if (area >= 0)
+			{
+				// Counter-clockwise (y up) or degenerate : back face.
+				continue;
+			}
+			std::swap(b, c);
+			area = -area;
+
+			int x0{ std::max(0, static_cast<int>(floorf(std::min({ a.x, b.x, c.x })))) };
+			int x1{ std::min(static_cast<int>(resolution) - 1, static_cast<int>(ceilf(std::max({ a.x, b.x, c.x })))) };
+			int y0{ std::max(0, static_cast<int>(floorf(std::min({ a.y, b.y, c.y })))) };
+			int y1{ std::min(static_cast<int>(resolution) - 1, static_cast<int>(ceilf(std::max({ a.y, b.y, c.y })))) };
+			const float inverse_area{ 1.0f / area };
+			for (int y = y0; y <= y1; ++y)
+			{
+				const float py{ y + 0.5f };
+				for (int x = x0; x <= x1; ++x)
+				{
+					const float px{ x + 0.5f };
+					float w0{ (c.x - b.x) * (py - b.y) - (c.y - b.y) * (px - b.x) };
+					float w1{ (a.x - c.x) * (py - c.y) - (a.y - c.y) * (px - c.x) };
+					float w2{ (b.x - a.x) * (py - a.y) - (b.y - a.y) * (px - a.x) };
+					if (w0 < 0 || w1 < 0 || w2 < 0)
+					{
+						continue;
+					}
+					float z{ (w0 * a.z + w1 * b.z + w2 * c.z) * inverse_area };
+					float& d{ depth[static_cast<size_t>(y) * resolution + x] };
+					if (z < d)
+					{
+						if (d == std::numeric_limits<float>::infinity())
+						{
+							++statistics.pixels_covered;
+						}
+						d = z;
+						++statistics.pixels_shaded;
+					}
+				}
+			}
+		}
+	}
+	statistics.overdraw = statistics.pixels_covered > 0 ? static_cast<float>(statistics.pixels_shaded) / statistics.pixels_covered : 0.0f;
+	return statistics;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Overdraw-aware triangle ordering (Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex
+// Locality and Reduced Overdraw"). The index range, which should already be vertex cache optimized,
+// is cut into clusters at the points where the vertex cache is cold anyway, and the clusters are
+// sorted so that outward facing parts of the mesh are drawn first. Triangles only move inside the
+// given range, so subset ranges stay valid.
+//
+// 'positions' points to the first position (float3) and 'stride' is the vertex size in bytes.
+// 'threshold' is the vertex cache degradation (ACMR ratio) accepted to get smaller clusters.
+void optimize_overdraw(uint32_t* indices, size_t index_count, const float* positions, size_t stride, size_t vertex_count, float threshold = 1.05f);
+
+struct overdraw_statistics
+{
+	size_t pixels_covered{ 0 };	// pixels with at least one front facing fragment
+	size_t pixels_shaded{ 0 };	// fragments that passed the depth test
+	float overdraw{ 0.0f };	// pixels_shaded / pixels_covered, 1 is the ideal
+};
+
+// Rasterizes the triangles in software from the six axis aligned directions (orthographic, back faces
+// culled with the clockwise front face convention used by framework) with a LESS depth test in draw order,
+// and counts how many fragments are shaded per covered pixel.
+overdraw_statistics estimate_overdraw(const uint32_t* indices, size_t index_count, const float* positions, size_t stride, size_t vertex_count, uint32_t resolution = 256);
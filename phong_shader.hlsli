@@ -17,6 +17,8 @@ cbuffer OBJECT_CONSTANT_BUFFER : register(b0)
     float4 ka; //ːF
     float4 kd; //gUːF
     float4 ks; //ʔːF
+    float4 position_offset; //ʎq_̈ʒũItZbg
+    float4 position_scale; //ʎq_̈ʒu̔{ (ʒu = position_offset + position * position_scale)
 };
 
 //V[Ŝ̏
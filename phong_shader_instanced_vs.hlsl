@@ -0,0 +1,27 @@
+#include "phong_shader.hlsli"
+
+//CX^X` (static_mesh::render_instanced) p̒_VF[_[
+//[hs͒萔obt@ł͂ȂCX^XƂ̒_obt@ (Xbg1) ǂ
+VS_OUT main(
+float4 position : POSITION,
+float4 normal : NORMAL,
+float2 texcoord : TEXCOORD,
+float4 world0 : WORLD0, //CX^X̃[hs̊es
+float4 world1 : WORLD1,
+float4 world2 : WORLD2,
+float4 world3 : WORLD3)
+{
+    VS_OUT vont = (VS_OUT) 0; //o͍\ VS_OUT ̏
+    float4x4 instance_world = float4x4(world0, world1, world2, world3);
+    float4 world_position = mul(float4(position.xyz, 1), instance_world); //fԂ̒_u[hWnvɕϊ
+    vont.position = mul(world_position, view_projection); //[hWur[s~ˉesvŕϊAʏ̈ʒuɕϊ
+
+    vont.normal = normalize(mul(float4(normal.xyz, 0), instance_world)).xyz;
+    vont.binormal = float3(0.0f, 1.0f, 0.001f);//̏xNg
+    vont.binormal = normalize(vont.binormal);
+    vont.tangent = normalize(cross(vont.binormal, vont.normal));//O
+    vont.binormal = normalize(cross(vont.binormal, vont.tangent));
+    vont.world_position = world_position;
+    vont.texcoord = texcoord; //UVŴ܂܃sNZVF[_[ɓn
+    return vont;
+}
\ No newline at end of file
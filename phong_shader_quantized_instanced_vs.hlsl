@@ -0,0 +1,37 @@
+#include "phong_shader.hlsli"
+
+//ʑ̃GR[hꂽ@̕ (vertex_quantization.cpp  decode_octahedral_normal ƓvZ)
+float3 decode_octahedral_normal(float2 e)
+{
+    float3 n = float3(e.x, e.y, 1.0f - abs(e.x) - abs(e.y));
+    float t = saturate(-n.z);
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+    return normalize(n);
+}
+
+//ʎq_ (quantized_vertex) ̃CX^X` (static_mesh::render_instanced) p̒_VF[_[
+VS_OUT main(
+float4 position : POSITION, //R16G16B16A16_UNORM : oEfBO{bNX̑Έʒu
+float2 normal : NORMAL, //R16G16_SNORM : ʑ̃GR[hꂽ@
+float2 texcoord : TEXCOORD, //R16G16_FLOAT
+float4 world0 : WORLD0, //CX^X̃[hs̊es
+float4 world1 : WORLD1,
+float4 world2 : WORLD2,
+float4 world3 : WORLD3)
+{
+    VS_OUT vont = (VS_OUT) 0; //o͍\ VS_OUT ̏
+    float4x4 instance_world = float4x4(world0, world1, world2, world3);
+    float3 local_position = position_offset.xyz + position.xyz * position_scale.xyz; //fԂ̈ʒuɕ
+    float4 world_position = mul(float4(local_position, 1), instance_world); //fԂ̒_u[hWnvɕϊ
+    vont.position = mul(world_position, view_projection); //[hWur[s~ˉesvŕϊAʏ̈ʒuɕϊ
+
+    vont.normal = normalize(mul(float4(decode_octahedral_normal(normal), 0), instance_world)).xyz;
+    vont.binormal = float3(0.0f, 1.0f, 0.001f);//̏xNg
+    vont.binormal = normalize(vont.binormal);
+    vont.tangent = normalize(cross(vont.binormal, vont.normal));//O
+    vont.binormal = normalize(cross(vont.binormal, vont.tangent));
+    vont.world_position = world_position;
+    vont.texcoord = texcoord; //UVŴ܂܃sNZVF[_[ɓn
+    return vont;
+}
\ No newline at end of file
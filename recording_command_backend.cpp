@@ -0,0 +1,110 @@
+#include "recording_command_backend.h"
+
+#include <algorithm>
+#include <iterator>
+
+void recording_command_backend::reset()
+{
+	commands.clear();
+	std::fill(std::begin(command_counts), std::end(command_counts), 0);
+	constant_bytes = instance_bytes = vertex_bytes = 0;
+	largest_constants = 0;
+	largest_instances = largest_vertices = 0;
+	vertices_drawn = indices_drawn = 0;
+}
+
+uint64_t recording_command_backend::draw_calls() const
+{
+	return command_counts[command_stream::draw_command] + command_counts[command_stream::draw_indexed_command] +
+		command_counts[command_stream::draw_indexed_instanced_command];
+}
+
+void recording_command_backend::log(command_stream::command_type type)
+{
+	if (keep_commands)
+	{
+		commands.push_back(type);
+	}
+	++command_counts[type];
+}
+
+void recording_command_backend::set_input_layout(ID3D11InputLayout*)
+{
+	log(command_stream::set_input_layout_command);
+}
+
+void recording_command_backend::set_vertex_shader(ID3D11VertexShader*)
+{
+	log(command_stream::set_vertex_shader_command);
+}
+
+void recording_command_backend::set_pixel_shader(ID3D11PixelShader*)
+{
+	log(command_stream::set_pixel_shader_command);
+}
+
+void recording_command_backend::set_vertex_buffer(ID3D11Buffer*, uint32_t, uint32_t)
+{
+	log(command_stream::set_vertex_buffer_command);
+}
+
+void recording_command_backend::set_index_buffer(ID3D11Buffer*, uint32_t, uint32_t)
+{
+	log(command_stream::set_index_buffer_command);
+}
+
+void recording_command_backend::set_topology(command_stream::primitive_topology)
+{
+	log(command_stream::set_topology_command);
+}
+
+void recording_command_backend::set_shader_resources(uint32_t, uint32_t, ID3D11ShaderResourceView* const*)
+{
+	log(command_stream::set_shader_resources_command);
+}
+
+void recording_command_backend::set_constants(uint32_t, const void*, uint32_t size)
+{
+	log(command_stream::set_constants_command);
+	constant_bytes += size;
+	largest_constants = std::max(largest_constants, size);
+}
+
+void recording_command_backend::set_instances(const void*, uint32_t stride, uint32_t count)
+{
+	log(command_stream::set_instances_command);
+	const uint64_t size{ static_cast<uint64_t>(stride) * count };
+	instance_bytes += size;
+	largest_instances = std::max(largest_instances, size);
+}
+
+void recording_command_backend::set_vertices(const void*, uint32_t stride, uint32_t count)
+{
+	log(command_stream::set_vertices_command);
+	const uint64_t size{ static_cast<uint64_t>(stride) * count };
+	vertex_bytes += size;
+	largest_vertices = std::max(largest_vertices, size);
+}
+
+void recording_command_backend::draw(uint32_t vertex_count, uint32_t)
+{
+	log(command_stream::draw_command);
+	vertices_drawn += vertex_count;
+}
+
+void recording_command_backend::draw_indexed(uint32_t index_count, uint32_t, int32_t)
+{
+	log(command_stream::draw_indexed_command);
+	indices_drawn += index_count;
+}
+
+void recording_command_backend::draw_indexed_instanced(uint32_t index_count, uint32_t instance_count, uint32_t, int32_t)
+{
+	log(command_stream::draw_indexed_instanced_command);
+	indices_drawn += static_cast<uint64_t>(index_count) * instance_count;
+}
+
+void recording_command_backend::call(const std::function<void(ID3D11DeviceContext*)>&)
+{
+	log(command_stream::call_command);
+}
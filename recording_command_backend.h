@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "command_stream.h"
+
+// The null rendering device : keeps the decoded commands and totals instead of executing them, so the draw
+// submission (recording, state filtering, replay) runs and can be measured on machines without Direct3D.
+// Sizes are in bytes. Like the command stream it builds without the Windows headers.
+class recording_command_backend : public command_backend
+{
+public:
+	// Every replayed command in order, unless keep_commands is false.
+	bool keep_commands{ true };
+	std::vector<command_stream::command_type> commands;
+	uint64_t command_counts[command_stream::command_type_count]{};
+
+	// Data the Direct3D backend would upload to its dynamic buffers.
+	uint64_t constant_bytes{ 0 };
+	uint64_t instance_bytes{ 0 };
+	uint64_t vertex_bytes{ 0 };
+	// Largest single upload of each kind : the size the dynamic buffers grow to.
+	uint32_t largest_constants{ 0 };
+	uint64_t largest_instances{ 0 };
+	uint64_t largest_vertices{ 0 };
+
+	uint64_t vertices_drawn{ 0 };	// non-indexed draws
+	uint64_t indices_drawn{ 0 };	// indexed draws, times the instance count
+
+	// Forgets the commands and totals, as at the start of a frame.
+	void reset();
+	uint64_t upload_bytes() const { return constant_bytes + instance_bytes + vertex_bytes; }
+	uint64_t draw_calls() const;
+
+	void set_input_layout(ID3D11InputLayout* input_layout) override;
+	void set_vertex_shader(ID3D11VertexShader* vertex_shader) override;
+	void set_pixel_shader(ID3D11PixelShader* pixel_shader) override;
+	void set_vertex_buffer(ID3D11Buffer* buffer, uint32_t stride, uint32_t offset) override;
+	void set_index_buffer(ID3D11Buffer* buffer, uint32_t index_size, uint32_t offset) override;
+	void set_topology(command_stream::primitive_topology topology) override;
+	void set_shader_resources(uint32_t first_slot, uint32_t count, ID3D11ShaderResourceView* const* shader_resource_views) override;
+	void set_constants(uint32_t slot, const void* data, uint32_t size) override;
+	void set_instances(const void* data, uint32_t stride, uint32_t count) override;
+	void set_vertices(const void* data, uint32_t stride, uint32_t count) override;
+	void draw(uint32_t vertex_count, uint32_t start_vertex) override;
+	void draw_indexed(uint32_t index_count, uint32_t start_index, int32_t base_vertex) override;
+	void draw_indexed_instanced(uint32_t index_count, uint32_t instance_count, uint32_t start_index, int32_t base_vertex) override;
+	// The function is not called : there is no device context.
+	void call(const std::function<void(ID3D11DeviceContext*)>& function) override;
+
+private:
+	void log(command_stream::command_type type);
+};
@@ -0,0 +1,81 @@
+#include "render_queue.h"
+
+#include <algorithm>
+#include <cstring>
+
+uint64_t make_sort_key(uint32_t pass, uint32_t shader, uint32_t material, uint32_t texture_set, uint32_t depth)
+{
+	return static_cast<uint64_t>(pass & 0xF) << 60 | static_cast<uint64_t>(shader & 0xFF) << 52 | static_cast<uint64_t>(material & 0xFFFF) << 36 |
+		static_cast<uint64_t>(texture_set & 0xFFF) << 24 | (depth & 0xFFFFFF);
+}
+
+uint64_t make_blended_sort_key(uint32_t pass, uint32_t shader, uint32_t material, uint32_t texture_set, uint32_t depth)
+{
+	return static_cast<uint64_t>(pass & 0xF) << 60 | static_cast<uint64_t>(~depth & 0xFFFFFF) << 36 | static_cast<uint64_t>(shader & 0xFF) << 28 |
+		static_cast<uint64_t>(material & 0xFFFF) << 12 | (texture_set & 0xFFF);
+}
+
+uint32_t quantize_sort_depth(float view_depth, float near_z, float far_z)
+{
+	const float t{ std::min(std::max((view_depth - near_z) / (far_z - near_z), 0.0f), 1.0f) };
+	return static_cast<uint32_t>(t * 0xFFFFFF);
+}
+
+void radix_sort_packets(draw_packet* packets, draw_packet* scratch, size_t count)
+{
+	if (count < 2)
+	{
+		return;
+	}
+
+	// 11-bit digits : six passes cover the key, and a histogram still fits in the L1 cache.
+	constexpr int digit_bits{ 11 };
+	constexpr int digit_count{ (64 + digit_bits - 1) / digit_bits };
+	constexpr uint64_t digit_mask{ (1 << digit_bits) - 1 };
+
+	// All the histograms in one pass over the keys.
+	uint32_t histograms[digit_count][1 << digit_bits]{};
+	for (size_t i = 0; i < count; ++i)
+	{
+		uint64_t key{ packets[i].key };
+		for (int digit = 0; digit < digit_count; ++digit)
+		{
+			++histograms[digit][(key >> (digit * digit_bits)) & digit_mask];
+		}
+	}
+
+	draw_packet* source{ packets };
+	draw_packet* destination{ scratch };
+	for (int digit = 0; digit < digit_count; ++digit)
+	{
+		uint32_t* histogram{ histograms[digit] };
+		const int shift{ digit * digit_bits };
+		if (histogram[(source[0].key >> shift) & digit_mask] == count)
+		{
+			continue;
+		}
+		uint32_t offset{ 0 };
+		for (uint32_t& bucket : histograms[digit])
+		{
+			uint32_t bucket_count{ bucket };
+			bucket = offset;
+			offset += bucket_count;
+		}
+		for (size_t i = 0; i < count; ++i)
+		{
+			const draw_packet& packet{ source[i] };
+			destination[histogram[(packet.key >> shift) & digit_mask]++] = packet;
+		}
+		std::swap(source, destination);
+	}
+	if (source != packets)
+	{
+		memcpy(packets, source, sizeof(draw_packet) * count);
+	}
+}
+
+void render_queue::sort()
+{
+	scratch.resize(packets.size());
+	radix_sort_packets(packets.data(), scratch.data(), packets.size());
+}
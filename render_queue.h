@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 64-bit draw sort keys, most significant field first. Sorting the keys in increasing order groups the draws
+// by pass, then by shader, material and texture set to minimize state changes, and draws each group front to back.
+//	63-60 : pass	59-52 : shader	51-36 : material	35-24 : texture set	23-0 : depth
+// Blended passes are sorted back to front first, with the state fields below the depth :
+//	63-60 : pass	59-36 : inverted depth	35-28 : shader	27-12 : material	11-0 : texture set
+uint64_t make_sort_key(uint32_t pass, uint32_t shader, uint32_t material, uint32_t texture_set, uint32_t depth);
+uint64_t make_blended_sort_key(uint32_t pass, uint32_t shader, uint32_t material, uint32_t texture_set, uint32_t depth);
+// 24-bit depth of a view space distance between near_z and far_z (clamped), increasing with the distance.
+uint32_t quantize_sort_depth(float view_depth, float near_z, float far_z);
+
+inline uint32_t sort_key_pass(uint64_t key) { return static_cast<uint32_t>(key >> 60); }
+inline uint32_t sort_key_shader(uint64_t key) { return static_cast<uint32_t>(key >> 52) & 0xFF; }	// of make_sort_key keys
+inline uint32_t sort_key_material(uint64_t key) { return static_cast<uint32_t>(key >> 36) & 0xFFFF; }	// of make_sort_key keys
+
+// A recorded draw : its sort key and an index into whatever the caller keeps per draw (a command, an instance...).
+struct draw_packet
+{
+	uint64_t key;
+	uint32_t payload;
+};
+
+// Stable LSD radix sort of 'count' packets by key, 11 bits per pass (count must fit in 32 bits). Passes over a digit
+// that is the same in every key are skipped. 'scratch' must hold 'count' packets. The result ends up in 'packets'.
+void radix_sort_packets(draw_packet* packets, draw_packet* scratch, size_t count);
+
+// Packets recorded in any order during a frame, sorted once and then submitted in key order.
+class render_queue
+{
+public:
+	void clear() { packets.clear(); }
+	void record(uint64_t key, uint32_t payload) { packets.push_back({ key, payload }); }
+	void sort();
+
+	size_t size() const { return packets.size(); }
+	const draw_packet* begin() const { return packets.data(); }
+	const draw_packet* end() const { return packets.data() + packets.size(); }
+
+private:
+	std::vector<draw_packet> packets;
+	std::vector<draw_packet> scratch;
+};
@@ -0,0 +1,43 @@
+#include "ring_allocator.h"
+
+#include <cassert>
+
+ring_allocator::ring_allocator(size_t capacity, size_t alignment) : buffer_capacity(capacity), alignment(alignment)
+{
+	assert(alignment > 0 && (alignment & (alignment - 1)) == 0 && "The alignment must be a power of two.");
+	assert(capacity % alignment == 0 && "The capacity must be a multiple of the alignment.");
+}
+
+size_t ring_allocator::allocate(size_t size)
+{
+	if (size == 0 || size > buffer_capacity)
+	{
+		return npos;
+	}
+	uint64_t start{ (head + alignment - 1) & ~static_cast<uint64_t>(alignment - 1) };
+	if (start % buffer_capacity + size > buffer_capacity)
+	{
+		start += buffer_capacity - start % buffer_capacity;
+	}
+	if (start + size - tail > buffer_capacity)
+	{
+		return npos;
+	}
+	head = start + size;
+	return static_cast<size_t>(start % buffer_capacity);
+}
+
+void ring_allocator::end_frame(uint64_t fence)
+{
+	assert((frames.empty() || frames.back().fence < fence) && "Fence values must increase.");
+	frames.push_back({ fence, head });
+}
+
+void ring_allocator::retire(uint64_t completed_fence)
+{
+	while (!frames.empty() && frames.front().fence <= completed_fence)
+	{
+		tail = frames.front().end;
+		frames.pop_front();
+	}
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+
+// Suballocates a fixed size buffer as a ring, frame by frame. The ranges handed out during a frame stay
+// reserved until the frame is retired, i.e. until the GPU has signalled the fence value passed to end_frame.
+// Works on offsets only, so the same logic serves any buffer (the GraphicsMemory scheme of DirectXTK).
+class ring_allocator
+{
+public:
+	static constexpr size_t npos{ SIZE_MAX };
+
+	ring_allocator(size_t capacity, size_t alignment);
+
+	// Offset of 'size' free bytes aligned to 'alignment', or npos when they would overlap a frame still in flight.
+	// An allocation never straddles the end of the buffer : the tail of the buffer is skipped instead.
+	size_t allocate(size_t size);
+	// Closes the current frame. Its allocations are released by the first retire(completed_fence) with
+	// completed_fence >= fence. Fence values must increase.
+	void end_frame(uint64_t fence);
+	// Releases every closed frame whose fence is <= completed_fence.
+	void retire(uint64_t completed_fence);
+
+	size_t capacity() const { return buffer_capacity; }
+	size_t used() const { return static_cast<size_t>(head - tail); }	// bytes reserved, skipped ones included
+	size_t frames_in_flight() const { return frames.size(); }
+	// Fence of the oldest closed frame not retired yet, 0 if there is none.
+	uint64_t oldest_fence() const { return frames.empty() ? 0 : frames.front().fence; }
+
+private:
+	struct frame
+	{
+		uint64_t fence;
+		uint64_t end;	// 'head' when the frame was closed
+	};
+
+	size_t buffer_capacity;
+	size_t alignment;
+	// Positions counted from the creation of the allocator, so that head - tail is the reserved size even after wrapping.
+	uint64_t head{ 0 };
+	uint64_t tail{ 0 };
+	std::deque<frame> frames;
+};
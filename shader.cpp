@@ -4,7 +4,7 @@
 #include <memory>
 using namespace std;
 
-HRESULT create_vs_from_cso(ID3D11Device* device, const char* cso_name, ID3D11VertexShader** vertex_shader, ID3D11InputLayout** input_layout, D3D11_INPUT_ELEMENT_DESC* input_element_desc, UINT num_elements)
+HRESULT create_vs_from_cso(ID3D11Device* device, const char* cso_name, ID3D11VertexShader** vertex_shader, ID3D11InputLayout** input_layout, const D3D11_INPUT_ELEMENT_DESC* input_element_desc, UINT num_elements)
 {
 	FILE* fp{ nullptr };
 	fopen_s(&fp, cso_name, "rb");
@@ -0,0 +1,518 @@
+#include "shading_functions.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SHADING_FUNCTIONS_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+// MSVC accepts AVX intrinsics in any function; GCC and Clang need the target attribute on the lane operations,
+// and the loop over the lanes is flattened so that they are inlined into it.
+#define AVX_FUNCTION
+#define AVX_LOOP_FUNCTION
+#else
+#define AVX_FUNCTION __attribute__((target("avx")))
+#define AVX_LOOP_FUNCTION __attribute__((target("avx"), flatten))
+#endif
+#endif
+
+namespace
+{
+	// The HLSL intrinsics on the scalar types, for the references.
+	float saturate(float x) { return std::min(std::max(x, 0.0f), 1.0f); }
+	float3 operator+(const float3& a, const float3& b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+	float3 operator-(const float3& a, const float3& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+	float3 operator-(const float3& a) { return { -a.x, -a.y, -a.z }; }
+	float3 operator*(const float3& a, const float3& b) { return { a.x * b.x, a.y * b.y, a.z * b.z }; }
+	float3 operator*(const float3& a, float s) { return { a.x * s, a.y * s, a.z * s }; }
+	float dot(const float3& a, const float3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+	float length(const float3& a) { return sqrtf(dot(a, a)); }
+	float3 normalize(const float3& a) { return a * (1.0f / sqrtf(dot(a, a))); }
+	float3 reflect(const float3& i, const float3& n) { return i - n * (2.0f * dot(i, n)); }
+	float3 lerp(const float3& a, const float3& b, float s) { return a + (b - a) * s; }
+	float4 lerp(const float4& a, const float4& b, float s) { return { a.x + (b.x - a.x) * s, a.y + (b.y - a.y) * s, a.z + (b.z - a.z) * s, a.w + (b.w - a.w) * s }; }
+
+	// One pixel per lane : the scalar path of the batch versions, for the remainders and other CPUs.
+	struct scalar_lane
+	{
+		static constexpr size_t width{ 1 };
+		float v;
+		scalar_lane() = default;
+		scalar_lane(float value) : v{ value } {}
+		static scalar_lane load(const float* p) { return *p; }
+		void store(float* p) const { *p = v; }
+	};
+	inline scalar_lane operator+(scalar_lane a, scalar_lane b) { return a.v + b.v; }
+	inline scalar_lane operator-(scalar_lane a, scalar_lane b) { return a.v - b.v; }
+	inline scalar_lane operator-(scalar_lane a) { return -a.v; }
+	inline scalar_lane operator*(scalar_lane a, scalar_lane b) { return a.v * b.v; }
+	inline scalar_lane operator/(scalar_lane a, scalar_lane b) { return a.v / b.v; }
+	inline scalar_lane min(scalar_lane a, scalar_lane b) { return std::min(a.v, b.v); }
+	inline scalar_lane max(scalar_lane a, scalar_lane b) { return std::max(a.v, b.v); }
+	inline scalar_lane sqrt(scalar_lane a) { return sqrtf(a.v); }
+	inline scalar_lane pow(scalar_lane x, scalar_lane y) { return powf(x.v, y.v); }
+
+#ifdef SHADING_FUNCTIONS_X86
+	// log2(x) for x > 0 : x = m * 2^e with m in [sqrt(1/2), sqrt(2)), and the Cephes logf polynomial of m - 1.
+	inline __m128 log2_sse(__m128 x)
+	{
+		const __m128i bits{ _mm_castps_si128(x) };
+		__m128i e{ _mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127)) };
+		__m128 m{ _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007FFFFF)), _mm_set1_epi32(0x3F800000))) };
+		const __m128 large{ _mm_cmpgt_ps(m, _mm_set1_ps(1.41421356f)) };
+		m = _mm_sub_ps(m, _mm_and_ps(large, _mm_mul_ps(m, _mm_set1_ps(0.5f))));
+		e = _mm_sub_epi32(e, _mm_castps_si128(large));
+
+		const __m128 t{ _mm_sub_ps(m, _mm_set1_ps(1.0f)) };
+		const __m128 z{ _mm_mul_ps(t, t) };
+		__m128 p{ _mm_set1_ps(7.0376836292e-2f) };
+		for (float c : { -1.1514610310e-1f, 1.1676998740e-1f, -1.2420140846e-1f, 1.4249322787e-1f, -1.6668057665e-1f, 2.0000714765e-1f, -2.4999993993e-1f, 3.3333331174e-1f })
+		{
+			p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(c));
+		}
+		const __m128 ln{ _mm_add_ps(t, _mm_sub_ps(_mm_mul_ps(_mm_mul_ps(p, t), z), _mm_mul_ps(z, _mm_set1_ps(0.5f)))) };
+		return _mm_add_ps(_mm_mul_ps(ln, _mm_set1_ps(1.44269504f)), _mm_cvtepi32_ps(e));
+	}
+
+	// 2^x : 2^round(x) built in the exponent bits times the Cephes exp2f polynomial of the remainder in [-1/2, 1/2].
+	inline __m128 exp2_sse(__m128 x)
+	{
+		x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-126.0f)), _mm_set1_ps(127.0f));
+		const __m128i i{ _mm_cvtps_epi32(x) };
+		const __m128 f{ _mm_sub_ps(x, _mm_cvtepi32_ps(i)) };
+		__m128 p{ _mm_set1_ps(1.535336188319500e-4f) };
+		for (float c : { 1.339887440266574e-3f, 9.618437357674640e-3f, 5.550332471162809e-2f, 2.402264791363012e-1f, 6.931472028550421e-1f })
+		{
+			p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(c));
+		}
+		p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(1.0f));
+		return _mm_mul_ps(p, _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(i, _mm_set1_epi32(127)), 23)));
+	}
+
+	struct sse_lane
+	{
+		static constexpr size_t width{ 4 };
+		__m128 v;
+		sse_lane() = default;
+		sse_lane(__m128 value) : v{ value } {}
+		sse_lane(float value) : v{ _mm_set1_ps(value) } {}
+		static sse_lane load(const float* p) { return _mm_loadu_ps(p); }
+		void store(float* p) const { _mm_storeu_ps(p, v); }
+	};
+	inline sse_lane operator+(sse_lane a, sse_lane b) { return _mm_add_ps(a.v, b.v); }
+	inline sse_lane operator-(sse_lane a, sse_lane b) { return _mm_sub_ps(a.v, b.v); }
+	inline sse_lane operator-(sse_lane a) { return _mm_xor_ps(a.v, _mm_set1_ps(-0.0f)); }
+	inline sse_lane operator*(sse_lane a, sse_lane b) { return _mm_mul_ps(a.v, b.v); }
+	inline sse_lane operator/(sse_lane a, sse_lane b) { return _mm_div_ps(a.v, b.v); }
+	inline sse_lane min(sse_lane a, sse_lane b) { return _mm_min_ps(a.v, b.v); }
+	inline sse_lane max(sse_lane a, sse_lane b) { return _mm_max_ps(a.v, b.v); }
+	inline sse_lane sqrt(sse_lane a) { return _mm_sqrt_ps(a.v); }
+	// exp2(y * log2(x)) as the HLSL compiler emits it, and 0 where x <= 0.
+	inline sse_lane pow(sse_lane x, sse_lane y)
+	{
+		return _mm_and_ps(_mm_cmpgt_ps(x.v, _mm_setzero_ps()), exp2_sse(_mm_mul_ps(y.v, log2_sse(x.v))));
+	}
+
+	struct avx_lane
+	{
+		static constexpr size_t width{ 8 };
+		__m256 v;
+		avx_lane() = default;
+		AVX_FUNCTION avx_lane(__m256 value) : v{ value } {}
+		AVX_FUNCTION avx_lane(float value) : v{ _mm256_set1_ps(value) } {}
+		AVX_FUNCTION static avx_lane load(const float* p) { return _mm256_loadu_ps(p); }
+		AVX_FUNCTION void store(float* p) const { _mm256_storeu_ps(p, v); }
+	};
+	AVX_FUNCTION inline avx_lane operator+(avx_lane a, avx_lane b) { return _mm256_add_ps(a.v, b.v); }
+	AVX_FUNCTION inline avx_lane operator-(avx_lane a, avx_lane b) { return _mm256_sub_ps(a.v, b.v); }
+	AVX_FUNCTION inline avx_lane operator-(avx_lane a) { return _mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f)); }
+	AVX_FUNCTION inline avx_lane operator*(avx_lane a, avx_lane b) { return _mm256_mul_ps(a.v, b.v); }
+	AVX_FUNCTION inline avx_lane operator/(avx_lane a, avx_lane b) { return _mm256_div_ps(a.v, b.v); }
+	AVX_FUNCTION inline avx_lane min(avx_lane a, avx_lane b) { return _mm256_min_ps(a.v, b.v); }
+	AVX_FUNCTION inline avx_lane max(avx_lane a, avx_lane b) { return _mm256_max_ps(a.v, b.v); }
+	AVX_FUNCTION inline avx_lane sqrt(avx_lane a) { return _mm256_sqrt_ps(a.v); }
+	// AVX has no 256 bit integer instructions, so log2 and exp2 run on the two halves.
+	AVX_FUNCTION inline avx_lane pow(avx_lane x, avx_lane y)
+	{
+		const __m256 log2_x{ _mm256_insertf128_ps(_mm256_castps128_ps256(log2_sse(_mm256_castps256_ps128(x.v))), log2_sse(_mm256_extractf128_ps(x.v, 1)), 1) };
+		const __m256 exponent{ _mm256_mul_ps(y.v, log2_x) };
+		const __m256 exp2_exponent{ _mm256_insertf128_ps(_mm256_castps128_ps256(exp2_sse(_mm256_castps256_ps128(exponent))), exp2_sse(_mm256_extractf128_ps(exponent, 1)), 1) };
+		return _mm256_and_ps(_mm256_cmp_ps(x.v, _mm256_setzero_ps(), _CMP_GT_OQ), exp2_exponent);
+	}
+#endif
+
+	// The HLSL intrinsics on vectors of lanes, written once for every lane type.
+	template <class V> struct lane3 { V x, y, z; };
+	template <class V> struct lane4 { V x, y, z, w; };
+
+	template <class V> lane3<V> splat(const float3& a) { return { V(a.x), V(a.y), V(a.z) }; }
+	template <class V> lane4<V> splat(const float4& a) { return { V(a.x), V(a.y), V(a.z), V(a.w) }; }
+	template <class V> lane3<V> load(const float3_array& a, size_t i) { return { V::load(a.x + i), V::load(a.y + i), V::load(a.z + i) }; }
+	template <class V> lane4<V> load(const float4_array& a, size_t i) { return { V::load(a.x + i), V::load(a.y + i), V::load(a.z + i), V::load(a.w + i) }; }
+	template <class V> void store(const float3_array& a, size_t i, const lane3<V>& v) { v.x.store(a.x + i); v.y.store(a.y + i); v.z.store(a.z + i); }
+	template <class V> void store(const float4_array& a, size_t i, const lane4<V>& v) { v.x.store(a.x + i); v.y.store(a.y + i); v.z.store(a.z + i); v.w.store(a.w + i); }
+
+	template <class V> V saturate(V x) { return min(max(x, V(0.0f)), V(1.0f)); }
+	template <class V> lane3<V> operator+(const lane3<V>& a, const lane3<V>& b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+	template <class V> lane3<V> operator-(const lane3<V>& a, const lane3<V>& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+	template <class V> lane3<V> operator-(const lane3<V>& a) { return { -a.x, -a.y, -a.z }; }
+	template <class V> lane3<V> operator*(const lane3<V>& a, const lane3<V>& b) { return { a.x * b.x, a.y * b.y, a.z * b.z }; }
+	template <class V> lane3<V> operator*(const lane3<V>& a, const V& s) { return { a.x * s, a.y * s, a.z * s }; }
+	template <class V> V dot(const lane3<V>& a, const lane3<V>& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+	template <class V> V length(const lane3<V>& a) { return sqrt(dot(a, a)); }
+	template <class V> lane3<V> normalize(const lane3<V>& a) { return a * (V(1.0f) / sqrt(dot(a, a))); }
+	template <class V> lane3<V> reflect(const lane3<V>& i, const lane3<V>& n) { return i - n * (V(2.0f) * dot(i, n)); }
+	template <class V> lane3<V> lerp(const lane3<V>& a, const lane3<V>& b, const V& s) { return a + (b - a) * s; }
+	template <class V> lane4<V> lerp(const lane4<V>& a, const lane4<V>& b, const V& s) { return { a.x + (b.x - a.x) * s, a.y + (b.y - a.y) * s, a.z + (b.z - a.z) * s, a.w + (b.w - a.w) * s }; }
+
+	// Texture fetches go through the scalar samplers lane by lane.
+	enum class sampler { point_clamp, linear_wrap };
+	template <class V> lane4<V> sample(const shading_texture& texture, sampler s, const V& u, const V& v)
+	{
+		float us[V::width], vs[V::width], r[V::width], g[V::width], b[V::width], a[V::width];
+		u.store(us);
+		v.store(vs);
+		for (size_t k = 0; k < V::width; ++k)
+		{
+			const float4 texel{ s == sampler::point_clamp ? texture.sample_point_clamp(us[k], vs[k]) : texture.sample_linear_wrap(us[k], vs[k]) };
+			r[k] = texel.x;
+			g[k] = texel.y;
+			b[k] = texel.z;
+			a[k] = texel.w;
+		}
+		return { V::load(r), V::load(g), V::load(b), V::load(a) };
+	}
+
+	// shading_functions.hlsli on lanes.
+	template <class V> lane3<V> lambert(const lane3<V>& N, const lane3<V>& L, const lane3<V>& C, const lane3<V>& K)
+	{
+		const V power{ saturate(dot(N, -L)) };
+		return C * power * K;
+	}
+	template <class V> lane3<V> phong_specular(const lane3<V>& N, const lane3<V>& L, const lane3<V>& E, const lane3<V>& C, const lane3<V>& K)
+	{
+		const lane3<V> R{ reflect(L, N) };
+		V power{ max(dot(-E, R), V(0.0f)) };
+		// pow(power, 128) as seven squarings.
+		for (int i = 0; i < 7; ++i)
+		{
+			power = power * power;
+		}
+		return C * power * K;
+	}
+	template <class V> lane3<V> half_lambert(const lane3<V>& N, const lane3<V>& L, const lane3<V>& C, const lane3<V>& K)
+	{
+		const V D{ saturate(dot(N, -L) * V(0.5f) + V(0.5f)) };
+		return C * D * K;
+	}
+	template <class V> lane3<V> rim_light(const lane3<V>& N, const lane3<V>& E, const lane3<V>& L, const lane3<V>& C, const V& rim_power)
+	{
+		const V rim{ V(1.0f) - saturate(dot(N, -E)) };
+		return C * (pow(rim, rim_power) * saturate(dot(L, -E)));
+	}
+	template <class V> lane3<V> ramp_shading(const shading_texture& ramp, const lane3<V>& N, const lane3<V>& L, const lane3<V>& C, const lane3<V>& K)
+	{
+		const V D{ saturate(dot(N, -L) * V(0.5f) + V(0.5f)) };
+		const V ramp_value{ sample(ramp, sampler::point_clamp, D, V(0.5f)).x };
+		return C * ramp_value * K;
+	}
+	template <class V> lane3<V> sphere_environment(const shading_texture& environment, const lane3<V>& color, const lane3<V>& N, const lane3<V>& E, const V& value)
+	{
+		const lane3<V> R{ reflect(E, N) };
+		const lane4<V> texel{ sample(environment, sampler::linear_wrap, R.x * V(0.5f) + V(0.5f), R.y * V(0.5f) + V(0.5f)) };
+		return lerp(color, lane3<V>{ texel.x, texel.y, texel.z }, value);
+	}
+	template <class V> lane3<V> hemisphere_light(const lane3<V>& normal, const lane3<V>& up, const lane3<V>& sky_color, const lane3<V>& ground_color, const V& hemisphere_weight_x)
+	{
+		const V factor{ dot(normal, up) * V(0.5f) + V(0.5f) };
+		return lerp(ground_color, sky_color, factor) * hemisphere_weight_x;
+	}
+	template <class V> lane4<V> fog(const lane4<V>& color, const lane4<V>& fog_color, const float2& fog_range, const V& eye_length)
+	{
+		const V fog_alpha{ saturate((eye_length - V(fog_range.x)) / (V(fog_range.y) - V(fog_range.x))) };
+		return lerp(color, fog_color, fog_alpha);
+	}
+	// 'L' is the normalized light direction, the same for every pixel.
+	template <class V> lane4<V> phong(const phong_constants& c, const lane3<V>& L, const lane4<V>& diffuse_color, const lane3<V>& world_position, const lane3<V>& normal)
+	{
+		const lane3<V> to_pixel{ world_position - splat<V>(c.camera_position) };
+		const lane3<V> E{ normalize(to_pixel) };
+		const lane3<V> N{ normalize(normal) };
+		const lane3<V> light_color{ splat<V>(c.light_color) };
+
+		lane3<V> ambient{ splat<V>(c.ambient_color) * splat<V>(c.ka) };
+		ambient = ambient + hemisphere_light(N, splat<V>(float3{ 0.0f, 1.0f, 0.0f }), splat<V>(c.sky_color), splat<V>(c.ground_color), V(c.hemisphere_weight.x));
+		const lane3<V> directional_diffuse{ half_lambert(N, L, light_color, splat<V>(c.kd)) };
+		const lane3<V> directional_specular{ phong_specular(N, L, E, light_color, splat<V>(c.ks)) };
+		const lane3<V> rim_color{ rim_light(N, E, L, light_color, V(3.0f)) };
+
+		const lane3<V> rgb{ lane3<V>{ diffuse_color.x, diffuse_color.y, diffuse_color.z } * (ambient + directional_diffuse) + directional_specular + rim_color };
+		return fog(lane4<V>{ rgb.x, rgb.y, rgb.z, diffuse_color.w }, splat<V>(c.fog_color), c.fog_range, length(to_pixel));
+	}
+
+#ifdef SHADING_FUNCTIONS_X86
+	bool cpu_supports_avx()
+	{
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 1);
+		const bool osxsave{ (info[2] & (1 << 27)) != 0 };
+		const bool avx{ (info[2] & (1 << 28)) != 0 };
+		return osxsave && avx && (_xgetbv(0) & 6) == 6;
+#else
+		return __builtin_cpu_supports("avx");
+#endif
+	}
+#endif
+
+	std::atomic<shading_simd> selected_simd{ supported_shading_simd() };
+
+	// Calls 'kernel(V{}, i)' for the pixels [i, i + V::width) from 'first' while whole steps fit, and returns where it stopped.
+	template <class V, class Kernel> size_t shade_lanes(size_t first, size_t count, const Kernel& kernel)
+	{
+		size_t i{ first };
+		for (; i + V::width <= count; i += V::width)
+		{
+			kernel(V{}, i);
+		}
+		return i;
+	}
+#ifdef SHADING_FUNCTIONS_X86
+	template <class Kernel> AVX_LOOP_FUNCTION size_t shade_lanes_avx(size_t count, const Kernel& kernel)
+	{
+		return shade_lanes<avx_lane>(0, count, kernel);
+	}
+#endif
+	// The widest steps first, then narrower ones for the remainder.
+	template <class Kernel> void for_each_pixel(size_t count, const Kernel& kernel)
+	{
+		size_t i{ 0 };
+#ifdef SHADING_FUNCTIONS_X86
+		const shading_simd simd{ selected_simd.load(std::memory_order_relaxed) };
+		if (simd == shading_simd::avx)
+		{
+			i = shade_lanes_avx(count, kernel);
+		}
+		if (simd != shading_simd::scalar)
+		{
+			i = shade_lanes<sse_lane>(i, count, kernel);
+		}
+#endif
+		shade_lanes<scalar_lane>(i, count, kernel);
+	}
+}
+
+float4 shading_texture::sample_point_clamp(float u, float v) const
+{
+	if (texels.empty())
+	{
+		return { 0.0f, 0.0f, 0.0f, 0.0f };
+	}
+	const uint32_t x{ static_cast<uint32_t>(std::min(std::max(floorf(u * width), 0.0f), width - 1.0f)) };
+	const uint32_t y{ static_cast<uint32_t>(std::min(std::max(floorf(v * height), 0.0f), height - 1.0f)) };
+	const float* texel{ &texels[(static_cast<size_t>(y) * width + x) * 4] };
+	return { texel[0], texel[1], texel[2], texel[3] };
+}
+
+float4 shading_texture::sample_linear_wrap(float u, float v) const
+{
+	if (texels.empty())
+	{
+		return { 0.0f, 0.0f, 0.0f, 0.0f };
+	}
+	// Texel centers are at half integers; the four around the sample point, wrapped, weighted by distance.
+	const float tu{ u * width - 0.5f }, tv{ v * height - 0.5f };
+	const float fu{ floorf(tu) }, fv{ floorf(tv) };
+	const float wu{ tu - fu }, wv{ tv - fv };
+	auto wrap = [](float i, uint32_t size)
+	{
+		float m{ fmodf(i, static_cast<float>(size)) };
+		m += m < 0.0f ? size : 0.0f;
+		const uint32_t wrapped{ static_cast<uint32_t>(m) };
+		return wrapped < size ? wrapped : 0;
+	};
+	const uint32_t x0{ wrap(fu, width) }, y0{ wrap(fv, height) };
+	const uint32_t x1{ x0 + 1 < width ? x0 + 1 : 0 }, y1{ y0 + 1 < height ? y0 + 1 : 0 };
+	const float* t00{ &texels[(static_cast<size_t>(y0) * width + x0) * 4] };
+	const float* t10{ &texels[(static_cast<size_t>(y0) * width + x1) * 4] };
+	const float* t01{ &texels[(static_cast<size_t>(y1) * width + x0) * 4] };
+	const float* t11{ &texels[(static_cast<size_t>(y1) * width + x1) * 4] };
+	float result[4];
+	for (int k = 0; k < 4; ++k)
+	{
+		const float top{ t00[k] + (t10[k] - t00[k]) * wu };
+		const float bottom{ t01[k] + (t11[k] - t01[k]) * wu };
+		result[k] = top + (bottom - top) * wv;
+	}
+	return { result[0], result[1], result[2], result[3] };
+}
+
+float3 calc_lambert(const float3& N, const float3& L, const float3& C, const float3& K)
+{
+	const float power{ saturate(dot(N, -L)) };
+	return C * power * K;
+}
+
+float3 calc_phong_specular(const float3& N, const float3& L, const float3& E, const float3& C, const float3& K)
+{
+	const float3 R{ reflect(L, N) };
+	float power{ std::max(dot(-E, R), 0.0f) };
+	power = powf(power, 128.0f);
+	return C * power * K;
+}
+
+float3 calc_half_lambert(const float3& N, const float3& L, const float3& C, const float3& K)
+{
+	const float D{ saturate(dot(N, -L) * 0.5f + 0.5f) };
+	return C * D * K;
+}
+
+float3 calc_rim_light(const float3& N, const float3& E, const float3& L, const float3& C, float rim_power)
+{
+	const float rim{ 1.0f - saturate(dot(N, -E)) };
+	return C * (powf(rim, rim_power) * saturate(dot(L, -E)));
+}
+
+float3 calc_ramp_shading(const shading_texture& ramp, const float3& N, const float3& L, const float3& C, const float3& K)
+{
+	const float D{ saturate(dot(N, -L) * 0.5f + 0.5f) };
+	const float ramp_value{ ramp.sample_point_clamp(D, 0.5f).x };
+	return C * ramp_value * K;
+}
+
+float3 calc_sphere_environment(const shading_texture& environment, const float3& color, const float3& N, const float3& E, float value)
+{
+	const float3 R{ reflect(E, N) };
+	const float4 texel{ environment.sample_linear_wrap(R.x * 0.5f + 0.5f, R.y * 0.5f + 0.5f) };
+	return lerp(color, float3{ texel.x, texel.y, texel.z }, value);
+}
+
+float3 calc_hemisphere_light(const float3& normal, const float3& up, const float3& sky_color, const float3& ground_color, const float4& hemisphere_weight)
+{
+	const float factor{ dot(normal, up) * 0.5f + 0.5f };
+	return lerp(ground_color, sky_color, factor) * hemisphere_weight.x;
+}
+
+float4 calc_fog(const float4& color, const float4& fog_color, const float2& fog_range, float eye_length)
+{
+	const float fog_alpha{ saturate((eye_length - fog_range.x) / (fog_range.y - fog_range.x)) };
+	return lerp(color, fog_color, fog_alpha);
+}
+
+float4 shade_phong(const phong_constants& c, const float4& diffuse_color, const float3& world_position, const float3& normal)
+{
+	const float3 E{ normalize(world_position - c.camera_position) };
+	const float3 L{ normalize(c.light_direction) };
+	const float3 N{ normalize(normal) };
+
+	float3 ambient{ c.ambient_color * c.ka };
+	ambient = ambient + calc_hemisphere_light(N, float3{ 0.0f, 1.0f, 0.0f }, c.sky_color, c.ground_color, c.hemisphere_weight);
+	const float3 directional_diffuse{ calc_half_lambert(N, L, c.light_color, c.kd) };
+	const float3 directional_specular{ calc_phong_specular(N, L, E, c.light_color, c.ks) };
+	const float3 rim_color{ calc_rim_light(N, E, L, c.light_color) };
+
+	const float3 rgb{ float3{ diffuse_color.x, diffuse_color.y, diffuse_color.z } * (ambient + directional_diffuse) + directional_specular + rim_color };
+	return calc_fog(float4{ rgb.x, rgb.y, rgb.z, diffuse_color.w }, c.fog_color, c.fog_range, length(world_position - c.camera_position));
+}
+
+void calc_lambert(size_t count, const float3_array& N, const float3& L, const float3& C, const float3& K, const float3_array& result)
+{
+	for_each_pixel(count, [&](auto lane, size_t i)
+	{
+		using V = decltype(lane);
+		store(result, i, lambert(load<V>(N, i), splat<V>(L), splat<V>(C), splat<V>(K)));
+	});
+}
+
+void calc_phong_specular(size_t count, const float3_array& N, const float3& L, const float3_array& E, const float3& C, const float3& K, const float3_array& result)
+{
+	for_each_pixel(count, [&](auto lane, size_t i)
+	{
+		using V = decltype(lane);
+		store(result, i, phong_specular(load<V>(N, i), splat<V>(L), load<V>(E, i), splat<V>(C), splat<V>(K)));
+	});
+}
+
+void calc_half_lambert(size_t count, const float3_array& N, const float3& L, const float3& C, const float3& K, const float3_array& result)
+{
+	for_each_pixel(count, [&](auto lane, size_t i)
+	{
+		using V = decltype(lane);
+		store(result, i, half_lambert(load<V>(N, i), splat<V>(L), splat<V>(C), splat<V>(K)));
+	});
+}
+
+void calc_rim_light(size_t count, const float3_array& N, const float3_array& E, const float3& L, const float3& C, float rim_power, const float3_array& result)
+{
+	for_each_pixel(count, [&](auto lane, size_t i)
+	{
+		using V = decltype(lane);
+		store(result, i, rim_light(load<V>(N, i), load<V>(E, i), splat<V>(L), splat<V>(C), V(rim_power)));
+	});
+}
+
+void calc_ramp_shading(size_t count, const shading_texture& ramp, const float3_array& N, const float3& L, const float3& C, const float3& K, const float3_array& result)
+{
+	for_each_pixel(count, [&](auto lane, size_t i)
+	{
+		using V = decltype(lane);
+		store(result, i, ramp_shading(ramp, load<V>(N, i), splat<V>(L), splat<V>(C), splat<V>(K)));
+	});
+}
+
+void calc_sphere_environment(size_t count, const shading_texture& environment, const float3_array& color, const float3_array& N, const float3_array& E, float value, const float3_array& result)
+{
+	for_each_pixel(count, [&](auto lane, size_t i)
+	{
+		using V = decltype(lane);
+		store(result, i, sphere_environment(environment, load<V>(color, i), load<V>(N, i), load<V>(E, i), V(value)));
+	});
+}
+
+void calc_hemisphere_light(size_t count, const float3_array& normal, const float3& up, const float3& sky_color, const float3& ground_color, const float4& hemisphere_weight, const float3_array& result)
+{
+	for_each_pixel(count, [&](auto lane, size_t i)
+	{
+		using V = decltype(lane);
+		store(result, i, hemisphere_light(load<V>(normal, i), splat<V>(up), splat<V>(sky_color), splat<V>(ground_color), V(hemisphere_weight.x)));
+	});
+}
+
+void calc_fog(size_t count, const float4_array& color, const float4& fog_color, const float2& fog_range, const float* eye_length, const float4_array& result)
+{
+	for_each_pixel(count, [&](auto lane, size_t i)
+	{
+		using V = decltype(lane);
+		store(result, i, fog(load<V>(color, i), splat<V>(fog_color), fog_range, V::load(eye_length + i)));
+	});
+}
+
+void shade_phong(size_t count, const phong_constants& constants, const float4_array& diffuse_color, const float3_array& world_position, const float3_array& normal, const float4_array& result)
+{
+	const float3 L{ normalize(constants.light_direction) };
+	for_each_pixel(count, [&](auto lane, size_t i)
+	{
+		using V = decltype(lane);
+		store(result, i, phong(constants, splat<V>(L), load<V>(diffuse_color, i), load<V>(world_position, i), load<V>(normal, i)));
+	});
+}
+
+shading_simd supported_shading_simd()
+{
+#ifdef SHADING_FUNCTIONS_X86
+	static const bool avx{ cpu_supports_avx() };
+	return avx ? shading_simd::avx : shading_simd::sse;
+#else
+	return shading_simd::scalar;
+#endif
+}
+
+shading_simd set_shading_simd(shading_simd simd)
+{
+	const shading_simd used{ std::min(simd, supported_shading_simd()) };
+	selected_simd.store(used, std::memory_order_relaxed);
+	return used;
+}
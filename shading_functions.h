@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// C++ port of shading_functions.hlsli, so that CPU renderers and offline bakers light pixels exactly as
+// phong_shader_ps does. Every HLSL function has a scalar reference taking the same arguments, and a batch version
+// shading 'count' pixels stored as structure of arrays : 8 pixels per step with AVX, 4 with SSE, and the remainder
+// (or everything on other CPUs) one at a time. The batch versions agree with the references to about 1e-5 : they
+// use the same formulas, but pow is evaluated with polynomial approximations of log2 and exp2.
+
+struct float2 { float x, y; };
+struct float3 { float x, y, z; };
+struct float4 { float x, y, z, w; };
+
+// Top mip level of a texture as RGBA floats, with the two samplers the shaders use.
+struct shading_texture
+{
+	uint32_t width{ 0 };
+	uint32_t height{ 0 };
+	std::vector<float> texels;	// width * height * 4, rows from the top
+
+	// ramp_sampler_state of framework : D3D11_FILTER_MIN_MAG_MIP_POINT, D3D11_TEXTURE_ADDRESS_CLAMP.
+	float4 sample_point_clamp(float u, float v) const;
+	// sampler_state of framework : D3D11_FILTER_MIN_MAG_MIP_LINEAR, D3D11_TEXTURE_ADDRESS_WRAP, on the top level only.
+	float4 sample_linear_wrap(float u, float v) const;
+};
+
+// Scalar references. Argument names and meanings are those of shading_functions.hlsli.
+float3 calc_lambert(const float3& N, const float3& L, const float3& C, const float3& K);
+float3 calc_phong_specular(const float3& N, const float3& L, const float3& E, const float3& C, const float3& K);
+float3 calc_half_lambert(const float3& N, const float3& L, const float3& C, const float3& K);
+float3 calc_rim_light(const float3& N, const float3& E, const float3& L, const float3& C, float rim_power = 3.0f);
+float3 calc_ramp_shading(const shading_texture& ramp, const float3& N, const float3& L, const float3& C, const float3& K);
+float3 calc_sphere_environment(const shading_texture& environment, const float3& color, const float3& N, const float3& E, float value);
+float3 calc_hemisphere_light(const float3& normal, const float3& up, const float3& sky_color, const float3& ground_color, const float4& hemisphere_weight);
+float4 calc_fog(const float4& color, const float4& fog_color, const float2& fog_range, float eye_length);
+
+// The constant buffers phong_shader_ps reads.
+struct phong_constants
+{
+	float3 camera_position;
+	float3 light_direction;	// directional_light_direction, normalized by the shader
+	float3 light_color;
+	float3 ambient_color;
+	float3 ka, kd, ks;
+	float3 sky_color, ground_color;
+	float4 hemisphere_weight;
+	float4 fog_color;
+	float2 fog_range;
+};
+// phong_shader_ps after its texture fetches : 'normal' is the world space normal after normal mapping.
+float4 shade_phong(const phong_constants& constants, const float4& diffuse_color, const float3& world_position, const float3& normal);
+
+// 'count' vectors as one array per component. Batch inputs are read and outputs written element by element, so an
+// output may alias an input.
+struct float3_array { float* x; float* y; float* z; };
+struct float4_array { float* x; float* y; float* z; float* w; };
+
+// Batch versions. Arguments that are arrays vary per pixel, the others are shared by all pixels as in the shaders.
+void calc_lambert(size_t count, const float3_array& N, const float3& L, const float3& C, const float3& K, const float3_array& result);
+void calc_phong_specular(size_t count, const float3_array& N, const float3& L, const float3_array& E, const float3& C, const float3& K, const float3_array& result);
+void calc_half_lambert(size_t count, const float3_array& N, const float3& L, const float3& C, const float3& K, const float3_array& result);
+void calc_rim_light(size_t count, const float3_array& N, const float3_array& E, const float3& L, const float3& C, float rim_power, const float3_array& result);
+void calc_ramp_shading(size_t count, const shading_texture& ramp, const float3_array& N, const float3& L, const float3& C, const float3& K, const float3_array& result);
+void calc_sphere_environment(size_t count, const shading_texture& environment, const float3_array& color, const float3_array& N, const float3_array& E, float value, const float3_array& result);
+void calc_hemisphere_light(size_t count, const float3_array& normal, const float3& up, const float3& sky_color, const float3& ground_color, const float4& hemisphere_weight, const float3_array& result);
+void calc_fog(size_t count, const float4_array& color, const float4& fog_color, const float2& fog_range, const float* eye_length, const float4_array& result);
+void shade_phong(size_t count, const phong_constants& constants, const float4_array& diffuse_color, const float3_array& world_position, const float3_array& normal, const float4_array& result);
+
+// Instruction sets of the batch versions. They use the widest one the CPU supports unless limited to a narrower
+// one, e.g. to compare the paths.
+enum class shading_simd { scalar, sse, avx };
+shading_simd supported_shading_simd();
+// Limits the batch versions to 'simd' (or to the supported set if that is narrower) and returns the set now used.
+shading_simd set_shading_simd(shading_simd simd);
@@ -0,0 +1,483 @@
+#include "software_rasterizer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <future>
+#include <thread>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SOFTWARE_RASTERIZER_X86
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	// Runs 'work' on 'worker_count' threads, the calling thread included, and waits for all of them.
+	void run_workers(size_t worker_count, const std::function<void()>& work)
+	{
+		std::vector<std::future<void>> workers;
+		for (size_t w = 1; w < worker_count; ++w)
+		{
+			workers.push_back(std::async(std::launch::async, work));
+		}
+		work();
+		for (std::future<void>& worker : workers)
+		{
+			worker.get();
+		}
+	}
+
+	// c = a * b for row-major 4x4 matrices applied as 'float4(p, 1) * m'.
+	void multiply(const float a[16], const float b[16], float c[16])
+	{
+		for (int r = 0; r < 4; ++r)
+		{
+			for (int k = 0; k < 4; ++k)
+			{
+				c[r * 4 + k] = a[r * 4 + 0] * b[0 * 4 + k] + a[r * 4 + 1] * b[1 * 4 + k] + a[r * 4 + 2] * b[2 * 4 + k] + a[r * 4 + 3] * b[3 * 4 + k];
+			}
+		}
+	}
+
+	struct clip_vertex
+	{
+		float x, y, z, w;
+	};
+
+	uint32_t pack_color(const float color[4], float intensity)
+	{
+		uint32_t packed{ 0 };
+		for (int k = 0; k < 4; ++k)
+		{
+			const float value{ k < 3 ? color[k] * intensity : color[k] };
+			packed |= static_cast<uint32_t>(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f) << (k * 8);
+		}
+		return packed;
+	}
+}
+
+software_rasterizer::software_rasterizer(uint32_t width, uint32_t height, uint32_t tile_size, size_t thread_count) :
+	target_width(width), target_height(height), target_pitch((width + 3) & ~3u),
+	// Tiles are a multiple of the 4 pixel steps, so that no step reads or writes pixels of a neighbouring tile.
+	tile_size(std::max(4u, (tile_size + 3) & ~3u)),
+	thread_count(thread_count > 0 ? thread_count : std::max(1u, std::thread::hardware_concurrency()))
+{
+	tiles_x = (target_width + this->tile_size - 1) / this->tile_size;
+	tiles_y = (target_height + this->tile_size - 1) / this->tile_size;
+	colors.resize(static_cast<size_t>(target_pitch) * target_height);
+	depths.resize(static_cast<size_t>(target_pitch) * target_height);
+}
+
+void software_rasterizer::clear(uint32_t color, float depth)
+{
+	std::fill(colors.begin(), colors.end(), color);
+	std::fill(depths.begin(), depths.end(), depth);
+	for (size_t c = 0; c < chunk_count; ++c)
+	{
+		chunks[c].triangles.clear();
+		for (std::vector<uint32_t>& tile : chunks[c].tiles)
+		{
+			tile.clear();
+		}
+	}
+	chunk_count = 0;
+	counts = {};
+}
+
+void software_rasterizer::set_light(const float direction[3], float ambient)
+{
+	const float length{ sqrtf(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]) };
+	for (int k = 0; k < 3; ++k)
+	{
+		light_direction[k] = length > 0.0f ? direction[k] / length : 0.0f;
+	}
+	this->ambient = ambient;
+}
+
+void software_rasterizer::draw(const raster_mesh& mesh, const float world[16], const float view_projection[16])
+{
+	float world_view_projection[16];
+	multiply(world, view_projection, world_view_projection);
+
+	// Normals are transformed by the cofactor matrix of the upper 3x3 of 'world' (the inverse transpose times the
+	// determinant), negated when the determinant is negative so that they keep pointing out of the front faces.
+	const float* m{ world };
+	float normal_matrix[9]
+	{
+		m[5] * m[10] - m[6] * m[9], m[6] * m[8] - m[4] * m[10], m[4] * m[9] - m[5] * m[8],
+		m[2] * m[9] - m[1] * m[10], m[0] * m[10] - m[2] * m[8], m[1] * m[8] - m[0] * m[9],
+		m[1] * m[6] - m[2] * m[5], m[2] * m[4] - m[0] * m[6], m[0] * m[5] - m[1] * m[4],
+	};
+	const float determinant{ m[0] * normal_matrix[0] + m[1] * normal_matrix[1] + m[2] * normal_matrix[2] };
+	if (determinant < 0.0f)
+	{
+		for (float& e : normal_matrix)
+		{
+			e = -e;
+		}
+	}
+
+	// Vertices to clip space, in parallel slices.
+	const size_t vertex_count{ mesh.positions.size() / 3 };
+	clip_positions.resize(vertex_count * 4);
+	const size_t vertex_workers{ std::min(thread_count, 1 + vertex_count / 16384) };
+	std::atomic<size_t> next_slice{ 0 };
+	run_workers(vertex_workers, [&]()
+	{
+		for (size_t s = next_slice++; s < vertex_workers; s = next_slice++)
+		{
+			const size_t last{ vertex_count * (s + 1) / vertex_workers };
+			for (size_t v = vertex_count * s / vertex_workers; v < last; ++v)
+			{
+				const float* p{ &mesh.positions[v * 3] };
+				for (int k = 0; k < 4; ++k)
+				{
+					clip_positions[v * 4 + k] = p[0] * world_view_projection[0 * 4 + k] + p[1] * world_view_projection[1 * 4 + k] + p[2] * world_view_projection[2 * 4 + k] + world_view_projection[3 * 4 + k];
+				}
+			}
+		}
+	});
+
+	// Triangles to tile bins, in chunks of fixed size so that the binning order is the submission order whatever
+	// the thread count.
+	draw_first_triangles.clear();
+	uint32_t triangle_count{ 0 };
+	for (const raster_mesh::draw& d : mesh.draws)
+	{
+		draw_first_triangles.push_back(triangle_count);
+		triangle_count += d.index_count / 3;
+	}
+	draw_first_triangles.push_back(triangle_count);
+
+	const size_t new_chunks{ (triangle_count + triangles_per_chunk - 1) / triangles_per_chunk };
+	const size_t first_chunk{ chunk_count };
+	chunk_count += new_chunks;
+	if (chunks.size() < chunk_count)
+	{
+		chunks.resize(chunk_count);
+	}
+	std::atomic<size_t> next_chunk{ 0 };
+	run_workers(std::min(thread_count, new_chunks), [&]()
+	{
+		for (size_t c = next_chunk++; c < new_chunks; c = next_chunk++)
+		{
+			const uint32_t first{ static_cast<uint32_t>(c * triangles_per_chunk) };
+			set_up_chunk(mesh, normal_matrix, first, std::min(triangle_count, first + triangles_per_chunk), chunks[first_chunk + c]);
+		}
+	});
+	for (size_t c = first_chunk; c < chunk_count; ++c)
+	{
+		counts.triangles += chunks[c].counts.triangles;
+		counts.culled += chunks[c].counts.culled;
+		counts.clipped += chunks[c].counts.clipped;
+		counts.binned += chunks[c].counts.binned;
+	}
+}
+
+void software_rasterizer::set_up_chunk(const raster_mesh& mesh, const float normal_matrix[9], uint32_t first_triangle, uint32_t last_triangle, chunk& output) const
+{
+	output.counts = {};
+	output.tiles.resize(static_cast<size_t>(tiles_x) * tiles_y);
+	const clip_vertex* clip{ reinterpret_cast<const clip_vertex*>(clip_positions.data()) };
+	const float half_width{ target_width * 0.5f }, half_height{ target_height * 0.5f };
+	// Clip space extent of the guard band : snapped coordinates relative to the target center stay within
+	// +-guard_band_pixels, so that the edge functions fit in 32 bit integers.
+	const float guard_x{ guard_band_pixels / half_width }, guard_y{ guard_band_pixels / half_height };
+
+	// Screen space setup of one triangle inside the guard band, binned into every tile its bounds overlap.
+	// Returns false if it is back facing, without area or outside the target.
+	auto emit = [&](const clip_vertex& v0, const clip_vertex& v1, const clip_vertex& v2, uint32_t color)
+	{
+		const clip_vertex* v[3]{ &v0, &v1, &v2 };
+		int32_t sx[3], sy[3];	// 1 / subpixel_steps pixel units, relative to the target center
+		float z[3];
+		for (int k = 0; k < 3; ++k)
+		{
+			if (!(v[k]->w > 0.0f))
+			{
+				return false;
+			}
+			const float inverse_w{ 1.0f / v[k]->w };
+			sx[k] = static_cast<int32_t>(lrintf(v[k]->x * inverse_w * half_width * subpixel_steps));
+			sy[k] = static_cast<int32_t>(lrintf(-v[k]->y * inverse_w * half_height * subpixel_steps));
+			z[k] = v[k]->z * inverse_w;
+		}
+		// Clockwise on screen (y down) is a positive area : front facing. Exact, like the edge functions.
+		const int32_t area{ (sx[1] - sx[0]) * (sy[2] - sy[0]) - (sy[1] - sy[0]) * (sx[2] - sx[0]) };
+		if (area <= 0)
+		{
+			return false;
+		}
+
+		triangle t;
+		const int32_t center_x{ static_cast<int32_t>(target_width) * subpixel_steps / 2 }, center_y{ static_cast<int32_t>(target_height) * subpixel_steps / 2 };
+		t.min_x = std::max(0, (std::min({ sx[0], sx[1], sx[2] }) + center_x) / subpixel_steps);
+		t.min_y = std::max(0, (std::min({ sy[0], sy[1], sy[2] }) + center_y) / subpixel_steps);
+		t.max_x = std::min(static_cast<int32_t>(target_width) - 1, (std::max({ sx[0], sx[1], sx[2] }) + center_x) / subpixel_steps);
+		t.max_y = std::min(static_cast<int32_t>(target_height) - 1, (std::max({ sy[0], sy[1], sy[2] }) + center_y) / subpixel_steps);
+		if (t.min_x > t.max_x || t.min_y > t.max_y)
+		{
+			return false;
+		}
+		// Edge k is the one opposite vertex k, from vertex k + 1 to vertex k + 2 :
+		// e(p) = (xj - xi) * (py - yi) - (yj - yi) * (px - xi), exact and within 32 bits inside the guard band.
+		// Rewritten as a * x + b * y + c for the pixel (x, y), whose center is (x + 0.5, y + 0.5) - center, with
+		// unsigned wrapping arithmetic : the intermediate terms may overflow but the sum does not.
+		// Edges that are not top or left lose the pixels exactly on them : e - 1 >= 0 there instead of e >= 0.
+		for (int k = 0; k < 3; ++k)
+		{
+			const int i{ (k + 1) % 3 }, j{ (k + 2) % 3 };
+			const int32_t dx{ sx[j] - sx[i] }, dy{ sy[j] - sy[i] };
+			const bool top_left{ dy < 0 || (dy == 0 && dx > 0) };
+			const uint32_t origin_x{ static_cast<uint32_t>(subpixel_steps / 2 - center_x - sx[i]) };
+			const uint32_t origin_y{ static_cast<uint32_t>(subpixel_steps / 2 - center_y - sy[i]) };
+			t.edge_a[k] = static_cast<uint32_t>(-dy) * subpixel_steps;
+			t.edge_b[k] = static_cast<uint32_t>(dx) * subpixel_steps;
+			t.edge_c[k] = static_cast<uint32_t>(dx) * origin_y - static_cast<uint32_t>(dy) * origin_x - (top_left ? 0 : 1);
+		}
+		// z = z0 + (z1 - z0) * l1 + (z2 - z0) * l2 with the barycentric l1, l2 = e1, e2 / area, as a plane over the
+		// pixel centers.
+		const float inverse_area{ 1.0f / area };
+		const float dz1{ (z[1] - z[0]) * inverse_area }, dz2{ (z[2] - z[0]) * inverse_area };
+		const float x0{ static_cast<float>(sx[0]) / subpixel_steps + half_width }, y0{ static_cast<float>(sy[0]) / subpixel_steps + half_height };
+		// In pixels : de1 / dx = -(y0 - y2) and de2 / dx = -(y1 - y0), de1 / dy = x0 - x2 and de2 / dy = x1 - x0.
+		t.z_a = (dz1 * (sy[2] - sy[0]) + dz2 * (sy[0] - sy[1])) * subpixel_steps;
+		t.z_b = (dz1 * (sx[0] - sx[2]) + dz2 * (sx[1] - sx[0])) * subpixel_steps;
+		t.z_c = z[0] - t.z_a * x0 - t.z_b * y0;
+		t.color = color;
+
+		const uint32_t index{ static_cast<uint32_t>(output.triangles.size()) };
+		output.triangles.push_back(t);
+		for (uint32_t ty = t.min_y / tile_size; ty <= t.max_y / tile_size; ++ty)
+		{
+			for (uint32_t tx = t.min_x / tile_size; tx <= t.max_x / tile_size; ++tx)
+			{
+				output.tiles[ty * tiles_x + tx].push_back(index);
+				++output.counts.binned;
+			}
+		}
+		return true;
+	};
+
+	size_t draw_index{ static_cast<size_t>(std::upper_bound(draw_first_triangles.begin(), draw_first_triangles.end(), first_triangle) - draw_first_triangles.begin()) - 1 };
+	for (uint32_t triangle_index = first_triangle; triangle_index < last_triangle; ++triangle_index)
+	{
+		while (triangle_index >= draw_first_triangles[draw_index + 1])
+		{
+			++draw_index;
+		}
+		const raster_mesh::draw& d{ mesh.draws[draw_index] };
+		const uint32_t* indices{ &mesh.indices[d.first_index + (triangle_index - draw_first_triangles[draw_index]) * 3] };
+		const clip_vertex v[3]{ clip[indices[0]], clip[indices[1]], clip[indices[2]] };
+		++output.counts.triangles;
+
+		// Distances to the planes -w <= x, y <= w, 0 <= z <= w, then to the guard band planes.
+		auto distance = [&](const clip_vertex& p, int plane)
+		{
+			switch (plane)
+			{
+			case 0: return p.w + p.x;
+			case 1: return p.w - p.x;
+			case 2: return p.w + p.y;
+			case 3: return p.w - p.y;
+			case 4: return p.z;
+			case 5: return p.w - p.z;
+			case 6: return guard_x * p.w + p.x;
+			case 7: return guard_x * p.w - p.x;
+			case 8: return guard_y * p.w + p.y;
+			default: return guard_y * p.w - p.y;
+			}
+		};
+		// Bit n set for each plane n the vertex is behind.
+		auto outcode = [&](const clip_vertex& p)
+		{
+			uint32_t code{ 0 };
+			for (int plane = 0; plane < 10; ++plane)
+			{
+				code |= (distance(p, plane) < 0.0f ? 1u : 0u) << plane;
+			}
+			return code;
+		};
+		const uint32_t codes[3]{ outcode(v[0]), outcode(v[1]), outcode(v[2]) };
+		if ((codes[0] & codes[1] & codes[2] & 0x3F) != 0)
+		{
+			++output.counts.culled;
+			continue;
+		}
+
+		// Flat shading from the object space face normal.
+		const float* p0{ &mesh.positions[indices[0] * 3] };
+		const float* p1{ &mesh.positions[indices[1] * 3] };
+		const float* p2{ &mesh.positions[indices[2] * 3] };
+		const float e1[3]{ p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+		const float e2[3]{ p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+		const float face[3]{ e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+		auto shade = [&]()
+		{
+			float normal[3];
+			for (int k = 0; k < 3; ++k)
+			{
+				normal[k] = face[0] * normal_matrix[0 * 3 + k] + face[1] * normal_matrix[1 * 3 + k] + face[2] * normal_matrix[2 * 3 + k];
+			}
+			const float length{ sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]) };
+			const float diffuse{ length > 0.0f ? std::max(0.0f, -(normal[0] * light_direction[0] + normal[1] * light_direction[1] + normal[2] * light_direction[2]) / length) : 0.0f };
+			return pack_color(d.color, ambient + (1.0f - ambient) * diffuse);
+		};
+
+		// The near plane and the guard band planes ; the far plane is left to the depth test.
+		const bool inside_guard_band{ ((codes[0] | codes[1] | codes[2]) & 0x3D0) == 0 };
+		if (inside_guard_band)
+		{
+			// Back faces are the common case of culling : shading waits until the triangle is known to be kept.
+			if (!emit(v[0], v[1], v[2], 0))
+			{
+				++output.counts.culled;
+				continue;
+			}
+			output.triangles.back().color = shade();
+			continue;
+		}
+		// Clip against the near plane and the guard band, then draw the polygon as a fan.
+		++output.counts.clipped;
+		clip_vertex polygon[2][9];
+		int polygon_size{ 3 };
+		std::copy(v, v + 3, polygon[0]);
+		int current{ 0 };
+		for (int plane = 4; plane < 10 && polygon_size > 0; ++plane)
+		{
+			if (plane == 5)
+			{
+				continue;
+			}
+			int clipped_size{ 0 };
+			for (int k = 0; k < polygon_size; ++k)
+			{
+				const clip_vertex& a{ polygon[current][k] };
+				const clip_vertex& b{ polygon[current][(k + 1) % polygon_size] };
+				const float da{ distance(a, plane) }, db{ distance(b, plane) };
+				if (da >= 0.0f)
+				{
+					polygon[1 - current][clipped_size++] = a;
+				}
+				if ((da >= 0.0f) != (db >= 0.0f))
+				{
+					const float s{ da / (da - db) };
+					polygon[1 - current][clipped_size++] = { a.x + (b.x - a.x) * s, a.y + (b.y - a.y) * s, a.z + (b.z - a.z) * s, a.w + (b.w - a.w) * s };
+				}
+			}
+			polygon_size = clipped_size;
+			current = 1 - current;
+		}
+		const uint32_t color{ polygon_size >= 3 ? shade() : 0 };
+		bool kept{ false };
+		for (int k = 2; k < polygon_size; ++k)
+		{
+			kept = emit(polygon[current][0], polygon[current][k - 1], polygon[current][k], color) || kept;
+		}
+		if (!kept)
+		{
+			++output.counts.culled;
+		}
+	}
+}
+
+void software_rasterizer::resolve()
+{
+	const uint32_t tile_count{ tiles_x * tiles_y };
+	std::atomic<uint32_t> next_tile{ 0 };
+	run_workers(std::min<size_t>(thread_count, tile_count), [&]()
+	{
+		for (uint32_t tile = next_tile++; tile < tile_count; tile = next_tile++)
+		{
+			rasterize_tile(tile);
+		}
+	});
+}
+
+void software_rasterizer::rasterize_tile(uint32_t tile)
+{
+	const int32_t tile_x0{ static_cast<int32_t>((tile % tiles_x) * tile_size) };
+	const int32_t tile_y0{ static_cast<int32_t>((tile / tiles_x) * tile_size) };
+	const int32_t tile_x1{ std::min(tile_x0 + static_cast<int32_t>(tile_size), static_cast<int32_t>(target_width)) - 1 };
+	const int32_t tile_y1{ std::min(tile_y0 + static_cast<int32_t>(tile_size), static_cast<int32_t>(target_height)) - 1 };
+
+	for (size_t c = 0; c < chunk_count; ++c)
+	{
+		const chunk& source{ chunks[c] };
+		for (uint32_t index : source.tiles[tile])
+		{
+			const triangle& t{ source.triangles[index] };
+			// Steps start on a multiple of 4 pixels : tile_x0 is one, so no step leaves the tile.
+			const int32_t x0{ std::max(t.min_x, tile_x0) & ~3 };
+			const int32_t x1{ std::min(t.max_x, tile_x1) };
+			const int32_t y0{ std::max(t.min_y, tile_y0) };
+			const int32_t y1{ std::min(t.max_y, tile_y1) };
+#ifdef SOFTWARE_RASTERIZER_X86
+			const __m128 lane_offsets{ _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f) };
+			const __m128i lane_indices{ _mm_set_epi32(3, 2, 1, 0) };
+			const __m128 color{ _mm_castsi128_ps(_mm_set1_epi32(static_cast<int>(t.color))) };
+			__m128i edge_lanes[3], edge_step[3];
+			for (int k = 0; k < 3; ++k)
+			{
+				const uint32_t a{ t.edge_a[k] };
+				edge_lanes[k] = _mm_set_epi32(static_cast<int>(a * 3), static_cast<int>(a * 2), static_cast<int>(a), 0);
+				edge_step[k] = _mm_set1_epi32(static_cast<int>(a * 4));
+			}
+			const __m128 z_a{ _mm_set1_ps(t.z_a) };
+			for (int32_t y = y0; y <= y1; ++y)
+			{
+				__m128i edge[3];
+				for (int k = 0; k < 3; ++k)
+				{
+					edge[k] = _mm_add_epi32(edge_lanes[k], _mm_set1_epi32(static_cast<int>(t.edge_a[k] * static_cast<uint32_t>(x0) + t.edge_b[k] * static_cast<uint32_t>(y) + t.edge_c[k])));
+				}
+				const __m128 z_row{ _mm_set1_ps(t.z_b * (y + 0.5f) + t.z_c) };
+				float* depth_row{ &depths[static_cast<size_t>(y) * target_pitch] };
+				uint32_t* color_row{ &colors[static_cast<size_t>(y) * target_pitch] };
+				for (int32_t x = x0; x <= x1; x += 4)
+				{
+					// A pixel is inside when no edge function is negative. Lanes right of x1 are masked out; they
+					// still belong to the tile.
+					const __m128i outside{ _mm_or_si128(_mm_or_si128(edge[0], edge[1]), _mm_or_si128(edge[2], _mm_cmpgt_epi32(lane_indices, _mm_set1_epi32(x1 - x)))) };
+					for (int k = 0; k < 3; ++k)
+					{
+						edge[k] = _mm_add_epi32(edge[k], edge_step[k]);
+					}
+					__m128 mask{ _mm_castsi128_ps(_mm_srai_epi32(outside, 31)) };
+					if (_mm_movemask_ps(mask) == 0xF)
+					{
+						continue;
+					}
+					const __m128 z{ _mm_add_ps(_mm_mul_ps(z_a, _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), lane_offsets)), z_row) };
+					const __m128 depth{ _mm_loadu_ps(depth_row + x) };
+					mask = _mm_andnot_ps(mask, _mm_cmplt_ps(z, depth));
+					_mm_storeu_ps(depth_row + x, _mm_or_ps(_mm_and_ps(mask, z), _mm_andnot_ps(mask, depth)));
+					const __m128 old_color{ _mm_loadu_ps(reinterpret_cast<const float*>(color_row + x)) };
+					_mm_storeu_ps(reinterpret_cast<float*>(color_row + x), _mm_or_ps(_mm_and_ps(mask, color), _mm_andnot_ps(mask, old_color)));
+				}
+			}
+#else
+			for (int32_t y = y0; y <= y1; ++y)
+			{
+				for (int32_t x = x0; x <= x1; ++x)
+				{
+					bool inside{ true };
+					for (int k = 0; k < 3 && inside; ++k)
+					{
+						inside = static_cast<int32_t>(t.edge_a[k] * static_cast<uint32_t>(x) + t.edge_b[k] * static_cast<uint32_t>(y) + t.edge_c[k]) >= 0;
+					}
+					const size_t pixel{ static_cast<size_t>(y) * target_pitch + x };
+					const float z{ t.z_a * (x + 0.5f) + (t.z_b * (y + 0.5f) + t.z_c) };
+					if (inside && z < depths[pixel])
+					{
+						depths[pixel] = z;
+						colors[pixel] = t.color;
+					}
+				}
+			}
+#endif
+		}
+	}
+}
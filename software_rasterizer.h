@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Triangles in the form the software rasterizer consumes : object space positions, 32 bit indices with the base
+// vertex already applied, and one flat color per draw (static_mesh::make_raster_mesh builds it from a mesh source).
+struct raster_mesh
+{
+	struct draw
+	{
+		uint32_t first_index;
+		uint32_t index_count;
+		float color[4];	// linear RGBA, the material diffuse color
+	};
+	std::vector<float> positions;	// x, y, z per vertex
+	std::vector<uint32_t> indices;
+	std::vector<draw> draws;
+};
+
+struct software_rasterizer_statistics
+{
+	uint32_t triangles{ 0 };	// submitted
+	uint32_t culled{ 0 };	// back facing, outside the frustum or without area
+	uint32_t clipped{ 0 };	// crossing the near plane, split into one or two triangles
+	uint32_t binned{ 0 };	// triangle / tile pairs
+};
+
+// A CPU rasterizer for machines without a GPU (thumbnails, CI images). Draws are set up and binned into square
+// screen tiles by worker threads as they are submitted, in fixed size chunks of triangles; resolve then hands whole
+// tiles to the workers, which rasterize their triangles with SSE edge functions (4 pixels per step) against a depth
+// buffer. Every tile is written by one thread only, so no locking is needed, and tiles replay the chunks in
+// submission order, so the image does not depend on the thread count.
+//
+// Conventions follow the Direct3D pipeline of the renderer : row-major matrices used as 'float4(p, 1) * m',
+// clip space depth in [0, 1] with a less depth test, clockwise front faces with back faces culled, and pixel
+// centers at half integers. Shading is flat : the draw color lit by one directional light per triangle.
+class software_rasterizer
+{
+public:
+	// 'thread_count' 0 uses std::thread::hardware_concurrency.
+	software_rasterizer(uint32_t width, uint32_t height, uint32_t tile_size = 64, size_t thread_count = 0);
+
+	// Clears the targets and the binned triangles of the previous frame. 'color' is R8G8B8A8 with R in the low byte.
+	void clear(uint32_t color, float depth = 1.0f);
+	// World space direction the light travels in, and the ambient term added to the diffuse one.
+	void set_light(const float direction[3], float ambient);
+	// Transforms, clips, culls and bins the triangles of 'mesh'. 'world' and 'view_projection' are 16 floats.
+	void draw(const raster_mesh& mesh, const float world[16], const float view_projection[16]);
+	// Rasterizes everything binned since clear.
+	void resolve();
+
+	uint32_t width() const { return target_width; }
+	uint32_t height() const { return target_height; }
+	// Rows of the targets are 'pitch' pixels apart (the width rounded up to 4).
+	uint32_t pitch() const { return target_pitch; }
+	const uint32_t* color_buffer() const { return colors.data(); }
+	const float* depth_buffer() const { return depths.data(); }
+	const software_rasterizer_statistics& statistics() const { return counts; }
+
+	// A triangle ready for rasterization : edge functions e(x, y) = a * x + b * y + c of the pixel (x, y), in fixed
+	// point with wrapping unsigned arithmetic, not negative inside ; and the plane of z / w over the pixel centers.
+	struct triangle
+	{
+		uint32_t edge_a[3], edge_b[3], edge_c[3];
+		float z_a, z_b, z_c;
+		int32_t min_x, min_y, max_x, max_y;	// inclusive pixel bounds, clamped to the target
+		uint32_t color;
+	};
+
+private:
+	static constexpr uint32_t triangles_per_chunk{ 1024 };
+	// Vertices are snapped to 1 / 16 pixel. Triangles reaching further than 'guard_band_pixels' from the target
+	// center are clipped, which keeps the edge functions exact in 32 bits and limits targets to 2048 x 2048.
+	static constexpr int32_t subpixel_steps{ 16 };
+	static constexpr float guard_band_pixels{ 1024.0f };
+
+	// Setup and binning output of one chunk of triangles. Tile bins hold indices into 'triangles' of the same chunk.
+	struct chunk
+	{
+		std::vector<triangle> triangles;
+		std::vector<std::vector<uint32_t>> tiles;
+		software_rasterizer_statistics counts;
+	};
+
+	void set_up_chunk(const raster_mesh& mesh, const float normal_matrix[9], uint32_t first_triangle, uint32_t last_triangle, chunk& output) const;
+	void rasterize_tile(uint32_t tile);
+
+	uint32_t target_width, target_height, target_pitch;
+	uint32_t tile_size;
+	uint32_t tiles_x, tiles_y;
+	size_t thread_count;
+
+	std::vector<uint32_t> colors;
+	std::vector<float> depths;
+	// Chunks [0, chunk_count) hold the frame; the others keep their memory for the next frames.
+	std::vector<chunk> chunks;
+	size_t chunk_count{ 0 };
+	std::vector<float> clip_positions;	// x, y, z, w per vertex of the draw being set up
+	std::vector<uint32_t> draw_first_triangles;	// of each draw of the mesh being set up, and the total at the end
+
+	float light_direction[3]{ 0.0f, -1.0f, 0.0f };
+	float ambient{ 0.2f };
+	software_rasterizer_statistics counts;
+};
@@ -53,6 +53,55 @@ void sprite::render(ID3D11DeviceContext* immediate_context,
 	UINT num_viewports{ 1 };
 	immediate_context->RSGetViewports(&num_viewports, &viewport);
 
+	HRESULT hr{ S_OK };
+	D3D11_MAPPED_SUBRESOURCE mapped_subresource{};
+	hr = immediate_context->Map(vertex_buffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped_subresource);
+	_ASSERT_EXPR(SUCCEEDED(hr), hr_trace(hr));
+
+	vertex* vertices{ reinterpret_cast<vertex*>(mapped_subresource.pData) };
+	if (vertices != nullptr)
+	{
+		make_vertices(vertices, viewport.Width, viewport.Height, dx, dy, dw, dh, r, g, b, a, angle, sx, sy, sw, sh);
+	}
+
+	immediate_context->Unmap(vertex_buffer.Get(), 0);
+
+	UINT stride{ sizeof(vertex) };
+	UINT offset{ 0 };
+	immediate_context->IASetVertexBuffers(0, 1, vertex_buffer.GetAddressOf(), &stride, &offset);
+
+	immediate_context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+
+	immediate_context->PSSetShaderResources(0, 1, shader_resource_view.GetAddressOf());
+
+	immediate_context->Draw(4, 0);
+}
+
+void sprite::record(command_stream& stream, float viewport_width, float viewport_height,
+	float dx, float dy, float dw, float dh,
+	float r, float g, float b, float a,
+	float angle/*degree*/,
+	float sx, float sy, float sw, float sh) const
+{
+	make_vertices(static_cast<vertex*>(stream.set_vertices(sizeof(vertex), 4)), viewport_width, viewport_height, dx, dy, dw, dh, r, g, b, a, angle, sx, sy, sw, sh);
+	stream.set_topology(command_stream::triangle_strip);
+	ID3D11ShaderResourceView* shader_resource_views[1]{ shader_resource_view.Get() };
+	stream.set_shader_resources(0, 1, shader_resource_views);
+	stream.draw(4, 0);
+}
+
+void sprite::record(command_stream& stream, float viewport_width, float viewport_height, float dx, float dy, float dw, float dh) const
+{
+	record(stream, viewport_width, viewport_height, dx, dy, dw, dh, 1.0f, 1.0f, 1.0f, 1.0f, 0.0f,
+		0.0f, 0.0f, static_cast<float>(texture2d_desc.Width), static_cast<float>(texture2d_desc.Height));
+}
+
+void sprite::make_vertices(vertex vertices[4], float viewport_width, float viewport_height,
+	float dx, float dy, float dw, float dh,
+	float r, float g, float b, float a,
+	float angle/*degree*/,
+	float sx, float sy, float sw, float sh) const
+{
 	// Set each sprite's vertices coordinate to screen space
 	//
 	//  (x0, y0) *----* (x1, y1) 
@@ -98,47 +147,26 @@ void sprite::render(ID3D11DeviceContext* immediate_context,
 	rotate(x3, y3, cx, cy, angle);
 
 	// Convert to NDC space
-	x0 = 2.0f * x0 / viewport.Width - 1.0f;
-	y0 = 1.0f - 2.0f * y0 / viewport.Height;
-	x1 = 2.0f * x1 / viewport.Width - 1.0f;
-	y1 = 1.0f - 2.0f * y1 / viewport.Height;
-	x2 = 2.0f * x2 / viewport.Width - 1.0f;
-	y2 = 1.0f - 2.0f * y2 / viewport.Height;
-	x3 = 2.0f * x3 / viewport.Width - 1.0f;
-	y3 = 1.0f - 2.0f * y3 / viewport.Height;
-
-	HRESULT hr{ S_OK };
-	D3D11_MAPPED_SUBRESOURCE mapped_subresource{};
-	hr = immediate_context->Map(vertex_buffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped_subresource);
-	_ASSERT_EXPR(SUCCEEDED(hr), hr_trace(hr));
-
-	vertex* vertices{ reinterpret_cast<vertex*>(mapped_subresource.pData) };
-	if (vertices != nullptr)
-	{
-		vertices[0].position = { x0, y0 , 0 };
-		vertices[1].position = { x1, y1 , 0 };
-		vertices[2].position = { x2, y2 , 0 };
-		vertices[3].position = { x3, y3 , 0 };
-
-		vertices[0].color = vertices[1].color = vertices[2].color = vertices[3].color = { r, g, b, a };
-
-		vertices[0].texcoord = { sx / texture2d_desc.Width, sy / texture2d_desc.Height };
-		vertices[1].texcoord = { (sx + sw) / texture2d_desc.Width, sy / texture2d_desc.Height };
-		vertices[2].texcoord = { sx / texture2d_desc.Width, (sy + sh) / texture2d_desc.Height };
-		vertices[3].texcoord = { (sx + sw) / texture2d_desc.Width, (sy + sh) / texture2d_desc.Height };
-	}
-
-	immediate_context->Unmap(vertex_buffer.Get(), 0);
-
-	UINT stride{ sizeof(vertex) };
-	UINT offset{ 0 };
-	immediate_context->IASetVertexBuffers(0, 1, vertex_buffer.GetAddressOf(), &stride, &offset);
-
-	immediate_context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
-
-	immediate_context->PSSetShaderResources(0, 1, shader_resource_view.GetAddressOf());
-
-	immediate_context->Draw(4, 0);
+	x0 = 2.0f * x0 / viewport_width - 1.0f;
+	y0 = 1.0f - 2.0f * y0 / viewport_height;
+	x1 = 2.0f * x1 / viewport_width - 1.0f;
+	y1 = 1.0f - 2.0f * y1 / viewport_height;
+	x2 = 2.0f * x2 / viewport_width - 1.0f;
+	y2 = 1.0f - 2.0f * y2 / viewport_height;
+	x3 = 2.0f * x3 / viewport_width - 1.0f;
+	y3 = 1.0f - 2.0f * y3 / viewport_height;
+
+	vertices[0].position = { x0, y0 , 0 };
+	vertices[1].position = { x1, y1 , 0 };
+	vertices[2].position = { x2, y2 , 0 };
+	vertices[3].position = { x3, y3 , 0 };
+
+	vertices[0].color = vertices[1].color = vertices[2].color = vertices[3].color = { r, g, b, a };
+
+	vertices[0].texcoord = { sx / texture2d_desc.Width, sy / texture2d_desc.Height };
+	vertices[1].texcoord = { (sx + sw) / texture2d_desc.Width, sy / texture2d_desc.Height };
+	vertices[2].texcoord = { sx / texture2d_desc.Width, (sy + sh) / texture2d_desc.Height };
+	vertices[3].texcoord = { (sx + sw) / texture2d_desc.Width, (sy + sh) / texture2d_desc.Height };
 }
 void sprite::render(ID3D11DeviceContext* immediate_context, float dx, float dy, float dw, float dh)
 {
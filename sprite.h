@@ -6,6 +6,8 @@
 #include <wrl.h>
 #include <string>
 
+#include "command_stream.h"
+
 class sprite
 {
 private:
@@ -29,4 +31,12 @@ public:
 	void render(ID3D11DeviceContext* immediate_context, float dx, float dy, float dw, float dh, float r, float g, float b, float a, float angle/*degree*/, float sx, float sy, float sw, float sh);
 	void render(ID3D11DeviceContext* immediate_context, float dx, float dy, float dw, float dh);
 	void textout(ID3D11DeviceContext* immediate_context, std::string s, float x, float y, float w, float h, float r, float g, float b, float a);
+
+	// Records the same draw into 'stream'. The vertices are written into the stream, so the viewport size is given
+	// instead of read from the context. The shaders and samplers are left to the caller, as for render.
+	void record(command_stream& stream, float viewport_width, float viewport_height, float dx, float dy, float dw, float dh, float r, float g, float b, float a, float angle/*degree*/, float sx, float sy, float sw, float sh) const;
+	void record(command_stream& stream, float viewport_width, float viewport_height, float dx, float dy, float dw, float dh) const;
+
+private:
+	void make_vertices(vertex vertices[4], float viewport_width, float viewport_height, float dx, float dy, float dw, float dh, float r, float g, float b, float a, float angle/*degree*/, float sx, float sy, float sw, float sh) const;
 };
@@ -0,0 +1,163 @@
+#include "state_filter.h"
+
+#include <algorithm>
+#include <cstring>
+
+bool state_filter::issue(bool changed)
+{
+	if (changed)
+	{
+		++counts.issued;
+	}
+	else
+	{
+		++counts.filtered;
+	}
+	return changed;
+}
+
+void state_filter::invalidate()
+{
+	input_layout.known = false;
+	vertex_shader.known = false;
+	pixel_shader.known = false;
+	vertex_buffer.known = false;
+	index_buffer.known = false;
+	topology.known = false;
+	for (shadowed<ID3D11ShaderResourceView*>& shader_resource : shader_resources)
+	{
+		shader_resource.known = false;
+	}
+	for (constant_binding& constant : constants)
+	{
+		constant.known = false;
+	}
+}
+
+void state_filter::set_input_layout(ID3D11InputLayout* input_layout)
+{
+	if (issue(this->input_layout.update(input_layout)))
+	{
+		target.set_input_layout(input_layout);
+	}
+}
+
+void state_filter::set_vertex_shader(ID3D11VertexShader* vertex_shader)
+{
+	if (issue(this->vertex_shader.update(vertex_shader)))
+	{
+		target.set_vertex_shader(vertex_shader);
+	}
+}
+
+void state_filter::set_pixel_shader(ID3D11PixelShader* pixel_shader)
+{
+	if (issue(this->pixel_shader.update(pixel_shader)))
+	{
+		target.set_pixel_shader(pixel_shader);
+	}
+}
+
+void state_filter::set_vertex_buffer(ID3D11Buffer* buffer, uint32_t stride, uint32_t offset)
+{
+	if (issue(vertex_buffer.update({ buffer, stride, offset })))
+	{
+		target.set_vertex_buffer(buffer, stride, offset);
+	}
+}
+
+void state_filter::set_index_buffer(ID3D11Buffer* buffer, uint32_t index_size, uint32_t offset)
+{
+	if (issue(index_buffer.update({ buffer, index_size, offset })))
+	{
+		target.set_index_buffer(buffer, index_size, offset);
+	}
+}
+
+void state_filter::set_topology(command_stream::primitive_topology topology)
+{
+	if (issue(this->topology.update(topology)))
+	{
+		target.set_topology(topology);
+	}
+}
+
+// Only the slots between the first and the last changed one are forwarded, as one call.
+void state_filter::set_shader_resources(uint32_t first_slot, uint32_t count, ID3D11ShaderResourceView* const* shader_resource_views)
+{
+	if (first_slot + count > max_shader_resource_slots)
+	{
+		issue(true);
+		target.set_shader_resources(first_slot, count, shader_resource_views);
+		for (uint32_t slot = first_slot; slot < max_shader_resource_slots; ++slot)
+		{
+			shader_resources[slot].known = false;
+		}
+		return;
+	}
+	uint32_t first_changed{ count };
+	uint32_t last_changed{ 0 };
+	for (uint32_t k = 0; k < count; ++k)
+	{
+		if (shader_resources[first_slot + k].update(shader_resource_views[k]))
+		{
+			first_changed = (std::min)(first_changed, k);
+			last_changed = k;
+		}
+	}
+	if (issue(first_changed < count))
+	{
+		target.set_shader_resources(first_slot + first_changed, last_changed - first_changed + 1, shader_resource_views + first_changed);
+	}
+}
+
+void state_filter::set_constants(uint32_t slot, const void* data, uint32_t size)
+{
+	if (slot >= max_constant_slots)
+	{
+		issue(true);
+		target.set_constants(slot, data, size);
+		return;
+	}
+	constant_binding& constant{ constants[slot] };
+	const bool changed{ !constant.known || constant.data.size() != size || memcmp(constant.data.data(), data, size) != 0 };
+	if (issue(changed))
+	{
+		constant.known = true;
+		constant.data.assign(static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + size);
+		target.set_constants(slot, data, size);
+	}
+}
+
+void state_filter::set_instances(const void* data, uint32_t stride, uint32_t count)
+{
+	target.set_instances(data, stride, count);
+}
+
+// The backend binds its own dynamic buffer to slot 0.
+void state_filter::set_vertices(const void* data, uint32_t stride, uint32_t count)
+{
+	target.set_vertices(data, stride, count);
+	vertex_buffer.known = false;
+}
+
+void state_filter::draw(uint32_t vertex_count, uint32_t start_vertex)
+{
+	target.draw(vertex_count, start_vertex);
+}
+
+void state_filter::draw_indexed(uint32_t index_count, uint32_t start_index, int32_t base_vertex)
+{
+	target.draw_indexed(index_count, start_index, base_vertex);
+}
+
+void state_filter::draw_indexed_instanced(uint32_t index_count, uint32_t instance_count, uint32_t start_index, int32_t base_vertex)
+{
+	target.draw_indexed_instanced(index_count, instance_count, start_index, base_vertex);
+}
+
+void state_filter::call(const std::function<void(ID3D11DeviceContext*)>& function)
+{
+	target.call(function);
+	invalidate();
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "command_stream.h"
+
+// Calls issued to and dropped before the target backend since the last reset_statistics. Draws and vertex or
+// instance uploads are never filtered and are not counted.
+struct state_filter_statistics
+{
+	uint32_t issued{ 0 };
+	uint32_t filtered{ 0 };
+};
+
+// A command_backend that shadows the bindings last forwarded to 'target' and drops commands that would bind the
+// same state again : input layout, shaders, vertex buffer slot 0, index buffer, topology, each pixel shader resource slot and
+// the constants of each register (compared by contents, since every set_constants pushes a new slice).
+// A call command or invalidate forgets everything, because code that talks to the context may change any of it.
+class state_filter : public command_backend
+{
+public:
+	explicit state_filter(command_backend& target) : target(target) {}
+
+	// Forgets the shadowed state. Call when other code has used the context since the last replay.
+	void invalidate();
+	const state_filter_statistics& statistics() const { return counts; }
+	void reset_statistics() { counts = {}; }
+
+	void set_input_layout(ID3D11InputLayout* input_layout) override;
+	void set_vertex_shader(ID3D11VertexShader* vertex_shader) override;
+	void set_pixel_shader(ID3D11PixelShader* pixel_shader) override;
+	void set_vertex_buffer(ID3D11Buffer* buffer, uint32_t stride, uint32_t offset) override;
+	void set_index_buffer(ID3D11Buffer* buffer, uint32_t index_size, uint32_t offset) override;
+	void set_topology(command_stream::primitive_topology topology) override;
+	void set_shader_resources(uint32_t first_slot, uint32_t count, ID3D11ShaderResourceView* const* shader_resource_views) override;
+	void set_constants(uint32_t slot, const void* data, uint32_t size) override;
+	void set_instances(const void* data, uint32_t stride, uint32_t count) override;
+	void set_vertices(const void* data, uint32_t stride, uint32_t count) override;
+	void draw(uint32_t vertex_count, uint32_t start_vertex) override;
+	void draw_indexed(uint32_t index_count, uint32_t start_index, int32_t base_vertex) override;
+	void draw_indexed_instanced(uint32_t index_count, uint32_t instance_count, uint32_t start_index, int32_t base_vertex) override;
+	void call(const std::function<void(ID3D11DeviceContext*)>& function) override;
+
+	static constexpr uint32_t max_shader_resource_slots{ 16 };
+	static constexpr uint32_t max_constant_slots{ 14 };
+
+private:
+	// The last value forwarded for one binding; unknown until the first forward after invalidate.
+	template <class T>
+	struct shadowed
+	{
+		bool known{ false };
+		T value{};
+
+		// Returns true, and remembers 'v', when binding 'v' could change the state.
+		bool update(const T& v)
+		{
+			if (known && memcmp(&value, &v, sizeof(T)) == 0)
+			{
+				return false;
+			}
+			known = true;
+			value = v;
+			return true;
+		}
+	};
+	struct buffer_binding
+	{
+		ID3D11Buffer* buffer;
+		uint32_t stride;	// index size for the index buffer
+		uint32_t offset;
+	};
+	struct constant_binding
+	{
+		bool known{ false };
+		std::vector<uint8_t> data;
+	};
+
+	// Counts the call as issued if 'changed', otherwise as filtered, and returns 'changed'.
+	bool issue(bool changed);
+
+	command_backend& target;
+	state_filter_statistics counts;
+
+	shadowed<ID3D11InputLayout*> input_layout;
+	shadowed<ID3D11VertexShader*> vertex_shader;
+	shadowed<ID3D11PixelShader*> pixel_shader;
+	shadowed<buffer_binding> vertex_buffer;
+	shadowed<buffer_binding> index_buffer;
+	shadowed<command_stream::primitive_topology> topology;
+	shadowed<ID3D11ShaderResourceView*> shader_resources[max_shader_resource_slots];
+	constant_binding constants[max_constant_slots];
+};
@@ -1,401 +1,711 @@
 #include "shader.h"
 #include "misc.h"
 #include "static_mesh.h"
+#include "obj_loader.h"
+#include "mesh_cache.h"
+#include "vertex_cache_optimizer.h"
+#include "overdraw_optimizer.h"
+#include "index_packing.h"
+#include "mesh_simplifier.h"
 
-#include <fstream>
+#include <algorithm>
+#include <cstddef>
 #include <vector>
+#include <sstream>
 
 #include <filesystem>
 #include "texture.h"
 
 using namespace DirectX;
-static_mesh::static_mesh(ID3D11Device* device, const wchar_t* obj_filename, bool flipping_v_coordinates)
+
+const D3D11_INPUT_ELEMENT_DESC static_mesh::input_element_desc[3]
+{
+	{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+};
+const D3D11_INPUT_ELEMENT_DESC static_mesh::quantized_input_element_desc[3]
+{
+	{ "POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+};
+const D3D11_INPUT_ELEMENT_DESC static_mesh::instanced_input_element_desc[7]
+{
+	{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "WORLD", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+	{ "WORLD", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+	{ "WORLD", 2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+	{ "WORLD", 3, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+};
+const D3D11_INPUT_ELEMENT_DESC static_mesh::quantized_instanced_input_element_desc[7]
+{
+	{ "POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "WORLD", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+	{ "WORLD", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+	{ "WORLD", 2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+	{ "WORLD", 3, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+};
+
+static_mesh::static_mesh(ID3D11Device* device, const wchar_t* obj_filename, bool flipping_v_coordinates, uint32_t optimizations) :
+	static_mesh(device, load_source(obj_filename, flipping_v_coordinates, optimizations))
+{
+}
+
+std::future<static_mesh::source> static_mesh::load_source_async(const wchar_t* obj_filename, bool flipping_v_coordinates, uint32_t optimizations)
 {
-	std::vector<vertex> vertices;
-	std::vector<uint32_t> indices;
-	uint32_t current_index{ 0 };
-
-	std::vector<XMFLOAT3> positions;
-	std::vector<XMFLOAT3> normals;
-	std::vector<XMFLOAT2> texcoords;
-	std::vector<std::wstring> mtl_filenames;
-
-	std::wifstream fin(obj_filename);
-	_ASSERT_EXPR(fin, L"'OBJ file not found.");
-	wchar_t command[256];
-	while (fin)
-	{
-		fin >> command;
-		if (0 == wcscmp(command, L"v"))
+	return std::async(std::launch::async, [obj_filename = std::wstring(obj_filename), flipping_v_coordinates, optimizations]()
+	{
+		return load_source(obj_filename.c_str(), flipping_v_coordinates, optimizations);
+	});
+}
+
+static_mesh::source static_mesh::load_source(const wchar_t* obj_filename, bool flipping_v_coordinates, uint32_t optimizations)
+{
+	source data;
+
+	// A binary cache next to the OBJ file skips parsing entirely; its vertex and index blobs are
+	// read straight from the mapped file, which 'data' keeps open until the vertex buffer is created.
+	const uint32_t cache_options{ (flipping_v_coordinates ? 1u : 0u) | ((optimizations & (optimize_vertex_cache | optimize_overdraw)) << 1) };
+	const std::filesystem::path cache_filename{ mesh_cache::cache_filename(obj_filename) };
+	obj_model model;
+	mesh_cache cache;
+	if (!cache.open(cache_filename, obj_filename, cache_options, model))
+	{
+		model = {};
+		bool loaded{ load_obj(obj_filename, flipping_v_coordinates, model) };
+		_ASSERT_EXPR(loaded, L"'OBJ file not found or malformed.");
+		group_subsets_by_material(model);
+
+		if (optimizations & optimize_vertex_cache)
 		{
-			// v x y z w
-			// 
-			// Specifies a geometric vertex and its x y z coordinates.Rational
-			// curves and surfaces require a fourth homogeneous coordinate, also
-			// called the weight.
-			// 
-			// x y z are the x, y, and z coordinates for the vertex.These are
-			// floating point numbers that define the position of the vertex in
-			// three dimensions.
-			// 
-			// w is the weight required for rational curves and surfaces.It is
-			// not required for non - rational curves and surfaces.If you do not
-			// specify a value for w, the default is 1.0.
-			float x, y, z;
-			fin >> x >> y >> z;
-			positions.push_back({ x, y, z });
-			fin.ignore(1024, L'\n');
+			for (const obj_subset& subset : model.subsets)
+			{
+				::optimize_vertex_cache(model.indices.data() + subset.index_start, subset.index_count, model.vertices.size());
+			}
 		}
-		else if (0 == wcscmp(command, L"vt"))
+		if ((optimizations & optimize_overdraw) && !model.vertices.empty())
 		{
-			// vt u v w
-			// 
-			// Specifies a texture vertex and its coordinates.A 1D texture
-			// requires only u texture coordinates, a 2D texture requires both u
-			// and v texture coordinates, and a 3D texture requires all three
-			// coordinates.
-			// 
-			// u is the value for the horizontal direction of the texture.
-			// 
-			// v is an optional argument.
-			// 
-			// v is the value for the vertical direction of the texture.The
-			// default is 0.
-			// 
-			// w is an optional argument.
-			// 
-			// w is a value for the depth of the texture.The default is 0.
-			float u, v;
-			fin >> u >> v;
-			texcoords.push_back({ u, flipping_v_coordinates ? 1.0f - v : v });
-			fin.ignore(1024, L'\n');
+			for (const obj_subset& subset : model.subsets)
+			{
+				::optimize_overdraw(model.indices.data() + subset.index_start, subset.index_count, model.vertices.data()->position, sizeof(obj_vertex), model.vertices.size());
+			}
 		}
-		else if (0 == wcscmp(command, L"vn"))
+		write_mesh_cache(cache_filename, obj_filename, cache_options, model);
+	}
+
+	for (const obj_subset& s : model.subsets)
+	{
+		data.subsets.push_back({ std::wstring(s.usemtl.begin(), s.usemtl.end()), s.index_start, s.index_count });
+	}
+
+	for (const obj_material& m : model.materials)
+	{
+		material material;
+		material.name = std::wstring(m.name.begin(), m.name.end());
+		material.Ka = { m.Ka[0], m.Ka[1], m.Ka[2], m.Ka[3] };
+		material.Kd = { m.Kd[0], m.Kd[1], m.Kd[2], m.Kd[3] };
+		material.Ks = { m.Ks[0], m.Ks[1], m.Ks[2], m.Ks[3] };
+		for (size_t i = 0; i < 2; ++i)
 		{
-			// vn i j k
-			// 
-			// Specifies a normal vector with components i, j, and k.
-			// 
-			// Vertex normals affect the smooth - shading and rendering of geometry.0
-			// For polygons, vertex normals are used in place of the actual facet
-			// normals.For surfaces, vertex normals are interpolated over the
-			// entire surface and replace the actual analytic surface normal.
-			// 
-			// When vertex normals are present, they supersede smoothing groups.
-			// 
-			// i j k are the i, j, and k coordinates for the vertex normal.They
-			// are floating point numbers.
-			FLOAT i, j, k;
-			fin >> i >> j >> k;
-			normals.push_back({ i, j, k });
-			fin.ignore(1024, L'\n');
+			if (m.texture_filenames[i].size() > 0)
+			{
+				material.texture_filenames[i] = resolve_obj_reference(obj_filename, m.texture_filenames[i]);
+			}
 		}
-		else if (0 == wcscmp(command, L"f"))
+		data.materials.push_back(material);
+	}
+
+	// obj_vertex and vertex share the same layout, so the mapped array is uploaded as is and the parsed one is
+	// copied without conversion.
+	static_assert(sizeof(vertex) == sizeof(obj_vertex), "static_mesh::vertex must match obj_vertex");
+	static_assert(offsetof(vertex, position) == offsetof(obj_vertex, position), "static_mesh::vertex must match obj_vertex");
+	static_assert(offsetof(vertex, normal) == offsetof(obj_vertex, normal), "static_mesh::vertex must match obj_vertex");
+	static_assert(offsetof(vertex, texcoord) == offsetof(obj_vertex, texcoord), "static_mesh::vertex must match obj_vertex");
+	const vertex* vertices{ reinterpret_cast<const vertex*>(cache.is_open() ? cache.vertices() : model.vertices.data()) };
+	size_t vertex_count{ cache.is_open() ? cache.vertex_count() : model.vertices.size() };
+	const uint32_t* indices{ cache.is_open() ? cache.indices() : model.indices.data() };
+	size_t index_count{ cache.is_open() ? cache.index_count() : model.indices.size() };
+
+	for (size_t i = 0; i < vertex_count; ++i)
+	{
+		const vertex& v{ vertices[i] };
+		data.bounding_box[0].x = std::min<float>(data.bounding_box[0].x, v.position.x);
+		data.bounding_box[0].y = std::min<float>(data.bounding_box[0].y, v.position.y);
+		data.bounding_box[0].z = std::min<float>(data.bounding_box[0].z, v.position.z);
+		data.bounding_box[1].x = std::max<float>(data.bounding_box[1].x, v.position.x);
+		data.bounding_box[1].y = std::max<float>(data.bounding_box[1].y, v.position.y);
+		data.bounding_box[1].z = std::max<float>(data.bounding_box[1].z, v.position.z);
+	}
+
+	// Index ranges uploaded to the index buffer : the subsets, then the subsets of every simplified level.
+	std::vector<index_range> ranges;
+	for (const subset& subset : data.subsets)
+	{
+		ranges.push_back({ subset.index_start, subset.index_count });
+	}
+	if (ranges.empty())
+	{
+		ranges.push_back({ 0, static_cast<uint32_t>(index_count) });
+	}
+	data.lods.push_back({ 0.0f, static_cast<uint32_t>(index_count / 3) });
+
+	std::vector<uint32_t> lod_indices;
+	if ((optimizations & generate_lods) && vertex_count > 0)
+	{
+		// Each level halves the triangles of every subset of the previous level, with collapses capped at a twentieth
+		// of the bounding box diagonal. The chain stops when a level no longer removes a tenth of the triangles.
+		// Level errors add up, since every level is simplified from the one before it.
+		const size_t max_lod_count{ 5 };
+		const float max_error{ 0.05f * XMVectorGetX(XMVector3Length(XMLoadFloat3(&data.bounding_box[1]) - XMLoadFloat3(&data.bounding_box[0]))) };
+		lod_indices.assign(indices, indices + index_count);
+		while (data.lods.size() < max_lod_count)
 		{
-			//f  v1 / vt1 / vn1   v2 / vt2 / vn2   v3 / vt3 / vn3 . . .
-			//
-			// optionally include the texture vertex and vertex normal reference
-			// numbers.
-			// 
-			// The reference numbers for the vertices, texture vertices, and
-			// vertex normals must be separated by slashes(/ ).There is no space
-			// between the number and the slash.
-			// 
-			// v is the reference number for a vertex in the face element.A
-			// minimum of three vertices are required.
-			// 
-			// vt is an optional argument.
-			// 
-			// vt is the reference number for a texture vertex in the face
-			// element.It always follows the first slash.
-			// 
-			// vn is an optional argument.
-			// 
-			// vn is the reference number for a vertex normal in the face element.
-			// It must always follow the second slash.
-			// 
-			// Face elements use surface normals to indicate their orientation.If
-			// vertices are ordered counterclockwise around the face, both the
-			// face and the normal will point toward the viewer.If the vertex
-			// ordering is clockwise, both will point away from the viewer.If
-			// vertex normals are assigned, they should point in the general
-			// direction of the surface normal, otherwise unpredictable results
-			// may occur.
-			//
-			// If a face has a texture map assigned to it and no texture vertices
-			// are assigned in the f statement, the texture map is ignored when
-			// the element is rendered.
-			for (size_t i = 0; i < 3; i++)
+			const size_t previous{ ranges.size() - data.subsets.size() };
+			lod level{ 0.0f, 0 };
+			std::vector<uint32_t> level_indices;
+			std::vector<index_range> level_ranges;
+			for (size_t s = 0; s < data.subsets.size(); ++s)
 			{
-				vertex vertex;
-				size_t v, vt, vn;
-
-				fin >> v;
-				vertex.position = positions.at(v - 1);
-				if (L'/' == fin.peek())
-				{
-					fin.ignore(1);
-					if (L'/' != fin.peek())
-					{
-						fin >> vt;
-						vertex.texcoord = texcoords.at(vt - 1);
-					}
-					if (L'/' == fin.peek())
-					{
-						fin.ignore(1);
-						fin >> vn;
-						vertex.normal = normals.at(vn - 1);
-					}
-				}
-				vertices.push_back(vertex);
-				indices.push_back(current_index++);
+				const index_range& previous_range{ ranges[previous + s] };
+				std::vector<uint32_t> simplified(previous_range.index_count);
+				float error{ 0.0f };
+				size_t count{ simplify_mesh(simplified.data(), lod_indices.data() + previous_range.index_start, previous_range.index_count,
+					&vertices->position.x, sizeof(vertex), vertex_count, previous_range.index_count / 6 * 3, max_error, &error) };
+				level_ranges.push_back({ static_cast<uint32_t>(lod_indices.size() + level_indices.size()), static_cast<uint32_t>(count) });
+				level_indices.insert(level_indices.end(), simplified.begin(), simplified.begin() + count);
+				level.error = std::max(level.error, error);
 			}
-			fin.ignore(1024, L'\n');
+			level.error += data.lods.back().error;
+			level.triangle_count = static_cast<uint32_t>(level_indices.size() / 3);
+			if (level.triangle_count == 0 || level.triangle_count * 10 > data.lods.back().triangle_count * 9)
+			{
+				break;
+			}
+			lod_indices.insert(lod_indices.end(), level_indices.begin(), level_indices.end());
+			ranges.insert(ranges.end(), level_ranges.begin(), level_ranges.end());
+			data.lods.push_back(level);
 		}
-		else if (0 == wcscmp(command, L"mtllib"))
+	}
+	if (optimizations & quantize_vertices)
+	{
+		const obj_vertex* obj_vertices{ reinterpret_cast<const obj_vertex*>(vertices) };
+		quantization_bounds bounds{ compute_quantization_bounds(obj_vertices, vertex_count) };
+		std::vector<quantized_vertex> quantized(vertex_count);
+		::quantize_vertices(obj_vertices, vertex_count, bounds, quantized.data());
+		data.vertex_stride = sizeof(quantized_vertex);
+		data.position_offset = { bounds.offset[0], bounds.offset[1], bounds.offset[2], 0.0f };
+		data.position_scale = { bounds.scale[0], bounds.scale[1], bounds.scale[2], 1.0f };
+		data.vertices.assign(reinterpret_cast<const uint8_t*>(quantized.data()), reinterpret_cast<const uint8_t*>(quantized.data() + vertex_count));
+	}
+	else if (!cache.is_open())
+	{
+		data.vertices.assign(reinterpret_cast<const uint8_t*>(vertices), reinterpret_cast<const uint8_t*>(vertices + vertex_count));
+	}
+
+	// 16-bit indices for the whole buffer or for each range that fits, 32-bit for the rest.
+	std::vector<packed_index_range> packed;
+	data.indices = pack_indices(lod_indices.empty() ? indices : lod_indices.data(), vertex_count, ranges.data(), ranges.size(), packed);
+	for (size_t i = 0; i < data.subsets.size(); ++i)
+	{
+		data.subsets[i].index_format = packed[i].index_size == sizeof(uint16_t) ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+		data.subsets[i].index_byte_offset = packed[i].byte_offset;
+		data.subsets[i].index_location = packed[i].index_start;
+		data.subsets[i].base_vertex = packed[i].base_vertex;
+	}
+
+	if (optimizations & build_meshlets)
+	{
+		for (subset& subset : data.subsets)
 		{
-			// mtllib filename1 filename2 . . .
-			// Specifies the material library file for the material definitions
-			// set with the usemtl statement.You can specify multiple filenames
-			// with mtllib.If multiple filenames are specified, the first file
-			// listed is searched first for the material definition, the second
-			// file is searched next, and so on.
-			wchar_t mtllib[256];
-			fin >> mtllib;
-			mtl_filenames.push_back(mtllib);
+			subset.meshlet_start = static_cast<uint32_t>(data.meshlets.meshlets.size());
+			subset.meshlet_count = static_cast<uint32_t>(::build_meshlets(indices + subset.index_start, subset.index_count, &vertices->position.x, sizeof(vertex), data.meshlets));
 		}
-		else if (0 == wcscmp(command, L"usemtl"))
+		data.culled_index_count = index_count;
+	}
+
+	if (data.materials.size() == 0)
+	{
+		for (const subset& subset : data.subsets)
 		{
-			wchar_t usemtl[MAX_PATH]{ 0 };
-			fin >> usemtl;
-			subsets.push_back({ usemtl, static_cast<uint32_t>(indices.size()), 0 });
+			data.materials.push_back({ subset.usemtl });
 		}
-		else
+	}
+
+	// Decode every distinct texture file here; the device constructor only creates the textures.
+	for (const material& material : data.materials)
+	{
+		for (const std::wstring& texture_filename : material.texture_filenames)
+		{
+			if (texture_filename.size() > 0 && std::none_of(data.textures.begin(), data.textures.end(), [&](const decoded_texture& t) { return t.filename == texture_filename; }))
+			{
+				data.textures.emplace_back();
+				decode_texture_from_file(texture_filename.c_str(), data.textures.back());
+			}
+		}
+	}
+
+	// Resolve usemtl names once; subsets are already grouped by material (group_subsets_by_material).
+	for (subset& subset : data.subsets)
+	{
+		for (size_t i = 0; i < data.materials.size(); ++i)
 		{
-			fin.ignore(1024, L'\n');
+			if (data.materials[i].name == subset.usemtl)
+			{
+				subset.material_index = static_cast<uint32_t>(i);
+				break;
+			}
+		}
+	}
+	// One draw list per level, from the packed range of every subset of that level.
+	for (size_t level = 0; level < data.lods.size(); ++level)
+	{
+		data.lods[level].draw_start = static_cast<uint32_t>(data.draws.size());
+		for (size_t s = 0; s < data.subsets.size(); ++s)
+		{
+			const packed_index_range& range{ packed[level * data.subsets.size() + s] };
+			const uint32_t material_index{ data.subsets[s].material_index };
+			if (material_index == UINT32_MAX || range.index_count == 0)
+			{
+				continue;
+			}
+			const DXGI_FORMAT index_format{ range.index_size == sizeof(uint16_t) ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT };
+			if (data.draws.size() > data.lods[level].draw_start)
+			{
+				draw& last{ data.draws.back() };
+				if (last.material_index == material_index && last.index_format == index_format &&
+					last.index_byte_offset == range.byte_offset && last.base_vertex == range.base_vertex &&
+					last.index_location + last.index_count == range.index_start)
+				{
+					last.index_count += range.index_count;
+					continue;
+				}
+			}
+			data.draws.push_back({ material_index, index_format, range.byte_offset, range.index_start, range.index_count, range.base_vertex });
 		}
+		data.lods[level].draw_count = static_cast<uint32_t>(data.draws.size()) - data.lods[level].draw_start;
 	}
-	fin.close();
 
-	std::vector<subset>::reverse_iterator iterator = subsets.rbegin();
-	iterator->index_count = static_cast<uint32_t>(indices.size()) - iterator->index_start;
-	for (iterator = subsets.rbegin() + 1; iterator != subsets.rend(); ++iterator)
+	// The vertex buffer is created from the mapping itself.
+	if (cache.is_open() && !(optimizations & quantize_vertices))
 	{
-		iterator->index_count = (iterator - 1)->index_start - iterator->index_start;
+		data.cache = std::move(cache);
 	}
+	return data;
+}
 
-	std::filesystem::path mtl_filename(obj_filename);
-	mtl_filename.replace_filename(std::filesystem::path(mtl_filenames[0]).filename());
+static_mesh::static_mesh(ID3D11Device* device, source&& data) :
+	subsets(std::move(data.subsets)), materials(std::move(data.materials)), meshlets(std::move(data.meshlets)), lods(std::move(data.lods)),
+	vertex_stride(data.vertex_stride), position_offset(data.position_offset), position_scale(data.position_scale), draws(std::move(data.draws))
+{
+	bounding_box[0] = data.bounding_box[0];
+	bounding_box[1] = data.bounding_box[1];
 
-	fin.open(mtl_filename);
-	//_ASSERT_EXPR(fin, L"'MTL file not found.");
+	create_com_buffers(device, data.vertex_data(), data.vertex_data_size(), data.indices.data(), data.indices.size());
 
-	while (fin)
+	HRESULT hr{ S_OK };
+
+	if (data.culled_index_count > 0)
 	{
-		fin >> command;
-		if (0 == wcscmp(command, L"map_Kd"))
-		{
-			// map_Kd - options args filename
-			//
-			// Specifies that a color texture file or color procedural texture file is
-			// linked to the diffuse reflectivity of the material.During rendering,
-			// the map_Kd value is multiplied by the Kd value.
-			//
-			// "filename" is the name of a color texture file(.mpc), a color
-			// procedural texture file(.cxc), or an image file.
-			fin.ignore();
-			wchar_t map_Kd[256];
-			fin >> map_Kd;
-
-			std::filesystem::path path(obj_filename);
-			path.replace_filename(std::filesystem::path(map_Kd).filename());
-			//texture_filename = path;
-			//materials.rbegin()->texture_filename = path;
-			materials.rbegin()->texture_filenames[0] = path;
-			fin.ignore(1024, L'\n');
-		}
-		else if (0 == wcscmp(command, L"map_bump") || 0 == wcscmp(command, L"bump"))
+		D3D11_BUFFER_DESC buffer_desc{};
+		buffer_desc.ByteWidth = static_cast<UINT>(sizeof(uint32_t) * data.culled_index_count);
+		buffer_desc.Usage = D3D11_USAGE_DYNAMIC;
+		buffer_desc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+		buffer_desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		hr = device->CreateBuffer(&buffer_desc, nullptr, culled_index_buffer.GetAddressOf());
+		_ASSERT_EXPR(SUCCEEDED(hr), hr_trace(hr));
+		culled_indices.reserve(data.culled_index_count);
+		culled_ranges.reserve(subsets.size());
+	}
+
+	D3D11_BUFFER_DESC buffer_desc{};
+	buffer_desc.ByteWidth = sizeof(constants);
+	buffer_desc.Usage = D3D11_USAGE_DEFAULT;
+	buffer_desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	hr = device->CreateBuffer(&buffer_desc, nullptr, constant_buffer.GetAddressOf());
+	_ASSERT_EXPR(SUCCEEDED(hr), hr_trace(hr));
+
+	D3D11_TEXTURE2D_DESC texture2d_desc{};
+	const DWORD dummy_values[2]{ 0xFFFFFFFF, 0xFFFF7F7F };
+	for (material& material : materials)
+	{
+		for (size_t i = 0; i < 2; ++i)
 		{
-			// map_bump - options args filename
-			//
-			// Specifies that a bump texture file or a bump procedural texture file is
-			// linked to the material.
-			//
-			// "filename" is the name of a bump texture file(.mpb), a bump procedural
-			// texture file(.cxb), or an image file.
-			fin.ignore();
-			wchar_t map_bump[256];
-			fin >> map_bump;
-			
-			std::filesystem::path path(obj_filename);
-			path.replace_filename(std::filesystem::path(map_bump).filename());
-			materials.rbegin()->texture_filenames[1] = path;
-			fin.ignore(1024, L'\n');
+			auto decoded{ std::find_if(data.textures.begin(), data.textures.end(), [&](const decoded_texture& t) { return t.filename == material.texture_filenames[i]; }) };
+			if (material.texture_filenames[i].size() > 0 && decoded != data.textures.end())
+			{
+				create_texture_from_decoded(device, *decoded, material.shader_resource_views[i].GetAddressOf(), &texture2d_desc);
+			}
+			else
+			{
+				make_dummy_texture(device, material.shader_resource_views[i].GetAddressOf(), dummy_values[i], 16);
+			}
 		}
-		else if (0 == wcscmp(command, L"newmtl"))
+	}
+}
+
+raster_mesh static_mesh::make_raster_mesh(const source& data, size_t lod)
+{
+	raster_mesh mesh;
+	const size_t vertex_count{ data.vertex_data_size() / data.vertex_stride };
+	mesh.positions.resize(vertex_count * 3);
+	for (size_t v = 0; v < vertex_count; ++v)
+	{
+		const uint8_t* p{ data.vertex_data() + v * data.vertex_stride };
+		if (data.vertex_stride == sizeof(quantized_vertex))
 		{
-			// The folowing syntax describes the material name statement.
-			//
-			//	newmtl name
-			//
-			// Specifies the start of a material description and assigns a name to the
-			// material.An.mtl file must have one newmtl statement at the start of
-			// each material description.
-			// "name" is the name of the material.Names may be any length but
-			// cannot include blanks.Underscores may be used in material names.material material;
-			fin.ignore();
-			wchar_t newmtl[256];
-			material material;
-			fin >> newmtl;
-			material.name = newmtl;
-			materials.push_back(material);
+			// As the quantized vertex shader : offset + unorm position * scale.
+			const quantized_vertex* q{ reinterpret_cast<const quantized_vertex*>(p) };
+			const float* offset{ &data.position_offset.x };
+			const float* scale{ &data.position_scale.x };
+			for (int k = 0; k < 3; ++k)
+			{
+				mesh.positions[v * 3 + k] = offset[k] + q->position[k] / 65535.0f * scale[k];
+			}
 		}
-		else if (0 == wcscmp(command, L"Ka"))
+		else
 		{
-			// Ka r g b
-			//
-			// The Ka statement specifies the ambient reflectivity using RGB values.
-			// "r g b" are the values for the red, green, and blue components of the
-			// color.The g and b arguments are optional.If only r is specified,
-			// then g, and b are assumed to be equal to r.The r g b values are
-			// normally in the range of 0.0 to 1.0.Values outside this range increase
-			// or decrease the relectivity accordingly.
-			float r, g, b;
-			fin >> r >> g >> b;
-			materials.rbegin()->Ka = { r, g, b, 1 };
-			fin.ignore(1024, L'\n');
+			memcpy(&mesh.positions[v * 3], &reinterpret_cast<const vertex*>(p)->position, sizeof(XMFLOAT3));
 		}
-		else if (0 == wcscmp(command, L"Kd"))
+	}
+
+	const static_mesh::lod& level{ data.lods[std::min(lod, data.lods.size() - 1)] };
+	for (uint32_t d = level.draw_start; d < level.draw_start + level.draw_count; ++d)
+	{
+		const draw& draw{ data.draws[d] };
+		raster_mesh::draw raster_draw{ static_cast<uint32_t>(mesh.indices.size()), draw.index_count };
+		memcpy(raster_draw.color, &data.materials[draw.material_index].Kd, sizeof(raster_draw.color));
+		mesh.draws.push_back(raster_draw);
+
+		const uint8_t* indices{ data.indices.data() + draw.index_byte_offset };
+		for (uint32_t i = draw.index_location; i < draw.index_location + draw.index_count; ++i)
 		{
-			// Kd r g b
-			//
-			// The Kd statement specifies the diffuse reflectivity using RGB values.
-			// "r g b" are the values for the red, green, and blue components of the
-			// atmosphere.The g and b arguments are optional.If only r is
-			// specified, then g, and b are assumed to be equal to r.The r g b values
-			// are normally in the range of 0.0 to 1.0.Values outside this range
-			// increase or decrease the relectivity accordingly.
-			float r, g, b;
-			fin >> r >> g >> b;
-			materials.rbegin()->Kd = { r, g, b, 1 };
-			fin.ignore(1024, L'\n');
+			uint32_t index;
+			if (draw.index_format == DXGI_FORMAT_R16_UINT)
+			{
+				uint16_t index16;
+				memcpy(&index16, indices + i * sizeof(uint16_t), sizeof(uint16_t));
+				index = index16;
+			}
+			else
+			{
+				memcpy(&index, indices + i * sizeof(uint32_t), sizeof(uint32_t));
+			}
+			mesh.indices.push_back(index + draw.base_vertex);
 		}
-		else if (0 == wcscmp(command, L"Ks"))
+	}
+	return mesh;
+}
+
+void static_mesh::render(ID3D11DeviceContext* immediate_context, const XMFLOAT4X4& world, const XMFLOAT4& material_color, size_t lod)
+{
+	const static_mesh::lod& level{ lods[std::min(lod, lods.size() - 1)] };
+
+	statistics = {};
+	uint32_t stride{ vertex_stride };
+	uint32_t offset{ 0 };
+	immediate_context->IASetVertexBuffers(0, 1, vertex_buffer.GetAddressOf(), &stride, &offset);
+	++statistics.state_changes;
+	immediate_context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	++statistics.state_changes;
+	if (!constant_ring)
+	{
+		immediate_context->VSSetConstantBuffers(0, 1, constant_buffer.GetAddressOf());
+		++statistics.state_changes;
+		immediate_context->PSSetConstantBuffers(0, 1, constant_buffer.GetAddressOf());
+		++statistics.state_changes;
+	}
+
+	// Material state and the index buffer are rebound only where the draw list changes them.
+	uint32_t bound_material_index{ UINT32_MAX };
+	DXGI_FORMAT bound_index_format{ DXGI_FORMAT_UNKNOWN };
+	uint32_t bound_index_byte_offset{ 0 };
+	for (uint32_t d = level.draw_start; d < level.draw_start + level.draw_count; ++d)
+	{
+		const draw& draw{ draws[d] };
+		if (draw.material_index != bound_material_index)
 		{
-			// Ks r g b
-			//
-			// The Ks statement specifies the specular reflectivity using RGB values.
-			// "r g b" are the values for the red, green, and blue components of the
-			// atmosphere.The g and b arguments are optional.If only r is
-			// specified, then g, and b are assumed to be equal to r.The r g b values
-			// are normally in the range of 0.0 to 1.0.Values outside this range
-			// increase or decrease the relectivity accordingly.
-			float r, g, b;
-			fin >> r >> g >> b;
-			materials.rbegin()->Ks = { r, g, b, 1 };
-			fin.ignore(1024, L'\n');
+			bind_material(immediate_context, draw.material_index, world, material_color);
+			bound_material_index = draw.material_index;
 		}
-		else
+		if (draw.index_format != bound_index_format || draw.index_byte_offset != bound_index_byte_offset)
 		{
-			fin.ignore(1024, L'\n');
+			immediate_context->IASetIndexBuffer(index_buffer.Get(), draw.index_format, draw.index_byte_offset);
+			++statistics.state_changes;
+			bound_index_format = draw.index_format;
+			bound_index_byte_offset = draw.index_byte_offset;
 		}
+		immediate_context->DrawIndexed(draw.index_count, draw.index_location, draw.base_vertex);
+		++statistics.draw_calls;
 	}
-	fin.close();
+}
 
-	create_com_buffers(device, vertices.data(), vertices.size(), indices.data(), indices.size());
+void static_mesh::render_instanced(ID3D11DeviceContext* immediate_context, const XMFLOAT4X4* worlds, const uint32_t* instances, size_t instance_count,
+	const XMFLOAT4& material_color, size_t lod)
+{
+	statistics = {};
+	if (instance_count == 0)
+	{
+		return;
+	}
+	const static_mesh::lod& level{ lods[std::min(lod, lods.size() - 1)] };
 
 	HRESULT hr{ S_OK };
-
-	D3D11_BUFFER_DESC buffer_desc{};
-	buffer_desc.ByteWidth = sizeof(constants);
-	buffer_desc.Usage = D3D11_USAGE_DEFAULT;
-	buffer_desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-	hr = device->CreateBuffer(&buffer_desc, nullptr, constant_buffer.GetAddressOf());
+	if (instance_capacity < instance_count)
+	{
+		instance_capacity = std::max(instance_count, instance_capacity * 2);
+		Microsoft::WRL::ComPtr<ID3D11Device> device;
+		immediate_context->GetDevice(device.GetAddressOf());
+		D3D11_BUFFER_DESC buffer_desc{};
+		buffer_desc.ByteWidth = static_cast<UINT>(sizeof(XMFLOAT4X4) * instance_capacity);
+		buffer_desc.Usage = D3D11_USAGE_DYNAMIC;
+		buffer_desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+		buffer_desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		hr = device->CreateBuffer(&buffer_desc, nullptr, instance_buffer.ReleaseAndGetAddressOf());
+		_ASSERT_EXPR(SUCCEEDED(hr), hr_trace(hr));
+	}
+	D3D11_MAPPED_SUBRESOURCE mapped_subresource{};
+	hr = immediate_context->Map(instance_buffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped_subresource);
 	_ASSERT_EXPR(SUCCEEDED(hr), hr_trace(hr));
+	pack_instance_worlds(worlds, instances, instance_count, static_cast<XMFLOAT4X4*>(mapped_subresource.pData));
+	immediate_context->Unmap(instance_buffer.Get(), 0);
+	++statistics.state_changes;
 
-	if (materials.size() == 0)
+	ID3D11Buffer* vertex_buffers[2]{ vertex_buffer.Get(), instance_buffer.Get() };
+	uint32_t strides[2]{ vertex_stride, sizeof(XMFLOAT4X4) };
+	uint32_t offsets[2]{ 0, 0 };
+	immediate_context->IASetVertexBuffers(0, 2, vertex_buffers, strides, offsets);
+	++statistics.state_changes;
+	immediate_context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	++statistics.state_changes;
+	if (!constant_ring)
 	{
-		for (const subset& subset : subsets)
+		immediate_context->VSSetConstantBuffers(0, 1, constant_buffer.GetAddressOf());
+		++statistics.state_changes;
+		immediate_context->PSSetConstantBuffers(0, 1, constant_buffer.GetAddressOf());
+		++statistics.state_changes;
+	}
+
+	// The world matrix of the constant buffer is not read by the instanced shaders; only the material part matters.
+	const XMFLOAT4X4 identity{ 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+	const UINT count{ static_cast<UINT>(instance_count) };
+	uint32_t bound_material_index{ UINT32_MAX };
+	DXGI_FORMAT bound_index_format{ DXGI_FORMAT_UNKNOWN };
+	uint32_t bound_index_byte_offset{ 0 };
+	for (uint32_t d = level.draw_start; d < level.draw_start + level.draw_count; ++d)
+	{
+		const draw& draw{ draws[d] };
+		if (draw.material_index != bound_material_index)
+		{
+			bind_material(immediate_context, draw.material_index, identity, material_color);
+			bound_material_index = draw.material_index;
+		}
+		if (draw.index_format != bound_index_format || draw.index_byte_offset != bound_index_byte_offset)
 		{
-			materials.push_back({ subset.usemtl });
+			immediate_context->IASetIndexBuffer(index_buffer.Get(), draw.index_format, draw.index_byte_offset);
+			++statistics.state_changes;
+			bound_index_format = draw.index_format;
+			bound_index_byte_offset = draw.index_byte_offset;
 		}
+		immediate_context->DrawIndexedInstanced(draw.index_count, count, draw.index_location, draw.base_vertex, 0);
+		++statistics.draw_calls;
 	}
+}
 
-	D3D11_TEXTURE2D_DESC texture2d_desc{};
-	//load_texture_from_file(device, texture_filename.c_str(), shader_resource_view.GetAddressOf(), &texture2d_desc);
-	for (material& material : materials)
+size_t static_mesh::select_lod(float distance, float world_scale, float projection_scale, float pixel_threshold) const
+{
+	if (distance <= 0.0f)
+	{
+		return 0;
+	}
+	for (size_t lod = lods.size() - 1; lod > 0; --lod)
 	{
-		//load_texture_from_file(device, material.texture_filename.c_str(), material.shader_resource_view.GetAddressOf(), &texture2d_desc);
-		if (material.texture_filenames[0].size() > 0)
+		if (lods[lod].error * world_scale / distance * projection_scale <= pixel_threshold)
 		{
-			load_texture_from_file(device, material.texture_filenames[0].c_str(), material.shader_resource_views[0].GetAddressOf(), &texture2d_desc);
+			return lod;
 		}
-		else
+	}
+	return 0;
+}
+
+void static_mesh::bind_material(ID3D11DeviceContext* immediate_context, uint32_t material_index, const XMFLOAT4X4& world, const XMFLOAT4& material_color)
+{
+	const material& material{ materials[material_index] };
+	ID3D11ShaderResourceView* shader_resource_views[2]{ material.shader_resource_views[0].Get(), material.shader_resource_views[1].Get() };
+	immediate_context->PSSetShaderResources(0, 2, shader_resource_views);
+	++statistics.state_changes;
+
+	const constants data{ make_constants(material_index, world, material_color) };
+	if (constant_ring)
+	{
+		const constant_buffer_ring::slice slice{ constant_ring->push(data) };
+		++statistics.state_changes;	// one Map/Unmap
+		constant_ring->bind(0, slice);
+		statistics.state_changes += 2;	// VSSetConstantBuffers1 and PSSetConstantBuffers1
+	}
+	else
+	{
+		immediate_context->UpdateSubresource(constant_buffer.Get(), 0, 0, &data, 0, 0);
+		++statistics.state_changes;
+	}
+}
+
+static_mesh::constants static_mesh::make_constants(uint32_t material_index, const XMFLOAT4X4& world, const XMFLOAT4& material_color) const
+{
+	const material& material{ materials[material_index] };
+	constants data{ world, material.Ka, material.Kd, material.Ks, position_offset, position_scale };
+	XMStoreFloat4(&data.kd, XMLoadFloat4(&material_color) * XMLoadFloat4(&material.Kd));
+	return data;
+}
+
+void static_mesh::record(command_stream& stream, const XMFLOAT4X4& world, const XMFLOAT4& material_color, size_t lod) const
+{
+	stream.set_vertex_buffer(vertex_buffer.Get(), vertex_stride, 0);
+	record_draws(stream, lods[std::min(lod, lods.size() - 1)], world, material_color, 0);
+}
+
+void static_mesh::record_instanced(command_stream& stream, const XMFLOAT4X4* worlds, const uint32_t* instances, size_t instance_count,
+	const XMFLOAT4& material_color, size_t lod) const
+{
+	if (instance_count == 0)
+	{
+		return;
+	}
+	const uint32_t count{ static_cast<uint32_t>(instance_count) };
+	pack_instance_worlds(worlds, instances, instance_count, static_cast<XMFLOAT4X4*>(stream.set_instances(sizeof(XMFLOAT4X4), count)));
+	stream.set_vertex_buffer(vertex_buffer.Get(), vertex_stride, 0);
+	// The world matrix of the constants is not read by the instanced shaders.
+	const XMFLOAT4X4 identity{ 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+	record_draws(stream, lods[std::min(lod, lods.size() - 1)], identity, material_color, count);
+}
+
+// Same draw list walk as render : material and index buffer bindings only where they change.
+void static_mesh::record_draws(command_stream& stream, const lod& level, const XMFLOAT4X4& world, const XMFLOAT4& material_color, uint32_t instance_count) const
+{
+	stream.set_topology(command_stream::triangle_list);
+	uint32_t bound_material_index{ UINT32_MAX };
+	DXGI_FORMAT bound_index_format{ DXGI_FORMAT_UNKNOWN };
+	uint32_t bound_index_byte_offset{ 0 };
+	for (uint32_t d = level.draw_start; d < level.draw_start + level.draw_count; ++d)
+	{
+		const draw& draw{ draws[d] };
+		if (draw.material_index != bound_material_index)
 		{
-			make_dummy_texture(device, material.shader_resource_views[0].GetAddressOf(), 0xFFFFFFFF, 16);
+			const material& material{ materials[draw.material_index] };
+			ID3D11ShaderResourceView* shader_resource_views[2]{ material.shader_resource_views[0].Get(), material.shader_resource_views[1].Get() };
+			stream.set_shader_resources(0, 2, shader_resource_views);
+			stream.set_constants(0, make_constants(draw.material_index, world, material_color));
+			bound_material_index = draw.material_index;
 		}
-		if (material.texture_filenames[1].size() > 0)
+		if (draw.index_format != bound_index_format || draw.index_byte_offset != bound_index_byte_offset)
 		{
-			load_texture_from_file(device, material.texture_filenames[1].c_str(), material.shader_resource_views[1].GetAddressOf(), &texture2d_desc);
+			stream.set_index_buffer(index_buffer.Get(), draw.index_format == DXGI_FORMAT_R16_UINT ? 2 : 4, draw.index_byte_offset);
+			bound_index_format = draw.index_format;
+			bound_index_byte_offset = draw.index_byte_offset;
+		}
+		if (instance_count > 0)
+		{
+			stream.draw_indexed_instanced(draw.index_count, instance_count, draw.index_location, draw.base_vertex);
 		}
 		else
 		{
-			make_dummy_texture(device, material.shader_resource_views[1].GetAddressOf(), 0xFFFF7F7F, 16);
+			stream.draw_indexed(draw.index_count, draw.index_location, draw.base_vertex);
 		}
 	}
+}
 
-	for (const vertex& v : vertices)
+meshlet_cull_statistics static_mesh::render_culled(ID3D11DeviceContext* immediate_context, const XMFLOAT4X4& world, const XMFLOAT4& material_color,
+	const XMFLOAT4X4& view_projection, const XMFLOAT3& camera_position)
+{
+	if (!culled_index_buffer)
 	{
-		bounding_box[0].x = std::min<float>(bounding_box[0].x, v.position.x);
-		bounding_box[0].y = std::min<float>(bounding_box[0].y, v.position.y);
-		bounding_box[0].z = std::min<float>(bounding_box[0].z, v.position.z);
-		bounding_box[1].x = std::max<float>(bounding_box[1].x, v.position.x);
-		bounding_box[1].y = std::max<float>(bounding_box[1].y, v.position.y);
-		bounding_box[1].z = std::max<float>(bounding_box[1].z, v.position.z);
+		render(immediate_context, world, material_color);
+		return {};
 	}
-}
 
-void static_mesh::render(ID3D11DeviceContext* immediate_context, const XMFLOAT4X4& world, const XMFLOAT4& material_color)
-{
-	uint32_t stride{ sizeof(vertex) };
+	// Cull in object space : the frustum of world * view_projection and the camera moved by the inverse world.
+	XMMATRIX W{ XMLoadFloat4x4(&world) };
+	XMFLOAT4X4 world_view_projection;
+	XMStoreFloat4x4(&world_view_projection, W * XMLoadFloat4x4(&view_projection));
+	const frustum object_frustum{ extract_frustum(&world_view_projection._11) };
+	XMFLOAT3 object_camera_position;
+	XMStoreFloat3(&object_camera_position, XMVector3TransformCoord(XMLoadFloat3(&camera_position), XMMatrixInverse(nullptr, W)));
+
+	meshlet_cull_statistics cull_statistics;
+	culled_indices.clear();
+	culled_ranges.clear();
+	for (const subset& subset : subsets)
+	{
+		const uint32_t index_start{ static_cast<uint32_t>(culled_indices.size()) };
+		meshlet_cull_statistics s{ cull_meshlets(meshlets, subset.meshlet_start, subset.meshlet_count, object_frustum, &object_camera_position.x, culled_indices) };
+		culled_ranges.push_back({ index_start, static_cast<uint32_t>(culled_indices.size()) - index_start });
+		cull_statistics.meshlet_count += s.meshlet_count;
+		cull_statistics.frustum_culled += s.frustum_culled;
+		cull_statistics.backface_culled += s.backface_culled;
+	}
+	if (culled_indices.empty())
+	{
+		statistics = {};
+		return cull_statistics;
+	}
+
+	statistics = {};
+	HRESULT hr{ S_OK };
+	D3D11_MAPPED_SUBRESOURCE mapped_subresource{};
+	hr = immediate_context->Map(culled_index_buffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped_subresource);
+	_ASSERT_EXPR(SUCCEEDED(hr), hr_trace(hr));
+	memcpy(mapped_subresource.pData, culled_indices.data(), sizeof(uint32_t) * culled_indices.size());
+	immediate_context->Unmap(culled_index_buffer.Get(), 0);
+	++statistics.state_changes;
+
+	uint32_t stride{ vertex_stride };
 	uint32_t offset{ 0 };
 	immediate_context->IASetVertexBuffers(0, 1, vertex_buffer.GetAddressOf(), &stride, &offset);
-	immediate_context->IASetIndexBuffer(index_buffer.Get(), DXGI_FORMAT_R32_UINT, 0);
+	++statistics.state_changes;
+	immediate_context->IASetIndexBuffer(culled_index_buffer.Get(), DXGI_FORMAT_R32_UINT, 0);
+	++statistics.state_changes;
 	immediate_context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-
-	for (const material& material : materials)
+	++statistics.state_changes;
+	if (!constant_ring)
 	{
-		immediate_context->PSSetShaderResources(0, 1, material.shader_resource_views[0].GetAddressOf());
-		immediate_context->PSSetShaderResources(1, 1, material.shader_resource_views[1].GetAddressOf());
-
-		//constants data{ world, material_color };
-		//XMStoreFloat4(&data.material_color, XMLoadFloat4(&material_color) * XMLoadFloat4(&material.Kd));
-		constants data{ world,material.Ka,material.Kd,material.Ks };
-		XMStoreFloat4(&data.kd, XMLoadFloat4(&material_color) * XMLoadFloat4(&material.Kd));
-		immediate_context->UpdateSubresource(constant_buffer.Get(), 0, 0, &data, 0, 0);
-		immediate_context->VSSetConstantBuffers(0, 1, constant_buffer.GetAddressOf());
-		immediate_context->PSSetConstantBuffers(0,1,constant_buffer.GetAddressOf());
-		
-		immediate_context->UpdateSubresource(constant_buffer.Get(), 0, 0, &data, 0, 0);
 		immediate_context->VSSetConstantBuffers(0, 1, constant_buffer.GetAddressOf());
+		++statistics.state_changes;
+		immediate_context->PSSetConstantBuffers(0, 1, constant_buffer.GetAddressOf());
+		++statistics.state_changes;
+	}
 
-		for (const subset& subset : subsets)
+	// Subsets are grouped by material, so each material is bound once.
+	uint32_t bound_material_index{ UINT32_MAX };
+	for (size_t i = 0; i < subsets.size(); ++i)
+	{
+		const index_range& range{ culled_ranges[i] };
+		const uint32_t material_index{ subsets[i].material_index };
+		if (material_index == UINT32_MAX || range.index_count == 0)
 		{
-			if (material.name == subset.usemtl)
-			{
-				immediate_context->DrawIndexed(subset.index_count, subset.index_start, 0);
-			}
+			continue;
+		}
+		if (material_index != bound_material_index)
+		{
+			bind_material(immediate_context, material_index, world, material_color);
+			bound_material_index = material_index;
 		}
+		immediate_context->DrawIndexed(range.index_count, range.index_start, 0);
+		++statistics.draw_calls;
 	}
+	return cull_statistics;
 }
 
-void static_mesh::create_com_buffers(ID3D11Device* device, vertex* vertices, size_t vertex_count, uint32_t* indices, size_t index_count)
+void static_mesh::create_com_buffers(ID3D11Device* device, const void* vertices, size_t vertices_size, const void* indices, size_t indices_size)
 {
 	HRESULT hr = S_OK;
 
 	D3D11_BUFFER_DESC buffer_desc{};
 	D3D11_SUBRESOURCE_DATA subresource_data{};
-	buffer_desc.ByteWidth = static_cast<UINT>(sizeof(vertex) * vertex_count);
+	buffer_desc.ByteWidth = static_cast<UINT>(vertices_size);
 	buffer_desc.Usage = D3D11_USAGE_DEFAULT;
 	buffer_desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
 	buffer_desc.CPUAccessFlags = 0;
@@ -407,7 +717,7 @@ void static_mesh::create_com_buffers(ID3D11Device* device, vertex* vertices, siz
 	hr = device->CreateBuffer(&buffer_desc, &subresource_data, vertex_buffer.ReleaseAndGetAddressOf());
 	_ASSERT_EXPR(SUCCEEDED(hr), hr_trace(hr));
 
-	buffer_desc.ByteWidth = static_cast<UINT>(sizeof(uint32_t) * index_count);
+	buffer_desc.ByteWidth = static_cast<UINT>(indices_size);
 	buffer_desc.Usage = D3D11_USAGE_DEFAULT;
 	buffer_desc.BindFlags = D3D11_BIND_INDEX_BUFFER;
 	subresource_data.pSysMem = indices;
@@ -7,6 +7,17 @@
 #include <string>
 
 #include <vector>
+#include <future>
+
+#include "meshlet.h"
+#include "mesh_cache.h"
+#include "vertex_quantization.h"
+#include "index_packing.h"
+#include "texture.h"
+#include "instancing.h"
+#include "constant_buffer_ring.h"
+#include "command_stream.h"
+#include "software_rasterizer.h"
 
 class static_mesh
 {
@@ -24,13 +35,32 @@ public:
 		DirectX::XMFLOAT4 ka;
 		DirectX::XMFLOAT4 kd;
 		DirectX::XMFLOAT4 ks;
+		// Dequantization of quantized_vertex positions : position = position_offset + position * position_scale.
+		DirectX::XMFLOAT4 position_offset;
+		DirectX::XMFLOAT4 position_scale;
 	};
+	// Input layouts of 'vertex' and of 'quantized_vertex', for the vertex shader bound by the caller.
+	static const D3D11_INPUT_ELEMENT_DESC input_element_desc[3];
+	static const D3D11_INPUT_ELEMENT_DESC quantized_input_element_desc[3];
+	// The same layouts followed by the per-instance world matrix (WORLD0-3, slot 1) read by render_instanced.
+	static const D3D11_INPUT_ELEMENT_DESC instanced_input_element_desc[7];
+	static const D3D11_INPUT_ELEMENT_DESC quantized_instanced_input_element_desc[7];
 
 	struct subset
 	{
 		std::wstring usemtl;
 		uint32_t index_start{ 0 }; 	// start position of index buffer
 		uint32_t index_count{ 0 }; 	// number of vertices (indices)
+		uint32_t meshlet_start{ 0 };	// first meshlet of the subset in 'meshlets'
+		uint32_t meshlet_count{ 0 };
+
+		// Where the subset lives in index_buffer, which mixes 16-bit and 32-bit ranges (see pack_indices).
+		DXGI_FORMAT index_format{ DXGI_FORMAT_R32_UINT };
+		uint32_t index_byte_offset{ 0 };	// offset to bind index_buffer at
+		uint32_t index_location{ 0 };	// start index relative to index_byte_offset
+		int32_t base_vertex{ 0 };
+
+		uint32_t material_index{ UINT32_MAX };	// index into 'materials' resolved at load time, UINT32_MAX if usemtl has no material
 	};
 	std::vector<subset> subsets;
 
@@ -45,20 +75,143 @@ public:
 	};
 	std::vector<material> materials;
 
+	// Clusters of each subset, built when 'build_meshlets' is requested.
+	meshlet_data meshlets;
+
+	// Levels of detail generated with 'generate_lods'. lods[0] is the full detail mesh; every level draws
+	// from the same vertex buffer.
+	struct lod
+	{
+		float error{ 0.0f };	// object space geometric error of the level
+		uint32_t triangle_count{ 0 };
+		uint32_t draw_start{ 0 };	// range of the level in the draw list
+		uint32_t draw_count{ 0 };
+	};
+	std::vector<lod> lods;
+
+	// API calls issued by the last render or render_culled call.
+	struct render_statistics
+	{
+		uint32_t draw_calls{ 0 };
+		uint32_t state_changes{ 0 };	// every non-draw call : bindings, and buffer updates counted once per Map/Unmap
+	};
+
 	DirectX::XMFLOAT3 bounding_box[2]{ { D3D11_FLOAT32_MAX, D3D11_FLOAT32_MAX, D3D11_FLOAT32_MAX }, { -D3D11_FLOAT32_MAX, -D3D11_FLOAT32_MAX, -D3D11_FLOAT32_MAX } };
 
 private:
 	Microsoft::WRL::ComPtr<ID3D11Buffer> vertex_buffer;
 	Microsoft::WRL::ComPtr<ID3D11Buffer> index_buffer;
+	uint32_t vertex_stride{ sizeof(vertex) };
+	DirectX::XMFLOAT4 position_offset{ 0.0f, 0.0f, 0.0f, 0.0f };
+	DirectX::XMFLOAT4 position_scale{ 1.0f, 1.0f, 1.0f, 1.0f };
 
 	Microsoft::WRL::ComPtr<ID3D11Buffer> constant_buffer;
+	// When set, the material constants are pushed to this ring instead of being written to constant_buffer.
+	constant_buffer_ring* constant_ring{ nullptr };
+
+	// Dynamic index buffer refilled by render_culled with the indices of the visible meshlets.
+	Microsoft::WRL::ComPtr<ID3D11Buffer> culled_index_buffer;
+	std::vector<uint32_t> culled_indices;
+	std::vector<index_range> culled_ranges;	// where each subset's visible indices start in culled_indices
+
+	// Dynamic per-instance vertex buffer refilled by render_instanced, grown on demand.
+	Microsoft::WRL::ComPtr<ID3D11Buffer> instance_buffer;
+	size_t instance_capacity{ 0 };
+
+	// Flat draw list built at load time : one entry per run of index ranges sharing a material and an
+	// index buffer binding, grouped by material.
+	struct draw
+	{
+		uint32_t material_index;
+		DXGI_FORMAT index_format;
+		uint32_t index_byte_offset;
+		uint32_t index_location;
+		uint32_t index_count;
+		int32_t base_vertex;
+	};
+	std::vector<draw> draws;
+
+	render_statistics statistics;
 
 public:
-	static_mesh(ID3D11Device* device, const wchar_t* obj_filename, bool flipping_v_coordinates);
+	// Optional processing done once at load time. The result is stored in the binary mesh cache.
+	enum optimization : uint32_t
+	{
+		optimize_vertex_cache = 1 << 0,	// reorder the triangles of each subset for post-transform cache reuse
+		optimize_overdraw = 1 << 1,	// then reorder clusters of triangles of each subset to reduce overdraw
+		build_meshlets = 1 << 2,	// split each subset into meshlets for render_culled (rebuilt at every load, not cached)
+		quantize_vertices = 1 << 3,	// upload 16 byte quantized_vertex instead of vertex (encoded at every load, not cached)
+		generate_lods = 1 << 4,	// simplify each subset into a chain of levels of detail (generated at every load, not cached)
+	};
+
+	// Everything the mesh needs before the device is involved : parsed or cached geometry after the optional processing,
+	// the packed vertex and index buffer contents, the draw list and the decoded material textures.
+	struct source
+	{
+		std::vector<subset> subsets;
+		std::vector<material> materials;
+		meshlet_data meshlets;
+		std::vector<lod> lods;
+		std::vector<draw> draws;
+		DirectX::XMFLOAT3 bounding_box[2]{ { D3D11_FLOAT32_MAX, D3D11_FLOAT32_MAX, D3D11_FLOAT32_MAX }, { -D3D11_FLOAT32_MAX, -D3D11_FLOAT32_MAX, -D3D11_FLOAT32_MAX } };
+
+		uint32_t vertex_stride{ sizeof(vertex) };
+		DirectX::XMFLOAT4 position_offset{ 0.0f, 0.0f, 0.0f, 0.0f };
+		DirectX::XMFLOAT4 position_scale{ 1.0f, 1.0f, 1.0f, 1.0f };
+		// Vertex buffer contents, vertex_stride bytes per vertex : 'vertices', or the vertex blob of 'cache' when the
+		// mesh comes unquantized from its cache, so that the mapped file is uploaded without a copy.
+		std::vector<uint8_t> vertices;
+		mesh_cache cache;
+		const uint8_t* vertex_data() const { return cache.is_open() ? reinterpret_cast<const uint8_t*>(cache.vertices()) : vertices.data(); }
+		size_t vertex_data_size() const { return cache.is_open() ? cache.vertex_count() * sizeof(vertex) : vertices.size(); }
+		std::vector<uint8_t> indices;
+		size_t culled_index_count{ 0 };	// size of the render_culled index buffer, 0 without 'build_meshlets'
+
+		std::vector<decoded_texture> textures;
+	};
+	// Does all the file reading and CPU work of the constructor without touching the device, so it can run on any thread.
+	static source load_source(const wchar_t* obj_filename, bool flipping_v_coordinates, uint32_t optimizations = 0);
+	// load_source on a worker thread. Construct the mesh from the result on the thread that owns the device.
+	static std::future<source> load_source_async(const wchar_t* obj_filename, bool flipping_v_coordinates, uint32_t optimizations = 0);
+	// The triangles of level 'lod' of 'data' for the software rasterizer : positions decoded from either vertex
+	// layout, indices unpacked to 32 bits, one draw per draw of the level colored by its material diffuse color.
+	static raster_mesh make_raster_mesh(const source& data, size_t lod = 0);
+
+	static_mesh(ID3D11Device* device, const wchar_t* obj_filename, bool flipping_v_coordinates, uint32_t optimizations = 0);
+	// Only creates the device objects : buffers, textures and constant buffer.
+	static_mesh(ID3D11Device* device, source&& data);
 	virtual ~static_mesh() = default;
 
-	void render(ID3D11DeviceContext* immediate_context, const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT4& material_color);
+	// True when the vertex buffer holds quantized_vertex : draw with quantized_input_element_desc and a decoding vertex shader.
+	bool is_quantized() const { return vertex_stride == sizeof(quantized_vertex); }
+	// Takes the per-draw constants from 'ring' (which must outlive the mesh) instead of the mesh's own constant buffer.
+	void set_constant_buffer_ring(constant_buffer_ring* ring) { constant_ring = ring; }
+
+	void render(ID3D11DeviceContext* immediate_context, const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT4& material_color, size_t lod = 0);
+	// Coarsest level whose error, seen from 'distance' away, projects to at most 'pixel_threshold' pixels.
+	// 'world_scale' is the largest scale factor of the world matrix and 'projection_scale' is the viewport
+	// height divided by 2 * tan(fovy / 2) (projection._22 * height / 2).
+	size_t select_lod(float distance, float world_scale, float projection_scale, float pixel_threshold = 1.0f) const;
+	// Draws 'instance_count' copies of level 'lod' with one DrawIndexedInstanced per draw entry. Instance i uses
+	// worlds[instances[i]], or worlds[i] when 'instances' is null. Needs a vertex shader that reads the world
+	// matrix from the instance layouts (instanced_input_element_desc) instead of the constant buffer.
+	void render_instanced(ID3D11DeviceContext* immediate_context, const DirectX::XMFLOAT4X4* worlds, const uint32_t* instances, size_t instance_count,
+		const DirectX::XMFLOAT4& material_color, size_t lod = 0);
+	// Draws only the meshlets that intersect the view frustum and are not entirely back facing.
+	// Falls back to render when the mesh was loaded without 'build_meshlets'.
+	meshlet_cull_statistics render_culled(ID3D11DeviceContext* immediate_context, const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT4& material_color,
+		const DirectX::XMFLOAT4X4& view_projection, const DirectX::XMFLOAT3& camera_position);
+	const render_statistics& last_render_statistics() const { return statistics; }
+
+	// render and render_instanced recorded into a command stream instead of issued to the context. They only read the
+	// mesh, so several threads may record the same mesh at once. The stream counts the draws and state changes.
+	void record(command_stream& stream, const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT4& material_color, size_t lod = 0) const;
+	void record_instanced(command_stream& stream, const DirectX::XMFLOAT4X4* worlds, const uint32_t* instances, size_t instance_count,
+		const DirectX::XMFLOAT4& material_color, size_t lod = 0) const;
 
 protected:
-	void create_com_buffers(ID3D11Device* device, vertex* vertices, size_t vertex_count, uint32_t* indices, size_t index_count);
+	void bind_material(ID3D11DeviceContext* immediate_context, uint32_t material_index, const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT4& material_color);
+	constants make_constants(uint32_t material_index, const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT4& material_color) const;
+	void record_draws(command_stream& stream, const lod& level, const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT4& material_color, uint32_t instance_count) const;
+	void create_com_buffers(ID3D11Device* device, const void* vertices, size_t vertices_size, const void* indices, size_t indices_size);
 };
@@ -0,0 +1,105 @@
+#include "command_stream.h"
+
+#include <thread>
+
+#include "benchmark.h"
+#include "recording_command_backend.h"
+
+// Recording 100k draws (a quarter of them instanced, 16 instances each) into 1 and 4 command streams with
+// record_parallel, and replaying them to recording_command_backend. Replaying 7 parallel streams must give the
+// commands of one serial stream.
+//
+//   bench_command_stream
+int main()
+{
+	const size_t draw_count{ 100000 };
+	const float world[16]{ 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+	struct
+	{
+		float world_view_projection[16];
+		float world[16];
+		float material_color[4];
+		float material[4];
+	} constants{};
+	// The commands static_mesh records per draw, with a shader change every 50 draws. The pointers are never
+	// dereferenced.
+	ID3D11Buffer* vertex_buffer{ reinterpret_cast<ID3D11Buffer*>(8) };
+	ID3D11Buffer* index_buffer{ reinterpret_cast<ID3D11Buffer*>(16) };
+	auto record = [&](command_stream& stream, size_t first, size_t last)
+	{
+		for (size_t i = first; i < last; ++i)
+		{
+			if (i % 50 == 0)
+			{
+				stream.set_input_layout(nullptr);
+				stream.set_vertex_shader(nullptr);
+				stream.set_pixel_shader(nullptr);
+			}
+			stream.set_vertex_buffer(vertex_buffer, 32, 0);
+			stream.set_index_buffer(index_buffer, 4, 0);
+			stream.set_constants(0, constants);
+			if (i % 4 == 0)
+			{
+				float* instances{ static_cast<float*>(stream.set_instances(sizeof(world), 16)) };
+				for (int k = 0; k < 16; ++k)
+				{
+					memcpy(instances + 16 * k, world, sizeof(world));
+				}
+				stream.draw_indexed_instanced(960, 16, 0, 0);
+			}
+			else
+			{
+				stream.draw_indexed(960, 0, 0);
+			}
+		}
+	};
+
+	for (size_t stream_count : { 1, 4 })
+	{
+		std::vector<command_stream> streams(stream_count);
+		recording_command_backend backend;
+		const double record_time{ best_time(10, [&]
+		{
+			for (command_stream& stream : streams)
+			{
+				stream.clear();
+			}
+			record_parallel(streams, draw_count, record);
+		}) };
+		const double replay_time{ best_time(10, [&]
+		{
+			backend.reset();
+			for (const command_stream& stream : streams)
+			{
+				replay(stream, backend);
+			}
+		}) };
+		size_t bytes{ 0 };
+		for (const command_stream& stream : streams)
+		{
+			bytes += stream.size();
+		}
+		printf("%zu streams : record %.2f ms, replay %.2f ms, %zu commands, %.1f MB of stream, %.1f MB uploaded\n", stream_count,
+			record_time * 1e3, replay_time * 1e3, backend.commands.size(), bytes / 1e6, backend.upload_bytes() / 1e6);
+	}
+	printf("%u hardware threads\n", std::thread::hardware_concurrency());
+
+	command_stream serial;
+	record(serial, 0, draw_count);
+	recording_command_backend serial_backend;
+	replay(serial, serial_backend);
+	std::vector<command_stream> streams(7);
+	record_parallel(streams, draw_count, record);
+	recording_command_backend parallel_backend;
+	for (const command_stream& stream : streams)
+	{
+		replay(stream, parallel_backend);
+	}
+	if (serial_backend.commands != parallel_backend.commands || serial_backend.upload_bytes() != parallel_backend.upload_bytes() ||
+		serial_backend.indices_drawn != parallel_backend.indices_drawn)
+	{
+		printf("the parallel streams differ from the serial one\n");
+		return 1;
+	}
+	return 0;
+}
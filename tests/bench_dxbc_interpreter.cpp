@@ -0,0 +1,103 @@
+#include "dxbc_interpreter.h"
+
+#include <random>
+#include <string>
+
+#include "benchmark.h"
+
+// Loads the shipped .cso files, then runs phong_shader_ps and phong_shader_vs for half a second each. The pixel
+// shader gets the constant buffers and 1 x 1 textures of a lit scene so that every instruction works on real values.
+//
+//   bench_dxbc_interpreter [directory of the .cso files, the repository root by default]
+int main(int argc, char** argv)
+{
+	const std::filesystem::path directory{ argc > 1 ? argv[1] : SOURCE_DIRECTORY };
+	const char* shader_names[]
+	{
+		"UVScroll_ps", "UVScroll_vs", "environment_mapping_shader_ps", "environment_mapping_shader_vs", "geometric_primitive_ps",
+		"geometric_primitive_vs", "phong_shader_ps", "phong_shader_vs", "ramp_shader_ps", "ramp_shader_vs", "sprite_dissolve_ps",
+		"sprite_dissolve_vs", "sprite_ps", "sprite_vs", "static_mesh_ps", "static_mesh_vs", "wireframe",
+	};
+	int failures{ 0 };
+	for (const char* name : shader_names)
+	{
+		dxbc_shader shader;
+		if (!shader.load(directory / (std::string(name) + ".cso")))
+		{
+			printf("%s.cso does not load\n", name);
+			++failures;
+		}
+	}
+
+	dxbc_shader pixel_shader, vertex_shader;
+	if (!pixel_shader.load(directory / "phong_shader_ps.cso") || !vertex_shader.load(directory / "phong_shader_vs.cso"))
+	{
+		return 1;
+	}
+
+	// b0 : world_view_projection, material ka / kd / ks. b1 : camera position in row 5. b2 : ambient, light direction
+	// and color. b4 : sky, ground and hemisphere weight. b5 : fog color and range.
+	float object_constants[7][4]{ { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { 0, 0, 0, 1 }, { 1, 0.9f, 1, 0 }, { 0.8f, 0.7f, 0.8f, 0 }, { 1, 1, 1, 0 } };
+	float scene_constants[6][4]{};
+	scene_constants[5][0] = 0;
+	scene_constants[5][1] = 10;
+	scene_constants[5][2] = -30;
+	scene_constants[5][3] = 1;
+	float light_constants[3][4]{ { 0.2f, 0.2f, 0.25f, 1 }, { 0.3f, -1, 0.4f, 0 }, { 1, 1, 0.9f, 1 } };
+	float hemisphere_constants[3][4]{ { 0.4f, 0.5f, 0.9f, 1 }, { 0.3f, 0.2f, 0.1f, 1 }, { 0.5f, 0, 0, 0 } };
+	float fog_constants[2][4]{ { 0.5f, 0.5f, 0.6f, 1 }, { 20, 80, 0, 0 } };
+	shading_texture color, flat_normal;
+	color.width = color.height = 1;
+	color.texels = { 0.9f, 0.6f, 0.3f, 0.8f };
+	flat_normal.width = flat_normal.height = 1;
+	flat_normal.texels = { 0.5f, 0.5f, 1.0f, 1.0f };
+
+	dxbc_interpreter pixels{ pixel_shader };
+	pixels.set_constant_buffer(0, object_constants, sizeof(object_constants));
+	pixels.set_constant_buffer(1, scene_constants, sizeof(scene_constants));
+	pixels.set_constant_buffer(2, light_constants, sizeof(light_constants));
+	pixels.set_constant_buffer(4, hemisphere_constants, sizeof(hemisphere_constants));
+	pixels.set_constant_buffer(5, fog_constants, sizeof(fog_constants));
+	pixels.set_texture(0, &color);
+	pixels.set_texture(1, &flat_normal);
+	// v1 : world position, v2 : tangent, v3 : binormal, v4 : normal, v5 : texcoord.
+	std::mt19937 rng(3);
+	std::uniform_real_distribution<float> position(-50, 50), direction(-1, 1), texcoord(0, 1);
+	for (size_t lane = 0; lane < dxbc_lanes; ++lane)
+	{
+		for (uint32_t c = 0; c < 3; ++c)
+		{
+			pixels.input(1, c)[lane] = position(rng);
+			pixels.input(2, c)[lane] = c == 0 ? 1.0f : 0.0f;
+			pixels.input(3, c)[lane] = c == 2 ? 1.0f : 0.0f;
+			pixels.input(4, c)[lane] = direction(rng);
+		}
+		pixels.input(1, 3)[lane] = 1;
+		pixels.input(5, 0)[lane] = texcoord(rng);
+		pixels.input(5, 1)[lane] = texcoord(rng);
+	}
+
+	dxbc_interpreter vertices{ vertex_shader };
+	const float world[4][4]{ { 2, 0, 0, 0 }, { 0, 1, 0.5f, 0 }, { 0, 0, 1, 0 }, { 3, 4, 5, 1 } };
+	const float view_projection[4][4]{ { 1, 0.2f, 0, 0 }, { 0, 1, 0, 0 }, { 0.1f, 0, 1, 1 }, { 0, 0, -1, 0 } };
+	vertices.set_constant_buffer(0, world, sizeof(world));
+	vertices.set_constant_buffer(1, view_projection, sizeof(view_projection));
+	for (size_t lane = 0; lane < dxbc_lanes; ++lane)
+	{
+		for (uint32_t c = 0; c < 3; ++c)
+		{
+			vertices.input(0, c)[lane] = position(rng);
+			vertices.input(1, c)[lane] = c == 1 ? 1.0f : 0.0f;
+		}
+	}
+
+	for (dxbc_interpreter* interpreter : { &pixels, &vertices })
+	{
+		const double executions{ calls_per_second(0.5, [interpreter] { interpreter->execute(); }) };
+		const double invocations{ executions * dxbc_lanes };
+		printf("%s, %zu instructions : %.2f M invocations/s, %.0f M lane-instructions/s\n",
+			interpreter == &pixels ? "phong_shader_ps" : "phong_shader_vs", interpreter->instruction_count(), invocations * 1e-6,
+			invocations * interpreter->instruction_count() * 1e-6);
+	}
+	return failures ? 1 : 0;
+}
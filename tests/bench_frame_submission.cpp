@@ -0,0 +1,210 @@
+#include "command_stream.h"
+
+#include <algorithm>
+#include <functional>
+#include <thread>
+
+#include "benchmark.h"
+#include "recording_command_backend.h"
+#include "render_queue.h"
+#include "state_filter.h"
+
+// framework's draw submission without Direct3D : 20k objects are recorded as sort keys and draw closures, sorted by
+// render_queue, recorded into 1 and 4 command streams with record_parallel and replayed through state_filter to
+// recording_command_backend. The objects draw like static_mesh (per-draw constants, an instanced draw every 8th object)
+// and the overlay sprite like sprite with its shader state in the stream. The uploaded bytes and the draws must be
+// those the objects recorded, and every stream count must give the same commands.
+//
+//   bench_frame_submission
+namespace
+{
+	// The pointers are never dereferenced.
+	template <class T>
+	T* handle(uintptr_t id) { return reinterpret_cast<T*>(id * 16); }
+
+	struct mesh
+	{
+		uintptr_t id;
+		uint32_t subsets;
+		uint32_t index_count;	// per subset
+	};
+
+	// object_constants of static_mesh and the sprite constants of framework.
+	struct object_constants
+	{
+		float world_view_projection[16];
+		float world[16];
+		float material_color[4];
+	};
+	struct scroll_constants { float scroll_direction[2], scroll_dummy[2]; };
+	struct dissolve_constants { float parameters[4]; };
+	struct sprite_vertex { float position[3], color[4], texcoord[2]; };
+
+	enum { mesh_shader, mesh_instanced_shader, primitive_shader, sprite_shader };
+	const uint32_t instance_count{ 16 };
+}
+
+int main()
+{
+	const size_t object_count{ 20000 };
+	const mesh meshes[]{ { 1, 3, 960 }, { 2, 1, 2880 }, { 3, 5, 300 }, { 4, 2, 1200 } };
+	const scroll_constants scroll{ { 0.1f, 0 }, { 0, 0 } };
+	const dissolve_constants dissolve{ { 0.5f } };
+
+	render_queue queue;
+	std::vector<std::function<void(command_stream&)>> draw_commands;
+	std::vector<float> instance_worlds(instance_count * 16, 1.0f);
+	// What the objects record, for the totals the backend must report.
+	uint64_t expected_draws{ 0 }, expected_indices{ 0 }, expected_upload{ 0 };
+	auto record_objects = [&]
+	{
+		queue.clear();
+		draw_commands.clear();
+		expected_draws = expected_indices = expected_upload = 0;
+		for (size_t i = 0; i < object_count; ++i)
+		{
+			const mesh& m{ meshes[i % std::size(meshes)] };
+			const bool instanced{ i % 8 == 0 };
+			const uint32_t shader{ instanced ? mesh_instanced_shader : (i % 3 == 0 ? primitive_shader : mesh_shader) };
+			const uint32_t material{ static_cast<uint32_t>(i % 7) };
+			queue.record(make_sort_key(0, shader, material, 0, quantize_sort_depth(static_cast<float>(i % 97), 0.1f, 100.0f)),
+				static_cast<uint32_t>(draw_commands.size()));
+			draw_commands.push_back([&, i, m, instanced, material](command_stream& stream)
+			{
+				stream.set_vertex_buffer(handle<ID3D11Buffer>(m.id), 32, 0);
+				stream.set_index_buffer(handle<ID3D11Buffer>(100 + m.id), 4, 0);
+				stream.set_topology(command_stream::triangle_list);
+				if (instanced)
+				{
+					memcpy(stream.set_instances(sizeof(float) * 16, instance_count), instance_worlds.data(), instance_worlds.size() * sizeof(float));
+				}
+				for (uint32_t s = 0; s < m.subsets; ++s)
+				{
+					ID3D11ShaderResourceView* views[2]{ handle<ID3D11ShaderResourceView>(200 + material), handle<ID3D11ShaderResourceView>(300) };
+					stream.set_shader_resources(0, 2, views);
+					// Every draw of every object has its own constants, so state_filter never drops them.
+					object_constants constants{};
+					constants.world[12] = static_cast<float>(i);
+					constants.material_color[0] = static_cast<float>(s);
+					stream.set_constants(0, constants);
+					if (instanced)
+					{
+						stream.draw_indexed_instanced(m.index_count, instance_count, s * m.index_count, 0);
+					}
+					else
+					{
+						stream.draw_indexed(m.index_count, s * m.index_count, 0);
+					}
+				}
+			});
+			expected_draws += m.subsets;
+			expected_indices += static_cast<uint64_t>(m.subsets) * m.index_count * (instanced ? instance_count : 1);
+			expected_upload += m.subsets * sizeof(object_constants) + (instanced ? instance_worlds.size() * sizeof(float) : 0);
+		}
+		queue.record(make_sort_key(1, sprite_shader, 0, 0, 0), static_cast<uint32_t>(draw_commands.size()));
+		draw_commands.push_back([](command_stream& stream)
+		{
+			memset(stream.set_vertices(sizeof(sprite_vertex), 4), 0, sizeof(sprite_vertex) * 4);
+			stream.set_topology(command_stream::triangle_strip);
+			stream.draw(4, 0);
+		});
+		expected_draws += 1;
+		expected_upload += sizeof(scroll_constants) + sizeof(dissolve_constants) + sizeof(sprite_vertex) * 4;
+		queue.sort();
+	};
+	// framework's record_shader : the shader state is recorded when the sort key changes shader.
+	auto record_shader = [&](command_stream& stream, uint32_t shader)
+	{
+		switch (shader)
+		{
+		case primitive_shader:
+			break;
+		case sprite_shader:
+			stream.set_input_layout(handle<ID3D11InputLayout>(sprite_shader + 1));
+			stream.set_vertex_shader(handle<ID3D11VertexShader>(sprite_shader + 1));
+			stream.set_pixel_shader(handle<ID3D11PixelShader>(sprite_shader + 1));
+			{
+				ID3D11ShaderResourceView* mask{ handle<ID3D11ShaderResourceView>(400) };
+				stream.set_shader_resources(1, 1, &mask);
+			}
+			stream.set_constants(2, scroll);
+			stream.set_constants(3, dissolve);
+			break;
+		default:
+			stream.set_input_layout(handle<ID3D11InputLayout>(shader + 1));
+			stream.set_vertex_shader(handle<ID3D11VertexShader>(shader + 1));
+			stream.set_pixel_shader(handle<ID3D11PixelShader>(1));
+			break;
+		}
+	};
+
+	int failures{ 0 };
+	std::vector<command_stream::command_type> reference;
+	for (size_t stream_count : { 1, 4 })
+	{
+		std::vector<command_stream> streams(stream_count);
+		recording_command_backend backend;
+		state_filter filter{ backend };
+		double queue_time{ 1e30 }, record_time{ 1e30 }, replay_time{ 1e30 };
+		for (int frame = 0; frame < 20; ++frame)
+		{
+			queue_time = std::min(queue_time, best_time(1, record_objects));
+			record_time = std::min(record_time, best_time(1, [&]
+			{
+				record_parallel(streams, queue.size(), [&](command_stream& stream, size_t first, size_t last)
+				{
+					uint32_t bound_shader{ UINT32_MAX };
+					for (size_t k = first; k < last; ++k)
+					{
+						const draw_packet& packet{ queue.begin()[k] };
+						if (sort_key_shader(packet.key) != bound_shader)
+						{
+							bound_shader = sort_key_shader(packet.key);
+							record_shader(stream, bound_shader);
+						}
+						draw_commands[packet.payload](stream);
+					}
+				});
+			}));
+			replay_time = std::min(replay_time, best_time(1, [&]
+			{
+				backend.reset();
+				filter.invalidate();
+				filter.reset_statistics();
+				for (const command_stream& stream : streams)
+				{
+					replay(stream, filter);
+				}
+			}));
+		}
+		printf("%zu streams : sort keys %.2f ms, record %.2f ms, replay %.2f ms, %llu draws, %.2f MB uploaded, %u state changes issued, %u filtered\n",
+			stream_count, queue_time * 1e3, record_time * 1e3, replay_time * 1e3, static_cast<unsigned long long>(backend.draw_calls()),
+			backend.upload_bytes() / 1e6, filter.statistics().issued, filter.statistics().filtered);
+
+		if (backend.draw_calls() != expected_draws || backend.indices_drawn != expected_indices || backend.vertices_drawn != 4 ||
+			backend.upload_bytes() != expected_upload)
+		{
+			printf("%zu streams : %llu draws, %llu indices, %llu bytes uploaded instead of %llu, %llu and %llu\n", stream_count,
+				static_cast<unsigned long long>(backend.draw_calls()), static_cast<unsigned long long>(backend.indices_drawn),
+				static_cast<unsigned long long>(backend.upload_bytes()), static_cast<unsigned long long>(expected_draws),
+				static_cast<unsigned long long>(expected_indices), static_cast<unsigned long long>(expected_upload));
+			++failures;
+		}
+		if (backend.command_counts[command_stream::call_command] != 0)
+		{
+			printf("%zu streams : the frame has call commands\n", stream_count);
+			++failures;
+		}
+		if (reference.empty())
+		{
+			reference = backend.commands;
+		}
+		else if (backend.commands != reference)
+		{
+			printf("%zu streams : the commands differ from those of one stream\n", stream_count);
+			++failures;
+		}
+	}
+	printf("%u hardware threads\n", std::thread::hardware_concurrency());
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,81 @@
+#include "frustum_culling.h"
+
+#include <random>
+
+#include "benchmark.h"
+
+// cull_aabbs on 1M random boxes around a camera at the origin, against a per-box loop of the same plane test.
+//
+//   bench_frustum_culling
+namespace
+{
+	bool inside_frustum(const frustum& f, const world_aabbs& boxes, size_t i)
+	{
+		for (const float(&plane)[4] : f.planes)
+		{
+			const float distance{ plane[0] * boxes.center_x[i] + plane[1] * boxes.center_y[i] + plane[2] * boxes.center_z[i] + plane[3] };
+			const float radius{ fabsf(plane[0]) * boxes.extent_x[i] + fabsf(plane[1]) * boxes.extent_y[i] + fabsf(plane[2]) * boxes.extent_z[i] };
+			if (distance + radius < 0)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+int main()
+{
+	// 60 degree vertical field of view, 16:9, near 0.1, far 100, looking along +z.
+	const float y_scale{ 1 / tanf(3.14159265f / 6) }, x_scale{ y_scale / (16.0f / 9.0f) }, near_z{ 0.1f }, far_z{ 100.0f };
+	const float projection[16]
+	{
+		x_scale, 0, 0, 0,
+		0, y_scale, 0, 0,
+		0, 0, far_z / (far_z - near_z), 1,
+		0, 0, -near_z * far_z / (far_z - near_z), 0,
+	};
+	const frustum f{ extract_frustum(projection) };
+
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> position(-150, 150), extent(0.1f, 2.0f), angle(-1, 1);
+	world_aabbs boxes;
+	const size_t box_count{ 1000000 };
+	for (size_t i = 0; i < box_count; ++i)
+	{
+		const float minimum[3]{ -extent(rng), -extent(rng), -extent(rng) }, maximum[3]{ extent(rng), extent(rng), extent(rng) };
+		const float c{ cosf(angle(rng)) }, s{ sinf(angle(rng)) };
+		const float world[16]{ c, 0, -s, 0, 0, 1, 0, 0, s, 0, c, 0, position(rng), position(rng), position(rng), 1 };
+		boxes.push_back(minimum, maximum, world);
+	}
+
+	std::vector<uint32_t> visible;
+	visible.reserve(box_count + 8);
+	const double simd_time{ best_time(20, [&]
+	{
+		visible.clear();
+		cull_aabbs(f, boxes, visible);
+	}) };
+	std::vector<uint32_t> reference;
+	reference.reserve(box_count);
+	const double reference_time{ best_time(5, [&]
+	{
+		reference.clear();
+		for (size_t i = 0; i < box_count; ++i)
+		{
+			if (inside_frustum(f, boxes, i))
+			{
+				reference.push_back(static_cast<uint32_t>(i));
+			}
+		}
+	}) };
+
+	printf("%zu boxes, %zu visible : cull_aabbs %.2f ns/box, per-box loop %.2f ns/box\n", box_count, visible.size(),
+		simd_time * 1e9 / box_count, reference_time * 1e9 / box_count);
+	if (visible != reference)
+	{
+		printf("cull_aabbs differs from the per-box loop (%zu visible)\n", reference.size());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,176 @@
+#include "instance_bvh.h"
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+
+#include "benchmark.h"
+
+// Builds, refits and queries instance_bvh over 10k, 100k and 1M random boxes : 200 frusta along the ground with a far
+// plane of 200, against cull_aabbs, and 100k random rays of length 200, checked against a brute force slab test.
+//
+//   bench_instance_bvh [build threads, 0 for the hardware concurrency]
+namespace
+{
+	bool ray_hits_box(const world_aabbs& boxes, uint32_t i, const float origin[3], const float direction[3], float max_distance)
+	{
+		const float center[3]{ boxes.center_x[i], boxes.center_y[i], boxes.center_z[i] };
+		const float extent[3]{ boxes.extent_x[i], boxes.extent_y[i], boxes.extent_z[i] };
+		float near_t{ 0 }, far_t{ max_distance };
+		for (int k = 0; k < 3; ++k)
+		{
+			const float inverse{ 1.0f / (fabsf(direction[k]) > 1e-30f ? direction[k] : copysignf(1e-30f, direction[k])) };
+			const float a{ (center[k] - extent[k] - origin[k]) * inverse }, b{ (center[k] + extent[k] - origin[k]) * inverse };
+			near_t = std::max(near_t, std::min(a, b));
+			far_t = std::min(far_t, std::max(a, b));
+		}
+		return near_t <= far_t;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const size_t thread_count{ argc > 1 ? static_cast<size_t>(atoi(argv[1])) : 0 };
+	int failures{ 0 };
+	printf("instances  nodes    build (1 thread)       refit all  refit 1%%  frustum (cull_aabbs)  visible  rays      hits\n");
+	for (size_t instance_count : { 10000, 100000, 1000000 })
+	{
+		std::mt19937 rng(42);
+		const float side{ 10.0f * cbrtf(static_cast<float>(instance_count)) };
+		std::uniform_real_distribution<float> position(0, side), size(0.5f, 2.0f), unit(-1, 1);
+		world_aabbs boxes;
+		for (size_t i = 0; i < instance_count; ++i)
+		{
+			const float s{ size(rng) };
+			const float minimum[3]{ -s, -s, -s }, maximum[3]{ s, s, s };
+			const float world[16]{ 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, position(rng), position(rng) * 0.1f, position(rng), 1 };
+			boxes.push_back(minimum, maximum, world);
+		}
+
+		instance_bvh bvh;
+		const int repeats{ instance_count >= 1000000 ? 3 : 10 };
+		const double build_time{ best_time(repeats, [&] { bvh.build(boxes, thread_count); }) };
+		const double single_thread_build_time{ best_time(repeats, [&] { bvh.build(boxes, 1); }) };
+		const double refit_time{ best_time(repeats, [&] { bvh.refit(boxes); }) };
+
+		// 1% of the instances move a little every frame; the incremental refit must give the nodes of a full refit.
+		std::vector<uint32_t> changed;
+		for (size_t i = 0; i < instance_count; i += 100)
+		{
+			changed.push_back(static_cast<uint32_t>(i * 7919 % instance_count));
+		}
+		std::sort(changed.begin(), changed.end());
+		changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+		double incremental_time{ 0 };
+		for (int r = 0; r < repeats; ++r)
+		{
+			for (uint32_t i : changed)
+			{
+				boxes.center_x[i] += unit(rng);
+				boxes.center_z[i] += unit(rng);
+			}
+			const auto start{ std::chrono::steady_clock::now() };
+			bvh.refit(boxes, changed.data(), changed.size());
+			incremental_time += seconds_since(start);
+		}
+		incremental_time /= repeats;
+		const std::vector<instance_bvh::node> incremental{ bvh.nodes() };
+		bvh.refit(boxes);
+		if (memcmp(incremental.data(), bvh.nodes().data(), incremental.size() * sizeof(instance_bvh::node)) != 0)
+		{
+			printf("the incremental refit differs from the full refit\n");
+			++failures;
+		}
+
+		// Cameras 5 above the ground looking along it.
+		const int views{ 200 };
+		double query_time{ 0 }, cull_time{ 0 };
+		size_t found{ 0 };
+		std::vector<uint32_t> queried, culled;
+		for (int v = 0; v < views; ++v)
+		{
+			const float eye[3]{ position(rng), 5, position(rng) }, direction[3]{ unit(rng), unit(rng) * 0.2f, unit(rng) };
+			float view_projection[16];
+			make_view_projection(eye, direction, 16.0f / 9.0f, 0.1f, 200.0f, view_projection);
+			const frustum f{ extract_frustum(view_projection) };
+			queried.clear();
+			culled.clear();
+			auto start{ std::chrono::steady_clock::now() };
+			bvh.query(f, queried);
+			query_time += seconds_since(start);
+			start = std::chrono::steady_clock::now();
+			cull_aabbs(f, boxes, culled);
+			cull_time += seconds_since(start);
+			found += queried.size();
+			std::sort(queried.begin(), queried.end());
+			if (queried != culled)
+			{
+				printf("frustum query differs from cull_aabbs : %zu and %zu instances\n", queried.size(), culled.size());
+				++failures;
+				break;
+			}
+		}
+
+		const int ray_count{ 100000 };
+		std::vector<float> rays(ray_count * 6);
+		for (int r = 0; r < ray_count; ++r)
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				rays[r * 6 + k] = position(rng) * (k == 1 ? 0.1f : 1.0f);
+				rays[r * 6 + 3 + k] = unit(rng);
+			}
+		}
+		size_t hits{ 0 };
+		const auto start{ std::chrono::steady_clock::now() };
+		for (int r = 0; r < ray_count; ++r)
+		{
+			queried.clear();
+			hits += bvh.query(&rays[r * 6], &rays[r * 6 + 3], 200.0f, queried);
+		}
+		const double ray_time{ seconds_since(start) };
+		for (int r = 0; r < 200; ++r)
+		{
+			queried.clear();
+			bvh.query(&rays[r * 6], &rays[r * 6 + 3], 200.0f, queried);
+			std::sort(queried.begin(), queried.end());
+			culled.clear();
+			for (uint32_t i = 0; i < instance_count; ++i)
+			{
+				if (ray_hits_box(boxes, i, &rays[r * 6], &rays[r * 6 + 3], 200.0f))
+				{
+					culled.push_back(i);
+				}
+			}
+			if (queried != culled)
+			{
+				printf("ray query differs from the slab test : %zu and %zu instances\n", queried.size(), culled.size());
+				++failures;
+				break;
+			}
+		}
+
+		printf("%9zu  %7zu  %7.1f ms (%7.1f ms)  %6.2f ms  %6.3f ms  %6.1f us (%6.1f us)  %7.0f  %4.2f M/s  %4.1f\n", instance_count,
+			bvh.nodes().size(), build_time * 1e3, single_thread_build_time * 1e3, refit_time * 1e3, incremental_time * 1e3,
+			query_time / views * 1e6, cull_time / views * 1e6, static_cast<double>(found) / views, ray_count / ray_time * 1e-6,
+			static_cast<double>(hits) / ray_count);
+	}
+
+	// 100k identical boxes : the build must terminate with a bounded depth and a ray must find all of them.
+	world_aabbs identical;
+	const float minimum[3]{ -1, -1, -1 }, maximum[3]{ 1, 1, 1 }, world[16]{ 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+	for (int i = 0; i < 100000; ++i)
+	{
+		identical.push_back(minimum, maximum, world);
+	}
+	instance_bvh bvh;
+	bvh.build(identical, thread_count);
+	std::vector<uint32_t> hit;
+	const float origin[3]{ -5, 0, 0 }, direction[3]{ 1, 0, 0 };
+	if (bvh.query(origin, direction, 100, hit) != identical.size())
+	{
+		printf("a ray through 100k identical boxes finds %zu\n", hit.size());
+		++failures;
+	}
+	return failures ? 1 : 0;
+}
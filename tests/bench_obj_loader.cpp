@@ -0,0 +1,182 @@
+#include "obj_loader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cwchar>
+#include <fstream>
+#include <random>
+#include <thread>
+
+#include "benchmark.h"
+
+// load_obj against the std::wifstream loop static_mesh used before, then with 1, 2, 4... threads up to the hardware
+// concurrency (at least 8). Without an argument it writes and loads a grid of 700 x 700 quads (72 MB, 980k triangles
+// in two subsets).
+//
+//   bench_obj_loader [file.obj]
+namespace
+{
+	void write_grid(const std::filesystem::path& filename, int n)
+	{
+		FILE* file{ fopen(filename.string().c_str(), "w") };
+		std::mt19937 rng(1);
+		std::uniform_real_distribution<float> height(0, 0.1f);
+		for (int j = 0; j <= n; ++j)
+		{
+			for (int i = 0; i <= n; ++i)
+			{
+				fprintf(file, "v %f %f %f\n", i * 0.01f, j * 0.01f, height(rng));
+			}
+		}
+		for (int j = 0; j <= n; ++j)
+		{
+			for (int i = 0; i <= n; ++i)
+			{
+				fprintf(file, "vt %f %f\n", static_cast<float>(i) / n, static_cast<float>(j) / n);
+			}
+		}
+		fprintf(file, "vn 0.000000 0.000000 1.000000\n");
+		for (int k = 0; k < 2; ++k)
+		{
+			fprintf(file, "usemtl material%d\n", k);
+			for (int j = k * n / 2; j < (k + 1) * n / 2; ++j)
+			{
+				for (int i = 0; i < n; ++i)
+				{
+					const int a{ j * (n + 1) + i + 1 }, b{ a + 1 }, c{ a + n + 1 }, d{ c + 1 };
+					fprintf(file, "f %d/%d/1 %d/%d/1 %d/%d/1\n", a, a, b, b, c, c);
+					fprintf(file, "f %d/%d/1 %d/%d/1 %d/%d/1\n", b, b, d, d, c, c);
+				}
+			}
+		}
+		fclose(file);
+	}
+
+	// The previous loader of static_mesh, reduced to positions, texcoords, normals and triangles : one vertex per
+	// face corner.
+	void load_with_wifstream(const std::filesystem::path& filename, std::vector<obj_vertex>& vertices)
+	{
+		std::vector<float> positions, normals, texcoords;
+		std::wifstream fin(filename);
+		wchar_t command[256];
+		while (fin)
+		{
+			fin >> command;
+			if (!fin)
+			{
+				break;	// the old loop read the last face twice here
+			}
+			if (0 == wcscmp(command, L"v"))
+			{
+				float x, y, z;
+				fin >> x >> y >> z;
+				positions.insert(positions.end(), { x, y, z });
+			}
+			else if (0 == wcscmp(command, L"vt"))
+			{
+				float u, v;
+				fin >> u >> v;
+				texcoords.insert(texcoords.end(), { u, 1.0f - v });
+			}
+			else if (0 == wcscmp(command, L"vn"))
+			{
+				float i, j, k;
+				fin >> i >> j >> k;
+				normals.insert(normals.end(), { i, j, k });
+			}
+			else if (0 == wcscmp(command, L"f"))
+			{
+				for (int i = 0; i < 3; ++i)
+				{
+					obj_vertex vertex;
+					size_t v, vt, vn;
+					fin >> v;
+					memcpy(vertex.position, &positions[(v - 1) * 3], sizeof(vertex.position));
+					if (L'/' == fin.peek())
+					{
+						fin.ignore(1);
+						if (L'/' != fin.peek())
+						{
+							fin >> vt;
+							memcpy(vertex.texcoord, &texcoords[(vt - 1) * 2], sizeof(vertex.texcoord));
+						}
+						if (L'/' == fin.peek())
+						{
+							fin.ignore(1);
+							fin >> vn;
+							memcpy(vertex.normal, &normals[(vn - 1) * 3], sizeof(vertex.normal));
+						}
+					}
+					vertices.push_back(vertex);
+				}
+			}
+			fin.ignore(1024, L'\n');
+		}
+	}
+
+	bool same_model(const obj_model& a, const obj_model& b)
+	{
+		return a.vertices.size() == b.vertices.size() && 0 == memcmp(a.vertices.data(), b.vertices.data(), a.vertices.size() * sizeof(obj_vertex)) &&
+			a.indices == b.indices && a.subsets.size() == b.subsets.size();
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::filesystem::path filename;
+	if (argc > 1)
+	{
+		filename = argv[1];
+	}
+	else
+	{
+		filename = std::filesystem::temp_directory_path() / "bench_obj_loader.obj";
+		write_grid(filename, 700);
+	}
+	const double megabytes{ std::filesystem::file_size(filename) / 1e6 };
+	int failures{ 0 };
+
+	obj_model model;
+	const double load_time{ best_time(3, [&]
+	{
+		model = obj_model{};
+		load_obj(filename, true, model);
+	}) };
+	std::vector<obj_vertex> corners;
+	const double wifstream_time{ best_time(1, [&] { load_with_wifstream(filename, corners); }) };
+	printf("%.1f MB, %zu vertices, %zu triangles, %zu subsets : load_obj %.3f s (%.1f MB/s), wifstream %.3f s (%.1f MB/s)\n",
+		megabytes, model.vertices.size(), model.indices.size() / 3, model.subsets.size(), load_time, megabytes / load_time,
+		wifstream_time, megabytes / wifstream_time);
+	bool same_corners{ corners.size() == model.indices.size() };
+	for (size_t i = 0; same_corners && i < corners.size(); ++i)
+	{
+		same_corners = 0 == memcmp(&corners[i], &model.vertices[model.indices[i]], sizeof(obj_vertex));
+	}
+	if (!same_corners)
+	{
+		printf("the face corners differ from the wifstream loop\n");
+		++failures;
+	}
+
+	const unsigned hardware_threads{ std::thread::hardware_concurrency() };
+	obj_model single_threaded;
+	load_obj(filename, true, single_threaded, 1);
+	for (unsigned threads = 1; threads <= std::max(hardware_threads, 8u); threads *= 2)
+	{
+		bool identical{ true };
+		const double seconds{ best_time(3, [&]
+		{
+			obj_model threaded;
+			load_obj(filename, true, threaded, threads);
+			identical = identical && same_model(threaded, single_threaded);
+		}) };
+		printf("%2u threads : %.3f s, %.1f MB/s%s\n", threads, seconds, megabytes / seconds, identical ? "" : ", differs from 1 thread");
+		failures += identical ? 0 : 1;
+	}
+
+	if (argc <= 1)
+	{
+		std::filesystem::remove(filename);
+	}
+	return failures ? 1 : 0;
+}
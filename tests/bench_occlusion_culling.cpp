@@ -0,0 +1,272 @@
+#include "occlusion_culling.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "benchmark.h"
+#include "test.h"
+
+// Replays the orbit camera paths of camera_paths.txt over framework's grid of 20 x 75 balls at 1280 x 720. Every frame
+// frustum culls the balls, draws the coarse spheres of the nearest visible ones into the occlusion buffer and culls
+// the others against it. Every 8th frame is checked against an exact ID buffer of fine spheres : no culled ball may
+// have a visible pixel.
+//
+//   bench_occlusion_culling [buffer width, 320] [buffer height, 180] [occluders, 32]
+namespace
+{
+	const int screen_width{ 1280 }, screen_height{ 720 };
+
+	// framework's camera : it looks at 'focus' from 'distance' away, turned by 'pitch' and 'yaw'.
+	struct camera_key
+	{
+		float focus[3];
+		float pitch, yaw, distance;
+	};
+
+	struct camera_path
+	{
+		std::string name;
+		int frames{ 0 };
+		std::vector<camera_key> keys;
+	};
+
+	std::vector<camera_path> load_camera_paths(const std::filesystem::path& filename)
+	{
+		std::vector<camera_path> paths;
+		std::ifstream file{ filename };
+		std::string line;
+		while (std::getline(file, line))
+		{
+			if (line.empty() || line[0] == '#' || line.compare(0, 3, "end") == 0)
+			{
+				continue;
+			}
+			std::istringstream words{ line };
+			camera_key key;
+			if (!paths.empty() && words >> key.focus[0] >> key.focus[1] >> key.focus[2] >> key.pitch >> key.yaw >> key.distance)
+			{
+				paths.back().keys.push_back(key);
+				continue;
+			}
+			camera_path path;
+			words.clear();
+			words.seekg(0);
+			if (words >> path.name >> path.frames)
+			{
+				paths.push_back(path);
+			}
+		}
+		return paths;
+	}
+
+	void camera_matrix(const camera_key& key, float view_projection[16], float eye[3])
+	{
+		const float front[3]{ -cosf(key.pitch) * sinf(key.yaw), -sinf(key.pitch), -cosf(key.pitch) * cosf(key.yaw) };
+		for (int i = 0; i < 3; ++i)
+		{
+			eye[i] = key.focus[i] - front[i] * key.distance;
+		}
+		make_view_projection(eye, front, static_cast<float>(screen_width) / screen_height, 0.1f, 100.0f, view_projection);
+	}
+
+	// Exact visibility : the triangles of 'positions' and 'indices' at every world matrix with interpolated depth, the
+	// nearest one writing its ball index.
+	void draw_ids(const std::vector<const float*>& worlds, const std::vector<float>& positions, const std::vector<uint32_t>& indices,
+		const float view_projection[16], std::vector<int>& ids)
+	{
+		std::vector<float> depth(screen_width * screen_height, 1.0f);
+		ids.assign(screen_width * screen_height, -1);
+		std::vector<float> clip(positions.size() / 3 * 4);
+		for (size_t b = 0; b < worlds.size(); ++b)
+		{
+			float m[16];
+			multiply_matrices(worlds[b], view_projection, m);
+			for (size_t v = 0; v < positions.size() / 3; ++v)
+			{
+				for (int c = 0; c < 4; ++c)
+				{
+					clip[v * 4 + c] = positions[v * 3] * m[c] + positions[v * 3 + 1] * m[4 + c] + positions[v * 3 + 2] * m[8 + c] + m[12 + c];
+				}
+			}
+			for (size_t i = 0; i < indices.size(); i += 3)
+			{
+				float x[3], y[3], z[3];
+				bool in_front{ true };
+				for (int k = 0; k < 3; ++k)
+				{
+					const float* p{ &clip[indices[i + k] * 4] };
+					in_front = in_front && p[2] >= 0;
+					x[k] = (p[0] / p[3] * 0.5f + 0.5f) * screen_width;
+					y[k] = (0.5f - p[1] / p[3] * 0.5f) * screen_height;
+					z[k] = p[2] / p[3];
+				}
+				const float area{ (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]) };
+				if (!in_front || area <= 0)
+				{
+					continue;
+				}
+				const int x0{ std::max(0, static_cast<int>(floorf(std::min({ x[0], x[1], x[2] })))) };
+				const int x1{ std::min(screen_width - 1, static_cast<int>(ceilf(std::max({ x[0], x[1], x[2] })))) };
+				const int y0{ std::max(0, static_cast<int>(floorf(std::min({ y[0], y[1], y[2] })))) };
+				const int y1{ std::min(screen_height - 1, static_cast<int>(ceilf(std::max({ y[0], y[1], y[2] })))) };
+				for (int py = y0; py <= y1; ++py)
+				{
+					for (int px = x0; px <= x1; ++px)
+					{
+						float weights[3];
+						for (int k = 0; k < 3; ++k)
+						{
+							const int a{ (k + 1) % 3 }, c{ (k + 2) % 3 };
+							weights[k] = ((x[c] - x[a]) * (py + 0.5f - y[a]) - (y[c] - y[a]) * (px + 0.5f - x[a])) / area;
+						}
+						if (weights[0] < 0 || weights[1] < 0 || weights[2] < 0)
+						{
+							continue;
+						}
+						const float pixel_depth{ weights[0] * z[0] + weights[1] * z[1] + weights[2] * z[2] };
+						if (pixel_depth < depth[py * screen_width + px])
+						{
+							depth[py * screen_width + px] = pixel_depth;
+							ids[py * screen_width + px] = static_cast<int>(b);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	std::vector<float> sphere_positions(uint32_t slices, uint32_t stacks, std::vector<uint32_t>& indices)
+	{
+		std::vector<obj_vertex> vertices;
+		make_sphere(slices, stacks, 0.0f, vertices, indices);
+		std::vector<float> positions;
+		for (const obj_vertex& vertex : vertices)
+		{
+			positions.insert(positions.end(), vertex.position, vertex.position + 3);
+		}
+		return positions;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const uint32_t buffer_width{ argc > 1 ? static_cast<uint32_t>(atoi(argv[1])) : 320 };
+	const uint32_t buffer_height{ argc > 2 ? static_cast<uint32_t>(atoi(argv[2])) : 180 };
+	const size_t occluder_count{ argc > 3 ? static_cast<size_t>(atoi(argv[3])) : 32 };
+
+	// Balls of radius 1, 3 apart, like ball.obj at a scale of 0.01 in framework.
+	std::vector<uint32_t> coarse_indices, fine_indices;
+	const std::vector<float> coarse{ sphere_positions(12, 6, coarse_indices) }, fine{ sphere_positions(48, 24, fine_indices) };
+	std::vector<float> worlds;
+	world_aabbs boxes;
+	const float minimum[3]{ -1, -1, -1 }, maximum[3]{ 1, 1, 1 };
+	for (int x = -10; x < 10; ++x)
+	{
+		for (int z = 0; z < 75; ++z)
+		{
+			const float world[16]{ 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, x * 3.0f, 0, z * 3.0f, 1 };
+			worlds.insert(worlds.end(), world, world + 16);
+			boxes.push_back(minimum, maximum, world);
+		}
+	}
+
+	const std::vector<camera_path> paths{ load_camera_paths(std::filesystem::path(SOURCE_DIRECTORY) / "tests" / "camera_paths.txt") };
+	if (paths.empty())
+	{
+		printf("camera_paths.txt not found\n");
+		return 1;
+	}
+	occlusion_buffer buffer{ buffer_width, buffer_height };
+	printf("%ux%u buffer, %zu occluders of %zu triangles\n", buffer_width, buffer_height, occluder_count, coarse_indices.size() / 3);
+	printf("%-13s %7s  %-15s  %9s  %9s  %s\n", "per frame", "frustum", "occluded", "occluders", "test", "wrongly culled");
+	size_t total_errors{ 0 };
+	for (const camera_path& path : paths)
+	{
+		double occluder_time{ 0 }, test_time{ 0 };
+		size_t frustum_visible{ 0 }, occluded{ 0 }, errors{ 0 }, error_pixels{ 0 };
+		for (int frame = 0; frame < path.frames; ++frame)
+		{
+			const float t{ static_cast<float>(frame) / (path.frames - 1) * (path.keys.size() - 1) };
+			const size_t k{ std::min(static_cast<size_t>(t), path.keys.size() - 2) };
+			const float a{ t - k };
+			camera_key key;
+			for (int i = 0; i < 3; ++i)
+			{
+				key.focus[i] = path.keys[k].focus[i] * (1 - a) + path.keys[k + 1].focus[i] * a;
+			}
+			key.pitch = path.keys[k].pitch * (1 - a) + path.keys[k + 1].pitch * a;
+			key.yaw = path.keys[k].yaw * (1 - a) + path.keys[k + 1].yaw * a;
+			key.distance = path.keys[k].distance * (1 - a) + path.keys[k + 1].distance * a;
+			float view_projection[16], eye[3];
+			camera_matrix(key, view_projection, eye);
+
+			std::vector<uint32_t> visible;
+			cull_aabbs(extract_frustum(view_projection), boxes, visible);
+			frustum_visible += visible.size();
+
+			auto start{ std::chrono::steady_clock::now() };
+			auto distance = [&](uint32_t b)
+			{
+				const float dx{ boxes.center_x[b] - eye[0] }, dy{ boxes.center_y[b] - eye[1] }, dz{ boxes.center_z[b] - eye[2] };
+				return dx * dx + dy * dy + dz * dz;
+			};
+			std::vector<uint32_t> occluders{ visible };
+			if (occluders.size() > occluder_count)
+			{
+				std::nth_element(occluders.begin(), occluders.begin() + occluder_count, occluders.end(),
+					[&](uint32_t l, uint32_t r) { return distance(l) < distance(r); });
+				occluders.resize(occluder_count);
+			}
+			buffer.clear(view_projection);
+			for (uint32_t b : occluders)
+			{
+				buffer.add_occluder(coarse.data(), coarse.size() / 3, coarse_indices.data(), coarse_indices.size(), &worlds[b * 16]);
+			}
+			occluder_time += seconds_since(start);
+			start = std::chrono::steady_clock::now();
+			std::vector<uint32_t> kept{ visible };
+			occluded += buffer.cull_occluded(boxes, kept);
+			test_time += seconds_since(start);
+
+			if (frame % 8 == 0)
+			{
+				std::vector<const float*> visible_worlds;
+				for (uint32_t b : visible)
+				{
+					visible_worlds.push_back(&worlds[b * 16]);
+				}
+				std::vector<int> ids;
+				draw_ids(visible_worlds, fine, fine_indices, view_projection, ids);
+				std::vector<size_t> pixels(visible.size(), 0);
+				for (int id : ids)
+				{
+					if (id >= 0)
+					{
+						++pixels[id];
+					}
+				}
+				std::vector<bool> is_kept(boxes.size(), false);
+				for (uint32_t b : kept)
+				{
+					is_kept[b] = true;
+				}
+				for (size_t i = 0; i < visible.size(); ++i)
+				{
+					if (!is_kept[visible[i]] && pixels[i] > 0)
+					{
+						++errors;
+						error_pixels += pixels[i];
+					}
+				}
+			}
+		}
+		printf("%-13s %7.1f  %7.1f (%4.1f%%)  %6.3f ms  %6.3f ms  %zu (%zu pixels)\n", path.name.c_str(),
+			static_cast<double>(frustum_visible) / path.frames, static_cast<double>(occluded) / path.frames,
+			100.0 * occluded / std::max<size_t>(frustum_visible, 1), occluder_time * 1e3 / path.frames, test_time * 1e3 / path.frames,
+			errors, error_pixels);
+		total_errors += errors;
+	}
+	return total_errors ? 1 : 0;
+}
@@ -0,0 +1,109 @@
+#include "shading_functions.h"
+
+#include <algorithm>
+#include <random>
+
+#include "benchmark.h"
+
+// Pixels per second of shade_phong, calc_half_lambert and calc_rim_light on 64k pixels with the scalar, SSE and AVX
+// paths, against a per-pixel loop of the scalar shade_phong reference. Every path must shade as the reference does.
+//
+//   bench_shading_functions
+namespace
+{
+	struct float3_vector
+	{
+		std::vector<float> x, y, z;
+		explicit float3_vector(size_t count) : x(count), y(count), z(count) {}
+		float3_array data() { return { x.data(), y.data(), z.data() }; }
+		float3 operator[](size_t i) const { return { x[i], y[i], z[i] }; }
+		void set(size_t i, const float3& v) { x[i] = v.x; y[i] = v.y; z[i] = v.z; }
+	};
+	struct float4_vector
+	{
+		std::vector<float> x, y, z, w;
+		explicit float4_vector(size_t count) : x(count), y(count), z(count), w(count) {}
+		float4_array data() { return { x.data(), y.data(), z.data(), w.data() }; }
+		float4 operator[](size_t i) const { return { x[i], y[i], z[i], w[i] }; }
+		void set(size_t i, const float4& v) { x[i] = v.x; y[i] = v.y; z[i] = v.z; w[i] = v.w; }
+	};
+}
+
+int main()
+{
+	const size_t count{ 1 << 16 };
+	std::mt19937 rng(7);
+	auto uniform = [&rng](float minimum, float maximum) { return std::uniform_real_distribution<float>(minimum, maximum)(rng); };
+	float3_vector normals(count), eyes(count), positions(count), result(count);
+	float4_vector diffuse(count), result4(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		for (float3_vector* directions : { &normals, &eyes })
+		{
+			const float3 v{ uniform(-1, 1), uniform(-1, 1), uniform(-1, 1) };
+			const float length{ std::max(sqrtf(v.x * v.x + v.y * v.y + v.z * v.z), 1e-3f) };
+			directions->set(i, { v.x / length, v.y / length, v.z / length });
+		}
+		positions.set(i, { uniform(-50, 50), uniform(-5, 20), uniform(-50, 50) });
+		diffuse.set(i, { uniform(0, 1), uniform(0, 1), uniform(0, 1), 1 });
+	}
+	const float3 light{ 0.3f, -0.8f, 0.5f }, C{ 1.0f, 0.9f, 0.8f }, K{ 0.7f, 0.6f, 0.5f };
+	phong_constants constants{};
+	constants.camera_position = { 0, 10, -30 };
+	constants.light_direction = { 0.3f, -1, 0.4f };
+	constants.light_color = { 1, 1, 0.9f };
+	constants.ambient_color = { 0.2f, 0.2f, 0.25f };
+	constants.ka = { 1, 1, 1 };
+	constants.kd = { 0.8f, 0.8f, 0.8f };
+	constants.ks = { 1, 1, 1 };
+	constants.sky_color = { 0.4f, 0.5f, 0.9f };
+	constants.ground_color = { 0.3f, 0.2f, 0.1f };
+	constants.hemisphere_weight = { 0.5f, 0, 0, 0 };
+	constants.fog_color = { 0.5f, 0.5f, 0.6f, 1 };
+	constants.fog_range = { 20, 80 };
+
+	// The reference : one shade_phong call per pixel.
+	std::vector<float4> reference(count);
+	const double reference_rate{ calls_per_second(0.3, [&]
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			reference[i] = shade_phong(constants, diffuse[i], positions[i], normals[i]);
+		}
+	}) * count };
+	printf("%-9s phong %7.1f Mpixel/s\n", "reference", reference_rate * 1e-6);
+
+	int failures{ 0 };
+	const char* names[]{ "scalar", "sse", "avx" };
+	for (shading_simd simd : { shading_simd::scalar, shading_simd::sse, shading_simd::avx })
+	{
+		if (set_shading_simd(simd) != simd)
+		{
+			printf("%-9s not supported\n", names[static_cast<int>(simd)]);
+			continue;
+		}
+		const double phong{ calls_per_second(0.3, [&] { shade_phong(count, constants, diffuse.data(), positions.data(), normals.data(), result4.data()); }) * count };
+		const double half_lambert{ calls_per_second(0.3, [&] { calc_half_lambert(count, normals.data(), light, C, K, result.data()); }) * count };
+		const double rim{ calls_per_second(0.3, [&] { calc_rim_light(count, normals.data(), eyes.data(), light, C, 3.0f, result.data()); }) * count };
+		printf("%-9s phong %7.1f Mpixel/s (%4.1fx), half lambert %7.1f Mpixel/s, rim light %7.1f Mpixel/s\n", names[static_cast<int>(simd)],
+			phong * 1e-6, phong / reference_rate, half_lambert * 1e-6, rim * 1e-6);
+
+		// Within 1e-4 of the reference, relative above 1, as in test_shading_functions.
+		float worst_error{ 0 };
+		for (size_t i = 0; i < count; ++i)
+		{
+			const float4 value{ result4[i] };
+			for (const float difference : { reference[i].x - value.x, reference[i].y - value.y, reference[i].z - value.z, reference[i].w - value.w })
+			{
+				worst_error = std::max(worst_error, fabsf(difference) / std::max({ 1.0f, fabsf(reference[i].x), fabsf(reference[i].y), fabsf(reference[i].z) }));
+			}
+		}
+		if (worst_error > 1e-4f)
+		{
+			printf("%s : shade_phong differs from the reference by %g\n", names[static_cast<int>(simd)], worst_error);
+			++failures;
+		}
+	}
+	set_shading_simd(supported_shading_simd());
+	return failures ? 1 : 0;
+}
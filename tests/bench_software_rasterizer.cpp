@@ -0,0 +1,74 @@
+#include "software_rasterizer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+#include "benchmark.h"
+#include "test.h"
+
+// 200 balls of 4096 triangles (819k triangles) at 1280 x 720 with 1, 2, 4... threads up to the hardware concurrency (at
+// least 8), then 20 balls on one thread. Every thread count must give the image of one thread.
+//
+//   bench_software_rasterizer
+int main()
+{
+	const uint32_t width{ 1280 }, height{ 720 };
+	std::vector<obj_vertex> vertices;
+	raster_mesh ball;
+	make_sphere(64, 32, 0.0f, vertices, ball.indices);
+	for (const obj_vertex& v : vertices)
+	{
+		ball.positions.insert(ball.positions.end(), { v.position[0] * 0.5f, v.position[1] * 0.5f, v.position[2] * 0.5f });
+	}
+	ball.draws.push_back({ 0, static_cast<uint32_t>(ball.indices.size()), { 0.8f, 0.6f, 0.4f, 1 } });
+
+	const float eye[3]{ 0, 6, -20 }, direction[3]{ 0, -6, 20 }, light[3]{ 0.5f, -1, 0.7f };
+	float view_projection[16];
+	make_view_projection(eye, direction, static_cast<float>(width) / height, 0.1f, 100.0f, view_projection);
+	double resolve_time{ 0 };
+	auto frame = [&](software_rasterizer& r, int ball_count)
+	{
+		r.clear(0xFF000000);
+		r.set_light(light, 0.2f);
+		for (int i = 0; i < ball_count; ++i)
+		{
+			const float world[16]{ 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, i % 20 - 9.5f, 0, i / 20 - 5.0f, 1 };
+			r.draw(ball, world, view_projection);
+		}
+		const auto start{ std::chrono::steady_clock::now() };
+		r.resolve();
+		resolve_time = seconds_since(start);
+	};
+
+	int failures{ 0 };
+	std::vector<uint32_t> reference;
+	const size_t hardware_threads{ std::thread::hardware_concurrency() };
+	for (size_t threads = 1; threads <= std::max<size_t>(hardware_threads, 8); threads *= 2)
+	{
+		software_rasterizer r{ width, height, 64, threads };
+		double best_resolve{ 1e30 };
+		const double frame_time{ best_time(10, [&]
+		{
+			frame(r, 200);
+			best_resolve = std::min(best_resolve, resolve_time);
+		}) };
+		const software_rasterizer_statistics& counts{ r.statistics() };
+		printf("%2zu threads : %6.2f ms/frame (resolve %6.2f ms), %u triangles, %u culled, %u binned\n", threads, frame_time * 1e3,
+			best_resolve * 1e3, counts.triangles, counts.culled, counts.binned);
+		if (reference.empty())
+		{
+			reference.assign(r.color_buffer(), r.color_buffer() + r.pitch() * r.height());
+		}
+		else if (0 != memcmp(reference.data(), r.color_buffer(), reference.size() * sizeof(uint32_t)))
+		{
+			printf("the image of %zu threads differs from the image of 1 thread\n", threads);
+			++failures;
+		}
+	}
+
+	software_rasterizer r{ width, height, 64, 1 };
+	const double frame_time{ best_time(20, [&] { frame(r, 20); }) };
+	printf("20 balls (%u triangles), 1 thread : %.2f ms/frame\n", r.statistics().triangles, frame_time * 1e3);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+// Timing and cameras for the benchmarks of the device-independent modules. The benchmarks are built with the tests
+// but not run by ctest; they print their timings and return 1 if a result differs from its reference.
+inline double seconds_since(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Shortest time in seconds of 'repeats' calls of 'run'.
+template <class Function>
+double best_time(int repeats, Function&& run)
+{
+	double best{ 1e30 };
+	for (int i = 0; i < repeats; ++i)
+	{
+		const auto start{ std::chrono::steady_clock::now() };
+		run();
+		const double seconds{ seconds_since(start) };
+		best = seconds < best ? seconds : best;
+	}
+	return best;
+}
+
+// Calls of 'run' per second, calling it for at least 'seconds'.
+template <class Function>
+double calls_per_second(double seconds, Function&& run)
+{
+	const auto start{ std::chrono::steady_clock::now() };
+	long long calls{ 0 };
+	double elapsed{ 0 };
+	do
+	{
+		run();
+		++calls;
+		elapsed = seconds_since(start);
+	} while (elapsed < seconds);
+	return calls / elapsed;
+}
+
+// o = a * b for row-major 4 x 4 matrices.
+inline void multiply_matrices(const float a[16], const float b[16], float o[16])
+{
+	for (int i = 0; i < 4; ++i)
+	{
+		for (int k = 0; k < 4; ++k)
+		{
+			o[i * 4 + k] = 0;
+			for (int j = 0; j < 4; ++j)
+			{
+				o[i * 4 + k] += a[i * 4 + j] * b[j * 4 + k];
+			}
+		}
+	}
+}
+
+// Left-handed look-to view times a perspective projection with a vertical field of view of 30 degrees, like
+// framework's camera, as a row-major matrix used as 'float4(p, 1) * view_projection'.
+inline void make_view_projection(const float eye[3], const float direction[3], float aspect_ratio, float near_z, float far_z, float view_projection[16])
+{
+	auto normalize = [](float v[3])
+	{
+		const float length{ sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]) };
+		for (int i = 0; i < 3; ++i)
+		{
+			v[i] /= length;
+		}
+	};
+	float f[3]{ direction[0], direction[1], direction[2] };
+	normalize(f);
+	float r[3]{ f[2], 0, -f[0] };	// (0, 1, 0) x f
+	normalize(r);
+	const float u[3]{ f[1] * r[2] - f[2] * r[1], f[2] * r[0] - f[0] * r[2], f[0] * r[1] - f[1] * r[0] };
+	const float view[16]
+	{
+		r[0], u[0], f[0], 0,
+		r[1], u[1], f[1], 0,
+		r[2], u[2], f[2], 0,
+		-(r[0] * eye[0] + r[1] * eye[1] + r[2] * eye[2]), -(u[0] * eye[0] + u[1] * eye[1] + u[2] * eye[2]), -(f[0] * eye[0] + f[1] * eye[1] + f[2] * eye[2]), 1,
+	};
+	const float y_scale{ 1 / tanf(30 * 3.14159265f / 360) }, x_scale{ y_scale / aspect_ratio }, q{ far_z / (far_z - near_z) };
+	const float projection[16]
+	{
+		x_scale, 0, 0, 0,
+		0, y_scale, 0, 0,
+		0, 0, q, 1,
+		0, 0, -q * near_z, 0,
+	};
+	multiply_matrices(view, projection, view_projection);
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "obj_loader.h"
+
+// Checks for the tests of the device-independent modules. A failed check prints its expression and location and is
+// counted; main returns test_result() so that ctest sees the failure.
+inline int& test_failures()
+{
+	static int failures{ 0 };
+	return failures;
+}
+
+inline bool check(bool passed, const char* expression, const char* file, int line)
+{
+	if (!passed)
+	{
+		printf("%s(%d): check failed : %s\n", file, line, expression);
+		++test_failures();
+	}
+	return passed;
+}
+#define CHECK(expression) check((expression), #expression, __FILE__, __LINE__)
+
+inline int test_result()
+{
+	printf(test_failures() ? "%d checks failed\n" : "passed\n", test_failures());
+	return test_failures() ? 1 : 0;
+}
+
+// A closed UV sphere of radius 1 with outward normals, its triangles clockwise seen from outside like the meshes of
+// the renderer. 'bumps' adds a wave to the radius so that no two regions are alike.
+inline void make_sphere(uint32_t slices, uint32_t stacks, float bumps, std::vector<obj_vertex>& vertices, std::vector<uint32_t>& indices)
+{
+	const float pi{ 3.14159265f };
+	vertices.clear();
+	indices.clear();
+	for (uint32_t i = 0; i <= stacks; ++i)
+	{
+		for (uint32_t j = 0; j <= slices; ++j)
+		{
+			const float phi{ pi * i / stacks }, theta{ 2 * pi * j / slices };
+			const float r{ 1 + bumps * sinf(theta * 6) * sinf(phi * 5) };
+			obj_vertex v{};
+			v.normal[0] = sinf(phi) * cosf(theta);
+			v.normal[1] = cosf(phi);
+			v.normal[2] = sinf(phi) * sinf(theta);
+			for (int k = 0; k < 3; ++k)
+			{
+				v.position[k] = r * v.normal[k];
+			}
+			v.texcoord[0] = static_cast<float>(j) / slices;
+			v.texcoord[1] = static_cast<float>(i) / stacks;
+			vertices.push_back(v);
+		}
+	}
+	for (uint32_t i = 0; i < stacks; ++i)
+	{
+		for (uint32_t j = 0; j < slices; ++j)
+		{
+			const uint32_t a{ i * (slices + 1) + j }, b{ a + 1 }, c{ a + slices + 1 }, d{ c + 1 };
+			indices.insert(indices.end(), { a, b, c, b, d, c });
+		}
+	}
+}
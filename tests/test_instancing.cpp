@@ -0,0 +1,81 @@
+#include "instancing.h"
+
+#include <random>
+
+#include "test.h"
+
+namespace
+{
+	struct float4x4
+	{
+		float m[16];
+	};
+}
+
+int main()
+{
+	// Batches : grouped by increasing key, instances in their original order within a key, empty keys skipped.
+	const uint32_t instances[]{ 5, 7, 9, 11, 13, 15, 17 };
+	const uint32_t keys[]{ 2, 0, 2, 1, 0, 2, 4 };
+	std::vector<uint32_t> order;
+	std::vector<instance_batch> batches;
+	batch_instances(instances, keys, 7, 5, order, batches);
+	CHECK((order == std::vector<uint32_t>{ 7, 13, 11, 5, 9, 15, 17 }));
+	CHECK(batches.size() == 4);
+	if (batches.size() == 4)
+	{
+		CHECK(batches[0].key == 0 && batches[0].first == 0 && batches[0].count == 2);
+		CHECK(batches[1].key == 1 && batches[1].first == 2 && batches[1].count == 1);
+		CHECK(batches[2].key == 2 && batches[2].first == 3 && batches[2].count == 3);
+		CHECK(batches[3].key == 4 && batches[3].first == 6 && batches[3].count == 1);
+	}
+
+	// No instances, and a batch list reused from a previous frame.
+	batch_instances(nullptr, nullptr, 0, 5, order, batches);
+	CHECK(order.empty() && batches.empty());
+
+	// Many instances : the batches tile the order, and every instance lands in the batch of its key.
+	std::mt19937 rng(3);
+	std::vector<uint32_t> many(10000), many_keys(many.size());
+	for (size_t i = 0; i < many.size(); ++i)
+	{
+		many[i] = static_cast<uint32_t>(i * 3);
+		many_keys[i] = rng() % 6;
+	}
+	batch_instances(many.data(), many_keys.data(), many.size(), 6, order, batches);
+	CHECK(order.size() == many.size());
+	uint32_t next{ 0 };
+	bool placed{ true };
+	for (const instance_batch& batch : batches)
+	{
+		CHECK(batch.first == next && batch.count > 0);
+		uint32_t previous{ 0 };
+		for (uint32_t i = batch.first; i < batch.first + batch.count; ++i)
+		{
+			placed = placed && many_keys[order[i] / 3] == batch.key && (i == batch.first || order[i] > previous);
+			previous = order[i];
+		}
+		next += batch.count;
+	}
+	CHECK(placed && next == many.size());
+
+	// Packing : the matrices of the listed instances in order, or all of them.
+	std::vector<float4x4> worlds(16);
+	for (size_t i = 0; i < worlds.size(); ++i)
+	{
+		for (int k = 0; k < 16; ++k)
+		{
+			worlds[i].m[k] = static_cast<float>(i * 16 + k);
+		}
+	}
+	const uint32_t picked[]{ 3, 0, 15, 3 };
+	float4x4 packed[16];
+	pack_instance_worlds(worlds.data(), picked, 4, packed);
+	for (size_t i = 0; i < 4; ++i)
+	{
+		CHECK(packed[i].m[0] == picked[i] * 16.0f && packed[i].m[15] == picked[i] * 16.0f + 15);
+	}
+	pack_instance_worlds(worlds.data(), nullptr, worlds.size(), packed);
+	CHECK(packed[9].m[12] == 9 * 16.0f + 12);
+	return test_result();
+}
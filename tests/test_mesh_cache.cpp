@@ -0,0 +1,87 @@
+#include "mesh_cache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+#include "test.h"
+
+namespace
+{
+	// Overwrites 'size' bytes at 'offset' of 'filename'.
+	void patch(const std::filesystem::path& filename, uint64_t offset, const void* data, size_t size)
+	{
+		std::fstream file{ filename, std::ios::binary | std::ios::in | std::ios::out };
+		file.seekp(static_cast<std::streamoff>(offset));
+		file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+	}
+
+	mesh_cache_header read_header(const std::filesystem::path& filename)
+	{
+		mesh_cache_header header{};
+		std::ifstream file{ filename, std::ios::binary };
+		file.read(reinterpret_cast<char*>(&header), sizeof(header));
+		return header;
+	}
+}
+
+int main()
+{
+	const std::filesystem::path directory{ std::filesystem::temp_directory_path() / "test_mesh_cache" };
+	std::filesystem::remove_all(directory);
+	std::filesystem::create_directories(directory);
+	const std::filesystem::path obj_filename{ directory / "quad.obj" }, cache_filename{ mesh_cache::cache_filename(obj_filename) };
+	{
+		std::ofstream fout{ obj_filename };
+		fout << "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nvn 0 0 1\nvt 0 0\nusemtl a\nf 1/1/1 2/1/1 3/1/1\nusemtl b\nf 1/1/1 3/1/1 4/1/1\n";
+	}
+	obj_model model;
+	CHECK(load_obj(obj_filename, false, model));
+	CHECK(model.subsets.size() == 2);
+
+	// Loaders on several threads write the same cache at once : each writes its own temporary file, and none is
+	// left behind. On Windows a rename may fail while another one replaces the cache.
+	std::vector<std::thread> writers;
+	std::vector<char> written(8, 0);
+	for (size_t i = 0; i < written.size(); ++i)
+	{
+		writers.emplace_back([&, i] { written[i] = write_mesh_cache(cache_filename, obj_filename, 0, model); });
+	}
+	for (std::thread& writer : writers)
+	{
+		writer.join();
+	}
+	CHECK(std::count(written.begin(), written.end(), 1) > 0);
+	CHECK(std::distance(std::filesystem::directory_iterator(directory), std::filesystem::directory_iterator()) == 2);
+
+	obj_model cached;
+	mesh_cache cache;
+	CHECK(cache.open(cache_filename, obj_filename, 0, cached));
+	CHECK(cache.vertex_count() == model.vertices.size() && cache.index_count() == model.indices.size());
+	CHECK(cached.subsets.size() == 2 && cached.subsets[1].usemtl == "b");
+	CHECK(memcmp(cache.indices(), model.indices.data(), model.indices.size() * sizeof(uint32_t)) == 0);
+	cache.close();
+
+	// A subset past the end of the index blob, or an index past the vertices, rejects the cache.
+	const mesh_cache_header header{ read_header(cache_filename) };
+	const uint64_t subset_count_offset{ header.subset_offset + sizeof(mesh_cache_subset) + offsetof(mesh_cache_subset, index_count) };
+	const uint32_t too_many_indices{ header.index_count - 2 };
+	patch(cache_filename, subset_count_offset, &too_many_indices, sizeof(uint32_t));
+	cached = {};
+	CHECK(!cache.open(cache_filename, obj_filename, 0, cached));
+
+	CHECK(write_mesh_cache(cache_filename, obj_filename, 0, model));
+	const uint32_t outside{ header.vertex_count };
+	patch(cache_filename, header.index_offset + 4 * sizeof(uint32_t), &outside, sizeof(uint32_t));
+	cached = {};
+	CHECK(!cache.open(cache_filename, obj_filename, 0, cached));
+
+	CHECK(write_mesh_cache(cache_filename, obj_filename, 0, model));
+	cached = {};
+	CHECK(cache.open(cache_filename, obj_filename, 0, cached));
+	cache.close();
+	std::filesystem::remove_all(directory);
+	return test_result();
+}
@@ -0,0 +1,111 @@
+#include "mesh_simplifier.h"
+
+#include <algorithm>
+#include <cfloat>
+
+#include "test.h"
+
+namespace
+{
+	// Distance from p to triangle abc (Ericson, "Real-Time Collision Detection", 5.1.5).
+	float distance_to_triangle(const float* p, const float* a, const float* b, const float* c)
+	{
+		auto dot = [](const float* x, const float* y) { return x[0] * y[0] + x[1] * y[1] + x[2] * y[2]; };
+		auto distance = [&](const float* q) { const float d[3]{ p[0] - q[0], p[1] - q[1], p[2] - q[2] }; return sqrtf(dot(d, d)); };
+		auto point = [&](const float* origin, const float* u, float s, const float* v, float t, float* q)
+		{
+			for (int k = 0; k < 3; ++k) q[k] = origin[k] + u[k] * s + v[k] * t;
+		};
+		const float ab[3]{ b[0] - a[0], b[1] - a[1], b[2] - a[2] }, ac[3]{ c[0] - a[0], c[1] - a[1], c[2] - a[2] }, bc[3]{ c[0] - b[0], c[1] - b[1], c[2] - b[2] };
+		const float ap[3]{ p[0] - a[0], p[1] - a[1], p[2] - a[2] }, bp[3]{ p[0] - b[0], p[1] - b[1], p[2] - b[2] }, cp[3]{ p[0] - c[0], p[1] - c[1], p[2] - c[2] };
+		const float d1{ dot(ab, ap) }, d2{ dot(ac, ap) }, d3{ dot(ab, bp) }, d4{ dot(ac, bp) }, d5{ dot(ab, cp) }, d6{ dot(ac, cp) };
+		float q[3];
+		if (d1 <= 0 && d2 <= 0) return distance(a);
+		if (d3 >= 0 && d4 <= d3) return distance(b);
+		if (d6 >= 0 && d5 <= d6) return distance(c);
+		const float vc{ d1 * d4 - d3 * d2 }, vb{ d5 * d2 - d1 * d6 }, va{ d3 * d6 - d5 * d4 };
+		if (vc <= 0 && d1 >= 0 && d3 <= 0) { point(a, ab, d1 / (d1 - d3), ac, 0, q); return distance(q); }
+		if (vb <= 0 && d2 >= 0 && d6 <= 0) { point(a, ab, 0, ac, d2 / (d2 - d6), q); return distance(q); }
+		if (va <= 0 && d4 - d3 >= 0 && d5 - d6 >= 0) { point(b, bc, (d4 - d3) / ((d4 - d3) + (d5 - d6)), bc, 0, q); return distance(q); }
+		const float denominator{ 1 / (va + vb + vc) };
+		point(a, ab, vb * denominator, ac, vc * denominator, q);
+		return distance(q);
+	}
+}
+
+int main()
+{
+	const uint32_t slices{ 128 }, stacks{ 64 };
+	std::vector<obj_vertex> vertices;
+	std::vector<uint32_t> indices;
+	make_sphere(slices, stacks, 0.05f, vertices, indices);
+	const float* positions{ vertices.data()->position };
+	const size_t stride{ sizeof(obj_vertex) };
+
+	// The LOD chain of static_mesh : every level halves the previous one, collapses are capped at a twentieth of the
+	// bounding box diagonal, level errors add up and the chain stops when a level removes less than a tenth.
+	const float max_error{ 0.05f * sqrtf(3 * 2.1f * 2.1f) };
+	std::vector<std::vector<uint32_t>> levels{ indices };
+	std::vector<float> errors{ 0.0f };
+	while (levels.size() < 5)
+	{
+		const std::vector<uint32_t>& previous{ levels.back() };
+		std::vector<uint32_t> simplified(previous.size());
+		float error{ 0.0f };
+		const size_t count{ simplify_mesh(simplified.data(), previous.data(), previous.size(), positions, stride, vertices.size(),
+			previous.size() / 6 * 3, max_error, &error) };
+		CHECK(count % 3 == 0 && count <= previous.size());
+		CHECK(error <= max_error);
+		if (count == 0 || count * 10 > previous.size() * 9)
+		{
+			break;
+		}
+		simplified.resize(count);
+		levels.push_back(simplified);
+		errors.push_back(errors.back() + error);
+	}
+	CHECK(levels.size() == 5);
+
+	// Report : triangles, the error recorded for the level and the largest distance measured from the original
+	// vertices to the simplified surface, which the recorded error must bound.
+	for (size_t level = 0; level < levels.size(); ++level)
+	{
+		const std::vector<uint32_t>& list{ levels[level] };
+		CHECK(std::all_of(list.begin(), list.end(), [&](uint32_t i) { return i < vertices.size(); }));
+		float measured{ 0 };
+		for (size_t v = 0; v < vertices.size(); v += 29)
+		{
+			float nearest{ FLT_MAX };
+			for (size_t t = 0; t < list.size(); t += 3)
+			{
+				nearest = std::min(nearest, distance_to_triangle(vertices[v].position, vertices[list[t]].position, vertices[list[t + 1]].position, vertices[list[t + 2]].position));
+			}
+			measured = std::max(measured, nearest);
+		}
+		printf("LOD %zu : %6zu triangles, error %.5f, measured %.5f\n", level, list.size() / 3, errors[level], measured);
+		CHECK(measured <= errors[level] + 1e-5f);
+		if (level > 0)
+		{
+			CHECK(list.size() * 10 <= levels[level - 1].size() * 6);
+			CHECK(errors[level] >= errors[level - 1]);
+		}
+	}
+
+	// The texture seam (the first and last columns share positions) is locked : its vertices stay in every level.
+	for (const std::vector<uint32_t>& list : levels)
+	{
+		std::vector<bool> used(vertices.size(), false);
+		for (uint32_t i : list) used[i] = true;
+		bool seam_kept{ true };
+		for (uint32_t i = 1; i < stacks; ++i)
+		{
+			seam_kept = seam_kept && used[i * (slices + 1)] && used[i * (slices + 1) + slices];
+		}
+		CHECK(seam_kept);
+	}
+
+	// A target error of 0 removes nothing from a curved surface.
+	std::vector<uint32_t> unchanged(indices.size());
+	CHECK(simplify_mesh(unchanged.data(), indices.data(), indices.size(), positions, stride, vertices.size(), 0, 0.0f) == indices.size());
+	return test_result();
+}
@@ -0,0 +1,159 @@
+#include "meshlet.h"
+
+#include <algorithm>
+#include <array>
+
+#include "vertex_cache_optimizer.h"
+#include "test.h"
+
+namespace
+{
+	void multiply(const float a[16], const float b[16], float result[16])
+	{
+		for (int r = 0; r < 4; ++r)
+		{
+			for (int c = 0; c < 4; ++c)
+			{
+				result[r * 4 + c] = a[r * 4 + 0] * b[0 * 4 + c] + a[r * 4 + 1] * b[1 * 4 + c] + a[r * 4 + 2] * b[2 * 4 + c] + a[r * 4 + 3] * b[3 * 4 + c];
+			}
+		}
+	}
+
+	std::array<uint32_t, 3> triangle_key(const uint32_t* t)
+	{
+		std::array<uint32_t, 3> key{ t[0], t[1], t[2] };
+		std::rotate(key.begin(), std::min_element(key.begin(), key.end()), key.end());
+		return key;
+	}
+}
+
+int main()
+{
+	std::vector<obj_vertex> vertices;
+	std::vector<uint32_t> indices;
+	make_sphere(256, 128, 0.05f, vertices, indices);
+	optimize_vertex_cache(indices.data(), indices.size(), vertices.size());
+	const float* positions{ vertices.data()->position };
+
+	meshlet_data data;
+	const size_t count{ build_meshlets(indices.data(), indices.size(), positions, sizeof(obj_vertex), data) };
+	CHECK(count == data.meshlets.size());
+
+	// Every triangle is in exactly one meshlet, with its winding, and every meshlet respects the limits and bounds
+	// its vertices.
+	std::vector<std::array<uint32_t, 3>> expected, built;
+	for (size_t i = 0; i < indices.size(); i += 3)
+	{
+		expected.push_back(triangle_key(&indices[i]));
+	}
+	size_t cones{ 0 };
+	for (const meshlet& m : data.meshlets)
+	{
+		CHECK(m.vertex_count <= 64 && m.triangle_count <= 124 && m.triangle_count > 0);
+		for (uint32_t t = 0; t < m.triangle_count; ++t)
+		{
+			uint32_t triangle[3];
+			for (int k = 0; k < 3; ++k)
+			{
+				const uint8_t local{ data.triangles[m.triangle_offset + t * 3 + k] };
+				CHECK(local < m.vertex_count);
+				triangle[k] = data.vertices[m.vertex_offset + local];
+			}
+			built.push_back(triangle_key(triangle));
+		}
+		for (uint32_t v = 0; v < m.vertex_count; ++v)
+		{
+			const float* p{ vertices[data.vertices[m.vertex_offset + v]].position };
+			float distance_squared{ 0 };
+			for (int k = 0; k < 3; ++k)
+			{
+				CHECK(p[k] >= m.aabb_min[k] && p[k] <= m.aabb_max[k]);
+				distance_squared += (p[k] - m.center[k]) * (p[k] - m.center[k]);
+			}
+			CHECK(sqrtf(distance_squared) <= m.radius * 1.0001f);
+		}
+		cones += m.cone_cutoff < 1;
+	}
+	std::sort(expected.begin(), expected.end());
+	std::sort(built.begin(), built.end());
+	CHECK(built == expected);
+	printf("%zu triangles, %zu meshlets, %zu with a normal cone\n", expected.size(), count, cones);
+
+	// Culling is conservative : from cameras around and inside the sphere, every front facing triangle with a part
+	// inside the frustum is kept.
+	const float cameras[][3]{ { 0.6f, 0, -3 }, { 0, 2.5f, -1 }, { 2, -1, 2 }, { 0, 0, -1.5f }, { 0.2f, 0.1f, 0 } };
+	size_t kept_total{ 0 }, triangle_total{ 0 };
+	for (const float* camera : cameras)
+	{
+		// Looking at the origin (along +z from the center), 40 degrees vertical field of view, row-major p * M.
+		float forward[3]{ -camera[0], -camera[1], -camera[2] };
+		float length{ sqrtf(forward[0] * forward[0] + forward[1] * forward[1] + forward[2] * forward[2]) };
+		if (length < 0.5f)
+		{
+			forward[0] = 0; forward[1] = 0; forward[2] = length = 1;
+		}
+		for (float& f : forward) f /= length;
+		float right[3]{ forward[2], 0, -forward[0] };
+		length = sqrtf(right[0] * right[0] + right[2] * right[2]);
+		for (float& r : right) r /= length;
+		const float up[3]{ forward[1] * right[2] - forward[2] * right[1], forward[2] * right[0] - forward[0] * right[2], forward[0] * right[1] - forward[1] * right[0] };
+		float view[16]{ right[0], up[0], forward[0], 0, right[1], up[1], forward[1], 0, right[2], up[2], forward[2], 0, 0, 0, 0, 1 };
+		for (int c = 0; c < 3; ++c)
+		{
+			view[12 + c] = -(camera[0] * view[c] + camera[1] * view[4 + c] + camera[2] * view[8 + c]);
+		}
+		const float y_scale{ 1 / tanf(20 * 3.14159265f / 180) }, x_scale{ y_scale / (16.0f / 9) }, z_near{ 0.01f }, z_far{ 100 };
+		const float projection[16]{ x_scale, 0, 0, 0, 0, y_scale, 0, 0, 0, 0, z_far / (z_far - z_near), 1, 0, 0, -z_near * z_far / (z_far - z_near), 0 };
+		float view_projection[16];
+		multiply(view, projection, view_projection);
+		const frustum f{ extract_frustum(view_projection) };
+
+		std::vector<uint32_t> kept;
+		meshlet_cull_statistics statistics{ cull_meshlets(data, 0, count, f, camera, kept) };
+		CHECK(statistics.meshlet_count == count);
+		std::vector<std::array<uint32_t, 3>> kept_triangles;
+		for (size_t i = 0; i < kept.size(); i += 3)
+		{
+			kept_triangles.push_back(triangle_key(&kept[i]));
+		}
+		std::sort(kept_triangles.begin(), kept_triangles.end());
+
+		size_t visible{ 0 }, missing{ 0 };
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			const float* a{ vertices[indices[i]].position };
+			const float* b{ vertices[indices[i + 1]].position };
+			const float* c{ vertices[indices[i + 2]].position };
+			const float e1[3]{ b[0] - a[0], b[1] - a[1], b[2] - a[2] }, e2[3]{ c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+			const float n[3]{ e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+			if (n[0] * (a[0] - camera[0]) + n[1] * (a[1] - camera[1]) + n[2] * (a[2] - camera[2]) >= 0)
+			{
+				continue;
+			}
+			bool inside{ true };
+			for (const float* plane : f.planes)
+			{
+				bool outside{ true };
+				for (const float* p : { a, b, c })
+				{
+					outside = outside && plane[0] * p[0] + plane[1] * p[1] + plane[2] * p[2] + plane[3] < 0;
+				}
+				inside = inside && !outside;
+			}
+			if (!inside)
+			{
+				continue;
+			}
+			++visible;
+			missing += !std::binary_search(kept_triangles.begin(), kept_triangles.end(), triangle_key(&indices[i]));
+		}
+		printf("camera (%g, %g, %g) : %zu frustum culled, %zu backface culled, %zu of %zu triangles kept, %zu visible\n",
+			camera[0], camera[1], camera[2], statistics.frustum_culled, statistics.backface_culled, kept.size() / 3, indices.size() / 3, visible);
+		CHECK(missing == 0);
+		kept_total += kept.size() / 3;
+		triangle_total += indices.size() / 3;
+	}
+	// And it is worth doing : outside the sphere half of it faces away.
+	CHECK(kept_total * 10 < triangle_total * 7);
+	return test_result();
+}
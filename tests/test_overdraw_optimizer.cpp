@@ -0,0 +1,83 @@
+#include "overdraw_optimizer.h"
+
+#include <algorithm>
+#include <array>
+
+#include "vertex_cache_optimizer.h"
+#include "test.h"
+
+int main()
+{
+	// Eight nested shells generated inside out, the worst order for overdraw. The outer shells have windows so that
+	// the inner ones are visible from every side.
+	const float pi{ 3.14159265f };
+	const uint32_t slices{ 96 }, stacks{ 48 };
+	std::vector<obj_vertex> vertices;
+	std::vector<uint32_t> indices;
+	for (uint32_t shell = 0; shell < 8; ++shell)
+	{
+		const float r{ 0.3f + shell * 0.1f }, x{ 0.05f * shell };
+		const uint32_t base{ static_cast<uint32_t>(vertices.size()) };
+		for (uint32_t i = 0; i <= stacks; ++i)
+		{
+			for (uint32_t j = 0; j <= slices; ++j)
+			{
+				const float phi{ pi * i / stacks }, theta{ 2 * pi * j / slices };
+				obj_vertex v{};
+				v.position[0] = x + r * sinf(phi) * cosf(theta);
+				v.position[1] = r * cosf(phi);
+				v.position[2] = r * sinf(phi) * sinf(theta);
+				vertices.push_back(v);
+			}
+		}
+		for (uint32_t i = 0; i < stacks; ++i)
+		{
+			for (uint32_t j = 0; j < slices; ++j)
+			{
+				if (shell < 7 && ((i / 6) + (j / 12)) % 2)
+				{
+					continue;
+				}
+				const uint32_t a{ base + i * (slices + 1) + j }, b{ a + 1 }, c{ a + slices + 1 }, d{ c + 1 };
+				indices.insert(indices.end(), { a, b, c, b, d, c });
+			}
+		}
+	}
+	const float* positions{ vertices.data()->position };
+	const size_t stride{ sizeof(obj_vertex) };
+
+	optimize_vertex_cache(indices.data(), indices.size(), vertices.size());
+	const std::vector<uint32_t> cache_ordered{ indices };
+	overdraw_statistics before{ estimate_overdraw(indices.data(), indices.size(), positions, stride, vertices.size()) };
+	float acmr_before{ analyze_vertex_cache(indices.data(), indices.size(), vertices.size()).acmr };
+
+	optimize_overdraw(indices.data(), indices.size(), positions, stride, vertices.size());
+	overdraw_statistics after{ estimate_overdraw(indices.data(), indices.size(), positions, stride, vertices.size()) };
+	float acmr_after{ analyze_vertex_cache(indices.data(), indices.size(), vertices.size()).acmr };
+	printf("overdraw %.3f -> %.3f, ACMR %.3f -> %.3f\n", before.overdraw, after.overdraw, acmr_before, acmr_after);
+
+	// The pass only moves whole triangles.
+	auto sorted_triangles = [](const std::vector<uint32_t>& list)
+	{
+		std::vector<std::array<uint32_t, 3>> triangles;
+		for (size_t i = 0; i < list.size(); i += 3)
+		{
+			triangles.push_back({ list[i], list[i + 1], list[i + 2] });
+		}
+		std::sort(triangles.begin(), triangles.end());
+		return triangles;
+	};
+	CHECK(sorted_triangles(indices) == sorted_triangles(cache_ordered));
+
+	// The same pixels are covered, by far fewer fragments, for at most the default 5% of extra cache misses.
+	CHECK(after.pixels_covered == before.pixels_covered);
+	CHECK(before.overdraw > 2.0f);
+	CHECK(after.overdraw < 1.4f);
+	CHECK(acmr_after <= acmr_before * 1.05f + 0.01f);
+
+	// A threshold of 1 allows no cache loss at all.
+	indices = cache_ordered;
+	optimize_overdraw(indices.data(), indices.size(), positions, stride, vertices.size(), 1.0f);
+	CHECK(analyze_vertex_cache(indices.data(), indices.size(), vertices.size()).acmr <= acmr_before + 0.01f);
+	return test_result();
+}
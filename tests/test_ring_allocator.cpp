@@ -0,0 +1,88 @@
+#include "ring_allocator.h"
+
+#include <random>
+
+#include "test.h"
+
+int main()
+{
+	// Fill, wrap and retire on a small ring of four 256-byte slices.
+	ring_allocator ring{ 1024, 256 };
+	CHECK(ring.allocate(10) == 0);
+	CHECK(ring.allocate(300) == 256);
+	CHECK(ring.allocate(256) == 768);
+	CHECK(ring.allocate(1) == ring_allocator::npos);	// full
+	CHECK(ring.used() == 1024);
+	ring.end_frame(1);
+	CHECK(ring.frames_in_flight() == 1 && ring.oldest_fence() == 1);
+	CHECK(ring.allocate(1) == ring_allocator::npos);	// still in flight
+	ring.retire(0);
+	CHECK(ring.allocate(1) == ring_allocator::npos);
+	ring.retire(1);
+	CHECK(ring.used() == 0 && ring.frames_in_flight() == 0 && ring.oldest_fence() == 0);
+
+	CHECK(ring.allocate(600) == 0);
+	ring.end_frame(2);
+	CHECK(ring.allocate(500) == ring_allocator::npos);	// would straddle the end, and the start is in flight
+	CHECK(ring.allocate(256) == 768);
+	ring.end_frame(3);
+	ring.retire(2);
+	CHECK(ring.allocate(500) == 0);	// the tail of the buffer is skipped
+	CHECK(ring.allocate(0) == ring_allocator::npos);
+	CHECK(ring.allocate(2048) == ring_allocator::npos);
+
+	// A GPU two or three frames behind : allocations never overlap a range of a frame that is not retired, and are
+	// aligned and inside the buffer.
+	std::mt19937 rng(1);
+	ring_allocator frames{ 1 << 16, 256 };
+	struct range
+	{
+		uint64_t fence;
+		size_t offset, size;
+	};
+	std::vector<range> live;
+	uint64_t fence{ 0 };
+	size_t allocations{ 0 }, failures{ 0 };
+	bool aligned{ true }, disjoint{ true };
+	for (int frame = 0; frame < 20000; ++frame)
+	{
+		const int count{ static_cast<int>(rng() % 40) };
+		for (int i = 0; i < count; ++i)
+		{
+			const size_t size{ 1 + rng() % 1000 };
+			const size_t offset{ frames.allocate(size) };
+			if (offset == ring_allocator::npos)
+			{
+				++failures;
+				continue;
+			}
+			++allocations;
+			aligned = aligned && offset % 256 == 0 && offset + size <= frames.capacity();
+			for (const range& r : live)
+			{
+				disjoint = disjoint && (offset + size <= r.offset || r.offset + r.size <= offset);
+			}
+			live.push_back({ fence + 1, offset, size });
+		}
+		frames.end_frame(++fence);
+		if (fence > 3)
+		{
+			const uint64_t completed{ fence - 3 + rng() % 2 };
+			frames.retire(completed);
+			std::vector<range> still_live;
+			for (const range& r : live)
+			{
+				if (r.fence > completed)
+				{
+					still_live.push_back(r);
+				}
+			}
+			live.swap(still_live);
+		}
+	}
+	printf("%zu allocations, %zu refused\n", allocations, failures);
+	CHECK(aligned);
+	CHECK(disjoint);
+	CHECK(allocations > failures * 10);
+	return test_result();
+}
@@ -0,0 +1,169 @@
+#include "shading_functions.h"
+
+#include <algorithm>
+#include <random>
+
+#include "test.h"
+
+namespace
+{
+	std::mt19937 rng(7);
+
+	float uniform(float minimum, float maximum) { return std::uniform_real_distribution<float>(minimum, maximum)(rng); }
+
+	float3 random_direction()
+	{
+		for (;;)
+		{
+			const float3 v{ uniform(-1, 1), uniform(-1, 1), uniform(-1, 1) };
+			const float length{ sqrtf(v.x * v.x + v.y * v.y + v.z * v.z) };
+			if (length > 0.1f && length < 1)
+			{
+				return { v.x / length, v.y / length, v.z / length };
+			}
+		}
+	}
+
+	struct float3_vector
+	{
+		std::vector<float> x, y, z;
+		explicit float3_vector(size_t count) : x(count), y(count), z(count) {}
+		float3_array data() { return { x.data(), y.data(), z.data() }; }
+		float3 operator[](size_t i) const { return { x[i], y[i], z[i] }; }
+		void set(size_t i, const float3& v) { x[i] = v.x; y[i] = v.y; z[i] = v.z; }
+	};
+	struct float4_vector
+	{
+		std::vector<float> x, y, z, w;
+		explicit float4_vector(size_t count) : x(count), y(count), z(count), w(count) {}
+		float4_array data() { return { x.data(), y.data(), z.data(), w.data() }; }
+		float4 operator[](size_t i) const { return { x[i], y[i], z[i], w[i] }; }
+	};
+
+	// Batch results must match the scalar reference within 1e-4, relative above 1.
+	float worst_error{ 0 };
+	bool close(float reference, float value)
+	{
+		const float error{ fabsf(reference - value) };
+		worst_error = std::max(worst_error, error);
+		return error <= 1e-4f * std::max(1.0f, fabsf(reference));
+	}
+	bool close(const float3& reference, const float3& value) { return close(reference.x, value.x) && close(reference.y, value.y) && close(reference.z, value.z); }
+	bool close(const float4& reference, const float4& value) { return close(reference.x, value.x) && close(reference.y, value.y) && close(reference.z, value.z) && close(reference.w, value.w); }
+}
+
+int main()
+{
+	// An odd count so that the SSE and AVX paths also run their remainder.
+	const size_t count{ 1003 };
+	float3_vector normals(count), eyes(count), colors(count), positions(count), result(count);
+	float4_vector diffuse(count), result4(count);
+	std::vector<float> eye_lengths(count);
+	float3 light{ 0.3f, -0.8f, 0.5f };
+	const float light_length{ sqrtf(light.x * light.x + light.y * light.y + light.z * light.z) };
+	light = { light.x / light_length, light.y / light_length, light.z / light_length };
+	for (size_t i = 0; i < count; ++i)
+	{
+		const float3 n{ random_direction() };
+		normals.set(i, n);
+		eyes.set(i, random_direction());
+		// A third of the eye vectors near the mirror direction, so that the specular highlights are exercised.
+		if (i % 3 == 0)
+		{
+			const float d{ n.x * light.x + n.y * light.y + n.z * light.z };
+			const float3 jitter{ random_direction() };
+			float3 e{ -(light.x - 2 * d * n.x) + 0.01f * jitter.x, -(light.y - 2 * d * n.y) + 0.01f * jitter.y, -(light.z - 2 * d * n.z) + 0.01f * jitter.z };
+			const float length{ sqrtf(e.x * e.x + e.y * e.y + e.z * e.z) };
+			eyes.set(i, { e.x / length, e.y / length, e.z / length });
+		}
+		colors.set(i, { uniform(0, 1), uniform(0, 1), uniform(0, 1) });
+		positions.set(i, { uniform(-50, 50), uniform(-5, 20), uniform(-50, 50) });
+		diffuse.x[i] = uniform(0, 1); diffuse.y[i] = uniform(0, 1); diffuse.z[i] = uniform(0, 1); diffuse.w[i] = uniform(0, 1);
+		eye_lengths[i] = uniform(0, 100);
+	}
+	const float3 C{ 1.0f, 0.9f, 0.8f }, K{ 0.7f, 0.6f, 0.5f };
+	shading_texture ramp;
+	ramp.width = 16;
+	ramp.height = 1;
+	for (int i = 0; i < 16; ++i)
+	{
+		const float v{ (i / 4) / 3.0f };
+		ramp.texels.insert(ramp.texels.end(), { v, v, v, 1 });
+	}
+	shading_texture environment;
+	environment.width = 32;
+	environment.height = 32;
+	for (int i = 0; i < 32 * 32 * 4; ++i)
+	{
+		environment.texels.push_back(uniform(0, 1));
+	}
+	phong_constants constants{};
+	constants.camera_position = { 0, 10, -30 };
+	constants.light_direction = { 0.3f, -1, 0.4f };
+	constants.light_color = { 1, 1, 0.9f };
+	constants.ambient_color = { 0.2f, 0.2f, 0.25f };
+	constants.ka = { 1, 1, 1 };
+	constants.kd = { 0.8f, 0.8f, 0.8f };
+	constants.ks = { 1, 1, 1 };
+	constants.sky_color = { 0.4f, 0.5f, 0.9f };
+	constants.ground_color = { 0.3f, 0.2f, 0.1f };
+	constants.hemisphere_weight = { 0.5f, 0, 0, 0 };
+	constants.fog_color = { 0.5f, 0.5f, 0.6f, 1 };
+	constants.fog_range = { 20, 80 };
+
+	const char* names[]{ "scalar", "sse", "avx" };
+	for (shading_simd simd : { shading_simd::scalar, shading_simd::sse, shading_simd::avx })
+	{
+		if (set_shading_simd(simd) != simd)
+		{
+			printf("%s : not supported\n", names[static_cast<int>(simd)]);
+			continue;
+		}
+		worst_error = 0;
+		bool lambert{ true }, specular{ true }, half_lambert{ true }, rim{ true }, ramp_shading{ true }, sphere{ true }, hemisphere{ true }, fog{ true }, phong{ true };
+		calc_lambert(count, normals.data(), light, C, K, result.data());
+		for (size_t i = 0; i < count; ++i) lambert = lambert && close(calc_lambert(normals[i], light, C, K), result[i]);
+		calc_phong_specular(count, normals.data(), light, eyes.data(), C, K, result.data());
+		for (size_t i = 0; i < count; ++i) specular = specular && close(calc_phong_specular(normals[i], light, eyes[i], C, K), result[i]);
+		calc_half_lambert(count, normals.data(), light, C, K, result.data());
+		for (size_t i = 0; i < count; ++i) half_lambert = half_lambert && close(calc_half_lambert(normals[i], light, C, K), result[i]);
+		for (float power : { 3.0f, 1.7f })
+		{
+			calc_rim_light(count, normals.data(), eyes.data(), light, C, power, result.data());
+			for (size_t i = 0; i < count; ++i) rim = rim && close(calc_rim_light(normals[i], eyes[i], light, C, power), result[i]);
+		}
+		calc_ramp_shading(count, ramp, normals.data(), light, C, K, result.data());
+		for (size_t i = 0; i < count; ++i) ramp_shading = ramp_shading && close(calc_ramp_shading(ramp, normals[i], light, C, K), result[i]);
+		calc_sphere_environment(count, environment, colors.data(), normals.data(), eyes.data(), 0.6f, result.data());
+		for (size_t i = 0; i < count; ++i) sphere = sphere && close(calc_sphere_environment(environment, colors[i], normals[i], eyes[i], 0.6f), result[i]);
+		calc_hemisphere_light(count, normals.data(), { 0, 1, 0 }, constants.sky_color, constants.ground_color, constants.hemisphere_weight, result.data());
+		for (size_t i = 0; i < count; ++i)
+		{
+			hemisphere = hemisphere && close(calc_hemisphere_light(normals[i], { 0, 1, 0 }, constants.sky_color, constants.ground_color, constants.hemisphere_weight), result[i]);
+		}
+		calc_fog(count, diffuse.data(), constants.fog_color, constants.fog_range, eye_lengths.data(), result4.data());
+		for (size_t i = 0; i < count; ++i) fog = fog && close(calc_fog(diffuse[i], constants.fog_color, constants.fog_range, eye_lengths[i]), result4[i]);
+		shade_phong(count, constants, diffuse.data(), positions.data(), normals.data(), result4.data());
+		for (size_t i = 0; i < count; ++i) phong = phong && close(shade_phong(constants, diffuse[i], positions[i], normals[i]), result4[i]);
+		printf("%s : largest difference to the scalar reference %.3g\n", names[static_cast<int>(simd)], worst_error);
+		CHECK(lambert);
+		CHECK(specular);
+		CHECK(half_lambert);
+		CHECK(rim);
+		CHECK(ramp_shading);
+		CHECK(sphere);
+		CHECK(hemisphere);
+		CHECK(fog);
+		CHECK(phong);
+	}
+
+	// A few values of the HLSL functions worked out by hand.
+	set_shading_simd(shading_simd::scalar);
+	const float3 up{ 0, 1, 0 }, down{ 0, -1, 0 }, white{ 1, 1, 1 };
+	CHECK(close(calc_lambert(up, down, white, white), float3{ 1, 1, 1 }));
+	CHECK(close(calc_lambert(up, up, white, white), float3{ 0, 0, 0 }));
+	CHECK(close(calc_half_lambert(up, { 1, 0, 0 }, white, white), float3{ 0.5f, 0.5f, 0.5f }));
+	CHECK(close(calc_fog({ 1, 0, 0, 1 }, { 0, 0, 1, 1 }, { 20, 80 }, 50), float4{ 0.5f, 0, 0.5f, 1 }));
+	set_shading_simd(supported_shading_simd());
+	return test_result();
+}
@@ -0,0 +1,153 @@
+#include "software_rasterizer.h"
+
+#include <cstring>
+
+#include "test.h"
+
+namespace
+{
+	const uint32_t width{ 1280 }, height{ 720 };
+	const float identity[16]{ 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+
+	// A camera at 'eye' looking along +z, with a 60 degree vertical field of view, near 0.1 and far 100.
+	void view_projection(float x, float y, float z, float m[16])
+	{
+		const float y_scale{ 1 / tanf(3.14159265f / 6) }, x_scale{ y_scale * height / width }, q{ 100.0f / (100.0f - 0.1f) };
+		const float matrix[16]{ x_scale, 0, 0, 0, 0, y_scale, 0, 0, 0, 0, q, 1, -x * x_scale, -y * y_scale, -z * q - 0.1f * q, -z };
+		memcpy(m, matrix, sizeof(matrix));
+	}
+
+	// An n x n grid of quads in the z = 0 plane over [-size, size]^2, clockwise seen from -z, its inner vertices moved a
+	// little so that no two edges are parallel.
+	raster_mesh make_grid(int n, float size, float jitter)
+	{
+		raster_mesh grid;
+		for (int i = 0; i <= n; ++i)
+		{
+			for (int j = 0; j <= n; ++j)
+			{
+				const bool border{ i == 0 || i == n || j == 0 || j == n };
+				const float x{ -size + 2 * size * j / n + (border ? 0 : jitter * sinf(i * 7.1f + j)) };
+				const float y{ size - 2 * size * i / n + (border ? 0 : jitter * cosf(j * 5.3f + i)) };
+				grid.positions.insert(grid.positions.end(), { x, y, 0 });
+			}
+		}
+		for (int i = 0; i < n; ++i)
+		{
+			for (int j = 0; j < n; ++j)
+			{
+				const uint32_t a{ static_cast<uint32_t>(i * (n + 1) + j) }, b{ a + 1 }, c{ a + n + 1 }, d{ c + 1 };
+				grid.indices.insert(grid.indices.end(), { a, b, c, b, d, c });
+			}
+		}
+		grid.draws.push_back({ 0, static_cast<uint32_t>(grid.indices.size()), { 1, 1, 1, 1 } });
+		return grid;
+	}
+
+	raster_mesh make_ball(bool inside_out)
+	{
+		std::vector<obj_vertex> vertices;
+		raster_mesh ball;
+		make_sphere(48, 24, 0.1f, vertices, ball.indices);
+		for (const obj_vertex& v : vertices)
+		{
+			ball.positions.insert(ball.positions.end(), v.position, v.position + 3);
+		}
+		for (size_t i = 0; inside_out && i < ball.indices.size(); i += 3)
+		{
+			std::swap(ball.indices[i + 1], ball.indices[i + 2]);
+		}
+		ball.draws.push_back({ 0, static_cast<uint32_t>(ball.indices.size()), { 0.8f, 0.6f, 0.4f, 1 } });
+		return ball;
+	}
+
+	// Pixels of rows [first_row, last_row) still at the clear color 0.
+	size_t holes(const software_rasterizer& r, uint32_t first_row, uint32_t last_row)
+	{
+		size_t count{ 0 };
+		for (uint32_t y = first_row; y < last_row; ++y)
+		{
+			for (uint32_t x = 0; x < r.width(); ++x)
+			{
+				count += r.color_buffer()[y * r.pitch() + x] == 0 ? 1 : 0;
+			}
+		}
+		return count;
+	}
+}
+
+int main()
+{
+	// A jittered grid drawn in clip space over more than the screen : the shared edges leave no pixel uncovered.
+	{
+		software_rasterizer r{ width, height, 64, 1 };
+		r.clear(0);
+		const raster_mesh grid{ make_grid(37, 1.2f, 0.012f) };
+		r.draw(grid, identity, identity);
+		r.resolve();
+		printf("grid : %u triangles, %zu holes\n", r.statistics().triangles, holes(r, 0, height));
+		CHECK(r.statistics().triangles == 2 * 37 * 37);
+		CHECK(holes(r, 0, height) == 0);
+	}
+
+	// A floor reaching behind the camera is clipped by the near plane. It covers the ground below its far edge and
+	// nothing above the horizon.
+	{
+		raster_mesh floor{ make_grid(16, 50.0f, 0) };
+		for (size_t i = 0; i < floor.positions.size(); i += 3)
+		{
+			std::swap(floor.positions[i + 1], floor.positions[i + 2]);	// the y = 0 plane, still clockwise from above
+		}
+		float camera[16];
+		view_projection(0, 1, -3, camera);
+		software_rasterizer r{ width, height };
+		r.clear(0);
+		r.draw(floor, identity, camera);
+		r.resolve();
+		printf("floor : %u triangles, %u clipped, %zu holes below the horizon\n", r.statistics().triangles, r.statistics().clipped, holes(r, height / 2 + 16, height));
+		CHECK(r.statistics().clipped > 0);
+		CHECK(holes(r, height / 2 + 16, height) == 0);
+		CHECK(holes(r, 0, height / 2 - 2) == width * (height / 2 - 2));
+	}
+
+	// The camera inside a ball seen from within : every pixel is covered.
+	{
+		const raster_mesh ball{ make_ball(true) };
+		const float world[16]{ 2, 0, 0, 0, 0, 2, 0, 0, 0, 0, 2, 0, 0, 0, 0, 1 };
+		float camera[16];
+		view_projection(0.3f, 0.2f, -0.3f, camera);
+		software_rasterizer r{ width, height };
+		r.clear(0);
+		r.draw(ball, world, camera);
+		r.resolve();
+		CHECK(holes(r, 0, height) == 0);
+	}
+
+	// A field of balls : the image and the statistics do not depend on the thread count.
+	const raster_mesh ball{ make_ball(false) };
+	float camera[16];
+	view_projection(0, 4, -16, camera);
+	std::vector<uint32_t> reference;
+	software_rasterizer_statistics reference_counts;
+	for (size_t threads : { 1, 2, 3, 8 })
+	{
+		software_rasterizer r{ width, height, 64, threads };
+		r.clear(0xFF000000);
+		for (int i = 0; i < 60; ++i)
+		{
+			const float world[16]{ 0.5f, 0, 0, 0, 0, 0.5f, 0, 0, 0, 0, 0.5f, 0, i % 10 * 1.2f - 5.4f, 0, i / 10 * 1.2f, 1 };
+			r.draw(ball, world, camera);
+		}
+		r.resolve();
+		if (reference.empty())
+		{
+			reference.assign(r.color_buffer(), r.color_buffer() + r.pitch() * r.height());
+			reference_counts = r.statistics();
+			CHECK(reference_counts.binned > 0);
+			continue;
+		}
+		CHECK(0 == memcmp(reference.data(), r.color_buffer(), reference.size() * sizeof(uint32_t)));
+		CHECK(r.statistics().culled == reference_counts.culled && r.statistics().binned == reference_counts.binned);
+	}
+	return test_result();
+}
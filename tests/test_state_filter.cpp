@@ -0,0 +1,166 @@
+#include "state_filter.h"
+
+#include <random>
+#include <string>
+
+#include "test.h"
+
+namespace
+{
+	template <class T>
+	T* handle(uintptr_t value) { return reinterpret_cast<T*>(value * 16); }
+
+	// Stands in for the device context : keeps the state the calls leave behind and records it at every draw, so a
+	// stream replayed with and without the filter must give the same draws. A call may change any binding, which is
+	// modelled by scrambling them all.
+	class device_model : public command_backend
+	{
+	public:
+		std::vector<std::string> draws;
+		uint64_t calls{ 0 };
+
+		void set_input_layout(ID3D11InputLayout* v) override { state.input_layout = v; ++calls; }
+		void set_vertex_shader(ID3D11VertexShader* v) override { state.vertex_shader = v; ++calls; }
+		void set_pixel_shader(ID3D11PixelShader* v) override { state.pixel_shader = v; ++calls; }
+		void set_vertex_buffer(ID3D11Buffer* b, uint32_t stride, uint32_t offset) override { state.vertex_buffer = b; state.vertex_stride = stride; state.vertex_offset = offset; ++calls; }
+		void set_index_buffer(ID3D11Buffer* b, uint32_t size, uint32_t offset) override { state.index_buffer = b; state.index_size = size; state.index_offset = offset; ++calls; }
+		void set_topology(command_stream::primitive_topology t) override { state.topology = t; ++calls; }
+		void set_shader_resources(uint32_t first, uint32_t count, ID3D11ShaderResourceView* const* views) override
+		{
+			for (uint32_t k = 0; k < count; ++k) state.shader_resources[first + k] = views[k];
+			++calls;
+		}
+		void set_constants(uint32_t slot, const void* data, uint32_t size) override
+		{
+			constants[slot].assign(static_cast<const char*>(data), size);
+			++calls;
+		}
+		void set_instances(const void* data, uint32_t stride, uint32_t count) override { instances.assign(static_cast<const char*>(data), stride * count); }
+		void set_vertices(const void* data, uint32_t stride, uint32_t count) override
+		{
+			state.vertex_buffer = handle<ID3D11Buffer>(999);
+			state.vertex_stride = stride;
+			state.vertex_offset = 0;
+			instances.assign(static_cast<const char*>(data), stride * count);
+		}
+		void draw(uint32_t vertex_count, uint32_t start) override { snapshot("draw " + std::to_string(vertex_count) + " " + std::to_string(start)); }
+		void draw_indexed(uint32_t index_count, uint32_t start, int32_t base) override
+		{
+			snapshot("indexed " + std::to_string(index_count) + " " + std::to_string(start) + " " + std::to_string(base));
+		}
+		void draw_indexed_instanced(uint32_t index_count, uint32_t instance_count, uint32_t start, int32_t base) override
+		{
+			snapshot("instanced " + std::to_string(index_count) + " " + std::to_string(instance_count) + " " + std::to_string(start) + " " + std::to_string(base) + instances);
+		}
+		void call(const std::function<void(ID3D11DeviceContext*)>& function) override
+		{
+			function(nullptr);
+			memset(&state, 0xCD, sizeof(state));
+			for (std::string& c : constants) c = "?";
+			snapshot("call");
+		}
+
+	private:
+		struct bindings
+		{
+			ID3D11InputLayout* input_layout;
+			ID3D11VertexShader* vertex_shader;
+			ID3D11PixelShader* pixel_shader;
+			ID3D11Buffer* vertex_buffer;
+			uint32_t vertex_stride, vertex_offset;
+			ID3D11Buffer* index_buffer;
+			uint32_t index_size, index_offset;
+			uint32_t topology;
+			ID3D11ShaderResourceView* shader_resources[state_filter::max_shader_resource_slots];
+		} state{};
+		std::string constants[state_filter::max_constant_slots];
+		std::string instances;
+
+		void snapshot(const std::string& what)
+		{
+			std::string s(reinterpret_cast<const char*>(&state), sizeof(state));
+			for (const std::string& c : constants) s += c + "|";
+			draws.push_back(s + what);
+		}
+	};
+}
+
+int main()
+{
+	// A frame like the framework records : sorted by shader, then mesh and material, with the same constants and
+	// textures bound over and over, some per object constants, sprites and the odd immediate call.
+	std::mt19937 rng(1);
+	const std::function<void(ID3D11DeviceContext*)> immediate{ [](ID3D11DeviceContext*) {} };
+	command_stream stream;
+	float scene[40]{};
+	for (uint32_t i = 0; i < 20000; ++i)
+	{
+		const uint32_t shader{ i / 5000 }, mesh{ (i / 200) % 7 }, material{ (i / 50) % 3 };
+		if (i % 5000 == 0)
+		{
+			stream.set_input_layout(handle<ID3D11InputLayout>(1 + shader));
+			stream.set_vertex_shader(handle<ID3D11VertexShader>(10 + shader));
+			stream.set_pixel_shader(handle<ID3D11PixelShader>(20));
+			stream.set_topology(command_stream::triangle_list);
+		}
+		if (rng() % 997 == 0)
+		{
+			stream.call(&immediate);
+		}
+		stream.set_vertex_buffer(handle<ID3D11Buffer>(100 + mesh), 32, 0);
+		stream.set_index_buffer(handle<ID3D11Buffer>(200 + mesh), rng() % 2 ? 2 : 4, 0);
+		ID3D11ShaderResourceView* views[3]{ handle<ID3D11ShaderResourceView>(300 + material), handle<ID3D11ShaderResourceView>(310 + rng() % 2), handle<ID3D11ShaderResourceView>(320) };
+		stream.set_shader_resources(0, 3, views);
+		scene[0] = static_cast<float>(material);
+		scene[1] = rng() % 3 == 0 ? static_cast<float>(i) : 0.0f;
+		stream.set_constants(0, scene, rng() % 50 ? sizeof(scene) : sizeof(float) * 4);
+		stream.set_constants(1, scene, sizeof(float) * 4);
+		if (i % 4 == 0)
+		{
+			float* worlds{ static_cast<float*>(stream.set_instances(64, 2)) };
+			for (int k = 0; k < 32; ++k) worlds[k] = static_cast<float>(i + k);
+			stream.draw_indexed_instanced(300, 2, 0, 0);
+		}
+		else if (i % 1000 == 999)
+		{
+			float* quad{ static_cast<float*>(stream.set_vertices(16, 4)) };
+			for (int k = 0; k < 16; ++k) quad[k] = static_cast<float>(k);
+			stream.set_topology(command_stream::triangle_strip);
+			stream.draw(4, 0);
+			stream.set_topology(command_stream::triangle_list);
+		}
+		else
+		{
+			stream.draw_indexed(300, i % 5 * 300, 0);
+		}
+	}
+
+	device_model direct;
+	replay(stream, direct);
+	device_model filtered;
+	state_filter filter{ filtered };
+	replay(stream, filter);
+
+	CHECK(filtered.draws.size() == direct.draws.size());
+	size_t first_difference{ 0 };
+	while (first_difference < direct.draws.size() && first_difference < filtered.draws.size() && direct.draws[first_difference] == filtered.draws[first_difference])
+	{
+		++first_difference;
+	}
+	CHECK(first_difference == direct.draws.size());
+	const state_filter_statistics& statistics{ filter.statistics() };
+	printf("%zu draws, %llu state calls without the filter, %llu with it (issued %u, filtered %u)\n", direct.draws.size(),
+		static_cast<unsigned long long>(direct.calls), static_cast<unsigned long long>(filtered.calls), statistics.issued, statistics.filtered);
+	CHECK(statistics.issued == filtered.calls);
+	CHECK(statistics.issued + statistics.filtered == direct.calls);
+	CHECK(filtered.calls * 2 < direct.calls);
+
+	// The next frame on a new context : after invalidate the filter issues every binding again.
+	filtered = device_model{};
+	filter.reset_statistics();
+	filter.invalidate();
+	replay(stream, filter);
+	CHECK(filtered.draws == direct.draws);
+	CHECK(filter.statistics().issued + filter.statistics().filtered == direct.calls);
+	return test_result();
+}
@@ -0,0 +1,66 @@
+#include "vertex_cache_optimizer.h"
+
+#include <algorithm>
+#include <array>
+#include <random>
+
+#include "test.h"
+
+namespace
+{
+	std::vector<std::array<uint32_t, 3>> sorted_triangles(const uint32_t* indices, size_t index_count)
+	{
+		std::vector<std::array<uint32_t, 3>> triangles;
+		for (size_t i = 0; i + 2 < index_count; i += 3)
+		{
+			triangles.push_back({ indices[i], indices[i + 1], indices[i + 2] });
+		}
+		std::sort(triangles.begin(), triangles.end());
+		return triangles;
+	}
+}
+
+int main()
+{
+	std::vector<obj_vertex> vertices;
+	std::vector<uint32_t> indices;
+	make_sphere(128, 64, 0.0f, vertices, indices);
+
+	// A scanned mesh without locality : the triangles of each of two subsets in random order.
+	const size_t split{ indices.size() / 6 * 3 };
+	std::mt19937 rng(1);
+	std::vector<std::array<uint32_t, 3>> triangles;
+	for (size_t i = 0; i < indices.size(); i += 3)
+	{
+		triangles.push_back({ indices[i], indices[i + 1], indices[i + 2] });
+	}
+	std::shuffle(triangles.begin(), triangles.begin() + split / 3, rng);
+	std::shuffle(triangles.begin() + split / 3, triangles.end(), rng);
+	for (size_t t = 0; t < triangles.size(); ++t)
+	{
+		std::copy(triangles[t].begin(), triangles[t].end(), indices.begin() + t * 3);
+	}
+	const std::vector<uint32_t> shuffled{ indices };
+
+	vertex_cache_statistics before{ analyze_vertex_cache(indices.data(), indices.size(), vertices.size()) };
+	optimize_vertex_cache(indices.data(), split, vertices.size());
+	optimize_vertex_cache(indices.data() + split, indices.size() - split, vertices.size());
+	vertex_cache_statistics after{ analyze_vertex_cache(indices.data(), indices.size(), vertices.size()) };
+	printf("ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", before.acmr, after.acmr, before.atvr, after.atvr);
+
+	// Each subset keeps the same triangles, with the same winding.
+	CHECK(sorted_triangles(indices.data(), split) == sorted_triangles(shuffled.data(), split));
+	CHECK(sorted_triangles(indices.data() + split, indices.size() - split) == sorted_triangles(shuffled.data() + split, shuffled.size() - split));
+
+	CHECK(before.triangle_count == indices.size() / 3 && after.triangle_count == before.triangle_count);
+	CHECK(after.unique_vertex_count == before.unique_vertex_count);
+	CHECK(before.acmr > 2.5f);
+	CHECK(after.acmr < 0.8f);
+	CHECK(after.atvr < 1.5f);
+
+	// Reoptimizing an optimized list does not make it worse, and an empty range is left alone.
+	optimize_vertex_cache(indices.data(), indices.size(), vertices.size());
+	CHECK(analyze_vertex_cache(indices.data(), indices.size(), vertices.size()).acmr <= after.acmr * 1.02f);
+	optimize_vertex_cache(indices.data(), 0, vertices.size());
+	return test_result();
+}
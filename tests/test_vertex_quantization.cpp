@@ -0,0 +1,106 @@
+#include "vertex_quantization.h"
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+
+#include "test.h"
+
+int main()
+{
+	// Half floats : every finite half survives a round trip, and rounding is to nearest even like the hardware.
+	size_t round_trip_failures{ 0 };
+	for (uint32_t h = 0; h < 0x10000; ++h)
+	{
+		if ((h & 0x7C00) == 0x7C00 && (h & 0x3FF) != 0)
+		{
+			continue;
+		}
+		round_trip_failures += float_to_half(half_to_float(static_cast<uint16_t>(h))) != h;
+	}
+	CHECK(round_trip_failures == 0);
+	CHECK(float_to_half(1.0f) == 0x3C00);
+	CHECK(float_to_half(-2.0f) == 0xC000);
+	CHECK(float_to_half(65504.0f) == 0x7BFF);
+	CHECK(float_to_half(1e6f) == 0x7C00);
+	CHECK(float_to_half(1.0f + 1.0f / 2048) == 0x3C00);	// halfway, rounds to even
+	CHECK(float_to_half(1.0f + 3.0f / 2048) == 0x3C02);
+	CHECK(half_to_float(0x0001) == 5.9604645e-8f);	// smallest subnormal
+
+	// Octahedral normals : the snorm16x2 encoding keeps every unit vector within a twentieth of a degree.
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> unit(-1, 1);
+	float max_degrees{ 0 };
+	for (int i = 0; i < 200000; ++i)
+	{
+		float n[3]{ unit(rng), unit(rng), unit(rng) };
+		const float length{ sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]) };
+		if (length < 1e-3f)
+		{
+			continue;
+		}
+		for (float& c : n) c /= length;
+		int16_t encoded[2];
+		encode_octahedral_normal(n, encoded);
+		float decoded[3];
+		decode_octahedral_normal(encoded, decoded);
+		const float dot{ std::min(1.0f, n[0] * decoded[0] + n[1] * decoded[1] + n[2] * decoded[2]) };
+		max_degrees = std::max(max_degrees, acosf(dot) * 57.29578f);
+	}
+	printf("octahedral normal error %.4f degrees\n", max_degrees);
+	CHECK(max_degrees < 0.05f);
+	const float axes[][3]{ { 1, 0, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+	for (const float* axis : axes)
+	{
+		int16_t encoded[2];
+		encode_octahedral_normal(axis, encoded);
+		float decoded[3];
+		decode_octahedral_normal(encoded, decoded);
+		CHECK(fabsf(decoded[0] - axis[0]) < 1e-4f && fabsf(decoded[1] - axis[1]) < 1e-4f && fabsf(decoded[2] - axis[2]) < 1e-4f);
+	}
+
+	// Whole vertices : positions within half a step of 16-bit fixed point over the bounds, normals and texcoords as
+	// above, and measure_quantization_error agrees with a dequantize round trip.
+	std::vector<obj_vertex> vertices;
+	std::vector<uint32_t> indices;
+	make_sphere(128, 64, 0.05f, vertices, indices);
+	for (obj_vertex& v : vertices)
+	{
+		v.position[0] = v.position[0] * 3 + 10;
+		v.position[2] *= 0.5f;
+		v.texcoord[0] *= 3.7f;
+	}
+	const quantization_bounds bounds{ compute_quantization_bounds(vertices.data(), vertices.size()) };
+	std::vector<quantized_vertex> quantized(vertices.size());
+	quantize_vertices(vertices.data(), vertices.size(), bounds, quantized.data());
+	const quantization_error error{ measure_quantization_error(vertices.data(), quantized.data(), quantized.size(), bounds) };
+	printf("position error %g (rms %g), normal error %g degrees (rms %g), texcoord error %g\n",
+		error.max_position_error, error.rms_position_error, error.max_normal_error, error.rms_normal_error, error.max_texcoord_error);
+
+	std::vector<obj_vertex> decoded(vertices.size());
+	dequantize_vertices(quantized.data(), quantized.size(), bounds, decoded.data());
+	float max_position{ 0 }, max_texcoord{ 0 };
+	bool within_step{ true };
+	for (size_t i = 0; i < vertices.size(); ++i)
+	{
+		float squared{ 0 };
+		for (int k = 0; k < 3; ++k)
+		{
+			const float difference{ decoded[i].position[k] - vertices[i].position[k] };
+			within_step = within_step && fabsf(difference) <= bounds.scale[k] / 65535 * 0.5f + 1e-6f;
+			squared += difference * difference;
+		}
+		max_position = std::max(max_position, sqrtf(squared));
+		for (int k = 0; k < 2; ++k)
+		{
+			max_texcoord = std::max(max_texcoord, fabsf(decoded[i].texcoord[k] - vertices[i].texcoord[k]));
+		}
+	}
+	CHECK(within_step);
+	CHECK(fabsf(max_position - error.max_position_error) <= 1e-6f);
+	CHECK(fabsf(max_texcoord - error.max_texcoord_error) <= 1e-6f);
+	CHECK(error.max_normal_error < 0.05f);
+	CHECK(error.max_texcoord_error > 0 && error.max_texcoord_error <= 1.0f / 1024);	// half an ulp of half precision below 4
+	CHECK(sizeof(quantized_vertex) * 2 == sizeof(obj_vertex));
+	return test_result();
+}
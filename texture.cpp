@@ -4,6 +4,8 @@
 #include <WICTextureLoader.h>
 using namespace DirectX;
 
+#include <wincodec.h>
+
 #include <wrl.h>
 using namespace Microsoft::WRL;
 
@@ -42,6 +44,120 @@ HRESULT load_texture_from_file(ID3D11Device* device, const wchar_t* filename, ID
 	return hr;
 }
 
+HRESULT decode_texture_from_file(const wchar_t* filename, decoded_texture& decoded)
+{
+	decoded = {};
+	decoded.filename = filename;
+
+	// Worker threads have no COM apartment of their own; WIC objects are free threaded.
+	HRESULT hr{ CoInitializeEx(nullptr, COINIT_MULTITHREADED) };
+	const bool uninitialize{ SUCCEEDED(hr) };
+	{
+		ComPtr<IWICImagingFactory> factory;
+		hr = CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(factory.GetAddressOf()));
+		ComPtr<IWICBitmapDecoder> decoder;
+		if (SUCCEEDED(hr))
+		{
+			hr = factory->CreateDecoderFromFilename(filename, nullptr, GENERIC_READ, WICDecodeMetadataCacheOnDemand, decoder.GetAddressOf());
+		}
+		ComPtr<IWICBitmapFrameDecode> frame;
+		if (SUCCEEDED(hr))
+		{
+			hr = decoder->GetFrame(0, frame.GetAddressOf());
+		}
+		ComPtr<IWICFormatConverter> converter;
+		if (SUCCEEDED(hr))
+		{
+			hr = factory->CreateFormatConverter(converter.GetAddressOf());
+		}
+		if (SUCCEEDED(hr))
+		{
+			hr = converter->Initialize(frame.Get(), GUID_WICPixelFormat32bppRGBA, WICBitmapDitherTypeNone, nullptr, 0.0, WICBitmapPaletteTypeCustom);
+		}
+		if (SUCCEEDED(hr))
+		{
+			hr = converter->GetSize(&decoded.width, &decoded.height);
+		}
+		if (SUCCEEDED(hr))
+		{
+			const UINT pitch{ decoded.width * 4 };
+			decoded.pixels.resize(static_cast<size_t>(pitch) * decoded.height);
+			hr = converter->CopyPixels(nullptr, pitch, static_cast<UINT>(decoded.pixels.size()), decoded.pixels.data());
+		}
+		if (FAILED(hr))
+		{
+			decoded.pixels.clear();
+		}
+	}
+	if (uninitialize)
+	{
+		CoUninitialize();
+	}
+	return hr;
+}
+
+future<decoded_texture> decode_texture_async(const wchar_t* filename)
+{
+	return async(launch::async, [filename = wstring(filename)]()
+	{
+		decoded_texture decoded;
+		decode_texture_from_file(filename.c_str(), decoded);
+		return decoded;
+	});
+}
+
+HRESULT create_texture_from_decoded(ID3D11Device* device, const decoded_texture& decoded, ID3D11ShaderResourceView** shader_resource_view, D3D11_TEXTURE2D_DESC* texture2d_desc)
+{
+	HRESULT hr{ S_OK };
+	ComPtr<ID3D11Resource> resource;
+
+	auto it = resources.find(decoded.filename);
+	if (it != resources.end())
+	{
+		*shader_resource_view = it->second.Get();
+		(*shader_resource_view)->AddRef();
+		(*shader_resource_view)->GetResource(resource.GetAddressOf());
+	}
+	else
+	{
+		_ASSERT_EXPR(!decoded.pixels.empty(), L"Texture file not found or not decodable.");
+		if (decoded.pixels.empty())
+		{
+			return E_FAIL;
+		}
+
+		D3D11_TEXTURE2D_DESC desc{};
+		desc.Width = decoded.width;
+		desc.Height = decoded.height;
+		desc.MipLevels = 1;
+		desc.ArraySize = 1;
+		desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		desc.SampleDesc.Count = 1;
+		desc.SampleDesc.Quality = 0;
+		desc.Usage = D3D11_USAGE_DEFAULT;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+		D3D11_SUBRESOURCE_DATA subresource_data{};
+		subresource_data.pSysMem = decoded.pixels.data();
+		subresource_data.SysMemPitch = decoded.width * 4;
+
+		ComPtr<ID3D11Texture2D> texture2d;
+		hr = device->CreateTexture2D(&desc, &subresource_data, texture2d.GetAddressOf());
+		_ASSERT_EXPR(SUCCEEDED(hr), hr_trace(hr));
+		hr = device->CreateShaderResourceView(texture2d.Get(), nullptr, shader_resource_view);
+		_ASSERT_EXPR(SUCCEEDED(hr), hr_trace(hr));
+		resources.insert(make_pair(decoded.filename, *shader_resource_view));
+		resource = texture2d;
+	}
+
+	ComPtr<ID3D11Texture2D> texture2d;
+	hr = resource.Get()->QueryInterface<ID3D11Texture2D>(texture2d.GetAddressOf());
+	_ASSERT_EXPR(SUCCEEDED(hr), hr_trace(hr));
+	texture2d->GetDesc(texture2d_desc);
+
+	return hr;
+}
+
 void release_all_textures()
 {
 	resources.clear();
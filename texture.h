@@ -2,7 +2,26 @@
 
 #include <d3d11.h>
 
+#include <cstdint>
+#include <future>
+#include <string>
+#include <vector>
+
 HRESULT load_texture_from_file(ID3D11Device* device, const wchar_t* filename, ID3D11ShaderResourceView** shader_resource_view, D3D11_TEXTURE2D_DESC* texture2d_desc);
 void release_all_textures();
 HRESULT make_dummy_texture(ID3D11Device* device, ID3D11ShaderResourceView** shader_resource_view, DWORD value/*0xAABBGGRR*/, UINT dimension);
 
+// CPU side of an image file, decoded to 32-bit RGBA. decode_texture_from_file does not touch the device and may run
+// on any thread; create_texture_from_decoded then creates the texture on the thread that owns the device.
+struct decoded_texture
+{
+	std::wstring filename;
+	UINT width{ 0 };
+	UINT height{ 0 };
+	std::vector<uint8_t> pixels;	// width * height RGBA8 texels, empty if decoding failed
+};
+HRESULT decode_texture_from_file(const wchar_t* filename, decoded_texture& decoded);
+std::future<decoded_texture> decode_texture_async(const wchar_t* filename);
+// Shares the same cache as load_texture_from_file, keyed by the file name.
+HRESULT create_texture_from_decoded(ID3D11Device* device, const decoded_texture& decoded, ID3D11ShaderResourceView** shader_resource_view, D3D11_TEXTURE2D_DESC* texture2d_desc);
+
@@ -0,0 +1,240 @@
+#include "vertex_cache_optimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+	constexpr int simulated_cache_size{ 32 };
+	constexpr float cache_decay_power{ 1.5f };
+	constexpr float last_triangle_score{ 0.75f };
+	constexpr float valence_boost_scale{ 2.0f };
+	constexpr float valence_boost_power{ 0.5f };
+	constexpr uint32_t max_valence{ 64 };
+
+	// Scores are tabulated; valences above 'max_valence' share the last entry.
+	struct score_table
+	{
+		float cache[simulated_cache_size];
+		float valence[max_valence + 1];
+
+		score_table()
+		{
+			for (int i = 0; i < simulated_cache_size; ++i)
+			{
+				if (i < 3)
+				{
+					// The vertices of the triangle that was just added get a fixed score, so the
+					// algorithm does not prefer re-using them over the others in the cache.
+					cache[i] = last_triangle_score;
+				}
+				else
+				{
+					const float scaler{ 1.0f / (simulated_cache_size - 3) };
+					cache[i] = powf(1.0f - (i - 3) * scaler, cache_decay_power);
+				}
+			}
+			valence[0] = 0.0f;
+			for (uint32_t i = 1; i <= max_valence; ++i)
+			{
+				// Bonus for vertices with few remaining triangles, so that lone triangles are not left behind.
+				valence[i] = valence_boost_scale * powf(static_cast<float>(i), -valence_boost_power);
+			}
+		}
+
+		float score(int cache_position, uint32_t remaining_valence) const
+		{
+			if (remaining_valence == 0)
+			{
+				return -1.0f;
+			}
+			float s{ cache_position < 0 ? 0.0f : cache[cache_position] };
+			return s + valence[std::min(remaining_valence, max_valence)];
+		}
+	};
+	const score_table& scores()
+	{
+		static const score_table table;
+		return table;
+	}
+}
+
+void optimize_vertex_cache(uint32_t* indices, size_t index_count, size_t vertex_count)
+{
+	const size_t triangle_count{ index_count / 3 };
+	if (triangle_count < 2)
+	{
+		return;
+	}
+	const score_table& table{ scores() };
+
+	// Vertex -> triangle adjacency in compressed rows.
+	std::vector<uint32_t> valence(vertex_count, 0);
+	for (size_t i = 0; i < triangle_count * 3; ++i)
+	{
+		++valence[indices[i]];
+	}
+	std::vector<uint32_t> offsets(vertex_count + 1, 0);
+	for (size_t v = 0; v < vertex_count; ++v)
+	{
+		offsets[v + 1] = offsets[v] + valence[v];
+	}
+	std::vector<uint32_t> adjacency(triangle_count * 3);
+	{
+		std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+		for (size_t t = 0; t < triangle_count; ++t)
+		{
+			for (size_t k = 0; k < 3; ++k)
+			{
+				adjacency[fill[indices[t * 3 + k]]++] = static_cast<uint32_t>(t);
+			}
+		}
+	}
+
+	std::vector<int> cache_position(vertex_count, -1);
+	std::vector<float> vertex_score(vertex_count);
+	for (size_t v = 0; v < vertex_count; ++v)
+	{
+		vertex_score[v] = table.score(-1, valence[v]);
+	}
+	std::vector<float> triangle_score(triangle_count);
+	std::vector<bool> emitted(triangle_count, false);
+	for (size_t t = 0; t < triangle_count; ++t)
+	{
+		triangle_score[t] = vertex_score[indices[t * 3 + 0]] + vertex_score[indices[t * 3 + 1]] + vertex_score[indices[t * 3 + 2]];
+	}
+
+	std::vector<uint32_t> output;
+	output.reserve(triangle_count * 3);
+
+	// LRU cache of vertex ids, with room for the three vertices pushed by a new triangle.
+	uint32_t cache[simulated_cache_size + 3];
+	size_t cache_count{ 0 };
+
+	size_t best_triangle{ 0 };
+	for (size_t t = 1; t < triangle_count; ++t)
+	{
+		if (triangle_score[t] > triangle_score[best_triangle])
+		{
+			best_triangle = t;
+		}
+	}
+	size_t scan_cursor{ 0 };
+	// Vertices of emitted triangles, most recent last. Used to restart near the last emitted area once
+	// the cache has no live triangles left, instead of jumping to an unrelated part of the mesh.
+	std::vector<uint32_t> dead_end;
+
+	for (size_t emitted_count = 0; emitted_count < triangle_count; ++emitted_count)
+	{
+		while (best_triangle == SIZE_MAX && !dead_end.empty())
+		{
+			uint32_t v{ dead_end.back() };
+			dead_end.pop_back();
+			if (valence[v] > 0)
+			{
+				best_triangle = adjacency[offsets[v]];
+			}
+		}
+		if (best_triangle == SIZE_MAX)
+		{
+			// Nothing is left around the emitted area; continue with the next triangle in input order.
+			while (emitted[scan_cursor]) ++scan_cursor;
+			best_triangle = scan_cursor;
+		}
+
+		emitted[best_triangle] = true;
+		const uint32_t* triangle{ indices + best_triangle * 3 };
+		output.insert(output.end(), triangle, triangle + 3);
+		dead_end.insert(dead_end.end(), triangle, triangle + 3);
+
+		// Remove the triangle from the adjacency of its vertices.
+		for (size_t k = 0; k < 3; ++k)
+		{
+			uint32_t v{ triangle[k] };
+			uint32_t* begin{ adjacency.data() + offsets[v] };
+			uint32_t* end{ begin + valence[v] };
+			uint32_t* found{ std::find(begin, end, static_cast<uint32_t>(best_triangle)) };
+			*found = *(end - 1);
+			--valence[v];
+		}
+
+		// Push the triangle's vertices to the front of the LRU cache.
+		uint32_t new_cache[simulated_cache_size + 3];
+		size_t new_count{ 0 };
+		for (size_t k = 0; k < 3; ++k)
+		{
+			new_cache[new_count++] = triangle[k];
+		}
+		for (size_t i = 0; i < cache_count; ++i)
+		{
+			uint32_t v{ cache[i] };
+			if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+			{
+				new_cache[new_count++] = v;
+			}
+		}
+
+		// Rescore everything that was in the cache; vertices falling out lose their cache bonus.
+		for (size_t i = 0; i < new_count; ++i)
+		{
+			uint32_t v{ new_cache[i] };
+			cache_position[v] = i < simulated_cache_size ? static_cast<int>(i) : -1;
+			vertex_score[v] = table.score(cache_position[v], valence[v]);
+		}
+		cache_count = std::min(new_count, static_cast<size_t>(simulated_cache_size));
+		std::copy(new_cache, new_cache + cache_count, cache);
+
+		// The next triangle is the best one touching the cache.
+		best_triangle = SIZE_MAX;
+		float best_score{ -1.0f };
+		for (size_t i = 0; i < new_count; ++i)
+		{
+			uint32_t v{ new_cache[i] };
+			for (uint32_t j = 0; j < valence[v]; ++j)
+			{
+				uint32_t t{ adjacency[offsets[v] + j] };
+				const uint32_t* tri{ indices + t * 3 };
+				float score{ vertex_score[tri[0]] + vertex_score[tri[1]] + vertex_score[tri[2]] };
+				if (score > best_score)
+				{
+					best_score = score;
+					best_triangle = t;
+				}
+			}
+		}
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+vertex_cache_statistics analyze_vertex_cache(const uint32_t* indices, size_t index_count, size_t vertex_count, uint32_t cache_size)
+{
+	vertex_cache_statistics statistics;
+	statistics.triangle_count = index_count / 3;
+
+	// A vertex is in the FIFO if it was pushed less than 'cache_size' pushes ago.
+	std::vector<size_t> pushed_at(vertex_count, SIZE_MAX);
+	std::vector<bool> referenced(vertex_count, false);
+	size_t push_count{ 0 };
+	for (size_t i = 0; i < statistics.triangle_count * 3; ++i)
+	{
+		uint32_t v{ indices[i] };
+		if (!referenced[v])
+		{
+			referenced[v] = true;
+			++statistics.unique_vertex_count;
+		}
+		if (pushed_at[v] == SIZE_MAX || push_count - pushed_at[v] >= cache_size)
+		{
+			pushed_at[v] = push_count++;
+			++statistics.transformed_vertex_count;
+		}
+	}
+	if (statistics.triangle_count > 0)
+	{
+		statistics.acmr = static_cast<float>(statistics.transformed_vertex_count) / statistics.triangle_count;
+		statistics.atvr = static_cast<float>(statistics.transformed_vertex_count) / statistics.unique_vertex_count;
+	}
+	return statistics;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Post-transform vertex cache optimization of triangle lists (Tom Forsyth, "Linear-Speed Vertex
+// Cache Optimisation"). Triangles are reordered in place; the vertices themselves are untouched, so
+// vertex buffers and index ranges (subsets) stay valid.
+void optimize_vertex_cache(uint32_t* indices, size_t index_count, size_t vertex_count);
+
+struct vertex_cache_statistics
+{
+	size_t triangle_count{ 0 };
+	size_t transformed_vertex_count{ 0 };	// cache misses
+	size_t unique_vertex_count{ 0 };
+	float acmr{ 0.0f };	// average cache miss ratio : transformed vertices per triangle (0.5 is the ideal for large meshes, 3 the worst)
+	float atvr{ 0.0f };	// average transform to vertex ratio : transformed vertices per referenced vertex (1 is the ideal)
+};
+
+// Simulates a FIFO post-transform cache of 'cache_size' entries, as found on most GPUs, over a triangle list.
+vertex_cache_statistics analyze_vertex_cache(const uint32_t* indices, size_t index_count, size_t vertex_count, uint32_t cache_size = 16);
@@ -0,0 +1,250 @@
+#include "vertex_quantization.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	constexpr float unorm16_max{ 65535.0f };
+	constexpr float snorm16_max{ 32767.0f };
+
+	uint16_t to_unorm16(float value)
+	{
+		return static_cast<uint16_t>(lrintf(std::min(std::max(value, 0.0f), 1.0f) * unorm16_max));
+	}
+	float from_snorm16(int16_t value)
+	{
+		// -32768 and -32767 both map to -1, as in the D3D SNORM conversion rules.
+		return std::max(value / snorm16_max, -1.0f);
+	}
+
+	float normalize(float v[3])
+	{
+		float length{ sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]) };
+		if (length > 0)
+		{
+			v[0] /= length;
+			v[1] /= length;
+			v[2] /= length;
+		}
+		return length;
+	}
+}
+
+quantization_bounds compute_quantization_bounds(const obj_vertex* vertices, size_t vertex_count)
+{
+	quantization_bounds bounds;
+	if (vertex_count == 0)
+	{
+		return bounds;
+	}
+	float minimum[3]{ vertices[0].position[0], vertices[0].position[1], vertices[0].position[2] };
+	float maximum[3]{ minimum[0], minimum[1], minimum[2] };
+	for (size_t i = 1; i < vertex_count; ++i)
+	{
+		for (size_t k = 0; k < 3; ++k)
+		{
+			minimum[k] = std::min(minimum[k], vertices[i].position[k]);
+			maximum[k] = std::max(maximum[k], vertices[i].position[k]);
+		}
+	}
+	for (size_t k = 0; k < 3; ++k)
+	{
+		bounds.offset[k] = minimum[k];
+		bounds.scale[k] = maximum[k] - minimum[k];
+	}
+	return bounds;
+}
+
+uint16_t float_to_half(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	const uint16_t sign{ static_cast<uint16_t>((bits >> 16) & 0x8000) };
+	uint32_t magnitude{ bits & 0x7fffffff };
+
+	if (magnitude >= 0x7f800000)
+	{
+		// Infinity, or a quiet NaN.
+		return sign | (magnitude > 0x7f800000 ? 0x7e00 : 0x7c00);
+	}
+	if (magnitude >= 0x477ff000)
+	{
+		// Rounds to 65520 or more : overflows to infinity.
+		return sign | 0x7c00;
+	}
+	if (magnitude < 0x38800000)
+	{
+		// Below the smallest normal half (2^-14) : denormal, in units of 2^-24, rounded to nearest even.
+		float f;
+		memcpy(&f, &magnitude, sizeof(f));
+		return sign | static_cast<uint16_t>(lrintf(f * 16777216.0f));
+	}
+	// Rebias the exponent from 127 to 15 and round the 13 dropped mantissa bits to nearest even.
+	magnitude += 0xc8000fff + ((magnitude >> 13) & 1);
+	return sign | static_cast<uint16_t>(magnitude >> 13);
+}
+
+float half_to_float(uint16_t value)
+{
+	const uint32_t sign{ static_cast<uint32_t>(value & 0x8000) << 16 };
+	const uint32_t exponent{ (value >> 10) & 0x1fu };
+	const uint32_t mantissa{ value & 0x3ffu };
+
+	uint32_t bits;
+	if (exponent == 0)
+	{
+		float f{ mantissa * (1.0f / 16777216.0f) };
+		memcpy(&bits, &f, sizeof(bits));
+		bits |= sign;
+	}
+	else if (exponent == 31)
+	{
+		bits = sign | 0x7f800000 | (mantissa << 13);
+	}
+	else
+	{
+		bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+	}
+	float result;
+	memcpy(&result, &bits, sizeof(result));
+	return result;
+}
+
+void decode_octahedral_normal(const int16_t encoded[2], float normal[3])
+{
+	// Same arithmetic as the decoder in phong_shader_quantized_vs.hlsl.
+	float x{ from_snorm16(encoded[0]) };
+	float y{ from_snorm16(encoded[1]) };
+	float z{ 1.0f - fabsf(x) - fabsf(y) };
+	float t{ std::max(-z, 0.0f) };
+	x += x >= 0 ? -t : t;
+	y += y >= 0 ? -t : t;
+	normal[0] = x;
+	normal[1] = y;
+	normal[2] = z;
+	normalize(normal);
+}
+
+void encode_octahedral_normal(const float normal[3], int16_t encoded[2])
+{
+	float n[3]{ normal[0], normal[1], normal[2] };
+	float l1{ fabsf(n[0]) + fabsf(n[1]) + fabsf(n[2]) };
+	if (l1 == 0)
+	{
+		encoded[0] = encoded[1] = 0;
+		return;
+	}
+	float x{ n[0] / l1 };
+	float y{ n[1] / l1 };
+	if (n[2] < 0)
+	{
+		float folded_x{ (1.0f - fabsf(y)) * (x >= 0 ? 1.0f : -1.0f) };
+		float folded_y{ (1.0f - fabsf(x)) * (y >= 0 ? 1.0f : -1.0f) };
+		x = folded_x;
+		y = folded_y;
+	}
+	normalize(n);
+
+	// Of the four neighbouring snorm16 pairs, keep the one that decodes closest to the normal.
+	const float fx{ floorf(x * snorm16_max) };
+	const float fy{ floorf(y * snorm16_max) };
+	float best_dot{ -2.0f };
+	for (int i = 0; i < 4; ++i)
+	{
+		const int16_t candidate[2]
+		{
+			static_cast<int16_t>(std::min(std::max(fx + (i & 1), -snorm16_max), snorm16_max)),
+			static_cast<int16_t>(std::min(std::max(fy + (i >> 1), -snorm16_max), snorm16_max)),
+		};
+		float decoded[3];
+		decode_octahedral_normal(candidate, decoded);
+		float dot{ decoded[0] * n[0] + decoded[1] * n[1] + decoded[2] * n[2] };
+		if (dot > best_dot)
+		{
+			best_dot = dot;
+			encoded[0] = candidate[0];
+			encoded[1] = candidate[1];
+		}
+	}
+}
+
+void quantize_vertices(const obj_vertex* vertices, size_t vertex_count, const quantization_bounds& bounds, quantized_vertex* quantized)
+{
+	float inverse_scale[3];
+	for (size_t k = 0; k < 3; ++k)
+	{
+		inverse_scale[k] = bounds.scale[k] > 0 ? 1.0f / bounds.scale[k] : 0.0f;
+	}
+	for (size_t i = 0; i < vertex_count; ++i)
+	{
+		const obj_vertex& v{ vertices[i] };
+		quantized_vertex& q{ quantized[i] };
+		for (size_t k = 0; k < 3; ++k)
+		{
+			q.position[k] = to_unorm16((v.position[k] - bounds.offset[k]) * inverse_scale[k]);
+		}
+		q.position[3] = static_cast<uint16_t>(unorm16_max);
+		encode_octahedral_normal(v.normal, q.normal);
+		q.texcoord[0] = float_to_half(v.texcoord[0]);
+		q.texcoord[1] = float_to_half(v.texcoord[1]);
+	}
+}
+
+void dequantize_vertices(const quantized_vertex* quantized, size_t vertex_count, const quantization_bounds& bounds, obj_vertex* vertices)
+{
+	for (size_t i = 0; i < vertex_count; ++i)
+	{
+		const quantized_vertex& q{ quantized[i] };
+		obj_vertex& v{ vertices[i] };
+		for (size_t k = 0; k < 3; ++k)
+		{
+			v.position[k] = bounds.offset[k] + q.position[k] / unorm16_max * bounds.scale[k];
+		}
+		decode_octahedral_normal(q.normal, v.normal);
+		v.texcoord[0] = half_to_float(q.texcoord[0]);
+		v.texcoord[1] = half_to_float(q.texcoord[1]);
+	}
+}
+
+quantization_error measure_quantization_error(const obj_vertex* vertices, const quantized_vertex* quantized, size_t vertex_count, const quantization_bounds& bounds)
+{
+	quantization_error error;
+	double position_sum{ 0 };
+	double normal_sum{ 0 };
+	size_t normal_count{ 0 };
+	for (size_t i = 0; i < vertex_count; ++i)
+	{
+		const obj_vertex& source{ vertices[i] };
+		obj_vertex decoded;
+		dequantize_vertices(quantized + i, 1, bounds, &decoded);
+
+		float d[3]{ decoded.position[0] - source.position[0], decoded.position[1] - source.position[1], decoded.position[2] - source.position[2] };
+		float distance_squared{ d[0] * d[0] + d[1] * d[1] + d[2] * d[2] };
+		error.max_position_error = std::max(error.max_position_error, sqrtf(distance_squared));
+		position_sum += distance_squared;
+
+		float n[3]{ source.normal[0], source.normal[1], source.normal[2] };
+		if (normalize(n) > 0)
+		{
+			float dot{ std::min(std::max(n[0] * decoded.normal[0] + n[1] * decoded.normal[1] + n[2] * decoded.normal[2], -1.0f), 1.0f) };
+			float degrees{ acosf(dot) * 57.2957795f };
+			error.max_normal_error = std::max(error.max_normal_error, degrees);
+			normal_sum += static_cast<double>(degrees) * degrees;
+			++normal_count;
+		}
+
+		error.max_texcoord_error = std::max({ error.max_texcoord_error,
+			fabsf(decoded.texcoord[0] - source.texcoord[0]), fabsf(decoded.texcoord[1] - source.texcoord[1]) });
+	}
+	if (vertex_count > 0)
+	{
+		error.rms_position_error = static_cast<float>(sqrt(position_sum / vertex_count));
+	}
+	if (normal_count > 0)
+	{
+		error.rms_normal_error = static_cast<float>(sqrt(normal_sum / normal_count));
+	}
+	return error;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "obj_loader.h"
+
+// Compact vertex layout, 16 bytes instead of the 32 of obj_vertex / static_mesh::vertex :
+//	position : R16G16B16A16_UNORM, fixed point relative to the bounding box (w is unused and set to 1)
+//	normal   : R16G16_SNORM, octahedral encoding of the unit normal
+//	texcoord : R16G16_FLOAT
+struct quantized_vertex
+{
+	uint16_t position[4];
+	int16_t normal[2];
+	uint16_t texcoord[2];
+};
+static_assert(sizeof(quantized_vertex) == 16, "quantized_vertex must stay 16 bytes");
+
+// Object space position = offset + unorm position * scale.
+struct quantization_bounds
+{
+	float offset[3]{ 0, 0, 0 };
+	float scale[3]{ 1, 1, 1 };
+};
+
+quantization_bounds compute_quantization_bounds(const obj_vertex* vertices, size_t vertex_count);
+
+void quantize_vertices(const obj_vertex* vertices, size_t vertex_count, const quantization_bounds& bounds, quantized_vertex* quantized);
+void dequantize_vertices(const quantized_vertex* quantized, size_t vertex_count, const quantization_bounds& bounds, obj_vertex* vertices);
+
+// Component encoders, decoded the same way the input assembler and the vertex shader do.
+uint16_t float_to_half(float value);
+float half_to_float(uint16_t value);
+void encode_octahedral_normal(const float normal[3], int16_t encoded[2]);
+void decode_octahedral_normal(const int16_t encoded[2], float normal[3]);
+
+struct quantization_error
+{
+	float max_position_error{ 0 };	// object space units
+	float rms_position_error{ 0 };
+	float max_normal_error{ 0 };	// degrees
+	float rms_normal_error{ 0 };
+	float max_texcoord_error{ 0 };	// texture space units
+};
+
+// Round-trip error of 'quantized' against the source 'vertices'.
+quantization_error measure_quantization_error(const obj_vertex* vertices, const quantized_vertex* quantized, size_t vertex_count, const quantization_bounds& bounds);